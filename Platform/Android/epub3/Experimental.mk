@@ -190,6 +190,9 @@
 #    $(THIRD_PARTY_PATH)/libzip/zip_fread.c \
 #    $(THIRD_PARTY_PATH)/libzip/zip_free.c \
 #    $(THIRD_PARTY_PATH)/libzip/zip_fseek.c \
+#    $(THIRD_PARTY_PATH)/libzip/zip_seekindex.c \
+#    $(THIRD_PARTY_PATH)/libzip/zip_pread.c \
+#    $(THIRD_PARTY_PATH)/libzip/zip_name_index.c \
 #    $(THIRD_PARTY_PATH)/libzip/zip_ftell.c \
 #    $(THIRD_PARTY_PATH)/libzip/zip_get_archive_comment.c \
 #    $(THIRD_PARTY_PATH)/libzip/zip_get_archive_flag.c \
@@ -205,6 +208,7 @@
 #    $(THIRD_PARTY_PATH)/libzip/zip_set_archive_comment.c \
 #    $(THIRD_PARTY_PATH)/libzip/zip_set_archive_flag.c \
 #    $(THIRD_PARTY_PATH)/libzip/zip_set_file_comment.c \
+#    $(THIRD_PARTY_PATH)/libzip/zip_set_lock_callbacks.c \
 #    $(THIRD_PARTY_PATH)/libzip/zip_set_name.c \
 #    $(THIRD_PARTY_PATH)/libzip/zip_source_buffer.c \
 #    $(THIRD_PARTY_PATH)/libzip/zip_source_file.c \
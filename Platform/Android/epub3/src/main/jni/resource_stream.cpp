@@ -258,10 +258,16 @@ static jlong GetBytesRangeX(JNIEnv* env, jobject thiz, jlong nativePtr, jlong of
 		readBytes = rangeByteStream->ReadBytes(reinterpret_cast<uint8_t*>(tmpBuffer), (std::size_t)dataLength, range);
 	} else {
 		ePub3::SeekableByteStream *seekableStream = dynamic_cast<ePub3::SeekableByteStream *>(byteStream);
+		ePub3::FilterChainByteStream *nonRangeByteStream = dynamic_cast<ePub3::FilterChainByteStream *>(byteStream);
 		if (seekableStream != nullptr) {
 			LOGD("JNI --- GetBytesRange_ SeekableByteStream\n");
 			seekableStream->Seek((std::size_t)offset, std::ios::beg);
 			readBytes = seekableStream->ReadBytes(reinterpret_cast<uint8_t*>(tmpBuffer), (std::size_t)dataLength);
+		} else if (nonRangeByteStream != nullptr) {
+			// the filtered content is cached, so this doesn't run the filters again
+			LOGD("JNI --- GetBytesRange_ FilterChainByteStream\n");
+			nonRangeByteStream->Seek((std::size_t)offset, std::ios::beg);
+			readBytes = nonRangeByteStream->ReadBytes(reinterpret_cast<uint8_t*>(tmpBuffer), (std::size_t)dataLength);
 		} else {
 			env->ThrowNew(java_class_IOException, "Seek operation not supported for this byte stream.");
 			return 0;
@@ -300,10 +306,16 @@ static jbyteArray GetBytesRange(JNIEnv* env, jobject thiz, jlong nativePtr, jlon
 		readBytes = rangeByteStream->ReadBytes(reinterpret_cast<uint8_t*>(tmpBuffer), (std::size_t)length, range);
 	} else {
 		ePub3::SeekableByteStream *seekableStream = dynamic_cast<ePub3::SeekableByteStream *>(byteStream);
+		ePub3::FilterChainByteStream *nonRangeByteStream = dynamic_cast<ePub3::FilterChainByteStream *>(byteStream);
 		if (seekableStream != nullptr) {
 			LOGD("JNI --- GetBytesRange SeekableByteStream\n");
 			seekableStream->Seek((std::size_t)offset, std::ios::beg);
 			readBytes = seekableStream->ReadBytes(reinterpret_cast<uint8_t*>(tmpBuffer), (std::size_t)length);
+		} else if (nonRangeByteStream != nullptr) {
+			// the filtered content is cached, so this doesn't run the filters again
+			LOGD("JNI --- GetBytesRange FilterChainByteStream\n");
+			nonRangeByteStream->Seek((std::size_t)offset, std::ios::beg);
+			readBytes = nonRangeByteStream->ReadBytes(reinterpret_cast<uint8_t*>(tmpBuffer), (std::size_t)length);
 		} else {
 			env->ThrowNew(java_class_IOException, "Seek operation not supported for this byte stream.");
 			return NULL;
@@ -335,7 +347,12 @@ static void Skip(JNIEnv* env, jobject thiz, jlong nativePtr, jlong byteCount) {
 	ePub3::SeekableByteStream *seekableStream = dynamic_cast<ePub3::SeekableByteStream*>(byteStream);
 
 	if (seekableStream == nullptr) {
-		// When the ByteStream is most likely a FilterChainByteStream:
+		ePub3::FilterChainByteStream *nonRangeByteStream = dynamic_cast<ePub3::FilterChainByteStream*>(byteStream);
+		if (nonRangeByteStream != nullptr) {
+			nonRangeByteStream->Seek(byteCount, std::ios::cur);
+			return;
+		}
+
 		env->ThrowNew(java_class_IOException, "Skip operation is not supported for this byte stream. (it is most likely not a raw stream)");
 		return;
 	}
@@ -357,7 +374,12 @@ JNIEXPORT void JNICALL Java_org_readium_sdk_android_util_ResourceInputStream_nat
 	ePub3::SeekableByteStream *seekableStream = dynamic_cast<ePub3::SeekableByteStream*>(byteStream);
 
 	if (seekableStream == nullptr) {
-		// When the ByteStream is most likely a FilterChainByteStream:
+		ePub3::FilterChainByteStream *nonRangeByteStream = dynamic_cast<ePub3::FilterChainByteStream*>(byteStream);
+		if (nonRangeByteStream != nullptr) {
+			nonRangeByteStream->Seek(ignoreMark == JNI_TRUE ? 0 : stream->markPosition, std::ios::beg);
+			return;
+		}
+
 		env->ThrowNew(java_class_IOException, "Reset operation is not supported for this byte stream. (it is most likely not a raw stream)");
 		return;
 	}
@@ -377,7 +399,12 @@ JNIEXPORT void JNICALL Java_org_readium_sdk_android_util_ResourceInputStream_nat
 	ePub3::SeekableByteStream *seekableStream = dynamic_cast<ePub3::SeekableByteStream*>(byteStream);
 
 	if (seekableStream == nullptr) {
-		// When the ByteStream is most likely a FilterChainByteStream:
+		ePub3::FilterChainByteStream *nonRangeByteStream = dynamic_cast<ePub3::FilterChainByteStream*>(byteStream);
+		if (nonRangeByteStream != nullptr) {
+			stream->markPosition = nonRangeByteStream->Position();
+			return;
+		}
+
 		env->ThrowNew(java_class_IOException, "Mark operation is not supported for this byte stream. (it is most likely not a raw stream)");
 		return;
 	}
@@ -301,7 +301,7 @@ IInputStream^ RandomAccessStream::GetInputStreamAt(unsigned long long position)
 	}
 	else
 	{
-		// file streams can seek natively
+		// file and memory-mapped streams can seek natively
 		result->Seek(position);
 	}
 
@@ -309,8 +309,8 @@ IInputStream^ RandomAccessStream::GetInputStreamAt(unsigned long long position)
 }
 IOutputStream^ RandomAccessStream::GetOutputStreamAt(unsigned long long position)
 {
-	// can't generate an in-the-middle output stream for a zip file...
-	if (!bool(_native) || bool(std::dynamic_pointer_cast<::ePub3::ZipFileByteStream>(_native)))
+	// can't generate an in-the-middle output stream for a zip file, whether it's read through libzip or a mapping...
+	if (!bool(_native) || bool(std::dynamic_pointer_cast<::ePub3::ZipFileByteStream>(_native)) || bool(std::dynamic_pointer_cast<::ePub3::MappedByteStream>(_native)))
 		return nullptr;
 
 	IRandomAccessStream^ result = CloneStream();
@@ -0,0 +1,53 @@
+//
+//  benchmark.h
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+
+#ifndef ePub3_UnitTests_benchmark_h
+#define ePub3_UnitTests_benchmark_h
+
+// Shared by the hidden "[.][benchmark]" test cases, which only run when asked for by tag.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+typedef std::chrono::high_resolution_clock BenchmarkClock;
+
+// Runs `fn` once and returns how long it took.
+template <typename _Fn>
+inline BenchmarkClock::duration TimeBenchmark(_Fn&& fn)
+{
+    auto start = BenchmarkClock::now();
+    fn();
+    return BenchmarkClock::now() - start;
+}
+
+// Prints the heading for a group of results.
+inline void ReportBenchmarkHeading(const std::string& heading)
+{
+    std::cout << heading << ":" << std::endl;
+}
+
+// Prints one result: `elapsed` divided by `iterations`, in whichever of ns, us or ms suits it.
+inline void ReportBenchmark(const std::string& label, BenchmarkClock::duration elapsed, long long iterations = 1)
+{
+    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iterations;
+    std::cout << "  " << label << ": ";
+    if ( ns < 10000 )
+        std::cout << ns << "ns";
+    else if ( ns < 10000000 )
+        std::cout << ns / 1000 << "us";
+    else
+        std::cout << ns / 1000000 << "ms";
+    std::cout << std::endl;
+}
+
+#endif
@@ -14,11 +14,68 @@
 
 
 #include "../ePub3/ePub/cfi.h"
+#include "../ePub3/ePub/cfi_resolver.h"
+#include "../ePub3/ePub/container.h"
+#include "../ePub3/ePub/package.h"
+#include "../ePub3/ePub/manifest.h"
+#include "../ePub3/ePub/spine.h"
 #include "../ePub3/utilities/error_handler.h"
 #include "catch.hpp"
+#include <libxml/parser.h>
+
+#define EPUB_PATH "TestData/childrens-literature-20120722.epub"
 
 using namespace ePub3;
 
+static const char kResolverDocument[] =
+    "<html xmlns='http://www.w3.org/1999/xhtml'><head><title>CFI</title></head>"
+    "<body id='body01'><p>xx<em>yy</em>zz</p>"
+    "<p id='para05'>abc<!-- note --><![CDATA[def]]>g\xF0\x9F\x98\x80h</p>"
+    "<img id='pic' alt='picture'/></body></html>";
+
+// every element and text node below `node`, in document order
+static void CollectLocations(shared_ptr<xml::Node> node, std::vector<shared_ptr<xml::Node>>& locations)
+{
+    for ( auto child = node->FirstChild(); bool(child); child = child->NextSibling() )
+    {
+        if ( child->IsElementNode() )
+        {
+            locations.push_back(child);
+            CollectLocations(child, locations);
+        }
+        else if ( child->IsTextNode() )
+        {
+            locations.push_back(child);
+        }
+    }
+}
+
+// a CFI for every element and text node in each spine item, up to `limit` per item
+static std::vector<CFI> PublicationCFIs(PackagePtr pkg, size_t limit)
+{
+    std::vector<CFI> cfis;
+    for ( auto spineItem = pkg->FirstSpineItem(); bool(spineItem); spineItem = spineItem->Next() )
+    {
+        ManifestItemPtr item = spineItem->ManifestItem();
+        auto doc = (bool(item) ? item->ReferencedDocument() : nullptr);
+        if ( !bool(doc) || !bool(doc->Root()) )
+            continue;
+        
+        std::vector<shared_ptr<xml::Node>> locations;
+        CollectLocations(doc->Root(), locations);
+        if ( locations.size() > limit )
+            locations.resize(limit);
+        
+        CFIResolver resolver(doc);
+        CFI base = pkg->CFIForSpineItem(spineItem);
+        for ( auto& node : locations )
+        {
+            cfis.push_back(base + resolver.CFIForLocation(node, node->IsTextNode() ? 1 : 0));
+        }
+    }
+    return cfis;
+}
+
 TEST_CASE("CFIs should be constructable from valid strings", "")
 {
     // valid strings
@@ -103,3 +160,113 @@ TEST_CASE("Location and Range CFIs should be reassignable by CFI or string, even
     REQUIRE_NOTHROW(base = "/6/4!/4/3:5");
     REQUIRE_FALSE(base.IsRangeTriplet());
 }
+
+TEST_CASE("Content document CFIs should resolve to nodes and character offsets", "")
+{
+    auto doc = xml::Wrapped<xml::Document>(xmlParseMemory(kResolverDocument, sizeof(kResolverDocument)-1));
+    REQUIRE(bool(doc));
+    CFIResolver resolver(doc);
+    
+    CFIResolver::Range range = resolver.Resolve(CFI("/4[body01]/2/1:1"));
+    REQUIRE(range.IsValid());
+    REQUIRE(range.start.node->Content() == "xx");
+    REQUIRE(range.start.offset == 1);
+    
+    // text on both sides of a child element
+    REQUIRE(resolver.Resolve(CFI("/4/2/3:2")).start.node->Content() == "zz");
+    REQUIRE(resolver.Resolve(CFI("/4/2/2/1:0")).start.node->Content() == "yy");
+    
+    // a text run spans the comment and CDATA section; side-bias picks a side at node boundaries
+    range = resolver.Resolve(CFI("/4/4[para05]/1:3"));
+    REQUIRE(range.start.node->Content() == "abc");
+    REQUIRE(range.start.offset == 3);
+    range = resolver.Resolve(CFI("/4/4[para05]/1:3[;s=a]"));
+    REQUIRE(range.start.node->Content() == "def");
+    REQUIRE(range.start.offset == 0);
+    REQUIRE(range.start.sideBias == CFI::SideBias::After);
+    
+    // offsets count UTF-16 units, so the emoji takes two
+    range = resolver.Resolve(CFI("/4/4[para05]/1:9"));
+    REQUIRE(range.start.node->Content() == "g\xF0\x9F\x98\x80h");
+    REQUIRE(range.start.offset == 3);
+    
+    // a mismatched index is corrected using the id assertion
+    range = resolver.Resolve(CFI("/4/2[para05]/1:2"));
+    REQUIRE(range.start.node->Content() == "abc");
+    
+    // ranges resolve both ends
+    range = resolver.Resolve(CFI("/4/2,/1:1,/3:1"));
+    REQUIRE(range.start.node->Content() == "xx");
+    REQUIRE(range.end.node->Content() == "zz");
+    REQUIRE(range.end.offset == 1);
+    
+    // and locations produce the CFI which leads to them, asserting ids along the way
+    REQUIRE(resolver.CFIForLocation(range.end.node, range.end.offset) == "epubcfi(/4[body01]/2/3:1)");
+    REQUIRE(resolver.CFIForLocation(resolver.Resolve(CFI("/4/6")).start.node) == "epubcfi(/4[body01]/6[pic])");
+    
+    REQUIRE_THROWS_AS(resolver.Resolve(CFI("/4/8")), epub_spec_error);
+    REQUIRE_THROWS_AS(resolver.Resolve(CFI("/4/4/5")), epub_spec_error);
+    REQUIRE_THROWS_AS(resolver.Resolve(CFI("/4/4/1:99")), epub_spec_error);
+    
+    // a character offset on an element other than an image doesn't resolve, even when the error is let through
+    REQUIRE(resolver.Resolve(CFI("/4/6:0")).IsValid());
+    REQUIRE_THROWS_AS(resolver.Resolve(CFI("/4/2:1")), epub_spec_error);
+    SetErrorHandler([](const error_details& err){
+        return err.epub_error_code() == EPUBError::CFICharOffsetOnIllegalElement;
+    });
+    REQUIRE_FALSE(resolver.Resolve(CFI("/4/2:1")).IsValid());
+    SetErrorHandler(DefaultErrorHandler);
+}
+
+TEST_CASE("Generated CFIs should resolve back to their nodes", "")
+{
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    PackagePtr pkg = c->DefaultPackage();
+    
+    for ( auto spineItem = pkg->FirstSpineItem(); bool(spineItem); spineItem = spineItem->Next() )
+    {
+        auto doc = spineItem->ManifestItem()->ReferencedDocument();
+        REQUIRE(bool(doc));
+        
+        std::vector<shared_ptr<xml::Node>> locations;
+        CollectLocations(doc->Root(), locations);
+        
+        CFIResolver resolver(doc);
+        for ( auto& node : locations )
+        {
+            CFI cfi = resolver.CFIForLocation(node);
+            REQUIRE_FALSE(cfi.Empty());
+            REQUIRE(resolver.Resolve(cfi).start.node == node);
+        }
+    }
+}
+
+TEST_CASE("Batches of CFIs should resolve across a publication", "")
+{
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    PackagePtr pkg = c->DefaultPackage();
+    
+    std::vector<CFI> cfis = PublicationCFIs(pkg, 50);
+    REQUIRE(cfis.size() > 0);
+    cfis.push_back(CFI("/6/2!/4/999"));
+    
+    std::vector<CFIResolver::Range> ranges = CFIResolver::ResolveAll(pkg, cfis);
+    REQUIRE(ranges.size() == cfis.size());
+    
+    // each valid result agrees with resolving that CFI on its own
+    for ( size_t i = 0; i < cfis.size()-1; i++ )
+    {
+        REQUIRE(ranges[i].IsValid());
+        
+        CFI cfi(cfis[i]), remaining;
+        ManifestItemPtr item = pkg->ManifestItemForCFI(cfi, &remaining);
+        REQUIRE(ranges[i].item == item);
+        
+        // the batch parsed its own copy of the document, so build the CFI against that one
+        CFIResolver resolver(ranges[i].start.node->Document());
+        REQUIRE(resolver.CFIForLocation(ranges[i].start.node, ranges[i].start.offset) == remaining);
+    }
+    
+    // a bad CFI doesn't take the rest of the batch with it
+    REQUIRE_FALSE(ranges.back().IsValid());
+}
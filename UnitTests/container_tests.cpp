@@ -14,12 +14,51 @@
 
 
 #include "../ePub3/ePub/container.h"
+#include "../ePub3/ePub/content_module_manager.h"
+#include "../ePub3/ePub/nav_table.h"
+#include "../ePub3/ePub/manifest.h"
+#include "../ePub3/ePub/document_cache.h"
+#include "../ePub3/ePub/package_snapshot.h"
+#include "../ePub3/ePub/media-overlays_smil_model.h"
+#include "../ePub3/ePub/zip_archive.h"
+#include "../ePub3/ePub/archive_xml.h"
+#include "../ePub3/utilities/byte_stream.h"
 #include "catch.hpp"
+#include "benchmark.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+#include <libxml/HTMLparser.h>
+#include <libxml/HTMLtree.h>
 
 using namespace ePub3;
 
 #define EPUB_PATH "TestData/childrens-literature-20120722.epub"
 
+static const char* kBenchmarkEPUBs[] = {
+    "TestData/alice3.epub",
+    "TestData/childrens-literature-20120722.epub",
+    "TestData/cole-voyage-of-life-20120320.epub",
+    "TestData/dante-hell.epub",
+    "TestData/moby-dick-preview-collection.epub",
+    "TestData/page-blanche.epub",
+    "TestData/wasteland-otf-obf-20120118.epub",
+    "TestData/widget-figure-gallery-20121022.epub",
+};
+
+static ContainerPtr OpenWithParallelism(const char* path, bool parallel)
+{
+    Container::SetParallelOpenEnabled(parallel);
+    ContainerPtr container = Container::OpenContainer(path);
+    Container::SetParallelOpenEnabled(false);
+    return container;
+}
+
 TEST_CASE("opening a container", "The container should open without problem")
 {
     ContainerPtr pContainer = Container::OpenContainer(EPUB_PATH);
@@ -43,3 +82,949 @@ TEST_CASE("", "Version should be 1.0")
     ContainerPtr container = Container::OpenContainer(EPUB_PATH);
     REQUIRE(container->Version() == "1.0");
 }
+
+TEST_CASE("Parallel opening should load the same container as serial opening", "")
+{
+    for ( const char* path : kBenchmarkEPUBs )
+    {
+        CAPTURE(path);
+        ContainerPtr serial = OpenWithParallelism(path, false);
+        ContainerPtr parallel = OpenWithParallelism(path, true);
+        REQUIRE(bool(serial));
+        REQUIRE(bool(parallel));
+        
+        REQUIRE(parallel->EncryptionData().size() == serial->EncryptionData().size());
+        REQUIRE(parallel->GetVendorMetadata_AppleIBooksDisplayOption_FixedLayout() == serial->GetVendorMetadata_AppleIBooksDisplayOption_FixedLayout());
+        REQUIRE(parallel->Packages().size() == serial->Packages().size());
+        
+        for ( size_t i = 0; i < serial->Packages().size(); i++ )
+        {
+            PackagePtr a = serial->Packages()[i];
+            PackagePtr b = parallel->Packages()[i];
+            REQUIRE(b->BasePath() == a->BasePath());
+            REQUIRE(b->UniqueID() == a->UniqueID());
+            REQUIRE(b->Manifest().size() == a->Manifest().size());
+            REQUIRE(b->SpineItemCount() == a->SpineItemCount());
+            REQUIRE(bool(b->TableOfContents()) == bool(a->TableOfContents()));
+            if ( a->TableOfContents() )
+                REQUIRE(b->TableOfContents()->Children().size() == a->TableOfContents()->Children().size());
+        }
+    }
+}
+
+static std::string ReadAll(ByteStream* stream)
+{
+    std::string result;
+    char buf[4096];
+    ByteStream::size_type n;
+    while ( (n = stream->ReadBytes(buf, sizeof(buf))) > 0 )
+        result.append(buf, n);
+    return result;
+}
+
+TEST_CASE("Stored items read through the file mapping should match libzip", "")
+{
+    for ( const char* path : kBenchmarkEPUBs )
+    {
+        CAPTURE(path);
+        ZipArchive::SetMemoryMappingEnabled(false);
+        ContainerPtr plain = Container::OpenContainer(path);
+        ZipArchive::SetMemoryMappingEnabled(true);
+        ContainerPtr mapped = Container::OpenContainer(path);
+        REQUIRE(bool(plain));
+        REQUIRE(bool(mapped));
+        
+        for ( auto& item : mapped->DefaultPackage()->Manifest() )
+        {
+            string itemPath = item.second->AbsolutePath();
+            CAPTURE(itemPath);
+            auto expected = plain->GetArchive()->ByteStreamAtPath(itemPath);
+            auto actual = mapped->GetArchive()->ByteStreamAtPath(itemPath);
+            if ( !bool(expected) || !expected->IsOpen() )
+                continue;
+            REQUIRE(bool(actual));
+            
+            std::string bytes = ReadAll(actual.get());
+            REQUIRE(bytes == ReadAll(expected.get()));
+            
+            // a clone taken part-way through picks up from the same place
+            auto seekable = dynamic_cast<SeekableByteStream*>(actual.get());
+            if ( seekable != nullptr && bytes.size() > 16 )
+            {
+                seekable->Seek(bytes.size() / 2, std::ios::beg);
+                auto clone = seekable->Clone();
+                REQUIRE(bool(clone));
+                REQUIRE(ReadAll(clone.get()) == bytes.substr(bytes.size() / 2));
+            }
+        }
+    }
+    ZipArchive::SetMemoryMappingEnabled(false);
+}
+
+// the serialized form of a document, or an empty string if there isn't one
+static std::string Serialized(xmlDocPtr doc, bool html)
+{
+    if ( doc == nullptr )
+        return std::string();
+    
+    xmlChar* mem = nullptr;
+    int size = 0;
+    if ( html )
+        htmlDocDumpMemory(doc, &mem, &size);
+    else
+        xmlDocDumpMemory(doc, &mem, &size);
+    std::string result(reinterpret_cast<const char*>(mem), size);
+    xmlFree(mem);
+    return result;
+}
+
+static void IgnoreXmlErrors(void*, const char*, ...)
+{
+}
+
+// parses `bytes` the way ManifestItem::ReferencedDocument() did before push parsing
+static std::string ReadFromMemory(const std::string& bytes, const char* url, bool html)
+{
+    xmlDocPtr raw;
+    if ( html )
+        raw = htmlReadMemory(bytes.data(), int(bytes.size()), url, nullptr, ArchiveXmlReader::DEFAULT_OPTIONS);
+    else
+        raw = xmlReadMemory(bytes.data(), int(bytes.size()), url, nullptr, ArchiveXmlReader::DEFAULT_OPTIONS);
+    
+    if ( raw != nullptr && ((raw->type != XML_HTML_DOCUMENT_NODE && raw->type != XML_DOCUMENT_NODE) || raw->children == nullptr) )
+    {
+        xmlFreeDoc(raw);
+        raw = nullptr;
+    }
+    std::string result = Serialized(raw, html);
+    if ( raw != nullptr )
+        xmlFreeDoc(raw);
+    return result;
+}
+
+// parses `bytes` the way ManifestItem::ReferencedDocument() does now
+static std::string PushParse(const std::string& bytes, const char* url, bool html)
+{
+    auto owner = std::make_shared<std::string>(bytes);
+    auto stream = std::make_shared<MappedByteStream>(owner, owner->data(), owner->size());
+    ByteStreamXmlReader reader(stream);
+    auto doc = reader.readDocument(url, nullptr, html);
+    return Serialized(bool(doc) ? doc->xml() : nullptr, html);
+}
+
+TEST_CASE("Push-parsed documents should match those parsed from memory", "")
+{
+    static const std::string kBOM("\xEF\xBB\xBF");
+    size_t compared = 0;
+    
+    // XHTML read as HTML draws plenty of complaints, all of them expected
+    xmlSetGenericErrorFunc(nullptr, &IgnoreXmlErrors);
+    
+    for ( const char* path : kBenchmarkEPUBs )
+    {
+        CAPTURE(path);
+        ContainerPtr container = Container::OpenContainer(path);
+        REQUIRE(bool(container));
+        
+        std::vector<string> documents;
+        for ( auto& location : container->PackageLocations() )
+            documents.push_back(location);
+        for ( auto& item : container->DefaultPackage()->Manifest() )
+        {
+            const string& type = item.second->MediaType();
+            if ( type == "application/xhtml+xml" || type == "text/html" || type == "application/x-dtbncx+xml" )
+                documents.push_back(item.second->AbsolutePath());
+        }
+        
+        for ( auto& docPath : documents )
+        {
+            CAPTURE(docPath);
+            auto stream = container->GetArchive()->ByteStreamAtPath(docPath);
+            REQUIRE(bool(stream));
+            std::string bytes = ReadAll(stream.get());
+            
+            // both parsers, with and without a byte-order mark
+            for ( bool html : { false, true } )
+            {
+                for ( const std::string& input : { bytes, kBOM + bytes } )
+                {
+                    CAPTURE(html);
+                    CAPTURE(input.size());
+                    std::string expected = ReadFromMemory(input, docPath.c_str(), html);
+                    REQUIRE_FALSE(expected.empty());
+                    REQUIRE(PushParse(input, docPath.c_str(), html) == expected);
+                    compared++;
+                }
+            }
+        }
+    }
+    
+    xmlSetGenericErrorFunc(nullptr, nullptr);
+    REQUIRE(compared > 100);
+}
+
+// writes a zip file holding `content` as a single stored (uncompressed) item named
+// "item", recording `crc` as its checksum, and returns its path
+static std::string MakeStoredArchive(const std::string& content, uint32_t crc)
+{
+    char path[] = "/tmp/epub3-stored-XXXXXX.zip";
+    int fd = mkstemps(path, 4);
+    REQUIRE(fd >= 0);
+    close(fd);
+    
+    std::string zip;
+    auto put16 = [&zip](uint32_t v) { zip.push_back(char(v & 0xff)); zip.push_back(char((v >> 8) & 0xff)); };
+    auto put32 = [&put16](uint32_t v) { put16(v & 0xffff); put16(v >> 16); };
+    auto entry = [&](uint32_t magic, bool central) {
+        put32(magic);
+        if ( central )
+            put16(20);                          // version made by
+        put16(10);                              // version needed
+        put16(0);                               // flags
+        put16(0);                               // stored
+        put16(0);                               // time
+        put16(0x21);                            // date: 1st Jan 1980
+        put32(crc);
+        put32(uint32_t(content.size()));        // compressed size
+        put32(uint32_t(content.size()));        // uncompressed size
+        put16(4);                               // name length
+        put16(0);                               // extra length
+        if ( central )
+        {
+            put16(0);                           // comment length
+            put16(0);                           // disk number
+            put16(0);                           // internal attributes
+            put32(0);                           // external attributes
+            put32(0);                           // local header offset
+        }
+        zip.append("item");
+    };
+    
+    entry(0x04034b50, false);
+    zip.append(content);
+    uint32_t centralOffset = uint32_t(zip.size());
+    entry(0x02014b50, true);
+    uint32_t centralSize = uint32_t(zip.size()) - centralOffset;
+    put32(0x06054b50);
+    put16(0);
+    put16(0);
+    put16(1);
+    put16(1);
+    put32(centralSize);
+    put32(centralOffset);
+    put16(0);
+    
+    std::ofstream out(path, std::ios::binary|std::ios::trunc);
+    out.write(zip.data(), zip.size());
+    out.close();
+    return path;
+}
+
+static std::string StoredContent()
+{
+    std::string content;
+    for ( int i = 0; content.size() < 256*1024; i++ )
+        content += "line " + std::to_string(i) + " of a stored item\n";
+    return content;
+}
+
+TEST_CASE("Mapped reads check the CRC of stored items", "")
+{
+    std::string content = StoredContent();
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(content.data()), uInt(content.size()));
+    std::string good = MakeStoredArchive(content, uint32_t(crc));
+    std::string bad = MakeStoredArchive(content, uint32_t(crc) ^ 1);
+    ZipArchive::SetMemoryMappingEnabled(true);
+    {
+        ZipArchive goodArchive(good);
+        ZipArchive badArchive(bad);
+        auto goodStream = goodArchive.ByteStreamAtPath("item");
+        auto badStream = badArchive.ByteStreamAtPath("item");
+        REQUIRE(dynamic_cast<MappedByteStream*>(goodStream.get()) != nullptr);
+        REQUIRE(dynamic_cast<MappedByteStream*>(badStream.get()) != nullptr);
+        
+        REQUIRE(ReadAll(goodStream.get()) == content);
+        
+        // the read reaching the end fails, and the stream is closed
+        std::string bytes = ReadAll(badStream.get());
+        REQUIRE(bytes.size() < content.size());
+        REQUIRE(content.compare(0, bytes.size(), bytes) == 0);
+        REQUIRE_FALSE(badStream->IsOpen());
+        
+        // a bad item stays bad; a good one isn't checked again
+        REQUIRE(ReadAll(badArchive.ByteStreamAtPath("item").get()).size() < content.size());
+        REQUIRE(ReadAll(goodArchive.ByteStreamAtPath("item").get()) == content);
+        
+    }
+    ZipArchive::SetMemoryMappingEnabled(false);
+    
+    // libzip closes its stream over the bad item too
+    int error = 0;
+    struct zip* za = zip_open(bad.c_str(), 0, &error);
+    REQUIRE(za != nullptr);
+    {
+        ZipFileByteStream unmapped(za, "item");
+        ReadAll(&unmapped);
+        REQUIRE_FALSE(unmapped.IsOpen());
+    }
+    zip_close(za);
+
+    std::remove(good.c_str());
+    std::remove(bad.c_str());
+}
+
+TEST_CASE("A stored item truncated under its mapping fails to read", "")
+{
+    std::string content = StoredContent();
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(content.data()), uInt(content.size()));
+    std::string path = MakeStoredArchive(content, uint32_t(crc));
+    ZipArchive::SetMemoryMappingEnabled(true);
+    {
+        ZipArchive archive(path);
+        auto stream = archive.ByteStreamAtPath("item");
+        REQUIRE(dynamic_cast<MappedByteStream*>(stream.get()) != nullptr);
+        
+        // something else cuts the file short, leaving most of the mapping without any pages
+        REQUIRE(truncate(path.c_str(), 1024) == 0);
+        std::string bytes = ReadAll(stream.get());
+        REQUIRE(bytes.size() < content.size());
+        REQUIRE_FALSE(stream->IsOpen());
+    }
+    ZipArchive::SetMemoryMappingEnabled(false);
+    std::remove(path.c_str());
+}
+
+// writes a zip file holding one deflated entry, "item", and returns its path
+static std::string MakeDeflatedArchive(const std::string& content)
+{
+    char path[] = "/tmp/epub3-seek-XXXXXX.zip";
+    int fd = mkstemps(path, 4);
+    REQUIRE(fd >= 0);
+    close(fd);
+    unlink(path);
+    
+    int error = 0;
+    struct zip* za = zip_open(path, ZIP_CREATE|ZIP_EXCL, &error);
+    REQUIRE(za != nullptr);
+    REQUIRE(zip_add(za, "item", zip_source_buffer(za, content.data(), content.size(), 0)) == 0);
+    REQUIRE(zip_close(za) == 0);
+    return path;
+}
+
+// reads `len` bytes at `pos` in an entry via zip_fseek()
+static std::string ReadAt(struct zip_file* zf, long pos, size_t len)
+{
+    REQUIRE(zip_fseek(zf, pos, SEEK_SET) == 0);
+    REQUIRE(zip_ftell(zf) == pos);
+    std::string result(len, '\0');
+    size_t total = 0;
+    while ( total < len )
+    {
+        ssize_t n = zip_fread(zf, &result[total], len - total);
+        REQUIRE(n > 0);
+        total += size_t(n);
+    }
+    return result;
+}
+
+TEST_CASE("Seeking in a deflated entry should give the same bytes with or without inflate checkpoints", "")
+{
+    // compressible but irregular, so the entry spans many deflate blocks
+    static const char* kWords[] = { "lorem ", "ipsum ", "dolor ", "sit ", "amet ", "<p>", "</p>\n", "epub " };
+    std::string content;
+    unsigned int seed = 12345;
+    while ( content.size() < 1024*1024 )
+    {
+        seed = seed * 1103515245 + 12345;
+        content += kWords[(seed >> 16) % 8];
+        if ( (seed >> 8) % 16 == 0 )
+            content += std::to_string(seed);
+    }
+    std::string path = MakeDeflatedArchive(content);
+    
+    static const unsigned int kInterval = 16 * 1024;
+    // forward and backward, within one interval and across several
+    static const long kPositions[] = {
+        0, 100, 5000, 70000, 70100, 69000, 250000, 1000, 600000, 599999,
+        long(kInterval) * 20, long(kInterval) * 20 - 1, 1000000, 16, 300000, 300001
+    };
+    
+    for ( unsigned int interval : { kInterval, 0u } )
+    {
+        CAPTURE(interval);
+        int error = 0;
+        struct zip* za = zip_open(path.c_str(), 0, &error);
+        REQUIRE(za != nullptr);
+        REQUIRE(zip_set_seek_interval(za, interval) == 0);
+        
+        struct zip_file* zf = zip_fopen(za, "item", 0);
+        REQUIRE(zf != nullptr);
+        
+        // a sequential read first, which records the checkpoints
+        REQUIRE(ReadAt(zf, 0, content.size()) == content);
+        
+        for ( long pos : kPositions )
+        {
+            CAPTURE(pos);
+            REQUIRE(ReadAt(zf, pos, 4096) == content.substr(pos, 4096));
+        }
+        
+        // switching checkpoints off part way through drops them, and seeks still work
+        if ( interval != 0 )
+        {
+            REQUIRE(zip_set_seek_interval(za, 0) == 0);
+            REQUIRE(ReadAt(zf, 500000, 4096) == content.substr(500000, 4096));
+            REQUIRE(ReadAt(zf, 10, 4096) == content.substr(10, 4096));
+        }
+        
+        zip_fclose(zf);
+        zip_close(za);
+    }
+    
+    std::remove(path.c_str());
+}
+
+// writes a zip file of `count` small stored entries and returns its path
+static std::string MakeSyntheticArchive(int count)
+{
+    char path[] = "/tmp/epub3-names-XXXXXX.zip";
+    int fd = mkstemps(path, 4);
+    REQUIRE(fd >= 0);
+    close(fd);
+    unlink(path);
+    
+    int error = 0;
+    struct zip* za = zip_open(path, ZIP_CREATE|ZIP_EXCL, &error);
+    REQUIRE(za != nullptr);
+    static const char kData[] = "data";
+    for ( int i = 0; i < count; i++ )
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "OEBPS/images/Page-%05d.jpg", i);
+        REQUIRE(zip_add(za, name, zip_source_buffer(za, kData, sizeof(kData)-1, 0)) == i);
+    }
+    REQUIRE(zip_close(za) == 0);
+    return path;
+}
+
+// the answer zip_name_locate() gave before entry names were hashed
+static int ScanForName(struct zip* za, const char* name, int flags)
+{
+    for ( int i = 0; i < zip_get_num_files(za); i++ )
+    {
+        const char* fn = zip_get_name(za, i, 0);
+        if ( fn != nullptr && ((flags & ZIP_FL_NOCASE) ? strcasecmp(name, fn) : strcmp(name, fn)) == 0 )
+            return i;
+    }
+    return -1;
+}
+
+TEST_CASE("Zip name lookups should follow added, renamed and deleted entries", "")
+{
+    std::string path = MakeSyntheticArchive(300);
+    int error = 0;
+    struct zip* za = zip_open(path.c_str(), 0, &error);
+    REQUIRE(za != nullptr);
+    
+    static const char kData[] = "more";
+    REQUIRE(zip_rename(za, 10, "OEBPS/Renamed.jpg") == 0);
+    REQUIRE(zip_delete(za, 20) == 0);
+    REQUIRE(zip_delete(za, 30) == 0);
+    REQUIRE(zip_unchange(za, 30) == 0);
+    REQUIRE(zip_rename(za, 40, "OEBPS/Second.jpg") == 0);
+    REQUIRE(zip_unchange(za, 40) == 0);
+    REQUIRE(zip_rename(za, 50, "OEBPS/images/Page-00010.jpg") == 0);
+    
+    // enough additions to grow the index a few times
+    for ( int i = 0; i < 1000; i++ )
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "OEBPS/Added-%04d.xhtml", i);
+        REQUIRE(zip_add(za, name, zip_source_buffer(za, kData, sizeof(kData)-1, 0)) == 300 + i);
+    }
+    REQUIRE(zip_add(za, "OEBPS/Renamed.jpg", zip_source_buffer(za, kData, sizeof(kData)-1, 0)) == -1);
+    
+    const char* names[] = {
+        "OEBPS/Renamed.jpg", "OEBPS/renamed.JPG", "OEBPS/images/Page-00010.jpg", "OEBPS/images/Page-00020.jpg",
+        "OEBPS/images/Page-00030.jpg", "OEBPS/images/Page-00040.jpg", "OEBPS/Second.jpg", "OEBPS/images/Page-00050.jpg",
+        "OEBPS/images/page-00299.JPG", "OEBPS/Added-0999.xhtml", "oebps/added-0500.XHTML", "OEBPS/images/Page-00300.jpg", "",
+    };
+    for ( const char* name : names )
+    {
+        CAPTURE(name);
+        REQUIRE(zip_name_locate(za, name, 0) == ScanForName(za, name, 0));
+        REQUIRE(zip_name_locate(za, name, ZIP_FL_NOCASE) == ScanForName(za, name, ZIP_FL_NOCASE));
+    }
+    REQUIRE(zip_name_locate(za, "OEBPS/images/Page-00010.jpg", 0) == 50);
+    REQUIRE(zip_name_locate(za, "OEBPS/images/Page-00020.jpg", 0) == -1);
+    REQUIRE(zip_name_locate(za, "OEBPS/images/Page-00010.jpg", ZIP_FL_UNCHANGED) == 10);
+    REQUIRE(zip_name_locate(za, "Page-00299.jpg", ZIP_FL_NODIR) == 299);
+    
+    zip_unchange_all(za);
+    REQUIRE(zip_name_locate(za, "OEBPS/images/Page-00010.jpg", 0) == 10);
+    REQUIRE(zip_name_locate(za, "OEBPS/images/Page-00020.jpg", 0) == 20);
+    REQUIRE(zip_name_locate(za, "OEBPS/Renamed.jpg", 0) == -1);
+    
+    zip_close(za);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Zip name lookup benchmark", "[.][benchmark]")
+{
+    static const int kEntries = 10000;
+    std::string path = MakeSyntheticArchive(kEntries);
+    
+    int error = 0;
+    struct zip* za = zip_open(path.c_str(), 0, &error);
+    REQUIRE(za != nullptr);
+    std::vector<std::string> names;
+    for ( int i = 0; i < kEntries; i++ )
+        names.push_back(zip_get_name(za, i, 0));
+    
+    // ZIP_FL_UNCHANGED still scans, and gives the same answers for an unmodified archive
+    BenchmarkClock::duration scanned = TimeBenchmark([&]() {
+        for ( int i = 0; i < kEntries; i++ )
+            REQUIRE(zip_name_locate(za, names[i].c_str(), ZIP_FL_UNCHANGED) == i);
+    });
+    
+    BenchmarkClock::duration hashed = TimeBenchmark([&]() {
+        for ( int i = 0; i < kEntries; i++ )
+            REQUIRE(zip_name_locate(za, names[i].c_str(), 0) == i);
+    });
+    zip_close(za);
+    
+    // and through the archive layer, opening every entry
+    auto archive = Archive::Open(path);
+    REQUIRE(bool(archive));
+    BenchmarkClock::duration opened = TimeBenchmark([&]() {
+        for ( auto& name : names )
+            REQUIRE(bool(archive->ReaderAtPath(name)));
+    });
+    
+    ReportBenchmarkHeading(std::to_string(kEntries) + " entries");
+    ReportBenchmark("scanned lookup", scanned);
+    ReportBenchmark("hashed lookup", hashed);
+    ReportBenchmark("open every entry through ZipArchive", opened);
+    
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Items of one archive should read correctly on many threads at once", "")
+{
+    static const int kThreads = 8;
+    
+    // unmapped, so that stored items go through libzip too
+    ZipArchive::SetMemoryMappingEnabled(false);
+    for ( const char* path : kBenchmarkEPUBs )
+    {
+        CAPTURE(path);
+        auto archive = Archive::Open(path);
+        REQUIRE(bool(archive));
+        
+        std::vector<ArchiveItemInfo> items;
+        archive->EachItem([&](const ArchiveItemInfo& info) {
+            if ( info.Path().stl_str().back() != '/' )
+                items.push_back(info);
+        });
+        REQUIRE(items.size() > 0);
+        
+        std::mutex lock;
+        std::vector<std::string> failures;
+        std::vector<std::thread> threads;
+        for ( int t = 0; t < kThreads; t++ )
+        {
+            threads.emplace_back([&, t]() {
+                // each thread starts somewhere else, so different items are read at the same time
+                for ( size_t n = 0; n < items.size(); n++ )
+                {
+                    const ArchiveItemInfo& info = items[(n + t * items.size() / kThreads) % items.size()];
+                    auto stream = archive->ByteStreamAtPath(info.Path());
+                    std::string bytes = bool(stream) ? ReadAll(stream.get()) : std::string();
+                    
+                    std::string tail;
+                    auto seekable = dynamic_cast<SeekableByteStream*>(stream.get());
+                    if ( seekable != nullptr && bytes.size() > 16 )
+                    {
+                        seekable->Seek(bytes.size() / 2, std::ios::beg);
+                        auto clone = seekable->Clone();
+                        if ( bool(clone) )
+                            tail = ReadAll(clone.get());
+                    }
+                    
+                    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(bytes.data()), static_cast<uInt>(bytes.size()));
+                    if ( bytes.size() != info.UncompressedSize() || crc != info.CRC()
+                        || (bytes.size() > 16 && tail != bytes.substr(bytes.size() / 2)) )
+                    {
+                        std::lock_guard<std::mutex> _(lock);
+                        failures.push_back(info.Path().stl_str());
+                    }
+                }
+            });
+        }
+        for ( auto& thread : threads )
+            thread.join();
+        
+        std::string firstFailure = failures.empty() ? std::string() : failures.front();
+        CAPTURE(firstFailure);
+        REQUIRE(failures.empty());
+    }
+}
+
+// Declines every file but one in CanProcessFile(), and never returns a container.
+class SniffingContentModule : public ContentModule
+{
+public:
+    SniffingContentModule(const string& acceptedPath) : _acceptedPath(acceptedPath), sniffed(0), sniffedWithoutArchive(0), processed(0) {}
+    
+    virtual bool CanProcessFile(const string& path, const Archive* archive)
+    {
+        ++sniffed;
+        if ( archive == nullptr || !archive->ContainsItem("META-INF/container.xml") )
+            ++sniffedWithoutArchive;
+        return path == _acceptedPath;
+    }
+    
+#if FUTURE_ENABLED
+    virtual async_result<ContainerPtr> ProcessFile(const string& path, launch policy)
+    {
+        ++processed;
+        return make_ready_future<ContainerPtr>(nullptr);
+    }
+    virtual async_result<bool> ApproveUserAction(const UserAction& action)
+    {
+        return make_ready_future(true);
+    }
+#else
+    virtual ContainerPtr ProcessFile(const string& path)
+    {
+        ++processed;
+        return nullptr;
+    }
+#endif
+    
+    virtual void RegisterContentFilters() {}
+    virtual string GetModuleName() { return "SniffingContentModule"; }
+    
+    string              _acceptedPath;
+    std::atomic<int>    sniffed;
+    std::atomic<int>    sniffedWithoutArchive;
+    std::atomic<int>    processed;
+};
+
+TEST_CASE("Content modules should only process the files they don't rule out, on many threads at once", "")
+{
+    static const int kOpensPerPath = 2;
+    
+    auto module = new SniffingContentModule(kBenchmarkEPUBs[0]);
+    ContentModuleManager::Instance()->RegisterContentModule(module, "SniffingContentModule");
+    
+    // don't leave the module in place for the tests which follow, even if this one fails
+    struct Unregisterer {
+        ~Unregisterer() { ContentModuleManager::Instance()->UnregisterContentModule("SniffingContentModule"); }
+    } unregisterer;
+    
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    for ( const char* path : kBenchmarkEPUBs )
+    {
+        threads.emplace_back([&failures, path]() {
+            for ( int i = 0; i < kOpensPerPath; i++ )
+            {
+                if ( !bool(Container::OpenContainer(path)) )
+                    ++failures;
+            }
+        });
+    }
+    for ( auto& thread : threads )
+        thread.join();
+    
+    int numPaths = sizeof(kBenchmarkEPUBs) / sizeof(kBenchmarkEPUBs[0]);
+    REQUIRE(failures == 0);
+    REQUIRE(module->sniffed == numPaths * kOpensPerPath);
+    REQUIRE(module->sniffedWithoutArchive == 0);
+    REQUIRE(module->processed == kOpensPerPath);
+}
+
+TEST_CASE("Re-opening a container should take its documents from the cache", "")
+{
+    DocumentCache& cache = DocumentCache::Shared();
+    cache.Clear();
+    cache.ResetStatistics();
+    cache.SetCapacity(16 * 1024 * 1024);
+    
+    ContainerPtr first = Container::OpenContainer(EPUB_PATH);
+    REQUIRE(bool(first));
+    DocumentCache::Statistics afterFirst = cache.GetStatistics();
+    REQUIRE(afterFirst.misses > 0);
+    REQUIRE(afterFirst.entries > 0);
+    REQUIRE(afterFirst.bytes <= afterFirst.capacity);
+    
+    ContainerPtr second = Container::OpenContainer(EPUB_PATH);
+    REQUIRE(bool(second));
+    DocumentCache::Statistics afterSecond = cache.GetStatistics();
+    REQUIRE(afterSecond.misses == afterFirst.misses);
+    REQUIRE(afterSecond.hits > afterFirst.hits);
+    REQUIRE(second->DefaultPackage()->Title() == first->DefaultPackage()->Title());
+    REQUIRE(second->DefaultPackage()->Manifest().size() == first->DefaultPackage()->Manifest().size());
+    
+    // each caller gets its own copy of a cached document
+    ManifestItemPtr nav = first->DefaultPackage()->ManifestItemWithID("nav");
+    REQUIRE(bool(nav));
+    auto a = nav->ReferencedDocument();
+    auto b = nav->ReferencedDocument();
+    REQUIRE(bool(a));
+    REQUIRE(bool(b));
+    REQUIRE(a != b);
+    REQUIRE(a->XMLString() == b->XMLString());
+    REQUIRE(a->xml()->dict == nullptr);
+    
+    // shrinking the cache evicts, and a zero capacity turns it off
+    cache.SetCapacity(1);
+    REQUIRE(cache.GetStatistics().entries == 0);
+    REQUIRE(cache.GetStatistics().evictions > 0);
+    cache.SetCapacity(0);
+    REQUIRE_FALSE(cache.IsEnabled());
+    REQUIRE(bool(Container::OpenContainer(EPUB_PATH)));
+    REQUIRE(cache.GetStatistics().entries == 0);
+}
+
+TEST_CASE("Cached documents should be copied on many threads at once", "")
+{
+    static const int kThreads = 8;
+    static const int kCopiesPerThread = 50;
+    
+    DocumentCache& cache = DocumentCache::Shared();
+    cache.Clear();
+    cache.SetCapacity(16 * 1024 * 1024);
+    
+    ContainerPtr container = Container::OpenContainer(EPUB_PATH);
+    REQUIRE(bool(container));
+    ManifestItemPtr nav = container->DefaultPackage()->ManifestItemWithID("nav");
+    REQUIRE(bool(nav));
+    string expected = nav->ReferencedDocument()->XMLString();
+    cache.ResetStatistics();
+    
+    std::atomic<int> mismatches(0);
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < kThreads; t++ )
+    {
+        threads.emplace_back([&]() {
+            for ( int i = 0; i < kCopiesPerThread; i++ )
+            {
+                auto doc = nav->ReferencedDocument();
+                if ( !bool(doc) || doc->XMLString() != expected )
+                    mismatches++;
+            }
+        });
+    }
+    for ( auto& thread : threads )
+        thread.join();
+    
+    REQUIRE(mismatches == 0);
+    REQUIRE(cache.GetStatistics().hits == kThreads * kCopiesPerThread);
+    cache.SetCapacity(0);
+}
+
+static string MakeTemporaryDirectory()
+{
+    char path[] = "/tmp/epub3-snapshots-XXXXXX";
+    REQUIRE(mkdtemp(path) != nullptr);
+    return path;
+}
+
+static void CopyFile(const string& from, const string& to)
+{
+    std::ifstream in(from.stl_str(), std::ios::binary);
+    std::ofstream out(to.stl_str(), std::ios::binary|std::ios::trunc);
+    out << in.rdbuf();
+}
+
+static void RequireSameProperties(const PropertyHolder& a, const PropertyHolder& b)
+{
+    REQUIRE(b.NumberOfProperties() == a.NumberOfProperties());
+    for ( PropertyHolder::size_type i = 0; i < a.NumberOfProperties(); i++ )
+    {
+        PropertyPtr pa = a.PropertyAt(i), pb = b.PropertyAt(i);
+        CAPTURE(pa->PropertyIdentifier().URIString());
+        REQUIRE(pb->Type() == pa->Type());
+        REQUIRE(pb->PropertyIdentifier() == pa->PropertyIdentifier());
+        REQUIRE(pb->Value() == pa->Value());
+        REQUIRE(pb->Language() == pa->Language());
+        REQUIRE(pb->XMLIdentifier() == pa->XMLIdentifier());
+        REQUIRE(pb->Extensions().size() == pa->Extensions().size());
+        for ( size_t j = 0; j < pa->Extensions().size(); j++ )
+        {
+            REQUIRE(pb->Extensions()[j]->PropertyIdentifier() == pa->Extensions()[j]->PropertyIdentifier());
+            REQUIRE(pb->Extensions()[j]->Value() == pa->Extensions()[j]->Value());
+            REQUIRE(pb->Extensions()[j]->Scheme() == pa->Extensions()[j]->Scheme());
+        }
+    }
+}
+
+static void RequireSameNavigation(const NavigationList& a, const NavigationList& b)
+{
+    REQUIRE(b.size() == a.size());
+    for ( size_t i = 0; i < a.size(); i++ )
+    {
+        REQUIRE(b[i]->Title() == a[i]->Title());
+        auto pa = std::dynamic_pointer_cast<NavigationPoint>(a[i]);
+        auto pb = std::dynamic_pointer_cast<NavigationPoint>(b[i]);
+        REQUIRE(bool(pa) == bool(pb));
+        if ( pa )
+            REQUIRE(pb->Content() == pa->Content());
+        RequireSameNavigation(a[i]->Children(), b[i]->Children());
+    }
+}
+
+static void RequireSamePackage(PackagePtr a, PackagePtr b)
+{
+    REQUIRE(b->BasePath() == a->BasePath());
+    REQUIRE(b->Version() == a->Version());
+    REQUIRE(b->PackageID() == a->PackageID());
+    REQUIRE(b->UniqueID() == a->UniqueID());
+    REQUIRE(b->Title() == a->Title());
+    REQUIRE(b->SpineCFIIndex() == a->SpineCFIIndex());
+    REQUIRE(b->EPUB2PropertyMatching("cover") == a->EPUB2PropertyMatching("cover"));
+    RequireSameProperties(*a, *b);
+    
+    REQUIRE(b->Manifest().size() == a->Manifest().size());
+    for ( auto& pair : a->Manifest() )
+    {
+        ManifestItemPtr ia = pair.second, ib = b->ManifestItemWithID(pair.first);
+        REQUIRE(bool(ib));
+        REQUIRE(ib->Href() == ia->Href());
+        REQUIRE(ib->MediaType() == ia->MediaType());
+        REQUIRE(ib->MediaOverlayID() == ia->MediaOverlayID());
+        REQUIRE(ib->FallbackID() == ia->FallbackID());
+        REQUIRE(ib->HasProperty(ItemProperties::Navigation) == ia->HasProperty(ItemProperties::Navigation));
+        REQUIRE(b->ManifestItemAtRelativePath(ia->Href()) == ib);
+        RequireSameProperties(*ia, *ib);
+    }
+    
+    REQUIRE(b->SpineItemCount() == a->SpineItemCount());
+    for ( size_t i = 0; i < a->SpineItemCount(); i++ )
+    {
+        SpineItemPtr sa = a->SpineItemAt(i), sb = b->SpineItemAt(i);
+        REQUIRE(sb->Idref() == sa->Idref());
+        REQUIRE(sb->Linear() == sa->Linear());
+        REQUIRE(sb->Title() == sa->Title());
+        REQUIRE(sb->Spread() == sa->Spread());
+        REQUIRE(sb->Index() == i);
+        REQUIRE(sb->ManifestItem() == b->ManifestItemWithID(sa->Idref()));
+        RequireSameProperties(*sa, *sb);
+    }
+    
+    REQUIRE(b->MediaSupport().size() == a->MediaSupport().size());
+    for ( auto& pair : a->MediaSupport() )
+    {
+        REQUIRE(b->MediaSupport().at(pair.first)->Support() == pair.second->Support());
+    }
+    
+    REQUIRE(b->NavigationTables().size() == a->NavigationTables().size());
+    for ( auto& pair : a->NavigationTables() )
+    {
+        auto table = b->NavigationTable(pair.first);
+        REQUIRE(bool(table));
+        REQUIRE(table->Title() == pair.second->Title());
+        REQUIRE(table->SourceHref() == pair.second->SourceHref());
+        RequireSameNavigation(pair.second->Children(), table->Children());
+    }
+    
+    REQUIRE(b->MediaOverlaysSmilModel()->GetSmilCount() == a->MediaOverlaysSmilModel()->GetSmilCount());
+    REQUIRE(b->MediaOverlaysSmilModel()->DurationMilliseconds_Metadata() == a->MediaOverlaysSmilModel()->DurationMilliseconds_Metadata());
+}
+
+TEST_CASE("Encryption info should be found by path, with or without a leading slash", "")
+{
+    ContainerPtr c = Container::OpenContainer("TestData/wasteland-otf-obf-20120118.epub");
+    REQUIRE(bool(c));
+    REQUIRE(c->EncryptionData().size() == 3);
+
+    for ( auto& info : c->EncryptionData() )
+    {
+        REQUIRE(c->EncryptionInfoForPath(info->Path()) == info);
+        REQUIRE(c->EncryptionInfoForPath(string("/") + info->Path()) == info);
+    }
+    REQUIRE(c->EncryptionInfoForPath("EPUB/package.opf") == nullptr);
+
+    PackagePtr pkg = c->DefaultPackage();
+    ManifestItemPtr font = pkg->ManifestItemWithID("font.OldStandard.regular");
+    REQUIRE(bool(font));
+    REQUIRE(font->GetEncryptionInfo() == c->EncryptionInfoForPath("EPUB/OldStandard-Regular.obf.otf"));
+    REQUIRE(font->GetEncryptionInfo() == font->GetEncryptionInfo());
+    REQUIRE(pkg->ManifestItemWithID("nav")->GetEncryptionInfo() == nullptr);
+}
+
+TEST_CASE("Re-opening a container should restore it from its snapshot", "")
+{
+    string dir = MakeTemporaryDirectory();
+    
+    for ( const char* path : kBenchmarkEPUBs )
+    {
+        CAPTURE(path);
+        PackageSnapshot::SetDirectory("");
+        ContainerPtr parsed = Container::OpenContainer(path);
+        REQUIRE(bool(parsed));
+        
+        PackageSnapshot::SetDirectory(dir);
+        string snapshotPath = PackageSnapshot::PathForArchive(path);
+        REQUIRE_FALSE(snapshotPath.empty());
+        PackageSnapshot::Discard(path);
+        REQUIRE(bool(Container::OpenContainer(path)));
+        
+        bool saved = bool(std::ifstream(snapshotPath.stl_str()));
+        if ( !parsed->DefaultPackage()->Collections().empty() )
+        {
+            // collections aren't stored, so these packages are always parsed
+            REQUIRE_FALSE(saved);
+            continue;
+        }
+        REQUIRE(saved);
+        
+        // only container.xml is parsed when the snapshot is used
+        DocumentCache& cache = DocumentCache::Shared();
+        cache.SetCapacity(16 * 1024 * 1024);
+        cache.ResetStatistics();
+        ContainerPtr restored = Container::OpenContainer(path);
+        DocumentCache::Statistics stats = cache.GetStatistics();
+        cache.SetCapacity(0);
+        REQUIRE(bool(restored));
+        REQUIRE((stats.hits + stats.misses) == 1);
+        
+        REQUIRE(restored->GetVendorMetadata_AppleIBooksDisplayOption_FixedLayout() == parsed->GetVendorMetadata_AppleIBooksDisplayOption_FixedLayout());
+        REQUIRE(restored->EncryptionData().size() == parsed->EncryptionData().size());
+        for ( size_t i = 0; i < parsed->EncryptionData().size(); i++ )
+        {
+            REQUIRE(restored->EncryptionData()[i]->Path() == parsed->EncryptionData()[i]->Path());
+            REQUIRE(restored->EncryptionData()[i]->Algorithm() == parsed->EncryptionData()[i]->Algorithm());
+        }
+        
+        REQUIRE(restored->Packages().size() == parsed->Packages().size());
+        for ( size_t i = 0; i < parsed->Packages().size(); i++ )
+        {
+            RequireSamePackage(parsed->Packages()[i], restored->Packages()[i]);
+        }
+        
+        // restored content documents still load, through the same filters
+        ManifestItemPtr first = restored->DefaultPackage()->SpineItemAt(0)->ManifestItem();
+        REQUIRE(ReadAll(first->Reader().get()) == ReadAll(parsed->DefaultPackage()->SpineItemAt(0)->ManifestItem()->Reader().get()));
+        PackageSnapshot::Discard(path);
+    }
+    
+    // a snapshot is ignored once its archive changes
+    string copy = dir + "/book.epub";
+    CopyFile(kBenchmarkEPUBs[0], copy);
+    ContainerPtr original = Container::OpenContainer(copy);
+    REQUIRE(bool(original));
+    REQUIRE(bool(std::ifstream(PackageSnapshot::PathForArchive(copy).stl_str())));
+    CopyFile(EPUB_PATH, copy);
+    ContainerPtr replaced = Container::OpenContainer(copy);
+    REQUIRE(bool(replaced));
+    REQUIRE(replaced->DefaultPackage()->Title() != original->DefaultPackage()->Title());
+    REQUIRE(replaced->DefaultPackage()->Title() == Container::OpenContainer(EPUB_PATH)->DefaultPackage()->Title());
+    
+    PackageSnapshot::Discard(copy);
+    std::remove(copy.c_str());
+    PackageSnapshot::SetDirectory("");
+    REQUIRE_FALSE(PackageSnapshot::IsEnabled());
+}
@@ -15,6 +15,7 @@
 
 #include <vector>
 #include <set>
+#include <atomic>
 #include <future>
 #include <CoreFoundation/CFRunLoop.h>
 #include "../ePub3/utilities/executor.h"
@@ -158,6 +159,75 @@ TEST_CASE("thread_pool concurrency", "a thread_pool with multiple threads should
     REQUIRE(int(wait_result) == int(std::cv_status::no_timeout));
 }
 
+TEST_CASE("thread_pool work stealing", "closures added by a busy worker should be picked up by the idle ones")
+{
+    thread_pool pool(2);
+    std::atomic<int> completed(0);
+    std::set<std::thread::id> tids;
+    std::mutex mut;
+    std::thread::id parent_id;
+    
+    pool.add([&]() {
+        parent_id = std::this_thread::get_id();
+        for (int i = 0; i < 4; i++)
+        {
+            pool.add([&]() {
+                {
+                    std::lock_guard<std::mutex> lock(mut);
+                    tids.insert(std::this_thread::get_id());
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                completed++;
+            });
+        }
+        
+        // stay busy, so the closures above can only run if another worker steals them
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (completed < 4 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+    
+    pool.wait_idle();
+    
+    REQUIRE(completed == 4);
+    REQUIRE(tids.count(parent_id) == 0);
+}
+
+TEST_CASE("thread_pool wait_idle", "thread_pool::wait_idle() should return once every closure, including nested ones, has run")
+{
+    thread_pool pool(4);
+    std::atomic<int> completed(0);
+    std::atomic<int> drained(0);
+    
+    pool.set_drained_handler([&]() {
+        drained++;
+    });
+    
+    for (int i = 0; i < 100; i++)
+    {
+        pool.add([&]() {
+            for (int j = 0; j < 10; j++)
+            {
+                pool.add([&]() {
+                    completed++;
+                });
+            }
+            completed++;
+        });
+    }
+    
+    pool.wait_idle();
+    
+    REQUIRE(completed == 1100);
+    REQUIRE(pool.uninitiated_task_count() == 0);
+    
+    // the handler runs before wait_idle() is released, but a spurious wakeup could beat it
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (drained == 0 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+    REQUIRE(drained > 0);
+}
+
 TEST_CASE("scheduled_executor", "scheduled_executor should only enqueue closures after a given duration")
 {
     thread_pool& pool = shared_thread_pool();
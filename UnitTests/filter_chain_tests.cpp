@@ -125,6 +125,15 @@ void* ROT13Filter::FilterData(FilterContext* context, void* data, size_t len, si
     return data;
 }
 
+class StreamingROT13Filter : public ROT13Filter
+{
+public:
+    StreamingROT13Filter() : ROT13Filter() {}
+    virtual ~StreamingROT13Filter() {}
+    
+    virtual bool SupportsIncrementalFiltering() const OVERRIDE { return true; }
+};
+
 static void RegisterTestFilter()
 {
     std::atomic_flag registered(false);
@@ -135,6 +144,166 @@ static void RegisterTestFilter()
 }
 
 
+TEST_CASE("FilterChainByteStream can seek within its filtered content", "")
+{
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    PackagePtr pkg = c->DefaultPackage();
+    
+    ManifestItemPtr item = pkg->FirstSpineItem()->ManifestItem();
+    REQUIRE(bool(item));
+    
+    // filter the raw bytes by hand for comparison
+    ByteBuffer expected;
+    auto rawStream = item->Reader();
+    REQUIRE(bool(rawStream));
+    
+    ByteStream::size_type numRead = 0;
+    do
+    {
+        uint8_t buf[4096];
+        numRead = rawStream->ReadBytes(buf, 4096);
+        if ( numRead > 0 )
+            expected.AddBytes(buf, numRead);
+        
+    } while ( numRead > 0 );
+    
+    ROT13Filter tmp;
+    tmp.FilterData(nullptr, expected.GetBytes(), expected.GetBufferSize(), nullptr);
+    REQUIRE(expected.GetBufferSize() > 200);
+    
+    std::vector<ContentFilterPtr> filters{ROT13Filter::New()};
+    std::unique_ptr<SeekableByteStream> input(dynamic_cast<SeekableByteStream*>(item->Reader().release()));
+    REQUIRE(bool(input));
+    FilterChainByteStream stream(std::move(input), filters, item);
+    
+    uint8_t buf[100];
+    REQUIRE(stream.ReadBytes(buf, 100) == 100);
+    REQUIRE(memcmp(buf, expected.GetBytes(), 100) == 0);
+    REQUIRE(stream.Position() == 100);
+    REQUIRE(stream.BytesAvailable() == expected.GetBufferSize() - 100);
+    
+    // going backwards re-reads the same filtered bytes
+    REQUIRE(stream.Seek(10, std::ios::beg) == 10);
+    REQUIRE(stream.ReadBytes(buf, 20) == 20);
+    REQUIRE(memcmp(buf, expected.GetBytes() + 10, 20) == 0);
+    
+    REQUIRE(stream.Seek(50, std::ios::cur) == 80);
+    REQUIRE(stream.ReadBytes(buf, 20) == 20);
+    REQUIRE(memcmp(buf, expected.GetBytes() + 80, 20) == 0);
+    
+    // seeking past the end stops at the end
+    REQUIRE(stream.Seek(expected.GetBufferSize() + 10, std::ios::beg) == expected.GetBufferSize());
+    REQUIRE(stream.AtEnd());
+    REQUIRE(stream.ReadBytes(buf, 20) == 0);
+}
+
+TEST_CASE("FilterChainByteStream streams when every filter is incremental", "")
+{
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    PackagePtr pkg = c->DefaultPackage();
+    
+    ManifestItemPtr item = pkg->FirstSpineItem()->ManifestItem();
+    REQUIRE(bool(item));
+    
+    ByteBuffer expected;
+    auto rawStream = item->Reader();
+    REQUIRE(bool(rawStream));
+    
+    ByteStream::size_type numRead = 0;
+    do
+    {
+        uint8_t buf[4096];
+        numRead = rawStream->ReadBytes(buf, 4096);
+        if ( numRead > 0 )
+            expected.AddBytes(buf, numRead);
+        
+    } while ( numRead > 0 );
+    
+    ROT13Filter tmp;
+    tmp.FilterData(nullptr, expected.GetBytes(), expected.GetBufferSize(), nullptr);
+    REQUIRE(expected.GetBufferSize() > 200);
+    
+    std::vector<ContentFilterPtr> filters{std::make_shared<StreamingROT13Filter>()};
+    std::unique_ptr<SeekableByteStream> input(dynamic_cast<SeekableByteStream*>(item->Reader().release()));
+    REQUIRE(bool(input));
+    FilterChainByteStream stream(std::move(input), filters, item);
+    
+    // the length is known before anything has been filtered
+    REQUIRE(stream.BytesAvailable() == expected.GetBufferSize());
+    
+    // small reads come back in order
+    ByteBuffer output;
+    uint8_t buf[37];
+    while ( (numRead = stream.ReadBytes(buf, sizeof(buf))) > 0 )
+    {
+        output.AddBytes(buf, numRead);
+        REQUIRE(stream.Position() == output.GetBufferSize());
+    }
+    REQUIRE(stream.AtEnd());
+    REQUIRE(output.GetBufferSize() == expected.GetBufferSize());
+    REQUIRE(memcmp(output.GetBytes(), expected.GetBytes(), expected.GetBufferSize()) == 0);
+    
+    // seeking back restarts the filters
+    REQUIRE(stream.Seek(10, std::ios::beg) == 10);
+    REQUIRE(stream.BytesAvailable() == expected.GetBufferSize() - 10);
+    REQUIRE(stream.ReadBytes(buf, 20) == 20);
+    REQUIRE(memcmp(buf, expected.GetBytes() + 10, 20) == 0);
+    
+    REQUIRE(stream.Seek(50, std::ios::cur) == 80);
+    REQUIRE(stream.ReadBytes(buf, 20) == 20);
+    REQUIRE(memcmp(buf, expected.GetBytes() + 80, 20) == 0);
+}
+
+TEST_CASE("A filter chain sniffs each manifest item only once", "")
+{
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    PackagePtr pkg = c->DefaultPackage();
+
+    ManifestItemPtr xhtml = pkg->FirstSpineItem()->ManifestItem();
+    ManifestItemPtr image = pkg->ManifestItemWithID("j1_320");
+    REQUIRE(bool(xhtml));
+    REQUIRE(bool(image));
+
+    int sniffCount = 0;
+    auto streaming = std::make_shared<StreamingROT13Filter>();
+    auto caching = std::make_shared<ROT13Filter>();
+    auto counter = [&sniffCount](ConstManifestItemPtr item) {
+        sniffCount++;
+        return item->MediaType() == "application/xhtml+xml";
+    };
+    streaming->SetTypeSniffer(counter);
+    caching->SetTypeSniffer([&sniffCount](ConstManifestItemPtr item) { sniffCount++; return false; });
+
+    auto chain = std::make_shared<FilterChain>(FilterChain::FilterList{streaming, caching});
+    auto plan = chain->PlanForManifestItem(xhtml);
+    REQUIRE(sniffCount == 2);
+    REQUIRE(plan->filters.size() == 1);
+    REQUIRE(plan->filters[0] == streaming);
+    REQUIRE(plan->streamable);
+    REQUIRE_FALSE(plan->rangeReadable);
+
+    for ( int i = 0; i < 10; i++ )
+    {
+        REQUIRE(chain->GetFilterChainSize(xhtml) == 1);
+        REQUIRE(bool(chain->GetFilterChainByteStream(xhtml)));
+    }
+    REQUIRE(sniffCount == 2);
+    REQUIRE(chain->PlanForManifestItem(xhtml) == plan);
+
+    // a different chain works the item out afresh
+    caching->SetTypeSniffer(counter);
+    auto other = std::make_shared<FilterChain>(FilterChain::FilterList{streaming, caching});
+    auto otherPlan = other->PlanForManifestItem(xhtml);
+    REQUIRE(sniffCount == 4);
+    REQUIRE(otherPlan->filters.size() == 2);
+    REQUIRE_FALSE(otherPlan->streamable);
+    REQUIRE(other->GetFilterChainByteStreamRange(xhtml) == nullptr);
+
+    // images are left alone
+    REQUIRE(other->GetFilterChainSize(image) == 0);
+    REQUIRE(other->PlanForManifestItem(image)->rangeReadable);
+}
+
 #ifdef SUPPORT_ASYNC
 /*
 TEST_CASE("Filters apply automatically", "")
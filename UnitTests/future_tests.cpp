@@ -15,6 +15,8 @@
 #include "../ePub3/utilities/invoke.h"
 #include "../ePub3/utilities/future.h"
 #include <future>
+#include <set>
+#include <vector>
 #include "catch.hpp"
 
 using namespace EPUB3_NAMESPACE;
@@ -325,3 +327,117 @@ TEST_CASE("future::then(async) chain", "[future][async]")
     REQUIRE(output == true);
     REQUIRE(firstExit < secondEnter);
 }
+
+// collects the ids of the threads which tasks ran on
+class thread_tracker
+{
+    std::mutex                  _lock;
+    std::set<std::thread::id>   _ids;
+    
+public:
+    void note()
+        {
+            std::lock_guard<std::mutex> _(_lock);
+            _ids.insert(std::this_thread::get_id());
+        }
+    
+    std::set<std::thread::id> ids()
+        {
+            std::lock_guard<std::mutex> _(_lock);
+            return _ids;
+        }
+};
+
+TEST_CASE("async(executor&)", "[future][executor]")
+{
+    thread_pool pool(2);
+    thread_tracker tracker;
+    
+    std::vector<future<int>> results;
+    for (int i = 0; i < 50; i++)
+    {
+        auto first = async(pool, [&tracker](int n) {
+            tracker.note();
+            return n;
+        }, i);
+        
+        // without a policy, the continuation stays on the pool
+        results.push_back(first.then([&tracker](future<int> f) {
+            tracker.note();
+            return f.get() * 2;
+        }));
+    }
+    
+    for (int i = 0; i < 50; i++)
+        REQUIRE(results[i].get() == i * 2);
+    
+    auto ids = tracker.ids();
+    REQUIRE(ids.size() <= 3);       // two pool threads, plus this one for continuations of ready futures
+    
+    auto failed = async(pool, []() -> int { throw std::runtime_error("failed"); });
+    REQUIRE_THROWS_AS(failed.get(), std::runtime_error);
+}
+
+TEST_CASE("launch::pooled", "[future][executor]")
+{
+    std::thread::id my_id = std::this_thread::get_id();
+    thread_tracker tracker;
+    
+    std::vector<future<void>> results;
+    for (int i = 0; i < 200; i++)
+    {
+        results.push_back(async(launch::pooled, [&tracker]() {
+            tracker.note();
+        }).then([&tracker](future<void> f) {
+            f.get();
+            tracker.note();
+        }).then(launch::pooled, [&tracker](future<void> f) {
+            f.get();
+            tracker.note();
+        }));
+    }
+    
+    for (auto& result : results)
+        result.get();
+    
+    auto ids = tracker.ids();
+    ids.erase(my_id);
+    
+    size_t poolSize = std::max(1u, std::thread::hardware_concurrency());
+    REQUIRE(ids.size() <= poolSize);
+}
+
+TEST_CASE("then() on a ready future", "[future][then]")
+{
+    std::thread::id my_id = std::this_thread::get_id();
+    std::thread::id asyncId, pooledId, executorId;
+    
+    thread_pool pool(1);
+    
+    auto a = make_ready_future(1).then(launch::async, [&](future<int> f) {
+        asyncId = std::this_thread::get_id();
+        return f.get() + 1;
+    });
+    REQUIRE(asyncId == my_id);
+    REQUIRE(a.get() == 2);
+    
+    auto b = make_ready_future(1).then(launch::pooled, [&](future<int> f) {
+        pooledId = std::this_thread::get_id();
+        return f.get() + 2;
+    });
+    REQUIRE(pooledId == my_id);
+    REQUIRE(b.get() == 3);
+    
+    // a continuation given an executor always runs on it
+    auto c = make_ready_future(1).then(pool, [&](future<int> f) {
+        executorId = std::this_thread::get_id();
+        return f.get() + 3;
+    });
+    REQUIRE(c.get() == 4);
+    REQUIRE(executorId != my_id);
+    
+    auto d = make_ready_future<int>(std::make_exception_ptr(std::runtime_error("failed"))).then(pool, [&](future<int> f) {
+        return f.get();
+    });
+    REQUIRE_THROWS_AS(d.get(), std::runtime_error);
+}
@@ -0,0 +1,218 @@
+//
+//  library_tests.cpp
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+
+
+#include "../ePub3/ePub/library.h"
+#include "../ePub3/ePub/package_summary.h"
+#include "../ePub3/ePub/container.h"
+#include "../ePub3/ePub/package.h"
+#include "../ePub3/ePub/manifest.h"
+#include "../ePub3/ThirdParty/libzip/zip.h"
+#include "catch.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+using namespace ePub3;
+
+static const char* kLibraryEPUBs[] = {
+    "TestData/alice3.epub",
+    "TestData/childrens-literature-20120722.epub",
+    "TestData/cole-voyage-of-life-20120320.epub",
+    "TestData/dante-hell.epub",
+    "TestData/moby-dick-preview-collection.epub",
+    "TestData/page-blanche.epub",
+    "TestData/wasteland-otf-obf-20120118.epub",
+    "TestData/widget-figure-gallery-20121022.epub",
+};
+
+// Library's constructors are protected; MainLibrary() would share state between tests
+class TestLibrary : public Library
+{
+public:
+    TestLibrary() : Library() {}
+};
+
+TEST_CASE("Package summaries should agree with the opened packages", "")
+{
+    for ( const char* path : kLibraryEPUBs )
+    {
+        INFO(path);
+        auto summaries = PackageSummary::ReadContainerAtPath(path);
+        ContainerPtr c = Container::OpenContainer(path);
+        REQUIRE(bool(c));
+        REQUIRE(summaries.size() == c->Packages().size());
+        
+        for ( size_t i = 0; i < summaries.size(); i++ )
+        {
+            auto& summary = summaries[i];
+            PackagePtr pkg = c->Packages()[i];
+            
+            REQUIRE(summary.containerPath == path);
+            REQUIRE(summary.packageID == pkg->PackageID());
+            REQUIRE(summary.uniqueID == pkg->UniqueID());
+            REQUIRE(summary.title == pkg->Title(false));
+            REQUIRE(summary.authors.size() == pkg->AuthorNames(false).size());
+            REQUIRE(summary.spineSize == pkg->SpineItemCount());
+            REQUIRE_FALSE(summary.identifiers.empty());
+            
+            ManifestItemPtr cover = pkg->CoverManifestItem();
+            if ( bool(cover) )
+                REQUIRE(summary.coverPath == cover->AbsolutePath());
+            else
+                REQUIRE(summary.coverPath.empty());
+        }
+    }
+    
+    REQUIRE_THROWS(PackageSummary::ReadContainerAtPath("TestData/no-such-file.epub"));
+}
+
+static const char kSpacedIdentifier[] = "\n        urn:uuid:0c1f4a7e-3b2d-4c6e-9a8f-1d2e3f4a5b6c\n    ";
+
+// writes a one-chapter publication whose unique-id is spread over several lines
+static std::string MakeSpacedIdentifierEPUB()
+{
+    char path[] = "/tmp/epub3-library-XXXXXX.epub";
+    int fd = mkstemps(path, 5);
+    REQUIRE(fd >= 0);
+    close(fd);
+    unlink(path);
+    
+    static const char kMimetype[] = "application/epub+zip";
+    static const char kContainerXML[] =
+        "<?xml version=\"1.0\"?>\n"
+        "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">"
+        "<rootfiles><rootfile full-path=\"OEBPS/content.opf\" media-type=\"application/oebps-package+xml\"/></rootfiles>"
+        "</container>";
+    static const std::string kPackageOPF = std::string(
+        "<?xml version=\"1.0\"?>\n"
+        "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"3.0\" unique-identifier=\"uid\">\n"
+        "  <metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\">\n"
+        "    <dc:identifier id=\"uid\">") + kSpacedIdentifier + "</dc:identifier>\n"
+        "    <dc:title>Spaced</dc:title><dc:language>en</dc:language>\n"
+        "    <meta property=\"dcterms:modified\">2014-01-01T00:00:00Z</meta>\n"
+        "  </metadata>\n"
+        "  <manifest>\n"
+        "    <item id=\"nav\" href=\"nav.xhtml\" media-type=\"application/xhtml+xml\" properties=\"nav\"/>\n"
+        "    <item id=\"c1\" href=\"c1.xhtml\" media-type=\"application/xhtml+xml\"/>\n"
+        "  </manifest>\n"
+        "  <spine><itemref idref=\"c1\"/></spine>\n"
+        "</package>";
+    static const char kNavXHTML[] =
+        "<?xml version=\"1.0\"?>\n"
+        "<html xmlns=\"http://www.w3.org/1999/xhtml\" xmlns:epub=\"http://www.idpf.org/2007/ops\"><head><title>Contents</title></head>"
+        "<body><nav epub:type=\"toc\"><ol><li><a href=\"c1.xhtml\">One</a></li></ol></nav></body></html>";
+    static const char kChapter[] =
+        "<?xml version=\"1.0\"?>\n"
+        "<html xmlns=\"http://www.w3.org/1999/xhtml\"><head><title>One</title></head><body><p>One</p></body></html>";
+    
+    struct { const char* name; const char* data; size_t size; } entries[] = {
+        { "mimetype", kMimetype, sizeof(kMimetype)-1 },
+        { "META-INF/container.xml", kContainerXML, sizeof(kContainerXML)-1 },
+        { "OEBPS/content.opf", kPackageOPF.data(), kPackageOPF.size() },
+        { "OEBPS/nav.xhtml", kNavXHTML, sizeof(kNavXHTML)-1 },
+        { "OEBPS/c1.xhtml", kChapter, sizeof(kChapter)-1 },
+    };
+    
+    int error = 0;
+    struct zip* za = zip_open(path, ZIP_CREATE|ZIP_EXCL, &error);
+    REQUIRE(za != nullptr);
+    for ( auto& entry : entries )
+        REQUIRE(zip_add(za, entry.name, zip_source_buffer(za, entry.data, entry.size, 0)) >= 0);
+    REQUIRE(zip_close(za) == 0);
+    return path;
+}
+
+TEST_CASE("Package summaries should keep unique IDs exactly as the package has them", "")
+{
+    std::string path = MakeSpacedIdentifierEPUB();
+    auto summaries = PackageSummary::ReadContainerAtPath(path);
+    ContainerPtr c = Container::OpenContainer(path);
+    REQUIRE(bool(c));
+    REQUIRE(summaries.size() == 1);
+    
+    // the whitespace around the identifier is part of it
+    PackagePtr pkg = c->DefaultPackage();
+    REQUIRE(pkg->PackageID() == kSpacedIdentifier);
+    REQUIRE(pkg->UniqueID() == string(kSpacedIdentifier) + "@2014-01-01T00:00:00Z");
+    REQUIRE(summaries[0].packageID == pkg->PackageID());
+    REQUIRE(summaries[0].uniqueID == pkg->UniqueID());
+    
+    c.reset();
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Library ingestion should register publications without opening them", "")
+{
+    TestLibrary library;
+    std::vector<string> paths(std::begin(kLibraryEPUBs), std::end(kLibraryEPUBs));
+    paths.push_back("TestData/no-such-file.epub");
+    
+    std::map<string, PackageSummary::SummaryList> results;
+    size_t failures = 0;
+    auto done = library.AddPublicationsAtPaths(paths, [&](const string& path, const PackageSummary::SummaryList& packages, std::exception_ptr error) {
+        if ( error )
+            failures++;
+        else
+            results[path] = packages;
+    }, 3);
+    
+    done.get();
+    REQUIRE(failures == 1);
+    REQUIRE(results.size() == paths.size() - 1);
+    
+    for ( auto& result : results )
+    {
+        for ( auto& summary : result.second )
+            REQUIRE(library.PathForEPubWithUniqueID(summary.uniqueID) == result.first);
+    }
+    
+    // nothing was opened, so the library file is written from the summaries
+    string libraryPath("TestData/library-ingest-test.csv");
+    REQUIRE(library.WriteToFile(libraryPath));
+    std::ifstream stream(libraryPath.c_str());
+    std::string line;
+    size_t numLines = 0;
+    while ( std::getline(stream, line) )
+    {
+        string path(line.substr(0, line.find(',')));
+        REQUIRE(results.count(path) == 1);
+        for ( auto& summary : results[path] )
+            REQUIRE(line.find("," + summary.uniqueID.stl_str()) != std::string::npos);
+        numLines++;
+    }
+    stream.close();
+    std::remove(libraryPath.c_str());
+    REQUIRE(numLines == results.size());
+    
+    // an empty batch is finished straight away
+    REQUIRE(library.AddPublicationsAtPaths(std::vector<string>()).wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+}
+
+TEST_CASE("A library waits for its ingestion to finish before it is destroyed", "")
+{
+    std::vector<string> paths(std::begin(kLibraryEPUBs), std::end(kLibraryEPUBs));
+    std::atomic<size_t> handled(0);
+    std::future<void> done;
+    {
+        TestLibrary library;
+        done = library.AddPublicationsAtPaths(paths, [&](const string& path, const PackageSummary::SummaryList& packages, std::exception_ptr error) {
+            handled++;
+        }, 2);
+    }
+    
+    REQUIRE(handled == paths.size());
+    REQUIRE(done.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    REQUIRE_NOTHROW(done.get());
+}
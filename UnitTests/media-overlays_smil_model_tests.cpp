@@ -0,0 +1,356 @@
+//
+//  media-overlays_smil_model_tests.cpp
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+
+
+#include "../ePub3/ePub/container.h"
+#include "../ePub3/ePub/package.h"
+#include "../ePub3/ePub/media-overlays_smil_model.h"
+#include "../ePub3/utilities/error_handler.h"
+#include "../ePub3/ePub/media-overlays_smil_data.h"
+#include "../ePub3/ThirdParty/libzip/zip.h"
+#include "catch.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using namespace ePub3;
+
+static const char kContainerXML[] =
+    "<?xml version=\"1.0\"?>\n"
+    "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">"
+    "<rootfiles><rootfile full-path=\"OEBPS/content.opf\" media-type=\"application/oebps-package+xml\"/></rootfiles>"
+    "</container>";
+
+static const char kPackageOPF[] =
+    "<?xml version=\"1.0\"?>\n"
+    "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"3.0\" unique-identifier=\"uid\">"
+    "<metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\">"
+    "<dc:identifier id=\"uid\">urn:uuid:5e1c3a7e-8d34-4a8e-9d5e-2f0b3f5b6a01</dc:identifier>"
+    "<dc:title>Media Overlays</dc:title><dc:language>en</dc:language>"
+    "<meta property=\"dcterms:modified\">2014-01-01T00:00:00Z</meta>"
+    "<meta property=\"media:duration\">0:00:06</meta>"
+    "<meta property=\"media:duration\" refines=\"#s1\">0:00:02</meta>"
+    "<meta property=\"media:duration\" refines=\"#s2\">0:00:02</meta>"
+    "<meta property=\"media:duration\" refines=\"#s3\">0:00:02</meta>"
+    "</metadata><manifest>"
+    "<item id=\"nav\" href=\"nav.xhtml\" media-type=\"application/xhtml+xml\" properties=\"nav\"/>"
+    "<item id=\"c1\" href=\"c1.xhtml\" media-type=\"application/xhtml+xml\" media-overlay=\"s1\"/>"
+    "<item id=\"c2\" href=\"c2.xhtml\" media-type=\"application/xhtml+xml\" media-overlay=\"s2\"/>"
+    "<item id=\"c3\" href=\"c3.xhtml\" media-type=\"application/xhtml+xml\" media-overlay=\"s3\"/>"
+    "<item id=\"s1\" href=\"s1.smil\" media-type=\"application/smil+xml\"/>"
+    "<item id=\"s2\" href=\"s2.smil\" media-type=\"application/smil+xml\"/>"
+    "<item id=\"s3\" href=\"s3.smil\" media-type=\"application/smil+xml\"/>"
+    "<item id=\"audio\" href=\"audio.mp3\" media-type=\"audio/mpeg\"/>"
+    "</manifest><spine><itemref idref=\"c1\"/><itemref idref=\"c2\"/><itemref idref=\"c3\"/></spine>"
+    "</package>";
+
+static const char kNavXHTML[] =
+    "<?xml version=\"1.0\"?>\n"
+    "<html xmlns=\"http://www.w3.org/1999/xhtml\" xmlns:epub=\"http://www.idpf.org/2007/ops\"><head><title>Contents</title></head>"
+    "<body><nav epub:type=\"toc\"><ol><li><a href=\"c1.xhtml\">One</a></li><li><a href=\"c2.xhtml\">Two</a></li>"
+    "<li><a href=\"c3.xhtml\">Three</a></li></ol></nav></body></html>";
+
+// two 'par's of one second each
+static std::string SmilDocument(const char* chapter)
+{
+    return std::string("<?xml version=\"1.0\"?>\n"
+        "<smil xmlns=\"http://www.w3.org/ns/SMIL\" xmlns:epub=\"http://www.idpf.org/2007/ops\" version=\"3.0\"><body>"
+        "<par id=\"p1\"><text src=\"") + chapter + "#t1\"/><audio src=\"audio.mp3\" clipBegin=\"0s\" clipEnd=\"1s\"/></par>"
+        "<par id=\"p2\"><text src=\"" + chapter + "#t2\"/><audio src=\"audio.mp3\" clipBegin=\"1s\" clipEnd=\"2s\"/></par>"
+        "</body></smil>";
+}
+
+static std::string ChapterDocument(const char* title)
+{
+    return std::string("<?xml version=\"1.0\"?>\n"
+        "<html xmlns=\"http://www.w3.org/1999/xhtml\"><head><title>") + title + "</title></head>"
+        "<body><p id=\"t1\">First</p><p id=\"t2\">Second</p></body></html>";
+}
+
+// writes a three-chapter publication with a Media Overlay per chapter; the third SMIL has no
+// body, which the parser reports as a Major error
+static std::string MakeMediaOverlaysEPUB()
+{
+    char path[] = "/tmp/epub3-smil-XXXXXX.epub";
+    int fd = mkstemps(path, 5);
+    REQUIRE(fd >= 0);
+    close(fd);
+    unlink(path);
+
+    static const char kMimetype[] = "application/epub+zip";
+    static const char kBadSmil[] =
+        "<?xml version=\"1.0\"?>\n"
+        "<smil xmlns=\"http://www.w3.org/ns/SMIL\" version=\"3.0\"><head/></smil>";
+    static const std::string kSmil1 = SmilDocument("c1.xhtml");
+    static const std::string kSmil2 = SmilDocument("c2.xhtml");
+    static const std::string kChapter1 = ChapterDocument("One");
+    static const std::string kChapter2 = ChapterDocument("Two");
+    static const std::string kChapter3 = ChapterDocument("Three");
+    static const char kAudio[] = "ID3";
+
+    struct { const char* name; const char* data; size_t size; } entries[] = {
+        { "mimetype", kMimetype, sizeof(kMimetype)-1 },
+        { "META-INF/container.xml", kContainerXML, sizeof(kContainerXML)-1 },
+        { "OEBPS/content.opf", kPackageOPF, sizeof(kPackageOPF)-1 },
+        { "OEBPS/nav.xhtml", kNavXHTML, sizeof(kNavXHTML)-1 },
+        { "OEBPS/c1.xhtml", kChapter1.data(), kChapter1.size() },
+        { "OEBPS/c2.xhtml", kChapter2.data(), kChapter2.size() },
+        { "OEBPS/c3.xhtml", kChapter3.data(), kChapter3.size() },
+        { "OEBPS/s1.smil", kSmil1.data(), kSmil1.size() },
+        { "OEBPS/s2.smil", kSmil2.data(), kSmil2.size() },
+        { "OEBPS/s3.smil", kBadSmil, sizeof(kBadSmil)-1 },
+        { "OEBPS/audio.mp3", kAudio, sizeof(kAudio)-1 },
+    };
+
+    int error = 0;
+    struct zip* za = zip_open(path, ZIP_CREATE|ZIP_EXCL, &error);
+    REQUIRE(za != nullptr);
+    for ( auto& entry : entries )
+        REQUIRE(zip_add(za, entry.name, zip_source_buffer(za, entry.data, entry.size, 0)) >= 0);
+    REQUIRE(zip_close(za) == 0);
+    return path;
+}
+
+TEST_CASE("SMIL documents are only parsed when they're needed", "")
+{
+    std::string path = MakeMediaOverlaysEPUB();
+
+    // the broken SMIL doesn't stop the publication opening
+    ContainerPtr container = Container::OpenContainer(path);
+    REQUIRE(bool(container));
+    auto model = container->DefaultPackage()->MediaOverlaysSmilModel();
+    REQUIRE(bool(model));
+    REQUIRE(model->GetSmilCount() == 3);
+    REQUIRE(model->SmilParseError(2).empty());
+
+    auto smil = model->GetSmil(0);
+    REQUIRE(bool(smil->Body()));
+    REQUIRE(smil->DurationMilliseconds_Calculated() == 2000);
+    REQUIRE(model->SmilParseError(0).empty());
+    REQUIRE(model->SmilParseError(2).empty());
+
+    // the error handler throws for the broken one, and keeps throwing for everything that needs it
+    REQUIRE_THROWS(model->GetSmil(2));
+    REQUIRE_FALSE(model->SmilParseError(2).empty());
+    REQUIRE_THROWS(model->GetSmil(2));
+    REQUIRE_THROWS(model->DurationMilliseconds_Calculated());
+
+    container.reset();
+    std::remove(path.c_str());
+}
+
+TEST_CASE("SMIL error handlers can call back into the model", "")
+{
+    std::string path = MakeMediaOverlaysEPUB();
+    ContainerPtr container = Container::OpenContainer(path);
+    REQUIRE(bool(container));
+    auto model = container->DefaultPackage()->MediaOverlaysSmilModel();
+    REQUIRE(bool(model));
+
+    // the broken SMIL is let through, after looking at it and its neighbour; the
+    // total duration that's short because of it is fatal
+    bool sawBrokenSmil = false;
+    SetErrorHandler([&](const error_details& err) {
+        if (err.epub_error_code() == EPUBError::MediaOverlayNoBody)
+        {
+            sawBrokenSmil = true;
+            model->GetSmil(2);
+            return model->GetSmil(0)->DurationMilliseconds_Calculated() == 2000;
+        }
+        if (err.epub_error_code() == EPUBError::MediaOverlayMismatchDurationMetadata)
+            return false;
+        return DefaultErrorHandler(err);
+    });
+
+    REQUIRE_THROWS(model->DurationMilliseconds_Calculated());
+    REQUIRE(sawBrokenSmil);
+    REQUIRE(model->SmilParseError(2).empty());
+    REQUIRE(model->GetSmil(2)->Body() == nullptr);
+    REQUIRE_THROWS(model->DurationMilliseconds_Calculated());
+
+    SetErrorHandler(DefaultErrorHandler);
+    container.reset();
+    std::remove(path.c_str());
+}
+
+#if FUTURE_ENABLED
+TEST_CASE("Prefetching SMIL documents survives a broken one", "")
+{
+    std::string path = MakeMediaOverlaysEPUB();
+    ContainerPtr container = Container::OpenContainer(path);
+    REQUIRE(bool(container));
+    auto model = container->DefaultPackage()->MediaOverlaysSmilModel();
+    REQUIRE(bool(model));
+
+    // parses 1, 2 and 0 in the background; 2 fails
+    model->PrefetchSmilsAround(1);
+    for ( int i = 0; i < 500 && model->SmilParseError(2).empty(); i++ )
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    REQUIRE_FALSE(model->SmilParseError(2).empty());
+
+    REQUIRE(model->GetSmil(1)->DurationMilliseconds_Calculated() == 2000);
+    REQUIRE(model->SmilParseError(1).empty());
+    REQUIRE_THROWS(model->GetSmil(2));
+
+    container.reset();
+    std::remove(path.c_str());
+}
+#endif
+
+// SMILData's tree is normally built by MediaOverlaysSmilModel, a friend; these open up just
+// enough of it to build one by hand and to compare its indexed lookups with the tree walk
+class TestSMILData : public SMILData
+{
+public:
+    TestSMILData(SpineItemPtr spineItem) : SMILData(nullptr, nullptr, spineItem, 0) {}
+
+    void SetRoot(shared_ptr<Sequence> root)     { _root = root; }
+    void Index()                                { IndexTimeline(); }
+    void WalkTree()                             { _timelineIndexed = false; }
+
+    using SMILData::ParallelAt;
+    using SMILData::NthParallel;
+    using SMILData::ClipOffset;
+};
+
+class TestSequence : public SMILData::Sequence
+{
+public:
+    TestSequence(shared_ptr<Sequence> parent, SMILDataPtr smilData) : Sequence(parent, "", "", nullptr, "", smilData) {}
+
+    void Append(shared_ptr<const SMILData::TimeContainer> child) { _children.push_back(child); }
+};
+
+class TestParallel : public SMILData::Parallel
+{
+public:
+    TestParallel(shared_ptr<SMILData::Sequence> parent, SMILDataPtr smilData) : Parallel(parent, "", smilData) {}
+
+    void SetAudio(shared_ptr<SMILData::Audio> audio)   { _audio = audio; }
+    void SetText(shared_ptr<SMILData::Text> text)      { _text = text; }
+};
+
+// appends a 'par' to `seq`, with audio if `clipEnd` is nonzero and text in `textItem` if given
+static shared_ptr<const SMILData::Parallel> AddParallel(shared_ptr<TestSequence> seq, SMILDataPtr smilData, uint32_t clipBegin, uint32_t clipEnd, ManifestItemPtr textItem = nullptr)
+{
+    auto par = std::make_shared<TestParallel>(seq, smilData);
+    if ( clipEnd != 0 )
+        par->SetAudio(std::make_shared<SMILData::Audio>(par, "audio.mp3", nullptr, clipBegin, clipEnd, smilData));
+    if ( bool(textItem) )
+        par->SetText(std::make_shared<SMILData::Text>(par, textItem->Href(), "t1", textItem, smilData));
+    seq->Append(par);
+    return par;
+}
+
+TEST_CASE("Indexed SMIL timelines give the same answers as walking the tree", "")
+{
+    std::string path = MakeMediaOverlaysEPUB();
+    ContainerPtr container = Container::OpenContainer(path);
+    REQUIRE(bool(container));
+    PackagePtr package = container->DefaultPackage();
+    SpineItemPtr spineItem = package->SpineItemAt(0);
+    ManifestItemPtr ownText = package->ManifestItemWithID("c1");
+    ManifestItemPtr otherText = package->ManifestItemWithID("c2");
+    REQUIRE(spineItem->ManifestItem() == ownText);
+
+    auto smil = std::make_shared<TestSMILData>(spineItem);
+    auto body = std::make_shared<TestSequence>(nullptr, smil);
+    std::vector<shared_ptr<const SMILData::Parallel>> pars;
+
+    pars.push_back(AddParallel(body, smil, 0, 1000, ownText));          // 0-1000
+    pars.push_back(AddParallel(body, smil, 0, 0, ownText));             // empty: no audio
+    pars.push_back(AddParallel(body, smil, 1000, 1000, ownText));       // empty: zero-length clip
+    auto nested = std::make_shared<TestSequence>(body, smil);
+    body->Append(nested);
+    pars.push_back(AddParallel(nested, smil, 1000, 1500, ownText));     // 1000-1500
+    pars.push_back(AddParallel(nested, smil, 0, 0));                    // empty, no text either
+    pars.push_back(AddParallel(nested, smil, 1500, 2500));              // 1500-2500, no text
+    pars.push_back(AddParallel(body, smil, 0, 700, otherText));         // another document's audio
+    body->Append(std::make_shared<TestSequence>(body, smil));           // empty 'seq'
+    pars.push_back(AddParallel(body, smil, 5000, 5001, ownText));       // 2500-2501
+    pars.push_back(AddParallel(body, smil, 2000, 2500, ownText));       // 2501-3001
+    smil->SetRoot(body);
+
+    auto foreign = std::make_shared<TestParallel>(body, smil);
+
+    std::vector<shared_ptr<const SMILData::Parallel>> walkedAt, walkedNth;
+    std::vector<uint32_t> walkedOffsets;
+    smil->WalkTree();
+    uint32_t walkedDuration = smil->DurationMilliseconds_Calculated();
+    for ( uint32_t t = 0; t <= walkedDuration + 10; t++ )
+        walkedAt.push_back(smil->ParallelAt(t));
+    for ( uint32_t i = 0; i <= pars.size(); i++ )
+        walkedNth.push_back(smil->NthParallel(i));
+    for ( auto& par : pars )
+        walkedOffsets.push_back(smil->ClipOffset(par));
+
+    smil->Index();
+    REQUIRE(walkedDuration == 3001);
+    REQUIRE(smil->DurationMilliseconds_Calculated() == walkedDuration);
+    for ( uint32_t t = 0; t < walkedAt.size(); t++ )
+    {
+        CAPTURE(t);
+        REQUIRE(smil->ParallelAt(t) == walkedAt[t]);
+    }
+    for ( uint32_t i = 0; i < walkedNth.size(); i++ )
+    {
+        CAPTURE(i);
+        REQUIRE(smil->NthParallel(i) == walkedNth[i]);
+    }
+    for ( size_t i = 0; i < pars.size(); i++ )
+    {
+        CAPTURE(i);
+        REQUIRE(smil->ClipOffset(pars[i]) == walkedOffsets[i]);
+    }
+    REQUIRE(smil->ClipOffset(foreign) == 0);
+
+    // at a boundary the earlier 'par' is still playing; empty ones are never found by time
+    REQUIRE(smil->ParallelAt(0) == pars[0]);
+    REQUIRE(smil->ParallelAt(1000) == pars[0]);
+    REQUIRE(smil->ParallelAt(1001) == pars[3]);
+    REQUIRE(smil->ParallelAt(1500) == pars[3]);
+    REQUIRE(smil->ParallelAt(1501) == pars[5]);
+    REQUIRE(smil->ParallelAt(2501) == pars[7]);
+    REQUIRE(smil->ParallelAt(2502) == pars[8]);
+    REQUIRE(smil->ParallelAt(3001) == pars[8]);
+    REQUIRE(smil->ParallelAt(3002) == nullptr);
+    REQUIRE(smil->NthParallel(pars.size()) == nullptr);
+    REQUIRE(smil->ClipOffset(pars[8]) == 2501);
+
+    container.reset();
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Indexed SMIL timelines cope with a body of empty pars", "")
+{
+    auto smil = std::make_shared<TestSMILData>(nullptr);
+    auto body = std::make_shared<TestSequence>(nullptr, smil);
+    auto first = AddParallel(body, smil, 0, 0);
+    auto second = AddParallel(body, smil, 300, 300);
+    smil->SetRoot(body);
+    smil->Index();
+
+    REQUIRE(smil->DurationMilliseconds_Calculated() == 0);
+    REQUIRE(smil->ParallelAt(0) == nullptr);
+    REQUIRE(smil->ParallelAt(1) == nullptr);
+    REQUIRE(smil->NthParallel(0) == first);
+    REQUIRE(smil->NthParallel(1) == second);
+    REQUIRE(smil->NthParallel(2) == nullptr);
+    REQUIRE(smil->ClipOffset(second) == 0);
+
+    smil->WalkTree();
+    REQUIRE(smil->DurationMilliseconds_Calculated() == 0);
+    REQUIRE(smil->ParallelAt(0) == nullptr);
+    REQUIRE(smil->NthParallel(1) == second);
+}
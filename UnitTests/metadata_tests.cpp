@@ -135,3 +135,64 @@ TEST_CASE("An appropriately localized value should be returned if available", ""
     REQUIRE(pkg->Authors() == "Natsume, Sōseki");
     REQUIRE(pkg->Contributors() == u8"柴田 卓治, 伊藤 時也, Ministry of Internal Affairs and Communications, Japanese EPUB Specification Settlement Project, Reika Mochida, Mayu Hamada, Taichi Kawabata, and Makoto Murata");
 }
+
+TEST_CASE("Interned property IRIs should match the IRIs they stand for", "")
+{
+    PackagePtr pkg = GetContainer()->DefaultPackage();
+    
+    REQUIRE(PropertyHolder::InternIRI(IRI()) == 0);
+    REQUIRE(PropertyHolder::InternIRI(DCType::Custom) == 0);
+    REQUIRE(PropertyHolder::InternIRI(DCType::Title) == PropertyHolder::InternIRI(IRIForDCType(DCType::Title)));
+    REQUIRE(PropertyHolder::InternIRI(DCType::Title) != PropertyHolder::InternIRI(DCType::Creator));
+    
+    IRI iri = pkg->MakePropertyIRI("modified", "dcterms");
+    REQUIRE(pkg->InternPropertyIRI("modified", "dcterms") == PropertyHolder::InternIRI(iri));
+    REQUIRE(pkg->InternPropertyIRI("modified", "no-such-prefix") == 0);
+    
+    REQUIRE(pkg->PropertiesMatching(PropertyHolder::InternIRI(DCType::Creator)).size() == 2);
+    REQUIRE(pkg->PropertiesMatching(pkg->InternPropertyIRI("title-type")).size() == 2);
+    REQUIRE(pkg->PropertyMatching(PropertyHolder::InternIRI(iri))->Value() == "2010-02-17T04:39:13Z");
+    REQUIRE_FALSE(pkg->ContainsProperty(pkg->InternPropertyIRI("title-type")));
+}
+
+TEST_CASE("Cached metadata should follow property changes", "")
+{
+    // a private copy, since this modifies the package
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    PackagePtr pkg = c->DefaultPackage();
+    PropertyHolderPtr holder = pkg;
+    
+    REQUIRE(pkg->Publisher().empty());
+    auto publisher = std::make_shared<Property>(holder);
+    publisher->SetDCType(DCType::Publisher);
+    publisher->SetValue("Readium Foundation");
+    pkg->AddProperty(publisher);
+    REQUIRE(pkg->Publisher() == "Readium Foundation");
+    
+    auto creator = std::make_shared<Property>(holder);
+    creator->SetDCType(DCType::Creator);
+    creator->SetValue("Anonymous");
+    pkg->AddProperty(creator);
+    REQUIRE(pkg->Authors() == "Charles Madison Curry, Erle Elsworth Clippinger, and Anonymous");
+    
+    REQUIRE(pkg->ModificationDate() == "2010-02-17T04:39:13Z");
+    pkg->RemoveProperty("modified", "dcterms");
+    REQUIRE(pkg->ModificationDate().empty());
+    
+    // re-typing a title through its refinement
+    auto subtitle = pkg->PropertiesMatching(DCType::Title)[1];
+    auto titleType = subtitle->ExtensionWithIdentifier(pkg->MakePropertyIRI("title-type"));
+    REQUIRE(pkg->EditionTitle().empty());
+    titleType->SetValue("edition");
+    REQUIRE(pkg->Subtitle().empty());
+    REQUIRE(pkg->EditionTitle() == "A Textbook of Sources for Teachers and Teacher-Training Classes");
+    
+    // a new refinement on a property which is already in the holder
+    auto shortTitle = std::make_shared<PropertyExtension>(pkg->PropertiesMatching(DCType::Title)[0]);
+    shortTitle->SetPropertyIdentifier(pkg->MakePropertyIRI("title-type"));
+    shortTitle->SetValue("short");
+    REQUIRE(pkg->ShortTitle().empty());
+    pkg->PropertiesMatching(DCType::Title)[0]->AddExtension(shortTitle);
+    REQUIRE(pkg->ShortTitle().empty());     // the first title-type is still 'main'
+    REQUIRE(pkg->PropertiesMatching(pkg->InternPropertyIRI("title-type")).size() == 2);
+}
@@ -17,6 +17,8 @@
 #include "../ePub3/ePub/container.h"
 #include "../ePub3/ePub/package.h"
 #include "catch.hpp"
+#include "benchmark.h"
+#include REGEX_INCLUDE
 
 #define EPUB_PATH "TestData/widget-figure-gallery-20121022.epub"
 
@@ -223,3 +225,159 @@ TEST_CASE("The title of the 'Open Fullscreen' button may be replaced", "")
     REQUIRE(outLen == sizeof(gGalleryIFrameFrench));
     REQUIRE(strncmp(gGalleryIFrameFrench, output, outLen) == 0);
 }
+
+// The regular expressions ObjectPreprocessor used before it had a scanner of its own
+static const REGEX_NS::regex::flag_type gRegexFlags(REGEX_NS::regex::ECMAScript|REGEX_NS::regex::optimize);
+static const REGEX_NS::regex gParamMatcher("<param[^>]+(name|value)=\"([^\"]*)\"[^>]*?(value|name)=\"([^\"]*)\"(.|\\n|\\r)*?>", gRegexFlags);
+static const REGEX_NS::regex gSourceFinder("data=\\\"([^\\\"]*)\\\"", gRegexFlags);
+static const REGEX_NS::regex gIDFinder("id=\\\"([^\\\"]*)\\\"", gRegexFlags);
+
+static std::string RegexPreprocess(const std::string& input, PackagePtr pkg, const std::string& button)
+{
+    std::string reStr("<object\\s+?([^>]*?(?:media-)?type=\"(");
+    for ( auto& mediaType : pkg->MediaTypesWithDHTMLHandlers() )
+        reStr += mediaType.stl_str() + "|";
+    reStr.back() = ')';
+    reStr += "\"[^>]*?)>((?:.|\\n|\\r)*?)</object>";
+    REGEX_NS::regex objectMatcher(reStr, gRegexFlags);
+    
+    REGEX_NS::sregex_iterator pos(input.begin(), input.end(), objectMatcher);
+    REGEX_NS::sregex_iterator end;
+    if ( pos == end )
+        return input;
+    
+    std::string output;
+    while ( pos != end )
+    {
+        output += pos->prefix();
+        
+        std::string type(pos->str(2));
+        ContentHandler::ParameterList params;
+        params["type"] = type;
+        
+        REGEX_NS::smatch m;
+        std::string attrs(pos->str(1));
+        REGEX_NS::regex_search(attrs.cbegin(), attrs.cend(), m, gSourceFinder);
+        string src(m[1].str());
+        
+        std::string content(pos->str(3));
+        for ( REGEX_NS::sregex_iterator cpos(content.begin(), content.end(), gParamMatcher); cpos != end; ++cpos )
+        {
+            string name, value;
+            if ( cpos->str(1) == "name" )
+                name = cpos->str(2);
+            else
+                value = cpos->str(2);
+            
+            if ( cpos->str(3) == "value" )
+                value = cpos->str(4);
+            else
+                name = cpos->str(4);
+            
+            params[name] = value;
+        }
+        
+        std::string url = pkg->OPFHandlerForMediaType(type)->Target(src, params).URIString().stl_str();
+        
+        std::string objectID;
+        if ( REGEX_NS::regex_search(attrs.cbegin(), attrs.cend(), m, gIDFinder) )
+            objectID = m[1].str();
+        
+        output += "<iframe src=\"" + url + "\" srcdoc=\"" + url + "\"";
+        if ( !objectID.empty() )
+            output += " id=\"" + objectID + "\"";
+        output += " sandbox=\"allow-forms allow-scripts allow-same-origin\" seamless=\"seamless\"></iframe>";
+        output += "<form action=\"" + url + "\" method=\"get\"";
+        if ( !objectID.empty() )
+            output += " id=\"" + objectID + "-form\"";
+        output += "><button type=\"submit\"";
+        if ( !objectID.empty() )
+            output += " id=\"" + objectID + "-button\"";
+        output += ">" + button + "</button></form>";
+        
+        auto here = pos++;
+        if ( pos == end )
+            output += here->suffix();
+    }
+    return output;
+}
+
+// runs a document through the filter
+static std::string ScanPreprocess(ObjectPreprocessor& proc, const std::string& input)
+{
+    char* data = new char[input.size() + 1];
+    input.copy(data, input.size());
+    
+    size_t outLen = 0;
+    char* result = reinterpret_cast<char*>(proc.FilterData(nullptr, data, input.size(), &outLen));
+    std::string output(result, outLen);
+    
+    if ( result != data )
+        delete [] result;
+    delete [] data;
+    
+    return output;
+}
+
+static const char gOddObjects[] = R"raw(<html><body>
+    <object media-type="application/x-epub-figure-gallery" data="a.xml">
+        <param name="speed" value="fast"/>
+        <param value="2" name="count">
+        <param name="a" value="1" name="b" value="2"/>
+        <param name="only"/>
+    </object>
+    <objects type="application/x-epub-figure-gallery">not an object</objects>
+    <OBJECT type="application/x-epub-figure-gallery">upper case</OBJECT>
+    <object type="video/mpeg" data="v.mp4"></object>
+    <object id="x" class="type=&quot;" type="text/plain" data-type="application/x-epub-figure-gallery" data="b.xml"></object>
+    <object
+        type="application/x-epub-figure-gallery"
+        data="c.xml" id="multi-line"><p>fallback</p></object>
+    <object type="application/x-epub-figure-gallery" data="unterminated.xml">
+</body></html>)raw";
+
+static std::vector<std::string> SampleDocuments()
+{
+    return {gNormalObject, gGalleryObject, gShortGalleryObject, gOddObjects};
+}
+
+TEST_CASE("The object scanner should match the regular expressions it replaced", "")
+{
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    PackagePtr pkg = c->DefaultPackage();
+    
+    ObjectPreprocessor proc(pkg);
+    for ( auto& doc : SampleDocuments() )
+    {
+        INFO("Input:\n" << doc);
+        REQUIRE(ScanPreprocess(proc, doc) == RegexPreprocess(doc, pkg, "Open Fullscreen"));
+    }
+}
+
+TEST_CASE("Object preprocessing benchmark", "[.][benchmark]")
+{
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    PackagePtr pkg = c->DefaultPackage();
+    
+    // a long chapter: plenty of prose, with a gallery every few paragraphs
+    std::string doc("<html xmlns=\"http://www.w3.org/1999/xhtml\"><body>\n");
+    for ( int i = 0; doc.size() < 2*1024*1024; i++ )
+    {
+        doc += "<p class=\"body\">Lorem ipsum dolor sit amet, <em>consectetur</em> adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris.</p>\n";
+        if ( i % 8 == 0 )
+            doc += "<object data=\"moon-phases.xml\" type=\"application/x-epub-figure-gallery\" id=\"g" + std::to_string(i) + "\"><param name=\"start\" value=\"2\"/><img src=\"fallback.jpg\"/></object>\n";
+    }
+    doc += "</body></html>\n";
+    
+    ObjectPreprocessor proc(pkg);
+    
+    std::string expected, scannedOutput;
+    BenchmarkClock::duration regex = TimeBenchmark([&]() { expected = RegexPreprocess(doc, pkg, "Open Fullscreen"); });
+    BenchmarkClock::duration scanned = TimeBenchmark([&]() { scannedOutput = ScanPreprocess(proc, doc); });
+    
+    REQUIRE(scannedOutput == expected);
+    
+    ReportBenchmarkHeading(std::to_string(doc.size()) + " byte document");
+    ReportBenchmark("regular expressions", regex);
+    ReportBenchmark("scanner", scanned);
+}
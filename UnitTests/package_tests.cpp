@@ -625,6 +625,14 @@ TEST_CASE("Package should have a Unique ID, Package ID, Type, Version, and a Bas
     REQUIRE(pkg->BasePath() == "EPUB/");
 }
 
+TEST_CASE("Unique IDs should be built from the unique-id and modification date as written", "")
+{
+    REQUIRE(Package::MakeUniqueID("urn:isbn:9780000000000", "2014-01-01T00:00:00Z") == "urn:isbn:9780000000000@2014-01-01T00:00:00Z");
+    REQUIRE(Package::MakeUniqueID("\n    urn:isbn:9780000000000\n  ", "2014-01-01T00:00:00Z") == "\n    urn:isbn:9780000000000\n  @2014-01-01T00:00:00Z");
+    REQUIRE(Package::MakeUniqueID("urn:isbn:9780000000000", "") == "urn:isbn:9780000000000");
+    REQUIRE(Package::MakeUniqueID("", "2014-01-01T00:00:00Z") == "");
+}
+
 TEST_CASE("Packages with no version should raise a spec error", "")
 {
     EPUBError triggeredError = EPUBError::NoError;
@@ -965,6 +973,31 @@ TEST_CASE("Package should have multiple manifest items, and they should be index
     REQUIRE(fetched == randomItem);
 }
 
+TEST_CASE("Manifest items should be found by relative path, percent-encoded or not", "")
+{
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    PackagePtr pkg = c->DefaultPackage();
+    
+    for ( auto& pair : pkg->Manifest() )
+    {
+        ManifestItemPtr item = pair.second;
+        std::string href = item->Href().stl_str();
+        REQUIRE(pkg->ManifestItemAtRelativePath(href) == item);
+        
+        // escape every '.', in both upper and lower case hex
+        std::string upper, lower;
+        for ( char ch : href )
+        {
+            upper += (ch == '.' ? std::string("%2E") : std::string(1, ch));
+            lower += (ch == '.' ? std::string("%2e") : std::string(1, ch));
+        }
+        REQUIRE(pkg->ManifestItemAtRelativePath(upper) == item);
+        REQUIRE(pkg->ManifestItemAtRelativePath(lower) == item);
+    }
+    
+    REQUIRE(pkg->ManifestItemAtRelativePath("no/such%20file.xhtml") == nullptr);
+}
+
 TEST_CASE("Package should have multiple spine items", "")
 {
     ContainerPtr c = Container::OpenContainer(EPUB_PATH);
@@ -979,6 +1012,30 @@ TEST_CASE("Package should have multiple spine items", "")
     REQUIRE(pkg->SpineItemAt(idx) == (*pkg)[idx]);
 }
 
+TEST_CASE("Spine index lookups should agree with the linked list", "")
+{
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    PackagePtr pkg = c->DefaultPackage();
+    
+    size_t count = pkg->SpineItemCount();
+    REQUIRE(count == pkg->FirstSpineItem()->Count());
+    
+    size_t i = 0;
+    for ( auto item = pkg->FirstSpineItem(); item != nullptr; item = item->Next(), i++ )
+    {
+        REQUIRE(item->Index() == i);
+        REQUIRE(item->Count() == count - i);
+        REQUIRE(pkg->SpineItemAt(i) == item);
+        REQUIRE(pkg->IndexOfSpineItemWithIDRef(item->Idref()) == i);
+        REQUIRE(pkg->SpineItemWithIDRef(item->Idref()) == item);
+    }
+    REQUIRE(i == count);
+    
+    REQUIRE(pkg->SpineItemAt(count) == nullptr);
+    REQUIRE(pkg->IndexOfSpineItemWithIDRef("no-such-idref") == size_t(-1));
+    REQUIRE(pkg->SpineItemWithIDRef("no-such-idref") == nullptr);
+}
+
 TEST_CASE("Package should be able to create and resolve basic CFIs", "")
 {
     ContainerPtr c = Container::OpenContainer(EPUB_PATH);
@@ -62,3 +62,47 @@ TEST_CASE("string charset searching", "find_first_of with a set containing utf-8
     REQUIRE_THROWS_AS(str.find_first_of(str.stl_str().substr(0, 2)), string::InvalidUTF8Sequence);
     REQUIRE(str.find_first_of("#$%") == string::npos);
 }
+
+TEST_CASE("string index after mutation", "Code-point lookups should stay correct as a string is edited")
+{
+    // long enough to span several index strides
+    string str;
+    for ( int i = 0; i < 40; i++ )
+        str.append(u8"\u6f22\u5b57 ab\U0001F600 ");
+    
+    REQUIRE(str.size() == 280);
+    REQUIRE(str.at(7) == char32_t(0x6f22));
+    REQUIRE(str.at(278) == char32_t(0x1F600));
+    REQUIRE(str.find("ab", 100) == 101);
+    REQUIRE(str.substr(105, 4) == u8"\u6f22\u5b57 a");
+    
+    str.insert(1, u8"\u2026\u2026");
+    REQUIRE(str.size() == 282);
+    REQUIRE(str.at(2) == char32_t(0x2026));
+    REQUIRE(str.at(280) == char32_t(0x1F600));
+    REQUIRE(str.find("ab", 100) == 103);
+    
+    str.erase(0, 10);
+    REQUIRE(str.size() == 272);
+    REQUIRE(str.at(0) == char32_t(0x5b57));
+    REQUIRE(str.rfind(string(u8"\U0001F600")) == 270);
+    REQUIRE(str.rfind(string(u8"\U0001F600"), 269) == 263);
+    
+    string copy(str);
+    str.clear();
+    REQUIRE(str.size() == 0);
+    REQUIRE(copy.size() == 272);
+    
+    copy = "plain ASCII";
+    REQUIRE(copy.size() == 11);
+    REQUIRE(copy.at(6) == U'A');
+    
+    // moving the content takes its index along, and leaves none behind
+    string source(u8"\u6f22\u5b57 ab");
+    REQUIRE(source.at(3) == U'a');
+    string target;
+    target.assign(std::move(source));
+    REQUIRE(target.size() == 5);
+    REQUIRE(target.at(3) == U'a');
+    REQUIRE(source.size() == 0);
+}
@@ -12,11 +12,13 @@
 //  3. Neither the name of the organization nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
 //
 
-THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "../ePub3/ePub/switch_preprocessor.h"
 #include "catch.hpp"
+#include "benchmark.h"
+#include REGEX_INCLUDE
 
 using namespace ePub3;
 
@@ -420,3 +422,160 @@ TEST_CASE("Processors should NOT uncomment switch constructs which have been com
     
     SwitchPreprocessor::SetSupportedNamespaces({});
 }
+
+// The regular expressions SwitchPreprocessor used before it had a scanner of its own
+static const REGEX_NS::regex_constants::syntax_option_type gRegexFlags = REGEX_NS::regex::icase|REGEX_NS::regex::optimize|REGEX_NS::regex::ECMAScript;
+static const REGEX_NS::regex gCommentedSwitchIdentifier("(?:<!--)(\\s*<(?:epub:)switch(?:.|\\n|\\r)*?<(?:epub:)default(?:.|\\n|\\r)*?>\\s*)(?:-->)((?:.|\\n|\\r)*?)(?:<!--)(\\s*</(?:epub:)default>(?:.|\\n|\\r)*?)(?:-->)", gRegexFlags);
+static const REGEX_NS::regex gSwitchContentExtractor("<(?:epub:)?switch(?:.|\\n|\\r)*?>((?:.|\\n|\\r)*?)</(?:epub:)?switch(?:.|\\n|\\r)*?>", gRegexFlags);
+static const REGEX_NS::regex gCaseContentExtractor("<(?:epub:)?case\\s+required-namespace=\"(.*?)\">((?:.|\\n|\\r)*?)</(?:epub:)?case(?:.|\\n|\\r)*?>", gRegexFlags);
+static const REGEX_NS::regex gDefaultContentExtractor("<(?:epub:)?default(?:.|\\n|\\r)*?>((?:.|\\n|\\r)*?)</(?:epub:)?default(?:.|\\n|\\r)*?>", gRegexFlags);
+
+static std::string RegexPreprocess(const std::string& input, const SwitchPreprocessor::NamespaceList& namespaces)
+{
+    std::string str = REGEX_NS::regex_replace(input, gCommentedSwitchIdentifier, std::string("$1$2$3"));
+    
+    auto pos = REGEX_NS::sregex_iterator(str.begin(), str.end(), gSwitchContentExtractor);
+    auto end = REGEX_NS::sregex_iterator();
+    if ( pos == end )
+        return str;
+    
+    std::string output;
+    while ( pos != end )
+    {
+        output += pos->prefix();
+        std::string switchContents = pos->str(1);
+        
+        bool matched = false;
+        if ( !namespaces.empty() )
+        {
+            for ( auto cpos = REGEX_NS::sregex_iterator(switchContents.begin(), switchContents.end(), gCaseContentExtractor); cpos != end && !matched; ++cpos )
+            {
+                for ( auto& ns : namespaces )
+                {
+                    if ( ns == cpos->str(1) )
+                    {
+                        output += cpos->str(2);
+                        matched = true;
+                        break;
+                    }
+                }
+            }
+        }
+        
+        if ( !matched )
+        {
+            REGEX_NS::smatch defaultCase;
+            if ( REGEX_NS::regex_search(switchContents, defaultCase, gDefaultContentExtractor) )
+                output += defaultCase[1].str();
+        }
+        
+        auto here = pos++;
+        if ( pos == end )
+            output += here->suffix();
+    }
+    return output;
+}
+
+// runs a document through the filter
+static std::string ScanPreprocess(const std::string& input)
+{
+    SwitchPreprocessor proc;
+    char* data = new char[input.size() + 1];
+    input.copy(data, input.size());
+    
+    size_t outLen = 0;
+    char* result = reinterpret_cast<char*>(proc.FilterData(nullptr, data, input.size(), &outLen));
+    std::string output(result, outLen);
+    
+    if ( result != data )
+        delete [] result;
+    delete [] data;
+    
+    return output;
+}
+
+static const char gOddSwitches[] = R"raw(<html><body>
+    <SWITCH><Case required-namespace="urn:x:cml">cml</CASE><default>plain</default></switch>
+    <epub:switch><epub:case  required-namespace="http://www.w3.org/1998/Math/MathML" >not quite</epub:case>
+        <epub:case
+            required-namespace="http://www.w3.org/1998/Math/MathML">math</epub:case >
+        <epub:default class="x">fallback</epub:default ></epub:switch >
+    <epub:switch><epub:case required-namespace="urn:x:cml">no default</epub:case></epub:switch>
+    <!-- <epub:switch><epub:default>--><p>commented</p><!--</EPUB:DEFAULT></epub:switch> -->
+    <!--<epub:switched/>--> <switchy>not a switch</switchy> <!-- <epub:switch -->
+    <epub:switch><epub:default>unterminated</epub:default>
+</body></html>)raw";
+
+static std::vector<std::string> SampleDocuments()
+{
+    return {gInput, gCommentedInput, gTotallyCommentedInput, gOddSwitches};
+}
+
+static std::vector<SwitchPreprocessor::NamespaceList> SampleNamespaces()
+{
+    return {
+        {},
+        {"http://www.xml-cml.org/schema"},
+        {MathMLNamespaceURI, "urn:x:cml"},
+        {"http://www.xml-cml.org/schema", MathMLNamespaceURI},
+    };
+}
+
+TEST_CASE("The switch scanner should match the regular expressions it replaced", "")
+{
+    for ( auto& namespaces : SampleNamespaces() )
+    {
+        SwitchPreprocessor::SetSupportedNamespaces(namespaces);
+        for ( auto& doc : SampleDocuments() )
+        {
+            INFO("Input:\n" << doc);
+            REQUIRE(ScanPreprocess(doc) == RegexPreprocess(doc, namespaces));
+        }
+    }
+    
+    SwitchPreprocessor::SetSupportedNamespaces({});
+}
+
+TEST_CASE("Documents without switches should pass through unaltered", "")
+{
+    SwitchPreprocessor proc;
+    std::unique_ptr<FilterContext> ctx(proc.MakeFilterContext(nullptr));
+    
+    static const char doc[] = "<html><body><p>No <em>switches</em> here; <!-- just a comment --></p></body></html>";
+    char* input = strdup(doc);
+    size_t outLen = 0;
+    void* output = proc.FilterData(ctx.get(), input, sizeof(doc) - 1, &outLen);
+    
+    REQUIRE(output == input);
+    REQUIRE(outLen == sizeof(doc) - 1);
+    REQUIRE(strcmp(input, doc) == 0);
+    free(input);
+}
+
+TEST_CASE("Switch preprocessing benchmark", "[.][benchmark]")
+{
+    // a long chapter: plenty of prose, with a switch every few paragraphs
+    std::string doc("<html xmlns=\"http://www.w3.org/1999/xhtml\" xmlns:epub=\"http://www.idpf.org/2007/ops\"><body>\n");
+    for ( int i = 0; doc.size() < 2*1024*1024; i++ )
+    {
+        doc += "<p class=\"body\">Lorem ipsum dolor sit amet, <em>consectetur</em> adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris.</p>\n";
+        if ( i % 8 == 0 )
+            doc += "<epub:switch><epub:case required-namespace=\"http://www.w3.org/1998/Math/MathML\"><math><mi>x</mi></math></epub:case><epub:default><p>x</p></epub:default></epub:switch>\n";
+    }
+    doc += "</body></html>\n";
+    
+    SwitchPreprocessor::NamespaceList namespaces{MathMLNamespaceURI};
+    SwitchPreprocessor::SetSupportedNamespaces(namespaces);
+    
+    std::string expected, scannedOutput;
+    BenchmarkClock::duration regex = TimeBenchmark([&]() { expected = RegexPreprocess(doc, namespaces); });
+    BenchmarkClock::duration scanned = TimeBenchmark([&]() { scannedOutput = ScanPreprocess(doc); });
+    
+    REQUIRE(scannedOutput == expected);
+    
+    ReportBenchmarkHeading(std::to_string(doc.size()) + " byte document");
+    ReportBenchmark("regular expressions", regex);
+    ReportBenchmark("scanner", scanned);
+    
+    SwitchPreprocessor::SetSupportedNamespaces({});
+}
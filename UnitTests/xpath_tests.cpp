@@ -0,0 +1,137 @@
+//
+//  xpath_tests.cpp
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+//
+
+
+#include "../ePub3/ePub/container.h"
+#include "../ePub3/ePub/package.h"
+#include "../ePub3/ePub/manifest.h"
+#include "../ePub3/ePub/xpath_wrangler.h"
+#include "../ePub3/xml/tree/document.h"
+#include "../ePub3/xml/tree/xpath.h"
+#include "catch.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define EPUB_PATH "TestData/childrens-literature-20120722.epub"
+#define NAV_ITEM_ID "nav"
+
+using namespace ePub3;
+
+TEST_CASE("Compiled XPath expressions are shared between evaluators", "")
+{
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    PackagePtr pkg = c->DefaultPackage();
+
+    ManifestItemPtr nav = pkg->ManifestItemWithID(NAV_ITEM_ID);
+    REQUIRE(bool(nav));
+    shared_ptr<xml::Document> doc = nav->ReferencedDocument();
+    REQUIRE(bool(doc));
+
+    xml::XPathEvaluator::FlushCompiledExpressionCache();
+
+    XPathWrangler xpath(doc, {{"html", "http://www.w3.org/1999/xhtml"}});
+    xml::NodeSet lists = xpath.Nodes("//html:nav/html:ol");
+    REQUIRE(lists.size() > 0);
+
+    // a second wrangler picks up the compiled expression and gets the same answer
+    XPathWrangler other(doc, {{"html", "http://www.w3.org/1999/xhtml"}});
+    REQUIRE(other.Nodes("//html:nav/html:ol").size() == lists.size());
+
+    // the same prefix bound to another namespace must not reuse that expression
+    XPathWrangler wrongNS(doc, {{"html", "urn:not-xhtml"}});
+    REQUIRE(wrongNS.Nodes("//html:nav/html:ol").empty());
+
+    // one wrangler runs several expressions through the same context
+    XPathWrangler::StringList titles = xpath.Strings("//html:head/html:title/text()");
+    REQUIRE(titles.size() == 1);
+    REQUIRE(xpath.Nodes("//html:nav/html:ol").size() == lists.size());
+
+    // namespaces registered after the first query are seen by later ones
+    XPathWrangler late(doc);
+    REQUIRE(late.Nodes("//nav").empty());
+    late.RegisterNamespaces({{"html", "http://www.w3.org/1999/xhtml"}});
+    REQUIRE(late.Nodes("//html:nav/html:ol").size() == lists.size());
+
+    // and the package's own queries are unaffected
+    string packageID = pkg->PackageID();
+    REQUIRE_FALSE(packageID.empty());
+    REQUIRE(pkg->PackageID() == packageID);
+}
+
+static const char* kThreadedExpressions[] = {
+    "//html:nav/html:ol",
+    "//html:nav//html:a",
+    "//html:head/html:title/text()",
+    "//html:li[position() = last()]",
+    "//html:a[starts-with(@href, 'c')]",
+};
+
+// evaluates each of kThreadedExpressions once, returning the number of nodes found by each
+static std::vector<size_t> EvaluateThreadedExpressions(shared_ptr<xml::Document> doc)
+{
+    std::vector<size_t> counts;
+    XPathWrangler xpath(doc, {{"html", "http://www.w3.org/1999/xhtml"}});
+    for ( const char* expr : kThreadedExpressions )
+        counts.push_back(xpath.Nodes(expr).size());
+    return counts;
+}
+
+TEST_CASE("Cached XPath expressions evaluate correctly on many threads at once", "")
+{
+    static const int kThreads = 8;
+    static const int kIterations = 200;
+    
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    ManifestItemPtr nav = c->DefaultPackage()->ManifestItemWithID(NAV_ITEM_ID);
+    REQUIRE(bool(nav));
+    
+    xml::XPathEvaluator::FlushCompiledExpressionCache();
+    std::vector<size_t> expected = EvaluateThreadedExpressions(nav->ReferencedDocument());
+    REQUIRE(expected[0] > 0);
+    
+    std::atomic<int> mismatches(0);
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < kThreads; t++ )
+    {
+        threads.emplace_back([&]() {
+            shared_ptr<xml::Document> doc = nav->ReferencedDocument();
+            for ( int i = 0; i < kIterations; i++ )
+            {
+                if ( EvaluateThreadedExpressions(doc) != expected )
+                    ++mismatches;
+            }
+        });
+    }
+    for ( auto& thread : threads )
+        thread.join();
+    
+    REQUIRE(mismatches == 0);
+}
+
+TEST_CASE("Evicted XPath expressions are compiled again", "")
+{
+    ContainerPtr c = Container::OpenContainer(EPUB_PATH);
+    ManifestItemPtr nav = c->DefaultPackage()->ManifestItemWithID(NAV_ITEM_ID);
+    REQUIRE(bool(nav));
+    shared_ptr<xml::Document> doc = nav->ReferencedDocument();
+    
+    xml::XPathEvaluator::FlushCompiledExpressionCache();
+    std::vector<size_t> expected = EvaluateThreadedExpressions(doc);
+    
+    // more distinct expressions than the cache holds
+    XPathWrangler xpath(doc, {{"html", "http://www.w3.org/1999/xhtml"}});
+    for ( int i = 0; i < 1000; i++ )
+        xpath.Nodes(_Str("//html:li[", i + 1, "]"));
+    
+    REQUIRE(EvaluateThreadedExpressions(doc) == expected);
+}
@@ -163,6 +163,8 @@ enum zip_source_cmd {
 typedef ssize_t (*zip_source_callback)(void *state, void *data,
 				       size_t len, enum zip_source_cmd cmd);
 
+typedef void (*zip_lock_callback)(void *ctx);
+
 struct zip_stat {
     const char *name;			/* name of the file */
     int index;				/* index within archive */
@@ -207,6 +209,9 @@ ZIP_EXTERN int zip_replace(struct zip *, int, struct zip_source *);
 ZIP_EXTERN int zip_set_archive_comment(struct zip *, const char *, int);
 ZIP_EXTERN int zip_set_archive_flag(struct zip *, int, int);
 ZIP_EXTERN int zip_set_file_comment(struct zip *, int, const char *, int);
+ZIP_EXTERN int zip_set_lock_callbacks(struct zip *, zip_lock_callback,
+				      zip_lock_callback, void *);
+ZIP_EXTERN int zip_set_seek_interval(struct zip *, unsigned int);
 ZIP_EXTERN struct zip_source *zip_source_buffer(struct zip *, const void *,
 						off_t, int);
 ZIP_EXTERN struct zip_source *zip_source_file(struct zip *, const char *,
@@ -49,6 +49,7 @@ zip_fclose(struct zip_file *zf)
     free(zf->buffer);
     free(zf->zstr);
 
+    ZIP_LOCK(zf->za);
     for (i=0; i<zf->za->nfile; i++) {
 	if (zf->za->file[i] == zf) {
 	    zf->za->file[i] = zf->za->file[zf->za->nfile-1];
@@ -56,6 +57,7 @@ zip_fclose(struct zip_file *zf)
 	    break;
 	}
     }
+    ZIP_UNLOCK(zf->za);
 
     ret = 0;
     if (zf->error.zip_err)
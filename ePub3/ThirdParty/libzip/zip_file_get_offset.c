@@ -54,42 +54,42 @@
 /* _zip_file_get_offset(za, ze):
    Returns the offset of the file data for entry ze.
 
+   Only the fixed part of the local header is read, with _zip_pread(),
+   so this may be called on several threads at once.
+
    On error, fills in za->error and returns 0.
 */
 
 unsigned int
 _zip_file_get_offset(struct zip *za, int idx)
 {
-    struct zip_dirent de;
+    unsigned char buf[LENTRYSIZE], *cur;
     unsigned int offset;
+    unsigned short filename_len, extrafield_len;
+    ssize_t n;
 
     offset = za->cdir->entry[idx].offset;
 
-    if (fseeko(za->zp, offset, SEEK_SET) != 0) {
-	_zip_error_set(&za->error, ZIP_ER_SEEK, errno);
+    if ((n=_zip_pread(za, buf, LENTRYSIZE, offset)) < 0) {
+	_zip_error_set(&za->error, ZIP_ER_READ, errno);
 	return 0;
     }
-
-    if (_zip_dirent_read(&de, za->zp, NULL, NULL, 1, &za->error) != 0)
+    if (n < LENTRYSIZE || memcmp(buf, LOCAL_MAGIC, 4) != 0) {
+	_zip_error_set(&za->error, ZIP_ER_NOZIP, 0);
 	return 0;
+    }
 
-    offset += LENTRYSIZE + de.filename_len + de.extrafield_len;
-
-    _zip_dirent_finalize(&de);
+    cur = buf + 26;
+    filename_len = _zip_read2(&cur);
+    extrafield_len = _zip_read2(&cur);
 
-    return offset;
+    return offset + LENTRYSIZE + filename_len + extrafield_len;
 }
 
 /* JCD added */
 unsigned int
 _zip_file_get_offset_safe(struct zip* za, int idx)
 {
-    off_t curoff;
-    unsigned int offset;
-    
-    curoff = ftello(za->zp);
-    offset = _zip_file_get_offset(za, idx);
-    fseeko(za->zp, curoff, SEEK_SET);
-    
-    return offset;
+    /* _zip_file_get_offset() no longer moves za->zp */
+    return _zip_file_get_offset(za, idx);
 }
@@ -171,16 +171,13 @@ _zip_file_fillbuf(void *buf, size_t buflen, struct zip_file *zf)
     if ((zf->flags & ZIP_ZF_EOF) || zf->cbytes_left <= 0 || buflen <= 0)
 	return 0;
     
-    if (fseeko(zf->za->zp, zf->fpos, SEEK_SET) < 0) {
-	_zip_error_set(&zf->error, ZIP_ER_SEEK, errno);
-	return -1;
-    }
     if (buflen < zf->cbytes_left)
 	i = (ssize_t)buflen;
     else
 	i = zf->cbytes_left;
 
-    j = (ssize_t)fread(buf, 1, i, zf->za->zp);
+    /* zf keeps its own position, so this needs no lock */
+    j = _zip_pread(zf->za, buf, (size_t)i, zf->fpos);
     if (j == 0) {
 	_zip_error_set(&zf->error, ZIP_ER_EOF, 0);
 	j = -1;
@@ -208,11 +205,13 @@ _zip_file_new(struct zip *za)
 	return NULL;
     }
     
+    ZIP_LOCK(za);
     if (za->nfile >= za->nfile_alloc-1) {
 	n = za->nfile_alloc + 10;
 	file = (struct zip_file **)realloc(za->file,
 					   n*sizeof(struct zip_file *));
 	if (file == NULL) {
+	    ZIP_UNLOCK(za);
 	    _zip_error_set(&za->error, ZIP_ER_MEMORY, 0);
 	    free(zf);
 	    return NULL;
@@ -222,6 +221,7 @@ _zip_file_new(struct zip *za)
     }
 
     za->file[za->nfile++] = zf;
+    ZIP_UNLOCK(za);
 
     zf->za = za;
     _zip_error_init(&zf->error);
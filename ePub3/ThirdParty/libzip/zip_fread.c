@@ -40,7 +40,7 @@
 ZIP_EXTERN ssize_t
 zip_fread(struct zip_file *zf, void *outbuf, size_t toread)
 {
-    int ret;
+    int ret, flush;
     size_t out_before, len;
     int i;
 
@@ -78,15 +78,18 @@ zip_fread(struct zip_file *zf, void *outbuf, size_t toread)
     zf->zstr->next_out = (Bytef *)outbuf;
     zf->zstr->avail_out = (unsigned int)toread;
     out_before = zf->zstr->total_out;
+
+    /* stop at block boundaries if we're building a seek index */
+    flush = _zip_seekindex_wants(zf) ? Z_BLOCK : Z_SYNC_FLUSH;
     
     /* endless loop until something has been accomplished */
     for (;;) {
-	ret = inflate(zf->zstr, Z_SYNC_FLUSH);
+	ret = inflate(zf->zstr, flush);
 
 	switch (ret) {
 	case Z_STREAM_END:
 	    if (zf->zstr->total_out == out_before) {
-		if (zf->crc != zf->crc_orig) {
+		if ((zf->flags & ZIP_ZF_CRC) && zf->crc != zf->crc_orig) {
 		    _zip_error_set(&zf->error, ZIP_ER_CRC, 0);
 		    return -1;
 		}
@@ -98,6 +101,9 @@ zip_fread(struct zip_file *zf, void *outbuf, size_t toread)
 
 	case Z_OK:
 	    len = zf->zstr->total_out - out_before;
+	    if (flush == Z_BLOCK && (zf->zstr->data_type & 128)
+		&& !(zf->zstr->data_type & 64))
+		_zip_seekindex_record(zf, zf->file_fpos + (off_t)len);
 	    if (len >= zf->bytes_left || len >= toread) {
 		if (zf->flags & ZIP_ZF_CRC)
 		    zf->crc = crc32(zf->crc, (Bytef *)outbuf, (unsigned int)len);
@@ -57,6 +57,8 @@ _zip_free(struct zip *za)
     if (za->zp)
 	fclose(za->zp);
 
+    _zip_seekindex_free(za);
+    _zip_name_index_free(za);
     _zip_cdir_free(za->cdir);
 
     if (za->entry) {
@@ -51,6 +51,7 @@ static int _zip_fseek_comp(struct zip_file* zf, off_t abspos, off_t flen);
 
 /* helpers for dealing with inline decompression */
 static int _zip_fseek_to_start(struct zip_file* zf);
+static int _zip_fseek_to_point(struct zip_file* zf, const struct zip_seekpoint* pt);
 static int _zip_fseek_by_reading(struct zip_file* zf, size_t toread);
 
 ZIP_EXTERN int
@@ -135,9 +136,12 @@ int _zip_fseek_bytes(struct zip_file* zf, off_t abspos, off_t flen)
     return 0;
 }
 
-/* seeking by raw byte amounts - no compression/decompression to handle */
+/* seeking within deflated data - resumes from the nearest inflate checkpoint if there is one */
 int _zip_fseek_comp(struct zip_file* zf, off_t abspos, off_t flen)
 {
+    struct zip_seekpoint point;
+    const struct zip_seekpoint* pt;
+    
     if (abspos >= flen) {
         // simple case -- set EOF
         zf->flags |= ZIP_ZF_EOF;
@@ -145,12 +149,6 @@ int _zip_fseek_comp(struct zip_file* zf, off_t abspos, off_t flen)
         zf->file_fpos = abspos;
         return 0;
     }
-    else if (abspos > zf->file_fpos) {
-        // read & decompress bytes until we reach the right position
-        return _zip_fseek_by_reading(zf, abspos-zf->file_fpos);
-    }
-    
-    /* at this point, we're definitely moving backwards */
     
     /* can't set a negative offset */
     if (abspos < 0) {
@@ -158,6 +156,21 @@ int _zip_fseek_comp(struct zip_file* zf, off_t abspos, off_t flen)
         return -1;
     }
     
+    pt = _zip_seekindex_find(zf->za, zf->file_index, abspos, &point);
+    
+    if (abspos > zf->file_fpos && (pt == NULL || pt->out <= zf->file_fpos)) {
+        // read & decompress bytes until we reach the right position
+        return _zip_fseek_by_reading(zf, abspos-zf->file_fpos);
+    }
+    
+    /* at this point, we're either moving backwards or can jump ahead */
+    
+    if (pt != NULL) {
+        if (_zip_fseek_to_point(zf, pt) < 0)
+            return -1;  /* error already set */
+        return _zip_fseek_by_reading(zf, abspos-pt->out);
+    }
+    
     if (_zip_fseek_to_start(zf) < 0)
         return -1;      /* error already set */
     
@@ -169,34 +182,65 @@ int _zip_fseek_to_start(struct zip_file* zf)
 {
     int len, ret;
     
+    /* reading from the start again, so the CRC can be verified even after a jump to a checkpoint */
     zf->flags &= ~ZIP_ZF_EOF;
+    zf->flags |= ZIP_ZF_CRC;
     zf->file_fpos = 0;
     zf->bytes_left = zf->za->cdir->entry[zf->file_index].uncomp_size;
     zf->cbytes_left = zf->za->cdir->entry[zf->file_index].comp_size;
     zf->fpos = _zip_file_get_offset_safe(zf->za, zf->file_index);
+    zf->crc = crc32(0L, Z_NULL, 0);
     
     len = _zip_file_fillbuf(zf->buffer, BUFSIZE, zf);
+    if (len < 0)
+        return -1;      /* error already set */
+    
+    /* the stream is already initialized, so reset it rather than leaking its state */
+    if ((ret=inflateReset(zf->zstr)) != Z_OK) {
+        _zip_error_set(&zf->error, ZIP_ER_ZLIB, ret);
+        return -1;
+    }
     
-    zf->zstr->zalloc = Z_NULL;
-    zf->zstr->zfree = Z_NULL;
-	zf->zstr->opaque = NULL;
 	zf->zstr->next_in = (Bytef *)zf->buffer;
 	zf->zstr->avail_in = len;
     
-    /* negative value to tell zlib that there is no header */
-    if ((ret=inflateInit2(zf->zstr, -MAX_WBITS)) != Z_OK) {
+    return 0;
+}
+
+int _zip_fseek_to_point(struct zip_file* zf, const struct zip_seekpoint* pt)
+{
+    int len, ret;
+    
+    /* we won't see the data before the checkpoint, so can't verify the CRC */
+    zf->flags &= ~(ZIP_ZF_EOF | ZIP_ZF_CRC);
+    zf->file_fpos = pt->out;
+    zf->bytes_left = zf->za->cdir->entry[zf->file_index].uncomp_size - pt->out;
+    zf->cbytes_left = pt->cbytes_left;
+    zf->fpos = pt->in;
+    
+    len = _zip_file_fillbuf(zf->buffer, BUFSIZE, zf);
+    if (len < 0)
+        return -1;      /* error already set */
+    
+    /* restore the inflater: pending bits of a split byte first, then the window */
+    if ((ret=inflateReset(zf->zstr)) != Z_OK
+        || (pt->bits && (ret=inflatePrime(zf->zstr, pt->bits, pt->byte >> (8 - pt->bits))) != Z_OK)
+        || (ret=inflateSetDictionary(zf->zstr, pt->window, pt->wsize)) != Z_OK) {
         _zip_error_set(&zf->error, ZIP_ER_ZLIB, ret);
         return -1;
     }
     
+	zf->zstr->next_in = (Bytef *)zf->buffer;
+	zf->zstr->avail_in = len;
+    
     return 0;
 }
 
 int _zip_fseek_by_reading(struct zip_file* zf, size_t toread)
 {
-    char bytes[1024];
+    char bytes[BUFSIZE];
     while (toread > 0) {
-        ssize_t numRead = zip_fread(zf, bytes, (toread < 1024 ? toread : 1024));
+        ssize_t numRead = zip_fread(zf, bytes, (toread < BUFSIZE ? toread : BUFSIZE));
         if (numRead < 0 )
             return -1;      /* error already set */
         if (numRead == 0) {
@@ -0,0 +1,286 @@
+/*
+  zip_name_index.c -- hash index of entry names
+  Copyright (C) 1999-2013 Dieter Baron and Thomas Klausner
+
+  This file is part of libzip, a library to manipulate ZIP archives.
+  The authors can be contacted at <libzip@nih.at>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in
+     the documentation and/or other materials provided with the
+     distribution.
+  3. The names of the authors may not be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+  IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zipint.h"
+
+#if defined(_MSC_VER)
+# define strcasecmp _stricmp
+#endif
+
+#define NOT_INDEXED	-2
+
+static const char *_zip_name_index_name(struct zip *, int);
+static unsigned int _zip_name_hash(const char *, int);
+static int _zip_name_index_grow(struct zip_name_index *, int);
+static void _zip_name_index_unlink(int *, int *, int);
+
+
+
+/* _zip_name_index_build:
+   (re)builds za's name index from scratch, with room for twice as many
+   names as the archive has entries.  On failure the index is dropped and
+   _zip_name_locate() goes back to scanning. */
+
+int
+_zip_name_index_build(struct zip *za)
+{
+    struct zip_name_index *ni;
+    unsigned int nbucket;
+    int i;
+
+    _zip_name_index_free(za);
+
+    for (nbucket=16; nbucket < 2*(unsigned int)za->nentry; nbucket*=2)
+	;
+
+    if ((ni=(struct zip_name_index *)calloc(1, sizeof(*ni))) == NULL)
+	return -1;
+    ni->nbucket = nbucket;
+    if ((ni->bucket=(int *)malloc(sizeof(int)*nbucket)) == NULL
+	|| (ni->nocase_bucket=(int *)malloc(sizeof(int)*nbucket)) == NULL
+	|| _zip_name_index_grow(ni, za->nentry) < 0) {
+	za->names = ni;
+	_zip_name_index_free(za);
+	return -1;
+    }
+    memset(ni->bucket, 0xff, sizeof(int)*nbucket);
+    memset(ni->nocase_bucket, 0xff, sizeof(int)*nbucket);
+
+    za->names = ni;
+    for (i=0; i<za->nentry; i++)
+	_zip_name_index_insert(za, i);
+
+    return 0;
+}
+
+
+
+/* _zip_name_index_find:
+   returns the lowest index of a live entry called fname, compared
+   ignoring case if ZIP_FL_NOCASE is set in flags, or -1. */
+
+int
+_zip_name_index_find(struct zip *za, const char *fname, int flags)
+{
+    struct zip_name_index *ni;
+    const char *fn;
+    unsigned int h;
+    int i, found, nocase;
+
+    ni = za->names;
+    nocase = (flags & ZIP_FL_NOCASE) != 0;
+    h = _zip_name_hash(fname, nocase);
+
+    found = -1;
+    i = (nocase ? ni->nocase_bucket : ni->bucket)[h & (ni->nbucket-1)];
+    for (; i >= 0; i = (nocase ? ni->nocase_next : ni->next)[i]) {
+	if ((found != -1 && i > found)
+	    || (nocase ? ni->nocase_hash : ni->hash)[i] != h
+	    || za->entry[i].state == ZIP_ST_DELETED)
+	    continue;
+
+	fn = _zip_name_index_name(za, i);
+	if ((nocase ? strcasecmp(fname, fn) : strcmp(fname, fn)) == 0)
+	    found = i;
+    }
+
+    return found;
+}
+
+
+
+void
+_zip_name_index_free(struct zip *za)
+{
+    struct zip_name_index *ni;
+
+    if ((ni=za->names) == NULL)
+	return;
+
+    free(ni->bucket);
+    free(ni->nocase_bucket);
+    free(ni->next);
+    free(ni->nocase_next);
+    free(ni->hash);
+    free(ni->nocase_hash);
+    free(ni);
+    za->names = NULL;
+}
+
+
+
+/* _zip_name_index_insert:
+   adds entry idx under its current name, if it has one.  Call after
+   giving an entry a name. */
+
+void
+_zip_name_index_insert(struct zip *za, int idx)
+{
+    struct zip_name_index *ni;
+    const char *fn;
+    unsigned int b;
+
+    if ((ni=za->names) == NULL)
+	return;
+
+    if (idx >= ni->nalloc && _zip_name_index_grow(ni, za->nentry_alloc) < 0) {
+	_zip_name_index_free(za);
+	return;
+    }
+    if (ni->next[idx] != NOT_INDEXED
+	|| (fn=_zip_name_index_name(za, idx)) == NULL)
+	return;
+
+    /* keep chains short; rebuilding picks up idx too */
+    if ((unsigned int)ni->nindexed >= ni->nbucket) {
+	_zip_name_index_build(za);
+	return;
+    }
+
+    ni->hash[idx] = _zip_name_hash(fn, 0);
+    b = ni->hash[idx] & (ni->nbucket-1);
+    ni->next[idx] = ni->bucket[b];
+    ni->bucket[b] = idx;
+
+    ni->nocase_hash[idx] = _zip_name_hash(fn, 1);
+    b = ni->nocase_hash[idx] & (ni->nbucket-1);
+    ni->nocase_next[idx] = ni->nocase_bucket[b];
+    ni->nocase_bucket[b] = idx;
+
+    ni->nindexed++;
+}
+
+
+
+/* _zip_name_index_remove:
+   takes entry idx out of the index.  Call before changing an entry's
+   name. */
+
+void
+_zip_name_index_remove(struct zip *za, int idx)
+{
+    struct zip_name_index *ni;
+
+    if ((ni=za->names) == NULL || idx >= ni->nalloc
+	|| ni->next[idx] == NOT_INDEXED)
+	return;
+
+    _zip_name_index_unlink(ni->bucket+(ni->hash[idx] & (ni->nbucket-1)),
+			   ni->next, idx);
+    _zip_name_index_unlink(ni->nocase_bucket
+			   +(ni->nocase_hash[idx] & (ni->nbucket-1)),
+			   ni->nocase_next, idx);
+    ni->next[idx] = ni->nocase_next[idx] = NOT_INDEXED;
+    ni->nindexed--;
+}
+
+
+
+/* the name _zip_get_name() gives entry idx, deleted or not */
+
+static const char *
+_zip_name_index_name(struct zip *za, int idx)
+{
+    if (za->entry[idx].ch_filename)
+	return za->entry[idx].ch_filename;
+    if (za->cdir == NULL || idx >= za->cdir->nentry)
+	return NULL;
+    return za->cdir->entry[idx].filename;
+}
+
+
+
+/* FNV-1a, optionally folding case the way strcasecmp() does */
+
+static unsigned int
+_zip_name_hash(const char *s, int nocase)
+{
+    unsigned int h;
+    unsigned char c;
+
+    h = 2166136261u;
+    while ((c=(unsigned char)*s++) != '\0') {
+	if (nocase)
+	    c = (unsigned char)tolower(c);
+	h = (h ^ c) * 16777619u;
+    }
+
+    return h;
+}
+
+
+
+static int
+_zip_name_index_grow(struct zip_name_index *ni, int nalloc)
+{
+    void *p;
+    int i;
+
+    if (nalloc <= ni->nalloc)
+	return 0;
+
+#define GROW(field, type) \
+    if ((p=realloc(ni->field, sizeof(type)*nalloc)) == NULL) \
+	return -1; \
+    ni->field = (type *)p
+
+    GROW(next, int);
+    GROW(nocase_next, int);
+    GROW(hash, unsigned int);
+    GROW(nocase_hash, unsigned int);
+#undef GROW
+
+    for (i=ni->nalloc; i<nalloc; i++)
+	ni->next[i] = ni->nocase_next[i] = NOT_INDEXED;
+    ni->nalloc = nalloc;
+
+    return 0;
+}
+
+
+
+static void
+_zip_name_index_unlink(int *head, int *next, int idx)
+{
+    while (*head != -1) {
+	if (*head == idx) {
+	    *head = next[idx];
+	    return;
+	}
+	head = next+*head;
+    }
+}
@@ -68,6 +68,13 @@ _zip_name_locate(struct zip *za, const char *fname, int flags,
 	return -1;
     }
     
+    /* current names, whole or ignoring case, are hashed */
+    if (za->names && (flags & (ZIP_FL_NODIR|ZIP_FL_UNCHANGED)) == 0) {
+	if ((i=_zip_name_index_find(za, fname, flags)) == -1)
+	    _zip_error_set(error, ZIP_ER_NOENT, 0);
+	return i;
+    }
+
     cmp = (flags & ZIP_FL_NOCASE) ? strcasecmp : strcmp;
 
     n = (flags & ZIP_FL_UNCHANGED) ? za->cdir->nentry : za->nentry;
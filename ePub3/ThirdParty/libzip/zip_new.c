@@ -65,6 +65,11 @@ _zip_new(struct zip_error *error)
     za->nfile = za->nfile_alloc = 0;
     za->file = NULL;
     za->flags = za->ch_flags = 0;
+    za->seek_interval = 0;
+    za->seek_index = NULL;
+    za->lock = za->unlock = NULL;
+    za->lock_ctx = NULL;
+    za->names = NULL;
     
     return za;
 }
@@ -94,8 +94,10 @@ zip_open(const char *fn, int flags, int *zep)
     if (len == 0) {
 	if ((za=_zip_allocate_new(fn, zep)) == NULL)
 	    fclose(fp);
-	else
+	else {
 	    za->zp = fp;
+	    _zip_name_index_build(za);
+	}
 	return za;
     }
 
@@ -123,6 +125,9 @@ zip_open(const char *fn, int flags, int *zep)
     for (i=0; i<cdir->nentry; i++)
 	_zip_entry_new(za);
 
+    /* without an index, names are found by scanning */
+    _zip_name_index_build(za);
+
     _zip_check_torrentzip(za);
     za->ch_flags = za->flags;
 
@@ -0,0 +1,94 @@
+/*
+  zip_pread.c -- positional reads from the archive file
+  Copyright (C) 1999-2013 Dieter Baron and Thomas Klausner
+
+  This file is part of libzip, a library to manipulate ZIP archives.
+  The authors can be contacted at <libzip@nih.at>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in
+     the documentation and/or other materials provided with the
+     distribution.
+  3. The names of the authors may not be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+  IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <errno.h>
+#include <stdio.h>
+
+#include "zipint.h"
+
+#if defined(_MSC_VER)
+# define fseeko fseek
+#else
+# include <unistd.h>
+#endif
+
+
+
+/* _zip_pread:
+   reads up to len bytes at offset in the archive file into buf without
+   touching the position of za->zp, so any number of files of one
+   archive can be read at once with no lock held.  Returns the number of
+   bytes read, which is less than len only at the end of the file, or -1
+   with errno set.  Platforms without pread() seek and read za->zp under
+   the archive lock instead. */
+
+ssize_t
+_zip_pread(struct zip *za, void *buf, size_t len, off_t offset)
+{
+#if defined(_MSC_VER)
+    size_t n;
+
+    ZIP_LOCK(za);
+    if (fseeko(za->zp, offset, SEEK_SET) < 0) {
+	ZIP_UNLOCK(za);
+	return -1;
+    }
+    n = fread(buf, 1, len, za->zp);
+    ZIP_UNLOCK(za);
+    if (n == 0 && ferror(za->zp))
+	return -1;
+
+    return (ssize_t)n;
+#else
+    size_t done;
+    ssize_t n;
+    int fd;
+
+    fd = fileno(za->zp);
+    for (done=0; done<len; done+=(size_t)n) {
+	n = pread(fd, (char *)buf+done, len-done, offset+(off_t)done);
+	if (n < 0) {
+	    if (errno == EINTR) {
+		n = 0;
+		continue;
+	    }
+	    return -1;
+	}
+	if (n == 0)
+	    break;
+    }
+
+    return (ssize_t)done;
+#endif
+}
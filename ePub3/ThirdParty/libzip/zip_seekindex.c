@@ -0,0 +1,234 @@
+/*
+  zip_seekindex.c -- inflate checkpoints for random access into deflated files
+  Copyright (C) 1999-2013 Dieter Baron and Thomas Klausner
+
+  This file is part of libzip, a library to manipulate ZIP archives.
+  The authors can be contacted at <libzip@nih.at>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in
+     the documentation and/or other materials provided with the
+     distribution.
+  3. The names of the authors may not be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+  IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+
+#include "zipint.h"
+
+/* inflateGetDictionary() appeared in zlib 1.2.8; without it we can't
+   snapshot the sliding window, so the index stays empty */
+#if ZLIB_VERNUM >= 0x1280
+# define ZIP_HAVE_SEEK_INDEX 1
+#else
+# define ZIP_HAVE_SEEK_INDEX 0
+#endif
+
+
+
+/* zip_set_seek_interval:
+   enables (interval > 0) or disables (interval == 0) recording of inflate
+   checkpoints for deflated files read from za.  A checkpoint is taken at
+   the first deflate block boundary at least 'interval' bytes of
+   uncompressed data past the previous one, and lets zip_fseek() resume
+   decompression there instead of re-inflating from the start of the file.
+   Each checkpoint costs ZIP_SEEK_WINSIZE bytes; they are kept until the
+   archive is closed or indexing is switched off. */
+
+ZIP_EXTERN int
+zip_set_seek_interval(struct zip *za, unsigned int interval)
+{
+    if (za == NULL)
+	return -1;
+
+    za->seek_interval = interval;
+    if (interval == 0)
+	_zip_seekindex_free(za);
+
+    return 0;
+}
+
+
+
+void
+_zip_seekindex_free(struct zip *za)
+{
+    int i, j;
+    struct zip_seekindex *si;
+
+    ZIP_LOCK(za);
+    if (za->seek_index == NULL) {
+	ZIP_UNLOCK(za);
+	return;
+    }
+
+    for (i=0; za->cdir && i<za->cdir->nentry; i++) {
+	if ((si=za->seek_index[i]) == NULL)
+	    continue;
+	for (j=0; j<si->npoint; j++)
+	    free(si->point[j].window);
+	free(si->point);
+	free(si);
+    }
+
+    free(za->seek_index);
+    za->seek_index = NULL;
+    ZIP_UNLOCK(za);
+}
+
+
+
+/* _zip_seekindex_find:
+   copies the last checkpoint of entry idx at or before uncompressed
+   offset pos into copy and returns it, or returns NULL if there is none. */
+
+const struct zip_seekpoint *
+_zip_seekindex_find(struct zip *za, int idx, off_t pos,
+		    struct zip_seekpoint *copy)
+{
+    struct zip_seekindex *si;
+    int lo, hi, mid;
+
+    ZIP_LOCK(za);
+    if (za->seek_index == NULL || (si=za->seek_index[idx]) == NULL
+	|| si->npoint == 0 || si->point[0].out > pos) {
+	ZIP_UNLOCK(za);
+	return NULL;
+    }
+
+    lo = 0;
+    hi = si->npoint - 1;
+    while (lo < hi) {
+	mid = (lo + hi + 1) / 2;
+	if (si->point[mid].out <= pos)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    /* the array may be moved by a reader on another thread, so hand out
+       a copy; the window it points to lives as long as the index */
+    *copy = si->point[lo];
+    ZIP_UNLOCK(za);
+
+    return copy;
+}
+
+
+
+/* _zip_seekindex_wants:
+   returns non-zero if zip_fread() should stop at deflate block
+   boundaries on zf so that checkpoints can be recorded. */
+
+int
+_zip_seekindex_wants(struct zip_file *zf)
+{
+#if ZIP_HAVE_SEEK_INDEX
+    struct zip *za = zf->za;
+
+    return (za->seek_interval > 0 && (zf->flags & ZIP_ZF_DECOMP)
+	    && za->cdir->entry[zf->file_index].uncomp_size > za->seek_interval);
+#else
+    return 0;
+#endif
+}
+
+
+
+#if ZIP_HAVE_SEEK_INDEX
+static void _zip_seekindex_add(struct zip_file *, off_t);
+#endif
+
+
+
+/* _zip_seekindex_record:
+   called by zip_fread() when inflate() has stopped at a block boundary
+   that lies at uncompressed offset out. */
+
+void
+_zip_seekindex_record(struct zip_file *zf, off_t out)
+{
+#if ZIP_HAVE_SEEK_INDEX
+    ZIP_LOCK(zf->za);
+    _zip_seekindex_add(zf, out);
+    ZIP_UNLOCK(zf->za);
+#endif
+}
+
+
+
+#if ZIP_HAVE_SEEK_INDEX
+static void
+_zip_seekindex_add(struct zip_file *zf, off_t out)
+{
+    struct zip *za = zf->za;
+    struct zip_seekindex *si;
+    struct zip_seekpoint *pt;
+    int bits, n;
+    uInt wsize;
+
+    if (za->seek_index == NULL) {
+	za->seek_index = (struct zip_seekindex **)calloc(za->cdir->nentry, sizeof(struct zip_seekindex *));
+	if (za->seek_index == NULL)
+	    return;
+    }
+    if ((si=za->seek_index[zf->file_index]) == NULL) {
+	if ((si=(struct zip_seekindex *)calloc(1, sizeof(struct zip_seekindex))) == NULL)
+	    return;
+	za->seek_index[zf->file_index] = si;
+    }
+
+    /* only append: points must stay sorted and at least an interval apart */
+    if (out < (si->npoint ? si->point[si->npoint-1].out : 0) + (off_t)za->seek_interval)
+	return;
+
+    /* the partially consumed byte must still be in our input buffer */
+    bits = zf->zstr->data_type & 7;
+    if (bits && zf->zstr->next_in == (Bytef *)zf->buffer)
+	return;
+
+    if (si->npoint >= si->npoint_alloc) {
+	n = si->npoint_alloc + 16;
+	pt = (struct zip_seekpoint *)realloc(si->point, n*sizeof(struct zip_seekpoint));
+	if (pt == NULL)
+	    return;
+	si->point = pt;
+	si->npoint_alloc = n;
+    }
+
+    pt = si->point + si->npoint;
+    if ((pt->window=(unsigned char *)malloc(ZIP_SEEK_WINSIZE)) == NULL)
+	return;
+    wsize = ZIP_SEEK_WINSIZE;
+    if (inflateGetDictionary(zf->zstr, pt->window, &wsize) != Z_OK) {
+	free(pt->window);
+	return;
+    }
+
+    pt->out = out;
+    pt->in = zf->fpos - zf->zstr->avail_in;
+    pt->cbytes_left = zf->cbytes_left + zf->zstr->avail_in;
+    pt->bits = bits;
+    pt->byte = bits ? zf->zstr->next_in[-1] : 0;
+    pt->wsize = wsize;
+    si->npoint++;
+}
+#endif
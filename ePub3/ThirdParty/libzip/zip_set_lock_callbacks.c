@@ -0,0 +1,60 @@
+/*
+  zip_set_lock_callbacks.c -- serialize shared use of an archive
+  Copyright (C) 2008 Dieter Baron and Thomas Klausner
+
+  This file is part of libzip, a library to manipulate ZIP archives.
+  The authors can be contacted at <libzip@nih.at>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in
+     the documentation and/or other materials provided with the
+     distribution.
+  3. The names of the authors may not be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+ 
+  THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+  OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+  IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+  IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "zipint.h"
+
+
+
+/* zip_set_lock_callbacks:
+   installs a pair of functions which libzip calls around every use of
+   the archive's shared state: the list of open files and the seek index,
+   and on platforms without pread() the position of its FILE *.  With
+   them, files of one archive may be opened, read, seeked and closed on
+   different threads at the same time.  File data is read with
+   _zip_pread(), outside the lock.  lock must be recursive.  Passing NULL
+   for both removes them. */
+
+ZIP_EXTERN int
+zip_set_lock_callbacks(struct zip *za, zip_lock_callback lock,
+		       zip_lock_callback unlock, void *ctx)
+{
+    if (za == NULL || (lock == NULL) != (unlock == NULL))
+	return -1;
+
+    za->lock = lock;
+    za->unlock = unlock;
+    za->lock_ctx = ctx;
+
+    return 0;
+}
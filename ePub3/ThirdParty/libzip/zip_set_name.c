@@ -72,8 +72,10 @@ _zip_set_name(struct zip *za, int idx, const char *name)
     if (za->entry[idx].state == ZIP_ST_UNCHANGED) 
 	za->entry[idx].state = ZIP_ST_RENAMED;
 
+    _zip_name_index_remove(za, idx);
     free(za->entry[idx].ch_filename);
     za->entry[idx].ch_filename = s;
+    _zip_name_index_insert(za, idx);
 
     return 0;
 }
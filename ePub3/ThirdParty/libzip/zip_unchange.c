@@ -68,8 +68,10 @@ _zip_unchange(struct zip *za, int idx, int allow_duplicates)
 	    }
 	}
 
+	_zip_name_index_remove(za, idx);
 	free(za->entry[idx].ch_filename);
 	za->entry[idx].ch_filename = NULL;
+	_zip_name_index_insert(za, idx);
     }
 
     free(za->entry[idx].ch_comment);
@@ -90,6 +90,10 @@ enum zip_state { ZIP_ST_UNCHANGED, ZIP_ST_DELETED, ZIP_ST_REPLACED,
 #define ZIP_ZF_DECOMP	2 /* decompress data */
 #define ZIP_ZF_CRC	4 /* compute and compare CRC */
 
+/* size of the zlib sliding window stored with each seek point */
+
+#define ZIP_SEEK_WINSIZE	32768
+
 /* directory entry: general purpose bit flags */
 
 #define ZIP_GPBF_ENCRYPTED		0x0001	/* is encrypted */
@@ -124,6 +128,15 @@ struct zip {
     int nfile;			/* number of opened files within archive */
     int nfile_alloc;		/* number of files allocated */
     struct zip_file **file;	/* opened files within archive */
+
+    unsigned int seek_interval;	/* min. distance between seek points, 0: off */
+    struct zip_seekindex **seek_index;	/* per cdir entry, built lazily */
+
+    zip_lock_callback lock;	/* guard file, seek_index and (without */
+    zip_lock_callback unlock;	/* pread) zp when files are used on */
+    void *lock_ctx;		/* several threads */
+
+    struct zip_name_index *names;	/* hashed entry names, NULL: scan */
 };
 
 /* file in zip archive, part of API */
@@ -175,6 +188,45 @@ struct zip_dirent {
     unsigned int offset;		/* (c)  offset of local header  */
 };
 
+/* inflate checkpoint: everything needed to resume decompression mid-stream */
+
+struct zip_seekpoint {
+    off_t out;			/* offset into the uncompressed data */
+    off_t in;			/* offset in zip file of next compressed byte */
+    unsigned long cbytes_left;	/* compressed bytes left from 'in' onwards */
+    int bits;			/* unused bits of the byte before 'in' (0-7) */
+    unsigned char byte;		/* value of that byte, if bits != 0 */
+    unsigned int wsize;		/* number of valid bytes in window */
+    unsigned char *window;	/* last ZIP_SEEK_WINSIZE bytes of output */
+};
+
+/* seek points recorded for one deflated entry, sorted by 'out' */
+
+struct zip_seekindex {
+    int npoint;			/* number of seek points */
+    int npoint_alloc;		/* number of seek points allocated */
+    struct zip_seekpoint *point;	/* seek points */
+};
+
+/* entry names hashed for _zip_name_locate(), once exactly and once
+   ignoring case.  Every entry with a name is chained into one bucket of
+   each table, deleted entries included; lookups skip those.  Built by
+   zip_open() and kept up to date by _zip_set_name() and _zip_unchange(),
+   so lookups never write to it and can run on several threads. */
+
+struct zip_name_index {
+    unsigned int nbucket;	/* number of buckets, a power of two */
+    int *bucket;		/* first entry in each bucket, -1: none */
+    int *nocase_bucket;		/* the same, hashed ignoring case */
+    int nalloc;			/* number of entries allocated below */
+    int *next;			/* next entry in bucket, -1: none,
+				   -2: entry not indexed */
+    int *nocase_next;
+    unsigned int *hash;		/* hash of each indexed entry's name */
+    unsigned int *nocase_hash;
+    int nindexed;		/* number of entries indexed */
+};
+
 /* zip archive central directory */
 
 struct zip_cdir {
@@ -216,6 +268,9 @@ extern const int _zip_err_type[];
 			((x)->state == ZIP_ST_REPLACED  \
 			 || (x)->state == ZIP_ST_ADDED)
 
+#define ZIP_LOCK(za)	((za)->lock ? (za)->lock((za)->lock_ctx) : (void)0)
+#define ZIP_UNLOCK(za)	((za)->unlock ? (za)->unlock((za)->lock_ctx) : (void)0)
+
 
 
 int _zip_cdir_compute_crc(struct zip *, uLong *);
@@ -256,11 +311,22 @@ void _zip_free(struct zip *);
 const char *_zip_get_name(struct zip *, int, int, struct zip_error *);
 int _zip_local_header_read(struct zip *, int);
 void *_zip_memdup(const void *, size_t, struct zip_error *);
+ssize_t _zip_pread(struct zip *, void *, size_t, off_t);
 int _zip_name_locate(struct zip *, const char *, int, struct zip_error *);
+int _zip_name_index_build(struct zip *);
+int _zip_name_index_find(struct zip *, const char *, int);
+void _zip_name_index_free(struct zip *);
+void _zip_name_index_insert(struct zip *, int);
+void _zip_name_index_remove(struct zip *, int);
 struct zip *_zip_new(struct zip_error *);
 unsigned short _zip_read2(unsigned char **);
 unsigned int _zip_read4(unsigned char **);
 int _zip_replace(struct zip *, int, const char *, struct zip_source *);
+void _zip_seekindex_free(struct zip *);
+const struct zip_seekpoint *_zip_seekindex_find(struct zip *, int, off_t,
+						struct zip_seekpoint *);
+int _zip_seekindex_wants(struct zip_file *);
+void _zip_seekindex_record(struct zip_file *, off_t);
 int _zip_set_name(struct zip *, int, const char *);
 int _zip_unchange(struct zip *, int, int);
 void _zip_unchange_data(struct zip_entry *);
@@ -298,14 +298,14 @@ class ArchiveItemInfo
 public:
     ///
     /// Default constructor
-    ArchiveItemInfo() : _path(""), _isCompressed(false), _compressedSize(0), _uncompressedSize(0), _posix(0)
+    ArchiveItemInfo() : _path(""), _isCompressed(false), _compressedSize(0), _uncompressedSize(0), _crc(0), _posix(0)
 #if EPUB_HAVE(ACL)
     , _acl(nullptr)
 #endif
     {}
     ///
     /// Copy constructor
-    ArchiveItemInfo(const ArchiveItemInfo & o) : _path(o._path), _isCompressed(o._isCompressed), _compressedSize(o._compressedSize), _uncompressedSize(o._uncompressedSize), _posix(o._posix) {
+    ArchiveItemInfo(const ArchiveItemInfo & o) : _path(o._path), _isCompressed(o._isCompressed), _compressedSize(o._compressedSize), _uncompressedSize(o._uncompressedSize), _crc(o._crc), _posix(o._posix) {
 #if EPUB_HAVE(ACL)
         if ( o._acl != nullptr )
             _acl = acl_dup(o._acl);
@@ -313,7 +313,7 @@ public:
     }
     ///
     /// Move constructor
-    ArchiveItemInfo(ArchiveItemInfo && o) : _path(std::move(o._path)), _isCompressed(o._isCompressed), _compressedSize(o._compressedSize), _uncompressedSize(o._uncompressedSize), _posix(o._posix)
+    ArchiveItemInfo(ArchiveItemInfo && o) : _path(std::move(o._path)), _isCompressed(o._isCompressed), _compressedSize(o._compressedSize), _uncompressedSize(o._uncompressedSize), _crc(o._crc), _posix(o._posix)
 #if EPUB_HAVE(ACL)
     , _acl(o._acl)
 #endif
@@ -341,6 +341,9 @@ public:
     /// The uncompressed size of the item.
     virtual size_t UncompressedSize() const { return _uncompressedSize; }
     ///
+    /// The CRC-32 of the item's uncompressed data, as recorded in the archive's directory.
+    virtual uint32_t CRC() const { return _crc; }
+    ///
     /// POSIX-style access permissions, if supported.
     virtual mode_t POSIXPermissions() const { return _posix; }
 #if EPUB_HAVE(ACL)
@@ -354,6 +357,7 @@ public:
     virtual void SetIsCompressed(bool flag) { _isCompressed = flag;}
     virtual void SetCompressedSize(size_t size) { _compressedSize = size; }
     virtual void SetUncompressedSize(size_t size) { _uncompressedSize = size; }
+    virtual void SetCRC(uint32_t crc) { _crc = crc; }
     virtual void SetPOSIXPermissions(mode_t perms) { _posix = perms; }
 #if EPUB_HAVE(ACL)
     virtual void SetAccessControlList(acl_t acl) { _acl = acl_dup(acl); }
@@ -364,6 +368,7 @@ protected:
     bool                        _isCompressed;      ///< Whether the item is compressed.
     size_t                      _compressedSize;    ///< The item's compressed size.
     size_t                      _uncompressedSize;  ///< The item's uncompressed size.
+    uint32_t                    _crc;               ///< The CRC-32 of the item's uncompressed data.
     
     mode_t                      _posix;             ///< POSIX permissions, if supported.
 #if EPUB_HAVE(ACL)
@@ -128,6 +128,33 @@ bool ArchiveXmlReader::close()
     return true;
 }
 
+#if !ENABLE_XML_READ_DOC_MEMORY
+
+ByteStreamXmlReader::ByteStreamXmlReader(std::shared_ptr<ByteStream> stream) : _stream(stream), _offset(0)
+{
+    if ( !bool(_stream) )
+        throw std::invalid_argument(std::string(__PRETTY_FUNCTION__) + ": Nil ByteStream supplied");
+}
+ByteStreamXmlReader::~ByteStreamXmlReader()
+{
+}
+std::shared_ptr<xml::Document> ByteStreamXmlReader::readDocument(const char * url, const char * encoding, bool html)
+{
+    return xml::InputBuffer::pushParseDocument(url, encoding, ArchiveXmlReader::DEFAULT_OPTIONS, html);
+}
+size_t ByteStreamXmlReader::read(uint8_t *buf, size_t len)
+{
+    size_t r = _stream->ReadBytes(buf, len);
+    _offset += r;
+    return r;
+}
+bool ByteStreamXmlReader::close()
+{
+    return true;
+}
+
+#endif //!ENABLE_XML_READ_DOC_MEMORY
+
 #if ENABLE_ZIP_ARCHIVE_WRITER
 
 ArchiveXmlWriter::ArchiveXmlWriter(ArchiveWriter* w) : _writer(w)
@@ -33,6 +33,7 @@
 #include <ePub3/epub3.h>
 
 #include <ePub3/archive.h>
+#include <ePub3/utilities/byte_stream.h>
 #include <ePub3/xml/io.h>
 
 EPUB3_BEGIN_NAMESPACE
@@ -98,6 +99,44 @@ protected:
     ArchiveXmlReader(const ArchiveXmlReader&) _DELETED_;
 };
 
+#if !ENABLE_XML_READ_DOC_MEMORY
+
+/**
+ Parses XML and HTML documents straight out of a ByteStream.
+ 
+ The stream is read a chunk at a time and each chunk is pushed into the parser as
+ it arrives, so a document coming through a filter chain is never gathered into a
+ single buffer on its way to libxml.
+ @ingroup archives
+ */
+class ByteStreamXmlReader : public xml::InputBuffer
+{
+public:
+    EPUB3_EXPORT ByteStreamXmlReader(std::shared_ptr<ByteStream> stream);
+    virtual ~ByteStreamXmlReader();
+    
+	virtual size_t size() const { return _offset + _stream->BytesAvailable(); }
+	virtual size_t offset() const { return _offset; }
+    
+	/**
+	 * Will read the given XML or HTML document using the default options
+	 * from ArchiveXmlReader::DEFAULT_OPTIONS.
+	 */
+    EPUB3_EXPORT
+    std::shared_ptr<xml::Document> readDocument(const char * url, const char * encoding, bool html=false);
+    
+protected:
+    std::shared_ptr<ByteStream>     _stream;
+    size_t                          _offset;
+    
+    virtual size_t read(uint8_t * buf, size_t len);
+    virtual bool close();
+    
+    ByteStreamXmlReader(const ByteStreamXmlReader&) _DELETED_;
+};
+
+#endif //!ENABLE_XML_READ_DOC_MEMORY
+
 #if ENABLE_ZIP_ARCHIVE_WRITER
 
 /**
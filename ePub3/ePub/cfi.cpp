@@ -105,7 +105,8 @@ CFI& CFI::Assign(const CFI& o)
 }
 CFI& CFI::Assign(const ePub3::CFI &o, size_t fromIndex)
 {
-    if ( fromIndex >= o._components.size() )
+    // an index equal to the size yields an empty path, e.g. the content part of "/6/4!"
+    if ( fromIndex > o._components.size() )
         throw std::out_of_range(_Str("Component index ", fromIndex, " out of range [0..", _components.size(), "]"));
     
     _components.assign(o._components.begin()+fromIndex, o._components.end());
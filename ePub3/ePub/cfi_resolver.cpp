@@ -0,0 +1,375 @@
+//
+//  cfi_resolver.cpp
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this
+//  list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//  this list of conditions and the following disclaimer in the documentation and/or
+//  other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be
+//  used to endorse or promote products derived from this software without specific
+//  prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+//  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+//  OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+//  OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "cfi_resolver.h"
+#include "package.h"
+#include "manifest.h"
+#include <ePub3/utilities/error_handler.h>
+#include <algorithm>
+#include <map>
+
+EPUB3_BEGIN_NAMESPACE
+
+CFIResolver::CFIResolver(std::shared_ptr<xml::Document> document) : _document(document), _root(), _children(), _ids(), _idsIndexed(false)
+{
+    if ( bool(_document) )
+        _root = _document->Root();
+}
+CFIResolver::Range CFIResolver::Resolve(const CFI &cfi)
+{
+    Range result;
+    if ( cfi.IsRangeTriplet() )
+    {
+        result.start = Walk(cfi._components, cfi._rangeStart);
+        result.end = Walk(cfi._components, cfi._rangeEnd);
+    }
+    else
+    {
+        result.start = Walk(cfi._components, CFI::ComponentList());
+        result.end = result.start;
+    }
+    return result;
+}
+CFI CFIResolver::CFIForLocation(std::shared_ptr<xml::Node> node, uint32_t offset)
+{
+    CFI result;
+    if ( !bool(node) || !bool(_root) )
+        return result;
+    
+    ComponentList reversed;
+    if ( IsCharacterData(node) )
+    {
+        NodePtr parent = node->Parent();
+        if ( !bool(parent) )
+            return result;
+        
+        // find the text run containing the node, and add the lengths of the nodes before it
+        const ChildIndex& children = ChildrenOf(parent);
+        bool found = false;
+        for ( size_t i = 0; i < children.chunks.size() && !found; i++ )
+        {
+            uint32_t preceding = 0;
+            for ( auto& text : children.chunks[i] )
+            {
+                if ( text == node )
+                {
+                    CFI::Component component(uint32_t(i*2+1));
+                    component.flags |= CFI::Component::CharacterOffset;
+                    component.characterOffset = preceding + offset;
+                    if ( offset == 0 && preceding > 0 )
+                        component.sideBias = CFI::SideBias::After;  // not the end of the previous node
+                    reversed.push_back(std::move(component));
+                    found = true;
+                    break;
+                }
+                preceding += UTF16Length(text);
+            }
+        }
+        
+        if ( !found )
+            return result;
+        node = parent;
+    }
+    else if ( !node->IsElementNode() )
+    {
+        return result;
+    }
+    
+    while ( node != _root )
+    {
+        NodePtr parent = node->Parent();
+        if ( !bool(parent) )
+            return result;      // not within our document
+        
+        const ChildIndex& children = ChildrenOf(parent);
+        auto pos = std::find(children.elements.begin(), children.elements.end(), node);
+        if ( pos == children.elements.end() )
+            return result;
+        
+        CFI::Component component(uint32_t((std::distance(children.elements.begin(), pos)+1)*2));
+        string ident = _getProp(node, "id");
+        if ( !ident.empty() )
+        {
+            component.flags |= CFI::Component::Qualifier;
+            component.qualifier = ident;
+        }
+        reversed.push_back(std::move(component));
+        node = parent;
+    }
+    
+    result._components.assign(reversed.rbegin(), reversed.rend());
+    return result;
+}
+std::vector<CFIResolver::Range> CFIResolver::ResolveAll(PackagePtr package, const std::vector<CFI> &cfis)
+{
+    typedef std::pair<size_t, CFI>  PendingCFI;
+    
+    std::vector<Range> results(cfis.size());
+    std::map<ManifestItemPtr, std::vector<PendingCFI>> byItem;
+    
+    for ( size_t i = 0; i < cfis.size(); i++ )
+    {
+        try
+        {
+            CFI cfi(cfis[i]), remaining;
+            ManifestItemPtr item = package->ManifestItemForCFI(cfi, &remaining);
+            if ( bool(item) )
+                byItem[item].emplace_back(i, std::move(remaining));
+        }
+        catch (std::exception&)
+        {
+            // leave this one invalid, carry on with the rest
+        }
+    }
+    
+    for ( auto& group : byItem )
+    {
+        std::shared_ptr<xml::Document> document;
+        try
+        {
+            document = group.first->ReferencedDocument();
+        }
+        catch (std::exception&)
+        {
+        }
+        
+        CFIResolver resolver(document);
+        for ( auto& pending : group.second )
+        {
+            Range& range = results[pending.first];
+            range.item = group.first;
+            if ( !bool(document) )
+                continue;
+            
+            try
+            {
+                Range resolved = resolver.Resolve(pending.second);
+                range.start = resolved.start;
+                range.end = resolved.end;
+            }
+            catch (std::exception&)
+            {
+            }
+        }
+    }
+    
+    return results;
+}
+CFIResolver::Location CFIResolver::Walk(const ComponentList& base, const ComponentList& tail)
+{
+    Location result;
+    if ( !bool(_root) )
+    {
+        HandleError(EPUBError::CFIStepOutOfBounds, "CFI target document has no root element");
+        return result;
+    }
+    
+    NodePtr node = _root;
+    result.node = node;
+    
+    size_t count = base.size() + tail.size();
+    for ( size_t i = 0; i < count; i++ )
+    {
+        const CFI::Component& step = (i < base.size() ? base[i] : tail[i-base.size()]);
+        bool terminal = (i == count-1);
+        
+        if ( step.IsIndirector() )
+        {
+            HandleError(EPUBError::CFIIndirectionTargetNotFound, _Str("CFI step ", step.nodeIndex, " indirects out of the content document, which is not supported"));
+            return Location();
+        }
+        if ( !node->IsElementNode() )
+        {
+            HandleError(EPUBError::CFIStepOutOfBounds, _Str("CFI step ", step.nodeIndex, " follows a character data step"));
+            return Location();
+        }
+        
+        const ChildIndex& children = ChildrenOf(node);
+        if ( terminal )
+            result.sideBias = step.sideBias;
+        
+        if ( (step.nodeIndex & 1) == 0 )
+        {
+            NodePtr next;
+            size_t idx = step.nodeIndex >> 1;
+            if ( idx > 0 && idx <= children.elements.size() )
+                next = children.elements[idx-1];
+            
+            // an id assertion takes precedence over the index, as the document may have been edited
+            if ( step.HasQualifier() && (!bool(next) || _getProp(next, "id") != step.qualifier) )
+            {
+                NodePtr identified = ElementWithID(step.qualifier);
+                if ( bool(identified) )
+                    next = identified;
+            }
+            
+            if ( !bool(next) )
+            {
+                HandleError(EPUBError::CFIStepOutOfBounds, _Str("CFI step ", step.nodeIndex, " is beyond the ", children.elements.size(), " child elements of <", node->Name(), ">"));
+                return Location();
+            }
+            if ( step.HasCharacterOffset() && next->Name() != "img" )
+            {
+                HandleError(EPUBError::CFICharOffsetOnIllegalElement, _Str("CFI applies a character offset to <", next->Name(), ">"));
+                return Location();
+            }
+            
+            node = next;
+            result.node = node;
+            continue;
+        }
+        
+        if ( !terminal )
+        {
+            HandleError(EPUBError::CFIStepOutOfBounds, _Str("CFI character data step ", step.nodeIndex, " is not the last step"));
+            return Location();
+        }
+        
+        size_t chunkIdx = step.nodeIndex >> 1;
+        if ( chunkIdx >= children.chunks.size() )
+        {
+            HandleError(EPUBError::CFIStepOutOfBounds, _Str("CFI step ", step.nodeIndex, " is beyond the ", children.chunks.size(), " text runs of <", node->Name(), ">"));
+            return Location();
+        }
+        
+        const std::vector<NodePtr>& chunk = children.chunks[chunkIdx];
+        uint32_t offset = (step.HasCharacterOffset() ? step.characterOffset : 0);
+        if ( chunk.empty() )
+        {
+            // an empty run between two elements: point at the parent
+            if ( offset > 0 )
+                HandleError(EPUBError::CFICharOffsetOutOfBounds, _Str("CFI character offset ", offset, " is beyond an empty text run"));
+            result.offset = 0;
+            return result;
+        }
+        
+        for ( size_t t = 0; t < chunk.size(); t++ )
+        {
+            uint32_t length = UTF16Length(chunk[t]);
+            bool lastNode = (t == chunk.size()-1);
+            
+            // at a boundary between two text nodes, side-bias 'after' selects the start of the next one
+            if ( offset < length || (offset == length && (step.sideBias != CFI::SideBias::After || lastNode)) )
+            {
+                result.node = chunk[t];
+                result.offset = offset;
+                return result;
+            }
+            if ( lastNode )
+            {
+                HandleError(EPUBError::CFICharOffsetOutOfBounds, _Str("CFI character offset ", step.characterOffset, " is beyond the end of its text"));
+                result.node = chunk[t];
+                result.offset = length;
+                return result;
+            }
+            
+            offset -= length;
+        }
+    }
+    
+    return result;
+}
+const CFIResolver::ChildIndex& CFIResolver::ChildrenOf(const NodePtr& element)
+{
+    auto found = _children.find(element.get());
+    if ( found != _children.end() )
+        return found->second;
+    
+    ChildIndex& index = _children[element.get()];
+    index.parent = element;
+    index.chunks.emplace_back();
+    
+    // comments and processing instructions neither count as steps nor break up a text run
+    for ( NodePtr child = element->FirstChild(); bool(child); child = child->NextSibling() )
+    {
+        if ( child->IsElementNode() )
+        {
+            index.elements.push_back(child);
+            index.chunks.emplace_back();
+        }
+        else if ( IsCharacterData(child) )
+        {
+            index.chunks.back().push_back(child);
+        }
+    }
+    
+    return index;
+}
+CFIResolver::NodePtr CFIResolver::ElementWithID(const string &ident)
+{
+    if ( !_idsIndexed && bool(_root) )
+    {
+        IndexIDs(_root);
+        _idsIndexed = true;
+    }
+    
+    auto found = _ids.find(ident);
+    if ( found == _ids.end() )
+        return nullptr;
+    return found->second;
+}
+void CFIResolver::IndexIDs(const NodePtr &element)
+{
+    string ident = _getProp(element, "id");
+    if ( !ident.empty() )
+        _ids.emplace(ident, element);       // the first one wins
+    
+    for ( NodePtr child = element->FirstElementChild(); bool(child); child = child->NextElementSibling() )
+    {
+        IndexIDs(child);
+    }
+}
+bool CFIResolver::IsCharacterData(const NodePtr &node)
+{
+    switch ( node->Type() )
+    {
+        case xml::NodeType::Text:
+        case xml::NodeType::CDATASection:
+        case xml::NodeType::EntityReference:
+            return true;
+        default:
+            return false;
+    }
+}
+uint32_t CFIResolver::UTF16Length(const NodePtr &node)
+{
+    // count UTF-8 lead bytes; four-byte sequences become surrogate pairs
+    string content = node->Content();
+    uint32_t length = 0;
+    for ( unsigned char ch : content.stl_str() )
+    {
+        if ( (ch & 0xC0) != 0x80 )
+            length++;
+        if ( ch >= 0xF0 )
+            length++;
+    }
+    return length;
+}
+
+EPUB3_END_NAMESPACE
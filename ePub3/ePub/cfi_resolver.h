@@ -0,0 +1,192 @@
+//
+//  cfi_resolver.h
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this
+//  list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//  this list of conditions and the following disclaimer in the documentation and/or
+//  other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be
+//  used to endorse or promote products derived from this software without specific
+//  prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+//  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+//  OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+//  OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __ePub3__cfi_resolver__
+#define __ePub3__cfi_resolver__
+
+#include <ePub3/epub3.h>
+#include <ePub3/cfi.h>
+#include <ePub3/xml/document.h>
+#include <ePub3/xml/element.h>
+#include <unordered_map>
+#include <vector>
+
+EPUB3_BEGIN_NAMESPACE
+
+/**
+ Resolves content document CFIs against a parsed document, and builds CFIs for
+ locations within it.
+
+ Package::ManifestItemForCFI() handles the steps of a CFI which lead through the
+ spine to a content document; a CFIResolver walks the remaining steps (element and
+ character-data indices, `id` assertions, character offsets and side-bias) over
+ that document's tree. It does the same job as `cfi-resolver.js`, without a web
+ view.
+
+ Each resolver caches the child lists and `id` attributes it has looked at, so
+ resolving many CFIs against the same document with one resolver is much cheaper
+ than resolving them one at a time. ResolveAll() does exactly that for a set of
+ package-relative CFIs spread across a publication.
+
+ Character offsets are measured in UTF-16 code units, as required by the CFI
+ specification.
+
+ @see http://www.idpf.org/epub/linking/cfi/epub-cfi.html
+ @ingroup epub-model
+ */
+class CFIResolver
+{
+public:
+    ///
+    /// A point within a content document.
+    struct Location
+    {
+        ///
+        /// The element or text node identified, or `nullptr` if resolution failed.
+        /// When a CFI's character data step contains no text at all, this is the
+        /// parent element.
+        std::shared_ptr<xml::Node>  node;
+        ///
+        /// The character offset within `node`, if it is a text node.
+        uint32_t                    offset;
+        ///
+        /// The side-bias given in the CFI, if any.
+        CFI::SideBias               sideBias;
+
+        Location() : node(), offset(0), sideBias(CFI::SideBias::Unspecified) {}
+
+        bool    IsValid()   const   { return bool(node); }
+    };
+
+    ///
+    /// The result of resolving a CFI. For location CFIs, `start` and `end` are equal.
+    struct Range
+    {
+        ///
+        /// The content document the CFI points into. Only set by ResolveAll().
+        ManifestItemPtr             item;
+        Location                    start;
+        Location                    end;
+
+        bool    IsValid()   const   { return start.IsValid() && end.IsValid(); }
+    };
+
+public:
+    /**
+     Creates a resolver for a content document.
+     @param document The document against which to resolve CFIs, typically obtained
+     from ManifestItem::ReferencedDocument().
+     */
+    EPUB3_EXPORT
+    CFIResolver(std::shared_ptr<xml::Document> document);
+    virtual ~CFIResolver() {}
+
+    /**
+     Resolves a document-relative CFI, i.e. the `pRemainingCFI` output of
+     Package::ManifestItemForCFI().
+
+     A step whose `id` assertion doesn't match the element at its index is corrected
+     to the element bearing that `id`, if there is one.
+     @param cfi The CFI to resolve. Ranged CFIs resolve to the start and end of
+     the range.
+     @result The resolved location(s). If any step cannot be resolved an error is
+     raised through HandleError(), and the result is invalid if that returns.
+     */
+    EPUB3_EXPORT
+    Range           Resolve(const CFI& cfi);
+
+    /**
+     Builds a document-relative CFI for a location within the document.
+
+     Every step leading to an element with an `id` attribute asserts that `id`.
+     Prepend Package::CFIForManifestItem() to obtain a full publication CFI.
+     @param node An element or text node within the document.
+     @param offset A character offset within `node`, if it is a text node.
+     @result A new CFI, or an empty CFI if `node` isn't within the document.
+     */
+    EPUB3_EXPORT
+    CFI             CFIForLocation(std::shared_ptr<xml::Node> node, uint32_t offset=0);
+
+    /**
+     Resolves many package-relative CFIs at once.
+
+     The CFIs are grouped by the content document they point into, and each
+     document is parsed once and resolved against by a single resolver. A CFI that
+     fails to resolve yields an invalid Range rather than aborting the batch.
+     @param package The package the CFIs belong to.
+     @param cfis The CFIs to resolve, each starting from the package's spine.
+     @result One Range for each input CFI, in the same order.
+     */
+    EPUB3_EXPORT
+    static std::vector<Range>   ResolveAll(PackagePtr package, const std::vector<CFI>& cfis);
+
+protected:
+    typedef CFI::ComponentList  ComponentList;
+    typedef std::shared_ptr<xml::Node>  NodePtr;
+
+    ///
+    /// The element children and character data chunks of an element, by CFI index.
+    struct ChildIndex
+    {
+        NodePtr                 parent;     ///< Keeps the map key alive.
+        std::vector<NodePtr>    elements;   ///< Element children; elements[N] has CFI index 2N+2.
+        std::vector<std::vector<NodePtr>>   chunks; ///< The text runs before, between and after them; chunks[N] has CFI index 2N+1.
+    };
+
+    std::shared_ptr<xml::Document>  _document;
+    NodePtr                         _root;
+
+    std::unordered_map<const xml::Node*, ChildIndex>   _children;
+    std::unordered_map<string, NodePtr>                 _ids;
+    bool                            _idsIndexed;
+
+    ///
+    /// Walks `base` followed by `tail` from the root element.
+    Location                Walk(const ComponentList& base, const ComponentList& tail);
+
+    ///
+    /// Returns the (cached) CFI child index for an element.
+    const ChildIndex&       ChildrenOf(const NodePtr& element);
+
+    ///
+    /// Finds the element with a given `id` attribute.
+    NodePtr                 ElementWithID(const string& ident);
+    void                    IndexIDs(const NodePtr& element);
+
+    ///
+    /// Whether a node holds character data which counts towards a CFI text run.
+    static bool             IsCharacterData(const NodePtr& node);
+    ///
+    /// The length of a text node's content in UTF-16 code units.
+    static uint32_t         UTF16Length(const NodePtr& node);
+
+};
+
+EPUB3_END_NAMESPACE
+
+#endif /* defined(__ePub3__cfi_resolver__) */
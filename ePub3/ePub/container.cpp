@@ -32,11 +32,21 @@
 #include "archive.h"
 #include "archive_xml.h"
 #include "xpath_wrangler.h"
+#include "document_cache.h"
+#include "package_snapshot.h"
 #include "byte_stream.h"
 #include "filter_manager.h"
 #include <ePub3/xml/document.h>
 #include <ePub3/xml/io.h>
 #include <ePub3/content_module_manager.h>
+#if FUTURE_ENABLED
+#include <ePub3/utilities/executor.h>
+#endif //FUTURE_ENABLED
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
 
 /*
 #if EPUB_COMPILER(CLANG) && defined(ANDROID)
@@ -63,6 +73,70 @@ static const char * gRootfilesXPath = "/ocf:container/ocf:rootfiles/ocf:rootfile
 static const char * gRootfilePathsXPath = "/ocf:container/ocf:rootfiles/ocf:rootfile/@full-path";
 static const char * gVersionXPath = "/ocf:container/@version";
 
+static std::atomic<bool> gParallelOpen(false);
+
+// Runs every stage and returns once they have all finished: the first on the calling
+// thread, the others concurrently on a shared pool, or all of them in order on the calling
+// thread if there isn't one. The first exception thrown by any stage is rethrown.
+static void __RunConcurrently(const std::vector<std::function<void()>>& stages)
+{
+    if (stages.empty())
+        return;
+
+    std::mutex lock;
+    std::exception_ptr error;
+
+    auto run = [&](size_t i) {
+        try
+        {
+            stages[i]();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> _(lock);
+            if (!error)
+                error = std::current_exception();
+        }
+    };
+
+#if FUTURE_ENABLED
+    std::condition_variable finished;
+    size_t remaining = stages.size() - 1;
+
+    // the stages never wait on one another, so a shared pool can't deadlock here
+    static std::once_flag __once;
+    static std::unique_ptr<thread_pool> __openThreadPool;
+    std::call_once(__once, [](){
+        __openThreadPool.reset(new thread_pool(thread_pool::Automatic));
+    });
+
+    for (size_t i = 1; i < stages.size(); i++)
+    {
+        __openThreadPool->add([&, i]() {
+            run(i);
+            std::lock_guard<std::mutex> _(lock);
+            if (--remaining == 0)
+                finished.notify_all();
+        });
+    }
+
+    run(0);
+
+    std::unique_lock<std::mutex> lk(lock);
+    finished.wait(lk, [&]() { return remaining == 0; });
+    lk.unlock();
+#else
+    // no pool to share, and a thread apiece on every open costs more than it saves
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        run(i);
+    }
+#endif //FUTURE_ENABLED
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
 Container::Container() :
 #if EPUB_PLATFORM(WINRT)
 	NativeBridge(),
@@ -104,12 +178,16 @@ bool Container::Open(const string& path, bool skipLoadingPotentiallyEncryptedCon
 
 #if ENABLE_XML_READ_DOC_MEMORY
 
-    _ocf = reader.readXml(ePub3::string(gContainerFilePath));
+    _ocf = DocumentCache::Shared().DocumentAtPath(_path, gContainerFilePath, [&reader]() {
+        return reader.readXml(ePub3::string(gContainerFilePath));
+    });
 
 #else
 
 #if EPUB_USE(LIBXML2)
-    _ocf = reader.xmlReadDocument(gContainerFilePath, nullptr);
+    _ocf = DocumentCache::Shared().DocumentAtPath(_path, gContainerFilePath, [&reader]() {
+        return reader.xmlReadDocument(gContainerFilePath, nullptr);
+    });
 #else
     decltype(_ocf) __tmp(reader.ReadDocument(gContainerFilePath, nullptr, /*RESOLVE_EXTERNALS*/ 1));
     _ocf = __tmp;
@@ -132,11 +210,52 @@ bool Container::Open(const string& path, bool skipLoadingPotentiallyEncryptedCon
 	if (nodes.empty())
 		return false;
 
-	LoadEncryption();
+	// a snapshot of the same, unchanged archive stands in for everything else
+	bool useSnapshot = !skipLoadingPotentiallyEncryptedContent && PackageSnapshot::IsEnabled();
+	if (useSnapshot && PackageSnapshot::Restore(shared_from_this()))
+		return true;
+
+	if (ParallelOpenEnabled())
+	{
+		OpenPackagesConcurrently(nodes, skipLoadingPotentiallyEncryptedContent);
+	}
+	else
+	{
+		LoadEncryption();
+
+		ParseVendorMetadata();
+
+		for (auto n : nodes)
+		{
+			string type = _getProp(n, "media-type");
+
+			string path = _getProp(n, "full-path");
+			if (path.empty())
+				continue;
 
-    ParseVendorMetadata();
+			auto pkg = std::make_shared<Package>(shared_from_this(), type);
+			//Package::New(Ptr(), type);
 
-	for (auto n : nodes)
+			if (pkg->Open(path, skipLoadingPotentiallyEncryptedContent))
+				_packages.push_back(pkg);
+		}
+	}
+
+	if (useSnapshot)
+		PackageSnapshot::Save(shared_from_this());
+
+	return true;
+}
+bool Container::OpenPackagesConcurrently(const xml::NodeSet& rootfiles, bool skipLoadingPotentiallyEncryptedContent)
+{
+#if EPUB_USE(LIBXML2)
+	// libxml2's global state must be set up before it's used from several threads
+	xmlInitParser();
+#endif
+
+	PackageList packages;
+	std::vector<string> paths;
+	for (auto n : rootfiles)
 	{
 		string type = _getProp(n, "media-type");
 
@@ -144,15 +263,56 @@ bool Container::Open(const string& path, bool skipLoadingPotentiallyEncryptedCon
 		if (path.empty())
 			continue;
 
-		auto pkg = std::make_shared<Package>(shared_from_this(), type);
-        //Package::New(Ptr(), type);
+		packages.push_back(std::make_shared<Package>(shared_from_this(), type));
+		paths.push_back(path);
+	}
+
+	// not vector<bool>: the elements are written from different threads
+	std::vector<char> loaded(packages.size(), 0);
+	std::vector<char> opened(packages.size(), 0);
+
+	// first everything that depends only on the archive...
+	std::vector<std::function<void()>> stages;
+	stages.push_back([this]() { LoadEncryption(); });
+	stages.push_back([this]() { ParseVendorMetadata(); });
+	for (size_t i = 0; i < packages.size(); i++)
+	{
+		stages.push_back([&, i]() {
+			loaded[i] = packages[i]->PackageBase::Open(paths[i]);
+		});
+	}
+	__RunConcurrently(stages);
+
+	// ...then the packages, whose filter chains and layout properties need the encryption
+	// and vendor metadata loaded above
+	stages.clear();
+	for (size_t i = 0; i < packages.size(); i++)
+	{
+		if (!loaded[i])
+			continue;
 
-		if (pkg->Open(path, skipLoadingPotentiallyEncryptedContent))
-			_packages.push_back(pkg);
+		stages.push_back([&, i]() {
+			opened[i] = packages[i]->_FinishOpen(skipLoadingPotentiallyEncryptedContent);
+		});
+	}
+	__RunConcurrently(stages);
+
+	for (size_t i = 0; i < packages.size(); i++)
+	{
+		if (opened[i])
+			_packages.push_back(packages[i]);
 	}
 
 	return true;
 }
+void Container::SetParallelOpenEnabled(bool enabled)
+{
+	gParallelOpen = enabled;
+}
+bool Container::ParallelOpenEnabled()
+{
+	return gParallelOpen;
+}
 
 #if FUTURE_ENABLED
 ContainerPtr Container::OpenContainer(const string &path) {
@@ -294,12 +454,16 @@ void Container::ParseVendorMetadata()
 
 #if ENABLE_XML_READ_DOC_MEMORY
 
-    shared_ptr<xml::Document> docXml = reader.readXml(ePub3::string(gAppleiBooksDisplayOptionsFilePath));
+    shared_ptr<xml::Document> docXml = DocumentCache::Shared().DocumentAtPath(_path, gAppleiBooksDisplayOptionsFilePath, [&reader]() {
+        return reader.readXml(ePub3::string(gAppleiBooksDisplayOptionsFilePath));
+    });
 
 #else
 
 #if EPUB_USE(LIBXML2)
-    shared_ptr<xml::Document> docXml = reader.xmlReadDocument(gAppleiBooksDisplayOptionsFilePath, nullptr);
+    shared_ptr<xml::Document> docXml = DocumentCache::Shared().DocumentAtPath(_path, gAppleiBooksDisplayOptionsFilePath, [&reader]() {
+        return reader.xmlReadDocument(gAppleiBooksDisplayOptionsFilePath, nullptr);
+    });
 #elif EPUB_USE(WIN_XML)
     auto docXml = reader.ReadDocument(gAppleiBooksDisplayOptionsFilePath, nullptr, 0);
 #endif
@@ -353,12 +517,16 @@ void Container::LoadEncryption()
 
 #if ENABLE_XML_READ_DOC_MEMORY
 
-    shared_ptr<xml::Document> enc = reader.readXml(ePub3::string(gEncryptionFilePath));
+    shared_ptr<xml::Document> enc = DocumentCache::Shared().DocumentAtPath(_path, gEncryptionFilePath, [&reader]() {
+        return reader.readXml(ePub3::string(gEncryptionFilePath));
+    });
 
 #else
 
 #if EPUB_USE(LIBXML2)
-    shared_ptr<xml::Document> enc = reader.xmlReadDocument(gEncryptionFilePath, nullptr);
+    shared_ptr<xml::Document> enc = DocumentCache::Shared().DocumentAtPath(_path, gEncryptionFilePath, [&reader]() {
+        return reader.xmlReadDocument(gEncryptionFilePath, nullptr);
+    });
 #elif EPUB_USE(WIN_XML)
     auto enc = reader.ReadDocument(gEncryptionFilePath, nullptr, 0);
 #endif
@@ -389,16 +557,32 @@ void Container::LoadEncryption()
         if ( encPtr->ParseXML(node) )
             _encryption.push_back(encPtr);
     }
+    
+    IndexEncryption();
 }
-shared_ptr<EncryptionInfo> Container::EncryptionInfoForPath(const string &path) const
+void Container::IndexEncryption()
 {
-    for ( auto item : _encryption )
+    _encryptionByPath.clear();
+    _encryptionByPath.reserve(_encryption.size());
+    for ( auto& item : _encryption )
     {
-        if ( item->Path() == path )
-            return item;
+        const string& path = item->Path();
+        if ( !path.empty() && path[0] == '/' )
+            _encryptionByPath.emplace(path.substr(1), item);
+        else
+            _encryptionByPath.emplace(path, item);
     }
+}
+shared_ptr<EncryptionInfo> Container::EncryptionInfoForPath(const string &path) const
+{
+    if ( _encryptionByPath.empty() )
+        return nullptr;
+    
+    auto found = (!path.empty() && path[0] == '/' ? _encryptionByPath.find(path.substr(1)) : _encryptionByPath.find(path));
+    if ( found == _encryptionByPath.end() )
+        return nullptr;
     
-    return nullptr;
+    return found->second;
 }
 bool Container::FileExistsAtPath(const string& path) const
 {
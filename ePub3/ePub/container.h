@@ -38,6 +38,7 @@
 #include <ePub3/content_module.h>
 #include <ePub3/xml/node.h>
 #include <vector>
+#include <unordered_map>
 #include <ePub3/utilities/future.h>
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -88,6 +89,10 @@ public:
     ///
     /// A list of encryption information.
     typedef shared_vector<EncryptionInfo>       EncryptionList;
+    
+    ///
+    /// Encryption details keyed by container-relative path, without any leading `/`.
+    typedef std::unordered_map<string, EncryptionInfoPtr>  EncryptionLookup;
 
 private:
     ///
@@ -116,7 +121,8 @@ public:
 
 #ifdef SUPPORT_ASYNC
     ///
-    /// Asynchronously returns a new Container instance.
+    /// Asynchronously returns a new Container instance. When opening many at once, pass
+    /// launch::pooled so they share default_thread_pool() rather than a thread apiece.
     static future<ContainerPtr>
         OpenContainerAsync(const string& path, launch policy = launch::any);
 #endif /* SUPPORT_ASYNC */
@@ -126,6 +132,25 @@ public:
 	static ContainerPtr
 		OpenContainerForContentModule(const string& path, bool skipLoadingPotentiallyEncryptedContent = false); 
     
+    /**
+     Enables or disables parallel loading in Open(). Disabled by default.
+     
+     When enabled, the encryption data, the vendor metadata and every rootfile's
+     OPF document are read and parsed concurrently. Then each Package is unpacked
+     concurrently, including its navigation documents. Everything has finished by
+     the time Open() returns, and packages keep their rootfile order.
+     
+     The work is shared out on a thread pool, so without FUTURE_ENABLED the same
+     steps run one after another on the calling thread.
+     */
+    EPUB3_EXPORT
+    static void     SetParallelOpenEnabled(bool enabled);
+    
+    ///
+    /// Whether Open() loads independent parts of the container concurrently.
+    EPUB3_EXPORT
+    static bool     ParallelOpenEnabled();
+    
     virtual         ~Container();
     
     ///
@@ -155,6 +180,8 @@ public:
     
     /**
      Retrieves the encryption information for a specific file within the container.
+     
+     This is a hash lookup; a leading `/` on `path` is ignored.
      @param path A container-relative path to the item whose encryption information
      to retrieve.
      @result Returns the encryption information, or `nullptr` if none was found.
@@ -212,12 +239,22 @@ protected:
     shared_ptr<xml::Document>		_ocf;
     PackageList						_packages;
     EncryptionList					_encryption;
+    EncryptionLookup				_encryptionByPath;	///< Index of _encryption; the first entry for a path wins.
 	std::shared_ptr<ContentModule>	_creator;
 	string							_path;
     
     ///
     /// Parses the file META-INF/encryption.xml into an EncryptionList.
     void							LoadEncryption();
+    ///
+    /// Rebuilds _encryptionByPath from _encryption.
+    void							IndexEncryption();
+
+    ///
+    /// The parallel half of Open(), run once META-INF/container.xml has been read.
+    bool							OpenPackagesConcurrently(const xml::NodeSet& rootfiles, bool skipLoadingPotentiallyEncryptedContent);
+
+    friend class PackageSnapshot;
 
 	//////////////////////////////////////////////////////////////////////////////
 	// BLATANT HACK!
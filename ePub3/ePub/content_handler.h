@@ -172,6 +172,8 @@ public:
     
 protected:
     const IRI           _handlerIRI;        ///< The URL of a DHTML media handler.
+    
+    friend class PackageSnapshot;
 };
 
 /**
@@ -37,6 +37,8 @@
 
 EPUB3_BEGIN_NAMESPACE
 
+class Archive;
+
 #if FUTURE_ENABLED
 
 #if EPUB_COMPILER_SUPPORTS(CXX_ALIAS_TEMPLATES)
@@ -69,6 +71,23 @@ private:
 public:
     //////////////////////////////////////////////
     // Token files
+
+    /**
+     A cheap check made before ProcessFile(), such as looking for a rights file
+     in the archive. ContentModuleManager only hands a file to the modules which
+     don't rule it out here, so return `false` only when ProcessFile() certainly
+     wouldn't accept it.
+     
+     This may be called for several files at once, from any thread.
+     @param path The path of the file being opened.
+     @param archive The file's archive, opened once and shared by all modules,
+     or `nullptr` if it couldn't be opened as an archive.
+     */
+    virtual
+    bool
+    CanProcessFile(const string& path,
+                   const Archive* archive)                  { return true; }
+
 #if FUTURE_ENABLED
     virtual
     async_result<ContainerPtr>
@@ -28,6 +28,7 @@
 //  OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <ePub3/container.h>
+#include <ePub3/archive.h>
 #include "content_module_manager.h"
 #include "content_module.h"
 
@@ -44,10 +45,8 @@ EPUB3_BEGIN_NAMESPACE
 std::unique_ptr<ContentModuleManager> ContentModuleManager::s_instance;
 
 ContentModuleManager::ContentModuleManager() :
-#if FUTURE_ENABLED
         _mutex(),
-#endif //FUTURE_ENABLED
-        _known_modules()
+        _known_modules(std::make_shared<ModuleMap>())
 {
 }
 ContentModuleManager::~ContentModuleManager()
@@ -72,10 +71,49 @@ ContentModuleManager* ContentModuleManager::Instance() _NOEXCEPT
 void ContentModuleManager::RegisterContentModule(ContentModule* module,
                                                  const ePub3::string& name) _NOEXCEPT
 {
-#if FUTURE_ENABLED
     std::unique_lock<std::mutex> locker(_mutex);
-#endif //FUTURE_ENABLED
-    _known_modules[name] = std::shared_ptr<ContentModule>(module);
+    
+    // loads in progress keep using the map they started with
+    auto modules = std::make_shared<ModuleMap>(*std::atomic_load(&_known_modules));
+    (*modules)[name] = ContentModulePtr(module);
+    std::atomic_store(&_known_modules, std::shared_ptr<const ModuleMap>(modules));
+}
+
+void ContentModuleManager::UnregisterContentModule(const ePub3::string& name) _NOEXCEPT
+{
+    std::unique_lock<std::mutex> locker(_mutex);
+    
+    auto modules = std::make_shared<ModuleMap>(*std::atomic_load(&_known_modules));
+    if (modules->erase(name) == 0)
+        return;
+    std::atomic_store(&_known_modules, std::shared_ptr<const ModuleMap>(modules));
+}
+
+std::vector<ContentModulePtr> ContentModuleManager::CandidatesForPath(const string& path) const
+{
+    std::vector<ContentModulePtr> result;
+    
+    auto modules = std::atomic_load(&_known_modules);
+    if (modules->empty())
+        return result;
+    
+    std::unique_ptr<Archive> archive;
+    try
+    {
+        archive = Archive::Open(path);
+    }
+    catch (std::exception&)
+    {
+        // not an archive we can read; the modules may still know what to do with it
+    }
+    
+    for (auto& item : *modules)
+    {
+        if (item.second->CanProcessFile(path, archive.get()))
+            result.push_back(item.second);
+    }
+    
+    return result;
 }
 
 #if FUTURE_ENABLED
@@ -101,11 +139,8 @@ ContentModuleManager::RequestCredentialInput(const CredentialRequest &request)
 future<ContainerPtr>
 ContentModuleManager::LoadContentAtPath(const string& path, launch policy)
 {
-#if FUTURE_ENABLED
-    std::unique_lock<std::mutex> locker(_mutex);
-#endif //FUTURE_ENABLED
-
-    if (_known_modules.empty())
+    auto candidates = CandidatesForPath(path);
+    if (candidates.empty())
     {
         // special case for when we don't have any Content Modules to rely on for an initialized result
         return make_ready_future<ContainerPtr>(ContainerPtr(nullptr));
@@ -113,9 +148,8 @@ ContentModuleManager::LoadContentAtPath(const string& path, launch policy)
     
     future<ContainerPtr> result;
 
-    for (auto& item : _known_modules)
+    for (auto& modulePtr : candidates)
     {
-        auto modulePtr = item.second;
         result = modulePtr->ProcessFile(path, policy);
         
         // check the state of the future -- has it already been set?
@@ -150,19 +184,8 @@ ContentModuleManager::LoadContentAtPath(const string& path, launch policy)
     ContainerPtr
     ContentModuleManager::LoadContentAtPath(const string& path)
     {
-#if FUTURE_ENABLED
-        std::unique_lock<std::mutex> locker(_mutex);
-#endif //FUTURE_ENABLED
-
-        if (_known_modules.empty())
+        for (auto& modulePtr : CandidatesForPath(path))
         {
-            return nullptr;
-        }
-
-        for (auto& item : _known_modules)
-        {
-            std::shared_ptr<ContentModule> modulePtr = item.second;
-
             ContainerPtr container = modulePtr->ProcessFile(path);
 
             if (bool(container)) {
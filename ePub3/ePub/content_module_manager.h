@@ -36,9 +36,10 @@
 #include <ePub3/utilities/utfstring.h>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #if FUTURE_ENABLED
-#include <mutex>
 #include <future>
 #endif //FUTURE_ENABLED
 
@@ -69,6 +70,12 @@ public:
     void
     RegisterContentModule(ContentModule* module,
                           const ePub3::string& name) _NOEXCEPT;
+    
+    ///
+    /// Removes the module registered under `name`, if any. Loads already in progress
+    /// may still use it.
+    void
+    UnregisterContentModule(const ePub3::string& name) _NOEXCEPT;
 
     ////////////////////////////////////////////////////
     // Services for DRM implementations
@@ -84,15 +91,23 @@ public:
 #endif //FUTURE_ENABLED
 
 private:
+    typedef std::map<string, ContentModulePtr>          ModuleMap;
+    
     static std::unique_ptr<ContentModuleManager>        s_instance;
 
-#if FUTURE_ENABLED
-std::mutex                                          _mutex;
-#endif //FUTURE_ENABLED
+    ///
+    /// Serializes registrations; loads never take it.
+    std::mutex                                          _mutex;
 
-    std::map<string, std::shared_ptr<ContentModule>>    _known_modules;
+    ///
+    /// Replaced, never modified, on registration, so loads read it without locking.
+    std::shared_ptr<const ModuleMap>                    _known_modules;
     
     friend class Container;
+    
+    ///
+    /// The registered modules which don't rule out the file at `path`, in name order.
+    std::vector<ContentModulePtr> CandidatesForPath(const string& path) const;
 
 #if FUTURE_ENABLED
     async_result<ContainerPtr> LoadContentAtPath(const string& path, launch policy);
@@ -0,0 +1,219 @@
+//
+//  document_cache.cpp
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this
+//  list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//  this list of conditions and the following disclaimer in the documentation and/or
+//  other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be
+//  used to endorse or promote products derived from this software without specific
+//  prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+//  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+//  OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+//  OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "document_cache.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+
+EPUB3_BEGIN_NAMESPACE
+
+DocumentCache& DocumentCache::Shared()
+{
+    static DocumentCache __shared;
+    return __shared;
+}
+
+DocumentCache::DocumentCache() : _lock(), _entries(), _index(), _capacity(0), _bytes(0), _hits(0), _misses(0), _evictions(0)
+{
+}
+DocumentCache::~DocumentCache()
+{
+}
+
+size_t DocumentCache::KeyHash::operator()(const Key& k) const
+{
+    std::hash<string> __h;
+    size_t result = __h(k.archivePath);
+    result ^= __h(k.entryPath) + 0x9e3779b9 + (result << 6) + (result >> 2);
+    result ^= std::hash<int64_t>()(k.archiveModified) + 0x9e3779b9 + (result << 6) + (result >> 2);
+    result ^= std::hash<int64_t>()(k.archiveSize) + 0x9e3779b9 + (result << 6) + (result >> 2);
+    return result;
+}
+
+void DocumentCache::SetCapacity(size_t bytes)
+{
+    std::lock_guard<std::mutex> _(_lock);
+    _capacity = bytes;
+    Trim(_capacity);
+}
+size_t DocumentCache::Capacity() const
+{
+    std::lock_guard<std::mutex> _(_lock);
+    return _capacity;
+}
+
+std::shared_ptr<xml::Document> DocumentCache::DocumentAtPath(const string& archivePath, const string& entryPath, Loader loader)
+{
+    if ( !IsEnabled() )
+        return loader();
+    
+    // the archive's size & modification date tell us whether it's been replaced
+    struct stat sb;
+    if ( ::stat(archivePath.c_str(), &sb) != 0 )
+        return loader();
+    
+    Key key{archivePath, entryPath, static_cast<int64_t>(sb.st_mtime), static_cast<int64_t>(sb.st_size)};
+    DocumentPtr cached;
+    
+    {
+        std::lock_guard<std::mutex> _(_lock);
+        auto found = _index.find(key);
+        if ( found != _index.end() )
+        {
+            _entries.splice(_entries.begin(), _entries, found->second);
+            cached = found->second->doc;
+            _hits++;
+        }
+        else
+        {
+            _misses++;
+        }
+    }
+    
+    // copy outside the lock: the cached tree is only ever read (see CopyDocument())
+    if ( bool(cached) )
+        return CopyDocument(cached);
+    
+    DocumentPtr result = loader();
+    if ( !bool(result) )
+        return result;
+    
+    DocumentPtr copy = CopyDocument(result);
+    if ( !bool(copy) || copy->xml()->dict != nullptr )
+        return result;
+    size_t bytes = EstimatedSize(copy);
+    
+    std::lock_guard<std::mutex> _(_lock);
+    if ( bytes > _capacity || _index.find(key) != _index.end() )
+        return result;      // too big, or another thread got there first
+    
+    _entries.push_front(Entry{key, copy, bytes});
+    _index[key] = _entries.begin();
+    _bytes += bytes;
+    Trim(_capacity);
+    
+    return result;
+}
+
+void DocumentCache::Clear()
+{
+    std::lock_guard<std::mutex> _(_lock);
+    _index.clear();
+    _entries.clear();
+    _bytes = 0;
+}
+
+DocumentCache::Statistics DocumentCache::GetStatistics() const
+{
+    std::lock_guard<std::mutex> _(_lock);
+    return Statistics{_hits, _misses, _evictions, _entries.size(), _bytes, _capacity};
+}
+void DocumentCache::ResetStatistics()
+{
+    std::lock_guard<std::mutex> _(_lock);
+    _hits = _misses = _evictions = 0;
+}
+
+void DocumentCache::Trim(size_t capacity)
+{
+    while ( _bytes > capacity && !_entries.empty() )
+    {
+        Entry& victim = _entries.back();
+        _bytes -= victim.bytes;
+        _index.erase(victim.key);
+        _entries.pop_back();
+        _evictions++;
+    }
+}
+
+DocumentCache::DocumentPtr DocumentCache::CopyDocument(const DocumentPtr& doc)
+{
+    xmlDocPtr source = doc->xml();
+    
+    // Without a dictionary, the copy gets its own strings rather than sharing (and
+    // adding to) the original's, which isn't safe across threads. So copies never
+    // have one, and a cached tree, itself a copy, is copied without writing to it
+    // at all. Only a freshly-loaded tree, which belongs to the calling thread alone,
+    // has its dictionary set aside while it's copied.
+    xmlDictPtr dict = source->dict;
+    if ( dict != nullptr )
+        source->dict = nullptr;
+    xmlDocPtr raw = xmlCopyDoc(source, 1);
+    if ( dict != nullptr )
+        source->dict = dict;
+    
+    if ( raw == nullptr )
+        return nullptr;
+    return xml::Wrapped<xml::Document>(raw);
+}
+
+size_t DocumentCache::EstimatedSize(const DocumentPtr& doc)
+{
+    size_t result = sizeof(xmlDoc);
+    
+    // walk the tree without recursion; attribute values are their own little trees
+    xmlNodePtr top = reinterpret_cast<xmlNodePtr>(doc->xml());
+    xmlNodePtr node = top->children;
+    while ( node != nullptr )
+    {
+        result += sizeof(xmlNode) + sizeof(void*) * 4;      // plus its wrapper
+        if ( node->name != nullptr )
+            result += xmlStrlen(node->name) + 1;
+        if ( node->content != nullptr )
+            result += xmlStrlen(node->content) + 1;
+        if ( node->type == XML_ELEMENT_NODE )
+        {
+            for ( xmlAttrPtr attr = node->properties; attr != nullptr; attr = attr->next )
+            {
+                result += sizeof(xmlAttr) + xmlStrlen(attr->name) + 1;
+                for ( xmlNodePtr value = attr->children; value != nullptr; value = value->next )
+                    result += sizeof(xmlNode) + (value->content != nullptr ? xmlStrlen(value->content) + 1 : 0);
+            }
+            for ( xmlNsPtr ns = node->nsDef; ns != nullptr; ns = ns->next )
+                result += sizeof(xmlNs) + xmlStrlen(ns->href) + xmlStrlen(ns->prefix) + 2;
+        }
+        
+        if ( node->children != nullptr && node->type != XML_ENTITY_REF_NODE )
+        {
+            node = node->children;
+            continue;
+        }
+        while ( node != nullptr && node->next == nullptr )
+        {
+            node = node->parent;
+            if ( node == top )
+                node = nullptr;
+        }
+        if ( node != nullptr )
+            node = node->next;
+    }
+    
+    return result;
+}
+
+EPUB3_END_NAMESPACE
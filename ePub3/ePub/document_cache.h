@@ -0,0 +1,194 @@
+//
+//  document_cache.h
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this
+//  list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//  this list of conditions and the following disclaimer in the documentation and/or
+//  other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be
+//  used to endorse or promote products derived from this software without specific
+//  prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+//  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+//  OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+//  OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __ePub3__document_cache__
+#define __ePub3__document_cache__
+
+#include <ePub3/epub3.h>
+#include <ePub3/xml/document.h>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+EPUB3_BEGIN_NAMESPACE
+
+/**
+ A process-wide cache of parsed XML documents from EPUB archives.
+ 
+ Documents are keyed by the path of the archive file, the path of the entry
+ within it, and the archive's modification time and size, so a book that is
+ replaced on disk is never served from stale entries. The cache holds up to
+ Capacity() bytes of documents and discards the least recently used ones
+ beyond that.
+ 
+ The cache is disabled (with a capacity of zero) until SetCapacity() is called.
+ When enabled, Container::Open() and Package::Open() take container.xml,
+ encryption.xml, the vendor display options and each OPF from it, and
+ ManifestItem::ReferencedDocument() takes navigation documents, SMIL files and
+ other unfiltered content documents from it. Content which passes through a
+ content filter (e.g. decryption) is never cached.
+ 
+ Each caller gets its own copy of a cached document, which it's free to modify.
+ Copying a tree is far cheaper than reading, inflating and parsing the source.
+ @ingroup utilities
+ */
+class DocumentCache
+{
+public:
+    ///
+    /// Loads a document on a cache miss.
+    typedef std::function<std::shared_ptr<xml::Document>()>  Loader;
+    
+    ///
+    /// A snapshot of the cache's counters.
+    struct Statistics
+    {
+        size_t      hits;       ///< Lookups answered from the cache.
+        size_t      misses;     ///< Lookups which had to load their document.
+        size_t      evictions;  ///< Documents discarded to stay within capacity.
+        size_t      entries;    ///< Documents currently cached.
+        size_t      bytes;      ///< Estimated memory used by the cached documents.
+        size_t      capacity;   ///< The current capacity in bytes.
+    };
+    
+public:
+    ///
+    /// The process-wide cache.
+    EPUB3_EXPORT
+    static DocumentCache&       Shared();
+    
+                                DocumentCache();
+    virtual                     ~DocumentCache();
+    
+private:
+                                DocumentCache(const DocumentCache&)     _DELETED_;
+                                DocumentCache(DocumentCache&&)          _DELETED_;
+    DocumentCache&              operator=(const DocumentCache&)         _DELETED_;
+    DocumentCache&              operator=(DocumentCache&&)              _DELETED_;
+    
+public:
+    /**
+     Sets the maximum estimated size of all cached documents.
+     
+     Shrinking the capacity evicts documents immediately; a capacity of zero
+     empties and disables the cache.
+     @param bytes The new capacity in bytes.
+     */
+    EPUB3_EXPORT
+    void                        SetCapacity(size_t bytes);
+    
+    ///
+    /// The maximum estimated size of all cached documents, in bytes.
+    EPUB3_EXPORT
+    size_t                      Capacity()                  const;
+    
+    ///
+    /// Whether documents are being cached at all.
+    bool                        IsEnabled()                 const   { return Capacity() > 0; }
+    
+    /**
+     Returns a document from an archive, parsing it only if it isn't cached.
+     @param archivePath The filesystem path of the archive file.
+     @param entryPath The path of the document within the archive.
+     @param loader A function which reads and parses the document. It is called
+     on a cache miss, or whenever the cache is disabled.
+     @result A document owned by the caller, or `nullptr` if `loader` produced
+     none. Failed loads aren't cached.
+     */
+    EPUB3_EXPORT
+    std::shared_ptr<xml::Document>  DocumentAtPath(const string& archivePath, const string& entryPath, Loader loader);
+    
+    ///
+    /// Discards every cached document.
+    EPUB3_EXPORT
+    void                        Clear();
+    
+    ///
+    /// Returns the cache's current counters.
+    EPUB3_EXPORT
+    Statistics                  GetStatistics()             const;
+    
+    ///
+    /// Resets the hit, miss and eviction counters to zero.
+    EPUB3_EXPORT
+    void                        ResetStatistics();
+    
+protected:
+    typedef std::shared_ptr<xml::Document>  DocumentPtr;
+    
+    struct Key
+    {
+        string      archivePath;
+        string      entryPath;
+        int64_t     archiveModified;
+        int64_t     archiveSize;
+        
+        bool operator==(const Key& o) const
+        {
+            return archiveModified == o.archiveModified && archiveSize == o.archiveSize
+                && entryPath == o.entryPath && archivePath == o.archivePath;
+        }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key& k) const;
+    };
+    struct Entry
+    {
+        Key         key;
+        DocumentPtr doc;        ///< A private copy, never handed out.
+        size_t      bytes;      ///< Estimated memory used by `doc`.
+    };
+    typedef std::list<Entry>    EntryList;
+    
+    mutable std::mutex          _lock;
+    EntryList                   _entries;       ///< Most recently used first.
+    std::unordered_map<Key, EntryList::iterator, KeyHash>  _index;
+    size_t                      _capacity;
+    size_t                      _bytes;
+    size_t                      _hits;
+    size_t                      _misses;
+    size_t                      _evictions;
+    
+    ///
+    /// Evicts least recently used entries until the cache fits. Call with `_lock` held.
+    void                        Trim(size_t capacity);
+    
+    ///
+    /// Makes a deep copy of a document which shares nothing with the original.
+    static DocumentPtr          CopyDocument(const DocumentPtr& doc);
+    ///
+    /// Estimates the memory used by a document's tree.
+    static size_t               EstimatedSize(const DocumentPtr& doc);
+    
+};
+
+EPUB3_END_NAMESPACE
+
+#endif /* defined(__ePub3__document_cache__) */
@@ -126,6 +126,8 @@ protected:
     // To get additional information for the compressed and encrypted contents
     string          _compression_method;  //  Compression method : 0(no compression), 8(deflated)
     string          _uncompressed_size;   //  Uncompressed size of the content
+    
+    friend class PackageSnapshot;
 
 };
 
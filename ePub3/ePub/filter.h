@@ -344,6 +344,17 @@ public:
 
     virtual ByteStream::size_type BytesAvailable(FilterContext *context, SeekableByteStream *byteStream) const { return byteStream->BytesAvailable(); };
 
+    /**
+     Subclasses should override this method to return `true` if FilterData() can be
+     fed a resource as a sequence of consecutive chunks, and returns exactly as many
+     bytes as it is given for each of them.
+     
+     When every filter applied to a resource says so, FilterChainByteStream streams
+     the filtered bytes as they are read, and takes the content length from the raw
+     input (i.e. the ZIP central directory) instead of filtering everything up front.
+     */
+    virtual bool SupportsIncrementalFiltering() const { return false; }
+
     ///
     /// Obtains the type-sniffer for this filter.
     virtual TypeSnifferFn TypeSniffer() const { return _sniffer; }
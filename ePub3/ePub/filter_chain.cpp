@@ -34,6 +34,7 @@
 #include "filter.h"
 #include "byte_buffer.h"
 #include "make_unique.h"
+#include <atomic>
 #include <iostream>
 
 #define ASYNC_BUF_SIZE 4096*4
@@ -44,6 +45,40 @@
 
 EPUB3_BEGIN_NAMESPACE
 
+uint64_t FilterChain::NextIdentifier()
+{
+    static std::atomic<uint64_t> __next(1);
+    return __next++;
+}
+
+std::shared_ptr<const FilterChainPlan> FilterChain::PlanForManifestItem(ConstManifestItemPtr item) const
+{
+    auto plan = std::atomic_load(&item->_filterPlan);
+    if ( bool(plan) && plan->chainID == _identifier )
+        return plan;
+    
+    auto newPlan = std::make_shared<FilterChainPlan>();
+    newPlan->chainID = _identifier;
+    newPlan->streamable = true;
+    for ( ContentFilterPtr filter : _filters )
+    {
+        if ( !filter->TypeSniffer()(item) )
+            continue;
+        
+        newPlan->filters.push_back(filter);
+        if ( !filter->SupportsIncrementalFiltering() )
+            newPlan->streamable = false;
+    }
+    
+    newPlan->rangeReadable = newPlan->filters.empty() ||
+        (newPlan->filters.size() == 1 && newPlan->filters[0]->GetOperatingMode() == ContentFilter::OperatingMode::SupportsByteRanges);
+    
+    // two threads may both build a plan for the same item; they'll be identical
+    plan = newPlan;
+    std::atomic_store(&item->_filterPlan, plan);
+    return plan;
+}
+
 #ifdef SUPPORT_ASYNC
 std::unique_ptr<thread_pool> FilterChain::_filterThreadPool(nullptr);
 
@@ -57,17 +92,14 @@ std::shared_ptr<AsyncByteStream> FilterChain::GetFilteredOutputStreamForManifest
     
     AsyncPipe::Pair linkPipe;
     
-    for ( ContentFilterPtr filter : _filters )
+    for ( ContentFilterPtr filter : PlanForManifestItem(item)->filters )
     {
-        if ( filter->TypeSniffer()(item) )
-        {
-            if ( !thisChain.empty() )
-                thisChain.back()->SetOutputLink(linkPipe.first);
-            
-            thisChain.push_back(ChainLinkProcessor::New(filter, input, item));
-            linkPipe = AsyncPipe::LinkedPair();
-            input = linkPipe.second;
-        }
+        if ( !thisChain.empty() )
+            thisChain.back()->SetOutputLink(linkPipe.first);
+        
+        thisChain.push_back(ChainLinkProcessor::New(filter, input, item));
+        linkPipe = AsyncPipe::LinkedPair();
+        input = linkPipe.second;
     }
     
     // if no filters apply, read raw bytes
@@ -122,12 +154,7 @@ std::shared_ptr<ByteStream> FilterChain::GetFilterChainByteStream(ConstManifestI
 
 std::unique_ptr<ByteStream> FilterChain::GetFilterChainByteStream(ConstManifestItemPtr item, SeekableByteStream *rawInput) const
 {
-    std::vector<ContentFilterPtr> thisChain;
-    for (ContentFilterPtr filter : _filters)
-    {
-        if (filter->TypeSniffer()(item))
-            thisChain.push_back(filter);
-    }
+    std::vector<ContentFilterPtr> thisChain(PlanForManifestItem(item)->filters);
     
     unique_ptr<SeekableByteStream> rawInputPtr(rawInput);
     return unique_ptr<FilterChainByteStream>(new FilterChainByteStream(std::move(rawInputPtr), thisChain, item));
@@ -146,56 +173,30 @@ std::shared_ptr<ByteStream> FilterChain::GetFilterChainByteStreamRange(ConstMani
 
 std::unique_ptr<ByteStream> FilterChain::GetFilterChainByteStreamRange(ConstManifestItemPtr item, SeekableByteStream *rawInput) const
 {
-    unique_ptr<ByteStream> resultStream;
-    uint nFilters = 0;
-    for (ContentFilterPtr filter : _filters)
-    {
-        if (filter->TypeSniffer()(item))
-        {
-            nFilters++;
-            if (nFilters > 1)
-            {
-                continue;
-            }
-            
-            if (filter->GetOperatingMode() == ContentFilter::OperatingMode::SupportsByteRanges)
-            {
-                unique_ptr<SeekableByteStream> rawInputPtr(rawInput);
-                resultStream.reset(new FilterChainByteStreamRange(std::move(rawInputPtr), filter, item));
-            }
-        }
-    }
+    unique_ptr<SeekableByteStream> rawInputPtr(rawInput);
+    auto plan = PlanForManifestItem(item);
     
-    if (nFilters > 1)
+    if (!plan->rangeReadable)
     {
         // more than one filter...abort!
-        return nullptr;
+        if (plan->filters.size() > 1)
+            return nullptr;
+        
+        // a single filter which can't work on byte ranges: hand out the raw bytes
+        return unique_ptr<ByteStream>(new FilterChainByteStreamRange(std::move(rawInputPtr), nullptr, nullptr));
     }
     
     // There are no ContentFilter classes that curretly apply.
     // In this case, return an empty FilterChainByteStreamRange, that will simply put out raw bytes.
-    if (!resultStream)
-    {
-        unique_ptr<SeekableByteStream> rawInputPtr(rawInput);
-        resultStream.reset(new FilterChainByteStreamRange(std::move(rawInputPtr), nullptr, nullptr));
-    }
+    if (plan->filters.empty())
+        return unique_ptr<ByteStream>(new FilterChainByteStreamRange(std::move(rawInputPtr), nullptr, nullptr));
     
-    return resultStream;
+    return unique_ptr<ByteStream>(new FilterChainByteStreamRange(std::move(rawInputPtr), plan->filters[0], item));
 }
 
 size_t FilterChain::GetFilterChainSize(ConstManifestItemPtr item) const
 {
-    size_t numFilters = 0;
-    
-    for (ContentFilterPtr filter : _filters)
-    {
-        if (filter->TypeSniffer()(item))
-        {
-            numFilters++;
-        }
-    }
-
-    return numFilters;
+    return PlanForManifestItem(item)->filters.size();
 }
 
 #ifdef SUPPORT_ASYNC
@@ -250,11 +251,9 @@ void FilterChain::ChainLinkProcessor::ScheduleProcessor(RunLoopPtr runLoop)
                 {
                     size_t filteredLen = 0;
                     void* filteredData = _filter->FilterData(_context.get(), _collectionBuffer.GetBytes(), _collectionBuffer.GetBufferSize(), &filteredLen);
-                    if ( filteredData == nullptr || filteredLen == 0 ) {
-                        if (filteredData != nullptr && filteredData != _collectionBuffer.GetBytes())
-                            delete[] reinterpret_cast<uint8_t*>(filteredData);
+                    // an empty result is fine (e.g. a document made up of a single switch with empty default content)
+                    if ( filteredData == nullptr && _collectionBuffer.GetBufferSize() != 0 )
                         throw std::logic_error("ChainLinkProcessor: ContentFilter::FilterData() returned no data!");
-                    }
 
                     // forward the data
                     uint8_t *outputData = reinterpret_cast<uint8_t*>(filteredData);
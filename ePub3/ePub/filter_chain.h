@@ -36,6 +36,7 @@
 #include <memory>
 #include <algorithm>
 #include <utility>
+#include <vector>
 
 #if FUTURE_ENABLED
 #include <thread>
@@ -53,6 +54,31 @@ EPUB3_BEGIN_NAMESPACE
 class FilterContext;
 class ByteRange;
 
+/**
+ The filters of a FilterChain which apply to a single manifest item, in chain order,
+ along with what they allow a reader of that item to do.
+ 
+ A plan is built the first time a chain is asked about an item, and the item keeps
+ it until the package is given a different chain. Type sniffers are therefore
+ expected to give the same answer for a given item every time.
+ */
+struct FilterChainPlan
+{
+    ///
+    /// The chain this plan was made by; see FilterChain::Identifier().
+    uint64_t                        chainID;
+    ///
+    /// The filters whose type sniffers accepted the item.
+    std::vector<ContentFilterPtr>   filters;
+    ///
+    /// `true` if every filter works piecemeal, so the item can be filtered as it is
+    /// read. Otherwise the whole item is filtered into a cache before it can be read.
+    bool                            streamable;
+    ///
+    /// `true` if no filter applies, or the only one supports byte ranges.
+    bool                            rangeReadable;
+};
+
 
 class FilterChain : public PointerType<FilterChain>
 #if EPUB_PLATFORM(WINRT)
@@ -63,21 +89,40 @@ public:
     typedef shared_vector<ContentFilter>    FilterList;
     
 public:
-    FilterChain(FilterList filters) : _filters(filters) {}
+    FilterChain(FilterList filters) : _filters(filters), _identifier(NextIdentifier()) {}
 #if EPUB_COMPILER_SUPPORTS(CXX_DEFAULTED_FUNCTIONS)
-    FilterChain(FilterChain&& o) : _filters(std::move(o._filters)) {}
+    FilterChain(FilterChain&& o) : _filters(std::move(o._filters)), _identifier(NextIdentifier()) {}
     virtual ~FilterChain()                  = default;
     FilterChain& operator=(FilterChain&& o) {
         _filters = std::move(o._filters);
+        _identifier = NextIdentifier();
         return *this;
     }
 #else
-    FilterChain(FilterChain&& o) : _filters(std::move(o._filters)) {}
+    FilterChain(FilterChain&& o) : _filters(std::move(o._filters)), _identifier(NextIdentifier()) {}
     virtual ~FilterChain() {}
     FilterChain& operator=(FilterChain&& o) { swap(std::move(o)); return *this; }
 #endif
     
-    void swap(FilterChain&& __o) { _filters.swap(__o._filters); }
+    void swap(FilterChain&& __o) {
+        _filters.swap(__o._filters);
+        _identifier = NextIdentifier();
+        __o._identifier = NextIdentifier();
+    }
+    
+    ///
+    /// A process-unique value; every chain, and every change to a chain's filters, gets a new one.
+    uint64_t Identifier() const { return _identifier; }
+    
+    /**
+     Returns the filters which apply to a manifest item.
+     
+     The first call for an item runs every filter's type sniffer over it; the result
+     is stored on the item, and later calls simply return it.
+     @param item The manifest item to be read through this chain.
+     @result The item's plan for this chain. Never `nullptr`.
+     */
+    std::shared_ptr<const FilterChainPlan> PlanForManifestItem(ConstManifestItemPtr item) const;
     
     // obtains a stream which can be used to read filtered bytes from the chain
 
@@ -125,6 +170,9 @@ protected:
 
     private:
     FilterList              _filters;
+    uint64_t                _identifier;
+    
+    static uint64_t         NextIdentifier();
 
 };
 
@@ -62,7 +62,7 @@ FilterChainByteStream::~FilterChainByteStream()
 //}
 
 FilterChainByteStream::FilterChainByteStream(std::unique_ptr<SeekableByteStream>&& input, std::vector<ContentFilterPtr>& filters, ConstManifestItemPtr manifestItem)
-: _input(std::move(input)), m_filters(), m_filterContexts(), _needs_cache(false), _cache(), _read_cache(), _cacheHasBeenFilledUp(false)
+: _input(std::move(input)), m_filters(), m_filterContexts(), _manifestItem(manifestItem), _needs_cache(false), _cache(), _cache_pos(0), _read_cache(), _read_cache_pos(0), _cacheHasBeenFilledUp(false)
 {
     _cache.SetUsesSecureErasure();
     _read_cache.SetUsesSecureErasure();
@@ -71,13 +71,13 @@ FilterChainByteStream::FilterChainByteStream(std::unique_ptr<SeekableByteStream>
     {
         m_filters.push_back(filter);
         m_filterContexts.push_back(std::unique_ptr<FilterContext>(filter->MakeFilterContext(manifestItem)));
+
+        // The only way to reliably compute the content length of a resource is to run all of its raw content through
+        // the filters and store the result in the cache, unless every filter processes the data piecemeal and hands
+        // back as many bytes as it was given: then the length is that of the raw input, and we can stream.
+        if (!filter->SupportsIncrementalFiltering())
+            _needs_cache = true;
     }
-	
-	// We are currently hardcoding _needs_cache to true, because we realized that this is the only way to realiably compute
-	// the content length of any resource being read by FilterChainByteStream. Only by processing the raw conten of a given
-	// resource through all the filters in the chaing, and storing the result in the cache, that we can reliably stablish the
-	// size of the resource after being processed.
-	_needs_cache = true;
 }
 
 ByteStream::size_type FilterChainByteStream::ReadBytes(void* bytes, size_type len)
@@ -92,14 +92,7 @@ ByteStream::size_type FilterChainByteStream::ReadBytes(void* bytes, size_type le
         return ReadBytesFromCache(bytes, len);
     }
 
-    if (_read_cache.GetBufferSize() > 0)
-    {
-        size_type toMove = std::min(len, _read_cache.GetBufferSize());
-        ::memcpy_s(bytes, len, _read_cache.GetBytes(), toMove);
-        _read_cache.RemoveBytes(toMove);
-        return toMove;
-    }
-    else 
+    if (_read_cache_pos >= _read_cache.GetBufferSize())
     {
         if (!_input->IsOpen())
         {
@@ -113,19 +106,17 @@ ByteStream::size_type FilterChainByteStream::ReadBytes(void* bytes, size_type le
         }
 
         result = FilterBytes(bytes, result);
+        _read_cache_pos = 0;
         if (result == 0)
         {
             return 0;
         }
-
-        size_type toMove = std::min(len, _read_cache.GetBufferSize());
-        if (toMove > 0)
-        {
-            ::memcpy_s(bytes, len, _read_cache.GetBytes(), toMove);
-            _read_cache.RemoveBytes(toMove);
-        }
-        return toMove;
     }
+
+    size_type toMove = std::min(len, size_type(_read_cache.GetBufferSize() - _read_cache_pos));
+    ::memcpy_s(bytes, len, _read_cache.GetBytes() + _read_cache_pos, toMove);
+    _read_cache_pos += toMove;
+    return toMove;
 }
 
 ByteStream::size_type FilterChainByteStream::FilterBytes(void* bytes, size_type len)
@@ -241,13 +232,76 @@ ByteStream::size_type FilterChainByteStream::FilterBytes(void* bytes, size_type
     return result;
 }
 
+ByteStream::size_type FilterChainByteStream::Seek(size_type by, std::ios::seekdir dir)
+{
+    if (_needs_cache && _cache.GetBufferSize() == 0 && !_cacheHasBeenFilledUp)
+        CacheBytes();
+
+    size_type cur = Position();
+    size_type size = (_needs_cache ? _cache.GetBufferSize() : cur + BytesAvailable());
+    size_type pos = 0;
+    switch (dir)
+    {
+        case std::ios::beg:
+            pos = by;
+            break;
+        case std::ios::cur:
+            pos = cur + by;
+            break;
+        case std::ios::end:
+            pos = size + by;
+            break;
+        default:
+            return cur;
+    }
+    pos = std::min(pos, size);
+
+    if (_needs_cache)
+    {
+        _cache_pos = pos;
+        return _cache_pos;
+    }
+
+    // filters may keep state about what they've seen (e.g. FontObfuscator counts bytes), so
+    // they have to see the content in order: start over to go back, filter & drop to go forward
+    if (pos < cur)
+    {
+        RestartStream();
+        cur = 0;
+    }
+
+    uint8_t buf[4096];
+    while (cur < pos)
+    {
+        size_type numRead = ReadBytes(buf, std::min(size_type(sizeof(buf)), pos - cur));
+        if (numRead == 0)
+            break;
+        cur += numRead;
+    }
+
+    return cur;
+}
+
+void FilterChainByteStream::RestartStream()
+{
+    _input->Seek(0, std::ios::beg);
+    _read_cache.RemoveBytes(_read_cache.GetBufferSize());
+    _read_cache_pos = 0;
+
+    for (std::size_t i = 0; i < m_filters.size(); i++)
+    {
+        m_filterContexts[i].reset(m_filters[i]->MakeFilterContext(_manifestItem));
+    }
+}
+
 ByteStream::size_type FilterChainByteStream::ReadBytesFromCache(void* bytes, size_type len)
 {
     if (len == 0) return 0;
 
-    size_type numToRead = std::min(len, size_type(_cache.GetBufferSize()));
-    ::memcpy_s(bytes, len, _cache.GetBytes(), numToRead);
-    _cache.RemoveBytes(numToRead);
+    // the cache is kept intact and only the cursor moves; it is wiped once, on destruction
+    size_type numToRead = std::min(len, size_type(_cache.GetBufferSize() - _cache_pos));
+    ::memcpy_s(bytes, len, _cache.GetBytes() + _cache_pos, numToRead);
+    _cache_pos += numToRead;
     return numToRead;
 }
 
@@ -276,6 +330,7 @@ void FilterChainByteStream::CacheBytes()
 
         _cache = std::move(_read_cache);
         _read_cache.RemoveBytes(_read_cache.GetBufferSize());
+        _cache_pos = 0;
         _cacheHasBeenFilledUp = true;
     }
 
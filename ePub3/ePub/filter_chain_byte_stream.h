@@ -58,10 +58,13 @@ private:
 
     std::vector<ContentFilterPtr> m_filters;
     std::vector<std::unique_ptr<FilterContext>> m_filterContexts;
+    ConstManifestItemPtr            _manifestItem;
     
-    bool                            _needs_cache;
+    bool                            _needs_cache;   ///< `false` when every filter supports incremental filtering.
     ByteBuffer                        _cache;
+    size_type                       _cache_pos;     ///< Read cursor into the filtered bytes in _cache.
     ByteBuffer                        _read_cache;
+    size_type                       _read_cache_pos;    ///< Read cursor into the last filtered chunk in _read_cache.
 
 private:
     FilterChainByteStream(const FilterChainByteStream& o)             _DELETED_;
@@ -70,7 +73,7 @@ private:
     FilterChainByteStream&         operator=(FilterChainByteStream&&)                         _DELETED_;
 
 public:
-    FilterChainByteStream() : ByteStream(), _cacheHasBeenFilledUp(false) {}
+    FilterChainByteStream() : ByteStream(), _cache_pos(0), _read_cache_pos(0), _cacheHasBeenFilledUp(false) {}
     //EPUB3_EXPORT FilterChainByteStream(std::vector<ContentFilterPtr>& filters, ConstManifestItemPtr &manifestItem);
     EPUB3_EXPORT FilterChainByteStream(std::unique_ptr<SeekableByteStream>&& input, std::vector<ContentFilterPtr>& filters, ConstManifestItemPtr manifestItem);
     virtual ~FilterChainByteStream();
@@ -83,9 +86,10 @@ public:
 			{
 				CacheBytes();
 			}
-            return _cache.GetBufferSize();
+            return _cache.GetBufferSize() - _cache_pos;
         } else {
-            return _input->BytesAvailable();
+            // filters are length-preserving here, so the raw input tells us what's left
+            return (_read_cache.GetBufferSize() - _read_cache_pos) + _input->BytesAvailable();
         }
     }
     virtual size_type SpaceAvailable() const _NOEXCEPT OVERRIDE
@@ -110,7 +114,9 @@ public:
     virtual bool AtEnd() const _NOEXCEPT OVERRIDE
     {
         if (_needs_cache && _input->AtEnd()) {
-            return _cache.IsEmpty();
+            return _cache_pos >= _cache.GetBufferSize();
+        } else if (!_needs_cache) {
+            return _read_cache_pos >= _read_cache.GetBufferSize() && _input->AtEnd();
         } else {
             return _input->AtEnd();
         }
@@ -120,10 +126,37 @@ public:
         return _input->Error();
     }
     
+    /**
+     Moves the read position within the filtered content.
+     
+     When the content is cached, it is produced once and kept for the lifetime of the
+     stream, so byte-range readers can seek around it freely without running the
+     filters again. When it is streamed, seeking forward filters and discards the
+     bytes in between, and seeking backward restarts the filters from the beginning
+     of the resource.
+     @param by The amount to move the read position.
+     @param dir The starting point for the position calculation: current position,
+     start of content, or end of content.
+     @result The new read position. This may be different from the requested
+     position if the content is not large enough to accomodate the request.
+     */
+    EPUB3_EXPORT size_type Seek(size_type by, std::ios::seekdir dir);
+    
+    /**
+     Returns the current read position within the filtered content.
+     */
+    size_type Position() const
+    {
+        if (_needs_cache)
+            return _cache_pos;
+        return _input->Position() - (_read_cache.GetBufferSize() - _read_cache_pos);
+    }
+    
 private:
     size_type ReadBytesFromCache(void* bytes, size_type len);
     void CacheBytes();
     size_type FilterBytes(void* bytes, size_type len);
+    void RestartStream();
     //size_type FilterBytes(void* bytes, ByteRange &byteRange);
     
     bool _cacheHasBeenFilledUp;
@@ -35,7 +35,8 @@ EPUB3_BEGIN_NAMESPACE
 
 ContentFilterPtr FilterManagerImpl::GetFilterByName(const string& name, ConstPackagePtr package) const
 {
-    for ( auto& item : m_registeredFilters )
+    auto filters = std::atomic_load(&m_registeredFilters);
+    for ( auto& item : *filters )
     {
         if ( item.GetFilterName() == name )
             return item.CreateFilter(package);
@@ -45,13 +46,18 @@ ContentFilterPtr FilterManagerImpl::GetFilterByName(const string& name, ConstPac
 
 void FilterManagerImpl::RegisterFilter(const string& name, ContentFilter::FilterPriority priority, ContentFilter::TypeFactoryFn factory)
 {
-    m_registeredFilters.emplace(name, priority, factory);
+    std::lock_guard<std::mutex> _(m_writeLock);
+    
+    auto filters = std::make_shared<RecordSet>(*std::atomic_load(&m_registeredFilters));
+    if ( filters->emplace(name, priority, factory).second )
+        std::atomic_store(&m_registeredFilters, std::shared_ptr<const RecordSet>(filters));
 }
 
 FilterChainPtr FilterManagerImpl::BuildFilterChainForPackage(ConstPackagePtr package) const
 {
     shared_vector<ContentFilter> filters;
-    for ( auto& record : m_registeredFilters )
+    auto records = std::atomic_load(&m_registeredFilters);
+    for ( auto& record : *records )
     {
         ContentFilterPtr filter = record.CreateFilter(package);
         if ( filter )
@@ -32,6 +32,8 @@
 
 #include <ePub3/filter_manager.h>
 #include <ePub3/filter.h>
+#include <memory>
+#include <mutex>
 #include <set>
 
 EPUB3_BEGIN_NAMESPACE
@@ -40,7 +42,7 @@ class FilterManagerImpl : public FilterManager
 {
 public:
     
-    FilterManagerImpl() : FilterManager(), m_registeredFilters() {}
+    FilterManagerImpl() : FilterManager(), m_writeLock(), m_registeredFilters(std::make_shared<RecordSet>()) {}
     virtual ~FilterManagerImpl() {}
     
     virtual ContentFilterPtr GetFilterByName(const string& name, ConstPackagePtr package) const;
@@ -53,7 +55,13 @@ private:
     FilterManagerImpl(const FilterManagerImpl &o) _DELETED_;
     FilterManagerImpl(FilterManagerImpl &&o) _DELETED_;
     
-    std::set<Record, PriorityOrderHighToLow>     m_registeredFilters;
+    typedef std::set<Record, PriorityOrderHighToLow>    RecordSet;
+    
+    ///
+    /// Serializes registrations, which copy the set and replace it; lookups
+    /// read the current set without locking, so packages can open in parallel.
+    std::mutex                          m_writeLock;
+    std::shared_ptr<const RecordSet>    m_registeredFilters;
     
 };
 
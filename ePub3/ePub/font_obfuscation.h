@@ -131,6 +131,10 @@ public:
      */
     virtual void * FilterData(FilterContext* context, void * data, size_t len, size_t *outputLen) OVERRIDE;
     
+    ///
+    /// Only the first 1040 bytes are touched, in place, so any chunking will do.
+    virtual bool SupportsIncrementalFiltering() const OVERRIDE { return true; }
+    
     static void Register();
     
 protected:
@@ -32,9 +32,14 @@
 #include "manifest.h"
 #include "package.h"
 #include "zip_archive.h"
+#if FUTURE_ENABLED
+#include <ePub3/utilities/executor.h>
+#endif //FUTURE_ENABLED
+#include <atomic>
 #include <sstream>
 #include <fstream>
 #include <list>
+#include <thread>
 
 // file format is CSV, unencrypted
 
@@ -42,13 +47,23 @@ EPUB3_BEGIN_NAMESPACE
 
 unique_ptr<Library> Library::_singleton(nullptr);
 
-Library::Library(const string& path)
+Library::Library(const string& path) : _ingestsRunning(0)
 {
     if ( !Load(path) )
         throw std::invalid_argument("The provided Locator doesn't appear to contain library data.");
 }
 Library::~Library()
 {
+    // ingestion workers write to the library until they're done
+    std::unique_lock<std::mutex> lk(_ingestLock);
+    _ingestFinished.wait(lk, [this]() { return _ingestsRunning == 0; });
+}
+void Library::IngestFinished()
+{
+    // notified under the lock, so the destructor can't return while this still uses the library
+    std::lock_guard<std::mutex> _(_ingestLock);
+    if ( --_ingestsRunning == 0 )
+        _ingestFinished.notify_all();
 }
 bool Library::Load(const string& path)
 {
@@ -101,6 +116,7 @@ Library* Library::MainLibrary(const string& path)
 }
 string Library::PathForEPubWithUniqueID(const string &uniqueID) const
 {
+    std::lock_guard<std::mutex> _(_lock);
     auto found = _packages.find(uniqueID);
     if ( found == _packages.end() )
         return string::EmptyString;
@@ -110,6 +126,7 @@ string Library::PathForEPubWithUniqueID(const string &uniqueID) const
 string Library::PathForEPubWithPackageID(const string &packageID) const
 {
     string uniqueIDStart(packageID + "@");
+    std::lock_guard<std::mutex> _(_lock);
     for ( auto &pair : _packages )
     {
         if ( pair.first == packageID || pair.first.find(uniqueIDStart) == 0 )
@@ -120,13 +137,24 @@ string Library::PathForEPubWithPackageID(const string &packageID) const
 }
 void Library::AddPublicationsInContainer(shared_ptr<Container> container, const string& path)
 {
-    // store the container
+    std::lock_guard<std::mutex> _(_lock);
+    
+    // store the container, unless it's known but not yet loaded
     auto existing = _containers.find(path);
-    if ( existing == _containers.end() )
+    if ( existing == _containers.end() || !existing->second )
         _containers[path] = container;
     
     for ( auto pkg : container->Packages() )
     {
+        // fill in packages which were only known by path
+        auto found = _packages.find(pkg->UniqueID());
+        if ( found != _packages.end() )
+        {
+            if ( !found->second.second && found->second.first == path )
+                found->second.second = pkg;
+            continue;
+        }
+        
 #if EPUB_HAVE(CXX_MAP_EMPLACE)
         _packages.emplace(pkg->UniqueID(), LookupEntry(std::make_pair(path, pkg)));
 #else
@@ -134,12 +162,147 @@ void Library::AddPublicationsInContainer(shared_ptr<Container> container, const
 #endif
     }
 }
+void Library::AddPackageSummaries(const PackageSummary::SummaryList& packages)
+{
+    std::lock_guard<std::mutex> _(_lock);
+    for ( auto& summary : packages )
+    {
+        if ( summary.uniqueID.empty() )
+            continue;
+        
+        // like Load(): the container is opened when one of its packages is wanted
+        if ( _containers.find(summary.containerPath) == _containers.end() )
+            _containers[summary.containerPath] = nullptr;
+        
+#if EPUB_HAVE(CXX_MAP_EMPLACE)
+        _packages.emplace(summary.uniqueID, LookupEntry(std::make_pair(summary.containerPath, nullptr)));
+#else
+        if ( _packages.find(summary.uniqueID) == _packages.end() )
+            _packages[summary.uniqueID] = LookupEntry({summary.containerPath, nullptr});
+#endif
+    }
+}
 void Library::AddPublicationsInContainerAtPath(const ePub3::string &path)
 {
     ContainerPtr p = Container::OpenContainer(path);
     if ( p )
         AddPublicationsInContainer(p, path);
 }
+std::future<void> Library::AddPublicationsAtPaths(const std::vector<string>& paths, IngestHandler handler, size_t maxConcurrent)
+{
+    struct Batch
+    {
+        std::vector<string>     paths;
+        IngestHandler           handler;
+        std::atomic<size_t>     next;
+        std::atomic<size_t>     running;
+        std::mutex              handlerLock;
+        std::promise<void>      done;
+    };
+    
+    auto batch = std::make_shared<Batch>();
+    batch->paths = paths;
+    batch->handler = handler;
+    batch->next = 0;
+    
+    std::future<void> result = batch->done.get_future();
+    if ( paths.empty() )
+    {
+        batch->done.set_value();
+        return result;
+    }
+    
+    if ( maxConcurrent == 0 )
+        maxConcurrent = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t numWorkers = std::min(maxConcurrent, paths.size());
+    batch->running = numWorkers;
+    
+    {
+        std::lock_guard<std::mutex> _(_ingestLock);
+        ++_ingestsRunning;
+    }
+    
+#if EPUB_USE(LIBXML2)
+    // libxml2's global state must be set up before it's used from several threads
+    xmlInitParser();
+#endif
+    
+    // each worker takes the next unclaimed path until there are none left
+    auto worker = [this, batch]() {
+        for ( size_t i = batch->next++; i < batch->paths.size(); i = batch->next++ )
+        {
+            const string& path = batch->paths[i];
+            PackageSummary::SummaryList packages;
+            std::exception_ptr error;
+            try
+            {
+                packages = PackageSummary::ReadContainerAtPath(path);
+                AddPackageSummaries(packages);
+            }
+            catch (...)
+            {
+                packages.clear();
+                error = std::current_exception();
+            }
+            
+            if ( batch->handler )
+            {
+                std::lock_guard<std::mutex> _(batch->handlerLock);
+                try
+                {
+                    batch->handler(path, packages, error);
+                }
+                catch (...)
+                {
+                    // a misbehaving handler mustn't stop the batch
+                }
+            }
+        }
+        
+        if ( --batch->running == 0 )
+        {
+            batch->done.set_value();
+            IngestFinished();
+        }
+    };
+    
+#if FUTURE_ENABLED
+    static std::once_flag __once;
+    static std::unique_ptr<thread_pool> __ingestThreadPool;
+    std::call_once(__once, [](){
+        __ingestThreadPool.reset(new thread_pool(thread_pool::Automatic));
+    });
+#endif
+    
+    for ( size_t i = 0; i < numWorkers; i++ )
+    {
+        try
+        {
+#if FUTURE_ENABLED
+            __ingestThreadPool->add(worker);
+#else
+            std::thread(worker).detach();
+#endif
+        }
+        catch (...)
+        {
+            // the workers already started take the remaining paths between them
+            if ( i == 0 )
+            {
+                batch->done.set_exception(std::current_exception());
+                IngestFinished();
+            }
+            else if ( (batch->running -= numWorkers - i) == 0 )
+            {
+                batch->done.set_value();
+                IngestFinished();
+            }
+            break;
+        }
+    }
+    
+    return result;
+}
 IRI Library::EPubURLForPublication(shared_ptr<Package> package) const
 {
     return EPubURLForPublicationID(package->UniqueID());
@@ -155,16 +318,27 @@ shared_ptr<Package> Library::PackageForEPubURL(const IRI &url, bool allowLoad)
         return nullptr;
     
     string ident = url.Host();
-    auto entry = _packages.find(ident);
-    if ( entry == _packages.end() )
-        return nullptr;
-    
-    if ( entry->second.second != nullptr || !allowLoad )
-        return entry->second.second;
+    string path;
+    {
+        std::lock_guard<std::mutex> _(_lock);
+        auto entry = _packages.find(ident);
+        if ( entry == _packages.end() )
+            return nullptr;
+        
+        if ( entry->second.second != nullptr || !allowLoad )
+            return entry->second.second;
+        
+        path = entry->second.first;
+    }
     
-    AddPublicationsInContainerAtPath(entry->second.first);
+    // don't hold the lock while the container is opened
+    AddPublicationsInContainerAtPath(path);
     
     // returns a package ptr or nullptr
+    std::lock_guard<std::mutex> _(_lock);
+    auto entry = _packages.find(ident);
+    if ( entry == _packages.end() )
+        return nullptr;
     return entry->second.second;
 }
 IRI Library::EPubCFIURLForManifestItem(ManifestItemPtr item) const
@@ -206,9 +380,35 @@ unique_ptr<ByteStream> Library::ReadStreamForEPubURL(const IRI &url, CFI *pRemai
 }
 bool Library::WriteToFile(const string& path) const
 {
+    ContainerLookup containers;
+    std::map<string, std::vector<EPubIdentifier>> unloaded;
+    {
+        std::lock_guard<std::mutex> _(_lock);
+        containers = _containers;
+        for ( auto& pair : _packages )
+        {
+            if ( !pair.second.second )
+                unloaded[pair.second.first].push_back(pair.first);
+        }
+    }
+    
     std::ofstream stream(path.stl_str());
-    for ( auto item : _containers )
+    for ( auto item : containers )
     {
+        // containers which were never opened are written out from their known packages
+        auto known = unloaded.find(item.first);
+        if ( !item.second && known != unloaded.end() )
+        {
+            stream << item.first;
+            for ( auto& uid : known->second )
+            {
+                stream << "," << uid;
+            }
+            
+            stream << std::endl;
+            continue;
+        }
+        
         // works like an auto_ptr, scoping the allocation
         ContainerPtr pContainer = item.second;
         
@@ -34,9 +34,15 @@
 #include <ePub3/container.h>
 #include <ePub3/package.h>
 #include <ePub3/cfi.h>
+#include <ePub3/package_summary.h>
 #include <ePub3/utilities/utfstring.h>
 #include <ePub3/utilities/byte_stream.h>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
 #include <map>
+#include <mutex>
 
 EPUB3_BEGIN_NAMESPACE
 
@@ -66,10 +72,18 @@ class Library
 public:
     typedef string      EPubIdentifier;
     
+    /**
+     Receives the outcome of reading one EPUB file in AddPublicationsAtPaths().
+     @param path The path of the EPUB file.
+     @param packages A summary of each package found in it; empty on failure.
+     @param error The exception which prevented the file being read, if any.
+     */
+    typedef std::function<void(const string& path, const PackageSummary::SummaryList& packages, std::exception_ptr error)> IngestHandler;
+    
 protected:
-                        Library() : _containers(), _packages() {}
-                        Library(const Library& o) : _containers(o._containers), _packages(o._packages) {}
-                        Library(Library&& o) : _containers(std::move(o._containers)), _packages(std::move(o._packages)) {}
+                        Library() : _containers(), _packages(), _ingestsRunning(0) {}
+                        Library(const Library& o) : _containers(o._containers), _packages(o._packages), _ingestsRunning(0) {}
+                        Library(Library&& o) : _containers(std::move(o._containers)), _packages(std::move(o._packages)), _ingestsRunning(0) {}
     
     // load a library from a file generated using WriteToFile()
     EPUB3_EXPORT        Library(const string& path);
@@ -92,6 +106,26 @@ public:
     EPUB3_EXPORT
     void                AddPublicationsInContainerAtPath(const string& path);
     
+    /**
+     Registers the publications in many EPUB files without opening their containers.
+     
+     Each file is read with PackageSummary::ReadContainerAtPath() on a background
+     thread, at most `maxConcurrent` at a time, and its packages are registered by
+     unique ID and path; their containers are opened on demand, as for a library
+     loaded from a file. This returns at once.
+     @param paths The EPUB files to add.
+     @param handler Called once for each file as it is finished with, in no particular
+     order. Calls are never concurrent. May be `nullptr`.
+     @param maxConcurrent The most files read at the same time; `0` means one per
+     hardware thread.
+     @result A future which becomes ready once every file has been handled, or
+     which holds the exception if no background thread could be started. The
+     library's destructor waits for any files still being read, so it must not be
+     destroyed from within `handler`.
+     */
+    EPUB3_EXPORT
+    std::future<void>   AddPublicationsAtPaths(const std::vector<string>& paths, IngestHandler handler=nullptr, size_t maxConcurrent=0);
+    
     // returns an epub3:// url for the package with a given identifier
     EPUB3_EXPORT
     IRI                 EPubURLForPublication(shared_ptr<Package> package)       const;
@@ -130,6 +164,24 @@ protected:
     ContainerLookup                 _containers;
     PackageLookup                   _packages;
     
+    ///
+    /// Guards _containers and _packages, which background ingestion writes to.
+    mutable std::mutex              _lock;
+    
+    ///
+    /// The number of AddPublicationsAtPaths() calls whose workers haven't all finished.
+    size_t                          _ingestsRunning;
+    std::mutex                      _ingestLock;
+    std::condition_variable         _ingestFinished;
+    
+    ///
+    /// Called once the workers of an AddPublicationsAtPaths() call have all finished.
+    void                IngestFinished();
+    
+    ///
+    /// Records the publications in a container which hasn't been opened.
+    void                AddPackageSummaries(const PackageSummary::SummaryList& packages);
+    
     static unique_ptr<Library>      _singleton;
 };
 
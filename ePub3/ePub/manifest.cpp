@@ -31,6 +31,7 @@
 #include "package.h"
 #include "byte_stream.h"
 #include "container.h"
+#include "document_cache.h"
 #include "ePub3/xml/document.h"
 #include REGEX_INCLUDE
 #include <sstream>
@@ -162,10 +163,10 @@ string ItemProperties::str() const
     return builder.str();
 }
 
-ManifestItem::ManifestItem(const shared_ptr<Package>& owner) : OwnedBy(owner), PropertyHolder(owner), _href(), _mediaType(), _mediaOverlayID(), _fallbackID(), _parsedProperties(0)
+ManifestItem::ManifestItem(const shared_ptr<Package>& owner) : OwnedBy(owner), PropertyHolder(owner), _href(), _mediaType(), _mediaOverlayID(), _fallbackID(), _parsedProperties(0), _encryptionInfo(), _filterPlan()
 {
 }
-ManifestItem::ManifestItem(ManifestItem&& o) : OwnedBy(std::move(o)), PropertyHolder(std::move(o)), XMLIdentifiable(std::move(o)), _href(std::move(o._href)), _mediaType(std::move(o._mediaType)), _mediaOverlayID(std::move(o._mediaOverlayID)), _fallbackID(std::move(o._fallbackID)), _parsedProperties(std::move(o._parsedProperties))
+ManifestItem::ManifestItem(ManifestItem&& o) : OwnedBy(std::move(o)), PropertyHolder(std::move(o)), XMLIdentifiable(std::move(o)), _href(std::move(o._href)), _mediaType(std::move(o._mediaType)), _mediaOverlayID(std::move(o._mediaOverlayID)), _fallbackID(std::move(o._fallbackID)), _parsedProperties(std::move(o._parsedProperties)), _encryptionInfo(std::move(o._encryptionInfo)), _filterPlan(std::move(o._filterPlan))
 {
 }
 ManifestItem::~ManifestItem()
@@ -232,13 +233,22 @@ bool ManifestItem::HasProperty(const std::vector<IRI>& properties) const
 }
 EncryptionInfoPtr ManifestItem::GetEncryptionInfo() const
 {
+    // filter type sniffers ask for every item, every time a stream is opened, but a
+    // container's encryption.xml is always loaded before its packages are unpacked
+    auto cached = std::atomic_load(&_encryptionInfo);
+    if ( cached )
+        return *cached;
+    
     ContainerPtr container = GetPackage()->GetContainer();
     string abs = AbsolutePath();
     if (abs.at(0) == '/')
     {
         abs = abs.substr(1, abs.length()-1);
     }
-    return container->EncryptionInfoForPath(abs);
+    
+    auto result = std::make_shared<const EncryptionInfoPtr>(container->EncryptionInfoForPath(abs));
+    std::atomic_store(&_encryptionInfo, result);
+    return *result;
 }
 bool ManifestItem::CanLoadDocument() const
 {
@@ -264,40 +274,54 @@ shared_ptr<xml::Document> ManifestItem::ReferencedDocument() const
     if (!manifestRef)
         return nullptr;
 	
-    shared_ptr<ByteStream> byteStream = package->GetFilterChainByteStream(manifestRef);
-    if (!byteStream)
-        return nullptr;
-	
-	void *docBuf = nullptr;
-	std::size_t resbuflen = byteStream->ReadAllBytes(&docBuf);
-	
-    // In some EPUBs, UTF-8 XML/HTML files have a superfluous (erroneous?) BOM, so we either:
-    // pass "utf-8" and expect InputBuffer::read_cb (in io.cpp) to skip the 3 erroneous bytes
-    // (otherwise the XML parser fails),
-    // or we pass NULL (in which case the parser auto-detects encoding)
-    const char * encoding = nullptr;
-    //const char * encoding = "utf-8";
-
-//    std::string fileContents ((char*)docBuf, resbuflen);
-
-	xmlDocPtr raw;
-    if ( _mediaType == "text/html" ) {
-        raw = htmlReadMemory((const char*)docBuf, resbuflen, path.c_str(), encoding, ArchiveXmlReader::DEFAULT_OPTIONS);
-    } else {
-        raw = xmlReadMemory((const char*)docBuf, resbuflen, path.c_str(), encoding, ArchiveXmlReader::DEFAULT_OPTIONS);
-    }
-
-    if (docBuf)
-        free(docBuf);
-
-    if (!bool(raw) || (raw->type != XML_HTML_DOCUMENT_NODE && raw->type != XML_DOCUMENT_NODE) || !bool(raw->children)) {
-        if (bool(raw)) {
-            xmlFreeDoc(raw);
+    auto load = [&]() -> shared_ptr<xml::Document> {
+        shared_ptr<ByteStream> byteStream = package->GetFilterChainByteStream(manifestRef);
+        if (!byteStream)
+            return nullptr;
+        
+        // In some EPUBs, UTF-8 XML/HTML files have a superfluous (erroneous?) BOM, so we either:
+        // pass "utf-8" and expect InputBuffer::read_cb (in io.cpp) to skip the 3 erroneous bytes
+        // (otherwise the XML parser fails),
+        // or we pass NULL (in which case the parser auto-detects encoding)
+        const char * encoding = nullptr;
+        //const char * encoding = "utf-8";
+        
+#if !ENABLE_XML_READ_DOC_MEMORY
+        // push the filtered bytes into the parser as they come, rather than gathering
+        // the whole document up first: large navigation documents stay cheap, and the
+        // parser runs interleaved with decompression & decryption
+        ByteStreamXmlReader reader(byteStream);
+        return reader.readDocument(path.c_str(), encoding, _mediaType == "text/html");
+#else
+        void *docBuf = nullptr;
+        std::size_t resbuflen = byteStream->ReadAllBytes(&docBuf);
+        
+        xmlDocPtr raw;
+        if ( _mediaType == "text/html" ) {
+            raw = htmlReadMemory((const char*)docBuf, resbuflen, path.c_str(), encoding, ArchiveXmlReader::DEFAULT_OPTIONS);
+        } else {
+            raw = xmlReadMemory((const char*)docBuf, resbuflen, path.c_str(), encoding, ArchiveXmlReader::DEFAULT_OPTIONS);
         }
-        return nullptr;
-    }
-
-    result = xml::Wrapped<xml::Document>(raw);
+        
+        if (docBuf)
+            free(docBuf);
+        
+        if (!bool(raw) || (raw->type != XML_HTML_DOCUMENT_NODE && raw->type != XML_DOCUMENT_NODE) || !bool(raw->children)) {
+            if (bool(raw)) {
+                xmlFreeDoc(raw);
+            }
+            return nullptr;
+        }
+        
+        return xml::Wrapped<xml::Document>(raw);
+#endif //!ENABLE_XML_READ_DOC_MEMORY
+    };
+    
+    // filtered (e.g. decrypted) content mustn't outlive the filters which produced it
+    if ( package->GetFilterChainSize(manifestRef) == 0 )
+        result = DocumentCache::Shared().DocumentAtPath(package->Archive()->Path(), AbsolutePath(), load);
+    else
+        result = load();
 
 
 #elif EPUB_USE(WIN_XML)
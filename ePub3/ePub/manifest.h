@@ -44,6 +44,7 @@ class Package;
 class ManifestItem;
 class ArchiveReader;
 class ByteStream;
+struct FilterChainPlan;
 
 #ifdef SUPPORT_ASYNC
 class AsyncByteStream;
@@ -325,7 +326,7 @@ public:
     EPUB3_EXPORT
     bool                        HasProperty(const std::vector<IRI>& properties)  const;
     
-    // fetch any relevant encryption information
+    // fetch any relevant encryption information; looked up once, then remembered
     EncryptionInfoPtr           GetEncryptionInfo()                 const;
 
 	bool						CanLoadDocument()					const;
@@ -349,6 +350,16 @@ protected:
     string                  _mediaOverlayID;
     string                  _fallbackID;
     ItemProperties          _parsedProperties;
+    
+    ///
+    /// The result of GetEncryptionInfo(), which may itself be `nullptr`. Swapped atomically.
+    mutable shared_ptr<const EncryptionInfoPtr> _encryptionInfo;
+    ///
+    /// The filters which apply to this item, as worked out by FilterChain::PlanForManifestItem().
+    mutable shared_ptr<const FilterChainPlan>   _filterPlan;
+    
+    friend class PackageSnapshot;
+    friend class FilterChain;
 };
 
 EPUB3_END_NAMESPACE
@@ -0,0 +1,113 @@
+//
+//  markup_scanner.cpp
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this
+//  list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//  this list of conditions and the following disclaimer in the documentation and/or
+//  other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be
+//  used to endorse or promote products derived from this software without specific
+//  prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+//  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+//  OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+//  OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "markup_scanner.h"
+
+EPUB3_BEGIN_NAMESPACE
+
+static inline char AsciiLower(char c)
+{
+    return (c >= 'A' && c <= 'Z' ? char(c + ('a' - 'A')) : c);
+}
+
+const char* MarkupScanner::SkipSpace(const char* p, const char* end)
+{
+    while ( p < end && IsSpace(*p) )
+        ++p;
+    return p;
+}
+MarkupScanner::Match MarkupScanner::MatchLiteral(const char* p, const char* end, const char* literal, size_t literalLen, bool ignoreCase)
+{
+    for ( size_t i = 0; i < literalLen; i++ )
+    {
+        if ( p + i >= end )
+            return Match::None;
+        if ( p[i] != literal[i] && !(ignoreCase && AsciiLower(p[i]) == AsciiLower(literal[i])) )
+            return Match::None;
+    }
+    return Match::Found;
+}
+const char* MarkupScanner::FindLiteral(const char* p, const char* end, const char* literal, size_t literalLen, bool ignoreCase)
+{
+    if ( literalLen == 0 )
+        return p;
+    
+    char first = AsciiLower(literal[0]);
+    if ( !ignoreCase || first < 'a' || first > 'z' )
+    {
+        first = literal[0];
+        // the first byte has only one form, so let memchr() find the candidates
+        for ( p = FindChar(p, end, first); size_t(end - p) >= literalLen; p = FindChar(p + 1, end, first) )
+        {
+            if ( MatchLiteral(p, end, literal, literalLen, ignoreCase) == Match::Found )
+                return p;
+        }
+        return end;
+    }
+    
+    for ( ; size_t(end - p) >= literalLen; ++p )
+    {
+        if ( AsciiLower(*p) == first && MatchLiteral(p, end, literal, literalLen, true) == Match::Found )
+            return p;
+    }
+    return end;
+}
+bool MarkupScanner::Scan(const char* data, size_t len, std::string& output)
+{
+    bool changed = false;
+    const char* p = data;
+    const char* end = data + len;
+    for ( ;; )
+    {
+        const char* q = FindLiteral(p, end, _trigger, _triggerLen, _ignoreCase);
+        output.append(p, q - p);
+        if ( q == end )
+            return changed;
+        
+        const char* matchEnd = nullptr;
+        switch ( MatchConstruct(q, end, &matchEnd, output) )
+        {
+            case Match::Found:
+                changed = true;
+                p = matchEnd;
+                break;
+                
+            case Match::None:
+                output.push_back(*q);
+                p = q + 1;
+                break;
+                
+            case Match::NoneFollowing:
+                output.append(q, end - q);
+                return changed;
+        }
+    }
+}
+
+EPUB3_END_NAMESPACE
@@ -0,0 +1,133 @@
+//
+//  markup_scanner.h
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this
+//  list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//  this list of conditions and the following disclaimer in the documentation and/or
+//  other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be
+//  used to endorse or promote products derived from this software without specific
+//  prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+//  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+//  OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+//  OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef __ePub3__markup_scanner__
+#define __ePub3__markup_scanner__
+
+#include <ePub3/epub3.h>
+#include <cstring>
+#include <string>
+
+EPUB3_BEGIN_NAMESPACE
+
+/**
+ The base of the hand-written scanners used by the content filters which rewrite
+ markup, such as SwitchPreprocessor and ObjectPreprocessor.
+ 
+ A scanner looks for a fixed *trigger* string (e.g. `<object`) using `memchr()`,
+ which the C library vectorizes, and hands each occurrence to MatchConstruct() to
+ decide whether a complete construct starts there. Everything else is copied to the
+ output untouched.
+ 
+ A scanner works on a complete resource at a time, and keeps no state between
+ calls to Scan().
+ @ingroup filters
+ */
+class MarkupScanner
+{
+public:
+    ///
+    /// The outcome of trying to match a construct.
+    enum class Match
+    {
+        None,           ///< No construct starts here; carry on from the next byte.
+        Found,          ///< A construct was matched and its replacement written.
+        NoneFollowing   ///< Nothing here or anywhere after it can match.
+    };
+    
+    /**
+     Creates a scanner.
+     @param trigger The string with which every construct starts. Must outlive the scanner.
+     @param ignoreCase Whether the trigger is matched regardless of ASCII case.
+     */
+    MarkupScanner(const char* trigger, bool ignoreCase) : _trigger(trigger), _triggerLen(std::strlen(trigger)), _ignoreCase(ignoreCase) {}
+    virtual ~MarkupScanner() {}
+    
+    /**
+     Scans a complete resource.
+     @param data The resource's bytes.
+     @param len The number of bytes in `data`.
+     @param output The filtered bytes are appended to this string.
+     @result `true` if any construct was replaced, i.e. if the bytes appended differ
+     from `data`.
+     */
+    bool            Scan(const char* data, size_t len, std::string& output);
+    
+    ///
+    /// Whether an ASCII character is whitespace, as matched by `\s` in a regex.
+    static bool     IsSpace(char c)                             { return c == ' ' || (c >= '\t' && c <= '\r'); }
+    
+    ///
+    /// Returns the first non-whitespace character at or after `p`, or `end`.
+    static const char* SkipSpace(const char* p, const char* end);
+    
+    /**
+     Returns the first occurrence of a character at or after `p`, or `end`.
+     */
+    static const char* FindChar(const char* p, const char* end, char c)
+    {
+        const void* found = (p < end ? std::memchr(p, c, end - p) : nullptr);
+        return (found != nullptr ? reinterpret_cast<const char*>(found) : end);
+    }
+    
+    /**
+     Returns the first complete occurrence of a string at or after `p`, or `end`.
+     @param ignoreCase Whether to match regardless of ASCII case.
+     */
+    static const char* FindLiteral(const char* p, const char* end, const char* literal, size_t literalLen, bool ignoreCase);
+    
+    /**
+     Compares the bytes at `p` against a string.
+     @result Match::Found, or Match::None if the bytes differ or `end` comes first.
+     */
+    static Match    MatchLiteral(const char* p, const char* end, const char* literal, size_t literalLen, bool ignoreCase);
+    
+protected:
+    /**
+     Tries to match a construct at an occurrence of the trigger.
+     @param begin The start of the trigger.
+     @param end The end of the resource.
+     @param matchEnd On Match::Found, set to the end of the construct.
+     @param output On Match::Found, the construct's replacement is appended to this.
+     @result How the attempt went. Scanners whose constructs end at the first
+     occurrence of something return Match::NoneFollowing when the resource ends
+     before a construct is complete, since one starting later couldn't be either.
+     */
+    virtual Match   MatchConstruct(const char* begin, const char* end, const char** matchEnd, std::string& output) = 0;
+    
+private:
+    const char*     _trigger;
+    size_t          _triggerLen;
+    bool            _ignoreCase;
+    
+};
+
+EPUB3_END_NAMESPACE
+
+#endif /* defined(__ePub3__markup_scanner__) */
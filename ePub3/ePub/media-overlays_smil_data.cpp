@@ -38,6 +38,68 @@ SMILData::~SMILData()
     //
 }
 
+void SMILData::IndexTimeline()
+{
+    _parallels.clear();
+    _timedParallels.clear();
+    _timedParallelEnds.clear();
+    _clipOffsets.clear();
+    _calculatedDuration = 0;
+    _timelineIndexed = false;
+
+    if (_root == nullptr)
+    {
+        return;
+    }
+
+    ManifestItemPtr xhtmlItem = (_spineItem == nullptr ? nullptr : _spineItem->ManifestItem());
+
+    // same walk as Sequence::ParallelAt() and friends, done once
+    uint32_t offset = 0;
+    IndexSequence(*_root, xhtmlItem, offset);
+
+    _calculatedDuration = offset;
+    _timelineIndexed = true;
+}
+
+void SMILData::IndexSequence(const Sequence & sequence, const ManifestItemPtr & xhtmlItem, uint32_t & offset)
+{
+    for (auto & container : sequence._children)
+    {
+        if (container->IsParallel())
+        {
+            auto para = std::dynamic_pointer_cast<const Parallel>(container);
+            _parallels.push_back(para);
+            _clipOffsets.emplace(para.get(), offset);
+
+            if (para->Audio() == nullptr)
+            {
+                continue;
+            }
+
+            // audio for text outside this SMIL's spine item doesn't count towards its timeline
+            if (para->Text() != nullptr && para->Text()->SrcManifestItem() != nullptr && para->Text()->SrcManifestItem() != xhtmlItem)
+            {
+                continue;
+            }
+
+            uint32_t clipDur = para->Audio()->ClipDurationMilliseconds();
+            offset += clipDur;
+
+            // zero-length clips can never be found by time
+            if (clipDur > 0)
+            {
+                _timedParallels.push_back(para);
+                _timedParallelEnds.push_back(offset);
+            }
+        }
+        else if (container->IsSequence())
+        {
+            IndexSequence(*std::dynamic_pointer_cast<const Sequence>(container), xhtmlItem, offset);
+        }
+    }
+}
+
 const string & SMILData::TimeNode::Name() const
 {
     throw std::runtime_error("TimeNode Name()");
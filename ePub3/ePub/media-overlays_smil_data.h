@@ -34,6 +34,9 @@
 #include <ePub3/utilities/owned_by.h>
 #include <ePub3/manifest.h>
 #include <ePub3/spine.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 EPUB3_BEGIN_NAMESPACE
 
@@ -675,6 +678,24 @@ EPUB3_BEGIN_NAMESPACE
 
             shared_ptr<Sequence> _root;
 
+            // A flattened copy of the timeline under _root, built by IndexTimeline() once the tree is
+            // complete. Until then the lookups below walk the tree.
+            bool _timelineIndexed;
+
+            shared_vector<const Parallel> _parallels; // every 'par', in document order
+
+            shared_vector<const Parallel> _timedParallels; // the 'par's that take up playback time
+
+            std::vector<uint32_t> _timedParallelEnds; // the end of each of _timedParallels on this SMIL's timeline
+
+            std::unordered_map<const Parallel *, uint32_t> _clipOffsets; // the start of each 'par' on this SMIL's timeline
+
+            uint32_t _calculatedDuration;
+
+            void IndexTimeline();
+
+            void IndexSequence(const Sequence & sequence, const ManifestItemPtr & xhtmlItem, uint32_t & offset);
+
             shared_ptr<const Parallel> ParallelAt(uint32_t timeMilliseconds) const
             {
                 if (_root == nullptr)
@@ -682,7 +703,19 @@ EPUB3_BEGIN_NAMESPACE
                     return nullptr;
                 }
 
-                return _root->ParallelAt(timeMilliseconds);
+                if (!_timelineIndexed)
+                {
+                    return _root->ParallelAt(timeMilliseconds);
+                }
+
+                // the first 'par' still playing at that time (i.e. the earlier one, at a boundary)
+                auto pos = std::lower_bound(_timedParallelEnds.begin(), _timedParallelEnds.end(), timeMilliseconds);
+                if (pos == _timedParallelEnds.end())
+                {
+                    return nullptr;
+                }
+
+                return _timedParallels[pos - _timedParallelEnds.begin()];
             }
 
             shared_ptr<const Parallel> NthParallel(uint32_t index) const
@@ -692,6 +725,11 @@ EPUB3_BEGIN_NAMESPACE
                     return nullptr;
                 }
 
+                if (_timelineIndexed)
+                {
+                    return index < _parallels.size() ? _parallels[index] : nullptr;
+                }
+
                 uint32_t count = -1;
                 return _root->NthParallel(index, count);
             }
@@ -703,6 +741,12 @@ EPUB3_BEGIN_NAMESPACE
                     return 0;
                 }
 
+                if (_timelineIndexed)
+                {
+                    auto found = _clipOffsets.find(par.get());
+                    return found == _clipOffsets.end() ? 0 : found->second;
+                }
+
                 uint32_t offset = 0;
                 if (_root->ClipOffset(offset, par))
                 {
@@ -719,7 +763,7 @@ EPUB3_BEGIN_NAMESPACE
 #if EPUB_PLATFORM(WINRT)
                 NativeBridge(),
 #endif
-                _manifestItem(manifestItem), _spineItem(spineItem), _duration(duration), _root(nullptr)
+                _manifestItem(manifestItem), _spineItem(spineItem), _duration(duration), _root(nullptr), _timelineIndexed(false), _calculatedDuration(0)
             {
                 //printf("SMILData(%s)\n", manifestItem->Href().c_str());
             }
@@ -769,6 +813,11 @@ EPUB3_BEGIN_NAMESPACE
                     return 0;
                 }
 
+                if (_timelineIndexed)
+                {
+                    return _calculatedDuration;
+                }
+
                 return _root->DurationMilliseconds();
             }
         };
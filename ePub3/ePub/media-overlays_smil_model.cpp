@@ -33,6 +33,11 @@
 #include <ePub3/media-overlays_smil_data.h>
 #include "error_handler.h"
 #include "xpath_wrangler.h"
+#if FUTURE_ENABLED
+#include <ePub3/utilities/executor.h>
+#endif //FUTURE_ENABLED
+#include <algorithm>
+#include <thread>
 
 
 //#include <iostream>
@@ -165,7 +170,7 @@ public:
             //printf("~MediaOverlaysSmilModel()\n");
         }
 
-        MediaOverlaysSmilModel::MediaOverlaysSmilModel(const std::shared_ptr<Package> & package) : OwnedBy(package), _totalDuration(0), _smilDatas(std::vector<std::shared_ptr<SMILData>>())
+        MediaOverlaysSmilModel::MediaOverlaysSmilModel(const std::shared_ptr<Package> & package) : OwnedBy(package), _totalDuration(0), _smilDatas(std::vector<std::shared_ptr<SMILData>>()), _smilParsed(), _smilParsers(), _smilParseErrors(), _smilParseExceptions(), _smilDurations(), _allSmilsParsed(false)
         {
         }
 
@@ -183,31 +188,39 @@ public:
 
             //_smilDatas.erase(_smilDatas.begin(), _smilDatas.end());
             _smilDatas.clear();
+
+            std::lock_guard<std::mutex> lock(_parseLock);
+            _smilParsed.clear();
+            _smilParsers.clear();
+            _smilParseErrors.clear();
+            _smilParseExceptions.clear();
+            _smilDurations.clear();
+            _smilOffsets.clear();
+            _cache_manifestItemToAbsolutePath.clear();
+            _allSmilsParsed = false;
         }
 
         void MediaOverlaysSmilModel::populateData()
         {
+            // Only the OPF metadata is read here; the SMIL documents themselves are parsed the first
+            // time they're needed (see ensureSmilParsed()), and the total duration is checked against
+            // the metadata once all of them have been.
             parseMetadata();
 
-            uint32_t totalDurationFromSMILs = parseSMILs();
-
-            if (_totalDuration != totalDurationFromSMILs)
-            {
-                std::stringstream s;
-                s << "Media Overlays total duration mismatch (milliseconds): METADATA " << (long) _totalDuration << " != SMILs " << (long) totalDurationFromSMILs;
-                const std::string & str = _Str(s.str());
-                //printf("%s\n", str.c_str());
-
-                //_totalDuration = totalDurationFromSMILs;
-
-                HandleError(EPUBError::MediaOverlayMismatchDurationMetadata, str);
-            }
-            else
+            std::lock_guard<std::mutex> lock(_parseLock);
+            _smilParsed.assign(_smilDatas.size(), false);
+            _smilParsers.assign(_smilDatas.size(), std::thread::id());
+            _smilParseErrors.assign(_smilDatas.size(), string());
+            _smilParseExceptions.assign(_smilDatas.size(), std::exception_ptr());
+            _smilDurations.assign(_smilDatas.size(), 0);
+            for (shared_vector<SMILData>::size_type i = 0; i < _smilDatas.size(); i++)
             {
-                //printf("Media Overlays SMILs parsed, total duration checked okay (milliseconds): %ld\n", (long) totalDurationFromSMILs);
+                // placeholders for spine items without a media overlay are built complete
+                if (_smilDatas[i]->SmilManifestItem() == nullptr)
+                {
+                    _smilParsed[i] = true;
+                }
             }
-
-            //debugSmilData(_smilDatas);
         }
 
         void MediaOverlaysSmilModel::parseMetadata()
@@ -371,196 +384,316 @@ public:
 					sequence->_children.push_back(par);
 
                     par->_text = std::make_shared<SMILData::Text>(par, data->XhtmlSpineItem()->ManifestItem()->Href(), "", nullptr, data);
+
+                    data->IndexTimeline();
                 });
             }
         }
 
-        uint32_t MediaOverlaysSmilModel::parseSMILs()
-        {       
-            std::shared_ptr<Package> package = Owner(); // internally: std::weak_ptr<Package>.lock()
-            if (package == nullptr)
+        uint32_t MediaOverlaysSmilModel::parseSMILData(SMILDataPtr smilData)
+        {
+            ManifestItemPtr item = smilData->SmilManifestItem();
+            if (item == nullptr)
             {
                 return 0;
             }
 
-//Timer timer;
-            //uint counter = 0;
+            //printf("Media Overlays SMIL PARSING: %s\n", item->Href().c_str());
 
-            std::map<std::shared_ptr<ManifestItem>, string> cache_manifestItemToAbsolutePath;
+            //unique_ptr<ArchiveXmlReader> xmlReader = package->XmlReaderForRelativePath(item->Href());
+            shared_ptr<xml::Document> doc = item->ReferencedDocument();
+            if (!bool(doc))
+            {
+                HandleError(EPUBError::MediaOverlayCannotParseSMILXML, _Str("Cannot parse XML: ", item->Href().c_str()));
+                return 0;
+            }
 
-            uint32_t accumulatedDurationMilliseconds = 0;
+#if EPUB_COMPILER_SUPPORTS(CXX_INITIALIZER_LISTS)
+            XPathWrangler xpath(doc, {{"epub", ePub3NamespaceURI}, {"smil", SMILNamespaceURI}});
+#else
+            XPathWrangler::NamespaceList __ns;
+            __ns["epub"] = ePub3NamespaceURI;
+            __ns["smil"] = SMILNamespaceURI;
+            XPathWrangler xpath(doc, __ns);
+#endif
+            xpath.NameDefaultNamespace("smil");
 
+            xml::NodeSet nodes = xpath.Nodes("/smil:smil");
 
-            shared_ptr<SpineItem> spineItem = package->FirstSpineItem();
-            while (spineItem != nullptr)
+            if (nodes.empty())
             {
-                ManifestItemPtr item = spineItem->ManifestItem();
+                HandleError(EPUBError::MediaOverlayInvalidRootElement, _Str("'smil' root element not found: ", item->Href().c_str()));
+            }
+            else if (nodes.size() > 1)
+            {
+                HandleError(EPUBError::MediaOverlayInvalidRootElement, _Str("Multiple 'smil' root elements found: ", item->Href().c_str()));
+            }
 
-                //string
-                //const ManifestItem::MimeType & mediaType = item->MediaType();
-                //if (mediaType != "application/smil+xml")
+            if (nodes.size() != 1)
+                return 0;
 
-                //const string & mediaOverlayID = item->MediaOverlayID();
-                //printf("--- Media Overlays ID: %s\n", mediaOverlayID.c_str());
-                item = item->MediaOverlay();
-                if (item == nullptr)
-                {
-                    spineItem = spineItem->Next();
-                    continue;
-                }
+            shared_ptr<xml::Node> smil = nodes[0];
 
-//                counter++;
-//                if (counter > 10)
-//                {
-//                    break;
-//                }
+            string version = _getProp(smil, "version", SMILNamespaceURI);
+            if (version.empty())
+            {
+                HandleError(EPUBError::MediaOverlayVersionMissing, _Str("SMIL version not found: ", item->Href().c_str()));
+            }
+            else if (version != "3.0")
+            {
+                HandleError(EPUBError::MediaOverlayInvalidVersion, _Str("Invalid SMIL version (", version, "): ", item->Href().c_str()));
+            }
 
-                //printf("Media Overlays SMIL PARSING: %s\n", item->Href().c_str());
+            nodes = xpath.Nodes("./smil:head", smil);
 
-                //unique_ptr<ArchiveXmlReader> xmlReader = package->XmlReaderForRelativePath(item->Href());
-                shared_ptr<xml::Document> doc = item->ReferencedDocument();
-                if (!bool(doc))
-                {
-                    HandleError(EPUBError::MediaOverlayCannotParseSMILXML, _Str("Cannot parse XML: ", item->Href().c_str()));
-                }
+            if (nodes.empty())
+            {
+                // OKAY
+            }
+            else if (nodes.size() == 1)
+            {
+                //TODO: check head placement
+                //HandleError(EPUBError::MediaOverlayHeadIncorrectlyPlaced, _Str("'head' element incorrectly placed: ", item->Href().c_str()));
+            }
+            else if (nodes.size() > 1)
+            {
+                HandleError(EPUBError::MediaOverlayHeadIncorrectlyPlaced, _Str("multiple 'head' elements found: ", item->Href().c_str()));
+                return 0;
+            }
 
-#if EPUB_COMPILER_SUPPORTS(CXX_INITIALIZER_LISTS)
-                XPathWrangler xpath(doc, {{"epub", ePub3NamespaceURI}, {"smil", SMILNamespaceURI}});
-#else
-                XPathWrangler::NamespaceList __ns;
-                __ns["epub"] = ePub3NamespaceURI;
-                __ns["smil"] = SMILNamespaceURI;
-                XPathWrangler xpath(doc, __ns);
-#endif
-                xpath.NameDefaultNamespace("smil");
+            nodes = xpath.Nodes("./smil:body", smil);
 
-                xml::NodeSet nodes = xpath.Nodes("/smil:smil");
+            if (nodes.empty())
+            {
+                HandleError(EPUBError::MediaOverlayNoBody, _Str("'body' element not found: ", item->Href().c_str()));
+            }
+            else if (nodes.size() > 1)
+            {
+                HandleError(EPUBError::MediaOverlayMultipleBodies, _Str("multiple 'body' elements found: ", item->Href().c_str()));
+            }
 
-                if (nodes.empty())
-                {
-                    HandleError(EPUBError::MediaOverlayInvalidRootElement, _Str("'smil' root element not found: ", item->Href().c_str()));
-                }
-                else if (nodes.size() > 1)
-                {
-                    HandleError(EPUBError::MediaOverlayInvalidRootElement, _Str("Multiple 'smil' root elements found: ", item->Href().c_str()));
-                }
+            if (nodes.size() != 1)
+            {
+                return 0;
+            }
 
-                if (nodes.size() != 1)
-                    return 0;
+            shared_ptr<xml::Node> body = nodes[0];
 
-                shared_ptr<xml::Node> smil = nodes[0];
+            std::map<string, std::shared_ptr<ManifestItem>> cache_smilRelativePathToManifestItem;
 
-                string version = _getProp(smil, "version", SMILNamespaceURI);
-                if (version.empty())
-                {
-                    HandleError(EPUBError::MediaOverlayVersionMissing, _Str("SMIL version not found: ", item->Href().c_str()));
-                }
-                else if (version != "3.0")
-                {
-                    HandleError(EPUBError::MediaOverlayInvalidVersion, _Str("Invalid SMIL version (", version, "): ", item->Href().c_str()));
-                }
+            uint32_t smilDur = parseSMIL(smilData, nullptr, nullptr, item, body, _cache_manifestItemToAbsolutePath, cache_smilRelativePathToManifestItem);
+            smilData->IndexTimeline();
+            //printf("Media Overlays SMIL DURATION (milliseconds): %ld\n", (long) smilDur);
 
-                nodes = xpath.Nodes("./smil:head", smil);
+            uint32_t metaDur = smilData->DurationMilliseconds_Metadata();
+            if (metaDur != smilDur)
+            {
+                std::stringstream s;
+                s << "Media Overlays SMIL duration mismatch (milliseconds): METADATA " << (long) metaDur << " != SMIL " << (long) smilDur << " (" << item->Href().c_str() << ")";
+                const std::string & str = _Str(s.str());
+                //printf("%s\n", str.c_str());
 
-                if (nodes.empty())
-                {
-                    // OKAY
-                }
-                else if (nodes.size() == 1)
-                {
-                    //TODO: check head placement
-                    //HandleError(EPUBError::MediaOverlayHeadIncorrectlyPlaced, _Str("'head' element incorrectly placed: ", item->Href().c_str()));
-                }
-                else if (nodes.size() > 1)
-                {
-                    HandleError(EPUBError::MediaOverlayHeadIncorrectlyPlaced, _Str("multiple 'head' elements found: ", item->Href().c_str()));
-                    return 0;
-                }
+                //smilData->_duration = smilDur;
 
-                nodes = xpath.Nodes("./smil:body", smil);
+                HandleError(EPUBError::MediaOverlayMismatchDurationMetadata, str);
+            }
 
-                if (nodes.empty())
-                {
-                    HandleError(EPUBError::MediaOverlayNoBody, _Str("'body' element not found: ", item->Href().c_str()));
-                }
-                else if (nodes.size() > 1)
-                {
-                    HandleError(EPUBError::MediaOverlayMultipleBodies, _Str("multiple 'body' elements found: ", item->Href().c_str()));
-                }
+            return smilDur;
+        }
 
-                if (nodes.size() != 1)
+        void MediaOverlaysSmilModel::ensureSmilParsed(std::vector<std::shared_ptr<SMILData>>::size_type i) const
+        {
+            std::shared_ptr<SMILData> smilData;
+            {
+                std::unique_lock<std::mutex> lock(_parseLock);
+                if (i >= _smilParsed.size())
                 {
-                    return 0;
+                    return;
                 }
 
-                shared_ptr<SMILData> smilData = nullptr;
-                string id = item->Identifier();
-                for (shared_vector<SMILData>::size_type i = 0; i < _smilDatas.size(); i++)
+                // another thread is parsing this one: wait for it. An error handler that calls back
+                // into the model from the parse itself gets the SMIL as it stands.
+                while (!_smilParsed[i] && _smilParsers[i] != std::thread::id())
                 {
-                    const std::shared_ptr<SMILData> data = _smilDatas.at(i); // does not make a copy of the smart pointer (NO reference count++)
-
-                    if (data->SmilManifestItem() == nullptr)
+                    if (_smilParsers[i] == std::this_thread::get_id())
                     {
-                        continue;
+                        return;
                     }
+                    _smilParsedCondition.wait(lock);
+                }
 
-                    if (data->SmilManifestItem()->Identifier() == id)
+                if (_smilParsed[i])
+                {
+                    if (_smilParseExceptions[i])
                     {
-                        auto seq = data->Body();
-                        if (seq != nullptr)
-                        {
-                            continue;
-                        }
-
-                        if (data->XhtmlSpineItem()->ManifestItem()->Identifier() != spineItem->ManifestItem()->Identifier())
-                        {
-                            printf("XHTML spine item's manifest item ID mismatch?!\n");
-                        }
-                        smilData = data;
-                        break;
+                        std::rethrow_exception(_smilParseExceptions[i]);
                     }
+                    return;
                 }
 
-                shared_ptr<xml::Node> body = nodes[0];
+                _smilParsers[i] = std::this_thread::get_id();
+                smilData = _smilDatas[i];
+            }
 
-                std::map<string, std::shared_ptr<ManifestItem>> cache_smilRelativePathToManifestItem;
+            // parsed without the lock held, since the error handler may call back into the model.
+            // Parsing only fills in the SMILData's own tree, the model's observable state doesn't change.
+            // An exception from the handler leaves the SMIL empty, and is rethrown to everyone who asks for it.
+            uint32_t duration = 0;
+            std::exception_ptr exception;
+            string message;
+            try
+            {
+                duration = const_cast<MediaOverlaysSmilModel*>(this)->parseSMILData(smilData);
+            }
+            catch (const std::exception & error)
+            {
+                exception = std::current_exception();
+                message = error.what();
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+                message = _Str("Cannot parse SMIL: ", smilData->SmilManifestItem()->Href());
+            }
 
-//// TIMER START
-//timer.reset();
+            if (exception)
+            {
+                smilData->_root = nullptr;
+                smilData->IndexTimeline();
+                duration = 0;
+            }
 
-                uint32_t smilDur = parseSMIL(smilData, nullptr, nullptr, item, body, cache_manifestItemToAbsolutePath, cache_smilRelativePathToManifestItem);
-                //printf("Media Overlays SMIL DURATION (milliseconds): %ld\n", (long) smilDur);
+            {
+                std::lock_guard<std::mutex> lock(_parseLock);
+                _smilDurations[i] = duration;
+                _smilParseErrors[i] = message;
+                _smilParseExceptions[i] = exception;
+                _smilParsers[i] = std::thread::id();
+                _smilParsed[i] = true;
+            }
+            _smilParsedCondition.notify_all();
 
-//// TIMER END
-//double seconds = timer.elapsed();
-//std::stringstream s;
-//s << "TIMER (" << counter << "): " << seconds;
-//const std::string & str = _Str(s.str());
-//printf("%s\n", str.c_str());
-////std::cout << t << std::endl;
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
 
-                uint32_t metaDur = smilData->DurationMilliseconds_Metadata();
-                if (metaDur != smilDur)
+        void MediaOverlaysSmilModel::ensureAllSmilsParsed() const
+        {
+            {
+                std::lock_guard<std::mutex> lock(_parseLock);
+                if (_allSmilsParsed)
                 {
-                    std::stringstream s;
-                    s << "Media Overlays SMIL duration mismatch (milliseconds): METADATA " << (long) metaDur << " != SMIL " << (long) smilDur << " (" << item->Href().c_str() << ")";
-                    const std::string & str = _Str(s.str());
-                    //printf("%s\n", str.c_str());
+                    return;
+                }
+            }
 
-                    //smilData->_duration = smilDur;
+            uint32_t totalDurationFromSMILs = 0;
+            std::vector<uint32_t> smilOffsets(1, 0);
+            smilOffsets.reserve(_smilDatas.size() + 1);
+            for (shared_vector<SMILData>::size_type i = 0; i < _smilDatas.size(); i++)
+            {
+                ensureSmilParsed(i);
+                totalDurationFromSMILs += _smilDurations[i];
+                smilOffsets.push_back(smilOffsets.back() + _smilDatas[i]->DurationMilliseconds_Calculated());
+            }
 
-                    HandleError(EPUBError::MediaOverlayMismatchDurationMetadata, str);
+            // checked before the offsets are published, so a handler that throws for it
+            // keeps throwing for every getter which needs the whole timeline
+            if (_totalDuration != totalDurationFromSMILs)
+            {
+                std::stringstream s;
+                s << "Media Overlays total duration mismatch (milliseconds): METADATA " << (long) _totalDuration << " != SMILs " << (long) totalDurationFromSMILs;
+                const std::string & str = _Str(s.str());
+                //printf("%s\n", str.c_str());
+
+                HandleError(EPUBError::MediaOverlayMismatchDurationMetadata, str);
+            }
+            else
+            {
+                //printf("Media Overlays SMILs parsed, total duration checked okay (milliseconds): %ld\n", (long) totalDurationFromSMILs);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_parseLock);
+                if (_allSmilsParsed)
+                {
+                    return;
                 }
+                _smilOffsets = std::move(smilOffsets);
+                _allSmilsParsed = true;
+            }
 
-                accumulatedDurationMilliseconds += smilDur;
+            //debugSmilData(_smilDatas);
+        }
 
-                spineItem = spineItem->Next();
+        const std::shared_ptr<SMILData> MediaOverlaysSmilModel::GetSmil(std::vector<std::shared_ptr<SMILData>>::size_type i) const
+        {
+            if (i >= _smilDatas.size())
+            {
+                return nullptr;
             }
 
-            return accumulatedDurationMilliseconds;
+            ensureSmilParsed(i);
+
+            const std::shared_ptr<SMILData> smilData = _smilDatas.at(i); // does not make a copy of the smart pointer (NO reference count++)
+            return smilData;
         }
 
-        static std::vector<string> splitFileFragmentId; // = std::vector<string>(2);
+        string MediaOverlaysSmilModel::SmilParseError(std::vector<std::shared_ptr<SMILData>>::size_type i) const
+        {
+            std::lock_guard<std::mutex> lock(_parseLock);
+            if (i >= _smilParseErrors.size())
+            {
+                return "";
+            }
+            return _smilParseErrors[i];
+        }
+
+        void MediaOverlaysSmilModel::PrefetchSmilsAround(std::vector<std::shared_ptr<SMILData>>::size_type i) const
+        {
+#if FUTURE_ENABLED
+            if (_smilDatas.empty())
+            {
+                return;
+            }
+
+            std::weak_ptr<const MediaOverlaysSmilModel> weakMe = shared_from_this();
+            auto prefetch = [weakMe, i]() {
+                std::shared_ptr<const MediaOverlaysSmilModel> me = weakMe.lock();
+                if (me == nullptr)
+                {
+                    return;
+                }
+
+                // the one that's needed first goes first. A parse error is kept by the model
+                // and thrown to whoever asks for that SMIL, so it's dropped here.
+                auto parse = [&me](std::vector<std::shared_ptr<SMILData>>::size_type n) {
+                    try
+                    {
+                        me->ensureSmilParsed(n);
+                    }
+                    catch (...)
+                    {
+                    }
+                };
+                parse(i);
+                parse(i + 1);
+                if (i > 0)
+                {
+                    parse(i - 1);
+                }
+            };
+
+            static std::once_flag __once;
+            static std::unique_ptr<thread_pool> __prefetchPool;
+            std::call_once(__once, [](){
+                __prefetchPool.reset(new thread_pool(1));
+            });
+            __prefetchPool->add(prefetch);
+#endif //FUTURE_ENABLED
+        }
 
         void splitIriFileFragmentID(const string & iri, std::vector<string> &splitFileFragmentId)
         {
@@ -756,6 +889,8 @@ public:
 
             string elementName = element->Name();
 
+            std::vector<string> splitFileFragmentId;
+
             string textref_ = string(_getProp(element, "textref", ePub3NamespaceURI));
             string textref_file;
             string textref_fragmentID;
@@ -1076,39 +1211,43 @@ public:
 
         const uint32_t MediaOverlaysSmilModel::DurationMilliseconds_Calculated() const
         {
-            uint32_t total = 0;
+            ensureAllSmilsParsed();
 
-            ForEachSmilData([&total](const std::shared_ptr<SMILData> & data)
+            return _smilOffsets.back();
+        }
+
+        std::vector<std::shared_ptr<SMILData>>::size_type MediaOverlaysSmilModel::smilIndexAt(uint32_t timeMilliseconds) const
+        {
+            // the first SMIL whose timeline reaches that far; SMILs without audio take up no time, so a
+            // match at their (shared) boundary belongs to the next SMIL that does
+            auto pos = std::lower_bound(_smilOffsets.begin() + 1, _smilOffsets.end(), timeMilliseconds);
+            std::vector<std::shared_ptr<SMILData>>::size_type i = pos - (_smilOffsets.begin() + 1);
+
+            while (i < _smilDatas.size() && _smilOffsets[i + 1] == _smilOffsets[i])
             {
-                total += data->DurationMilliseconds_Calculated();
-            });
+                i++;
+            }
 
-            return total;
+            return i;
         }
 
         shared_ptr<const SMILData::Parallel> MediaOverlaysSmilModel::ParallelAt(uint32_t timeMilliseconds) const
         {
-            uint32_t offset = 0;
+            ensureAllSmilsParsed();
 
-            for (shared_vector<SMILData>::size_type i = 0; i < _smilDatas.size(); i++)
+            std::vector<std::shared_ptr<SMILData>>::size_type i = smilIndexAt(timeMilliseconds);
+            if (i >= _smilDatas.size())
             {
-                const std::shared_ptr<SMILData> data = _smilDatas.at(i); // does not make a copy of the smart pointer (NO reference count++)
-                uint32_t timeAdjusted = timeMilliseconds - offset;
-
-                shared_ptr<const SMILData::Parallel> para = data->ParallelAt(timeAdjusted);
-                if (para != nullptr)
-                {
-                    return para;
-                }
-
-                offset += data->DurationMilliseconds_Calculated();
+                return nullptr;
             }
 
-            return nullptr;
+            return _smilDatas[i]->ParallelAt(timeMilliseconds - _smilOffsets[i]);
         }
 
         const void MediaOverlaysSmilModel::PercentToPosition(double percent, SMILDataPtr & smilData, uint32_t & smilIndex, shared_ptr<const SMILData::Parallel>& par, uint32_t & parIndex, uint32_t & milliseconds) const
         {
+            ensureAllSmilsParsed();
+
             if (percent < 0.0 || percent > 100.0)
             {
                 percent = 0.0;
@@ -1120,46 +1259,33 @@ public:
 
             //printf("=== TIME SCRUB: %ldms / %ldms (==%ldms)", (long) timeMs, (long) total, (long) mo->DurationMillisecondsTotal());
 
-            par = ParallelAt(timeMs);
-            if (par == nullptr)
+            std::vector<std::shared_ptr<SMILData>>::size_type i = smilIndexAt(timeMs);
+            if (i >= _smilDatas.size())
             {
+                par = nullptr;
                 return;
             }
 
-            std::shared_ptr<SMILData> smilDataPar = par->Owner(); // internally: std::weak_ptr<SMILData>.lock()
-            if (smilDataPar == nullptr)
+            par = _smilDatas[i]->ParallelAt(timeMs - _smilOffsets[i]);
+            if (par == nullptr)
             {
                 return;
             }
-            
-            uint32_t smilDataOffset = 0;
-            for (std::vector<std::shared_ptr<SMILData>>::size_type i = 0; i < GetSmilCount(); i++)
-            {
-                smilData = GetSmil(i);
-                if (smilData == smilDataPar) // smart shared pointer comparison operator overloaded
-                {
-                    break;
-                }
-                smilDataOffset += smilData->DurationMilliseconds_Calculated();
-            }
 
-            milliseconds = timeMs - (smilDataOffset + smilData->ClipOffset(par));
+            smilData = _smilDatas[i];
+
+            milliseconds = timeMs - (_smilOffsets[i] + smilData->ClipOffset(par));
         }
 
         const double MediaOverlaysSmilModel::PositionToPercent(std::vector<std::shared_ptr<SMILData>>::size_type smilIndex, uint32_t parIndex, uint32_t milliseconds) const
         {
+            ensureAllSmilsParsed();
+
             if (smilIndex >= GetSmilCount())
             {
                 return -1.0;
             }
 
-            uint32_t smilDataOffset = 0;
-            for (std::vector<std::shared_ptr<SMILData>>::size_type i = 0; i < smilIndex; i++)
-            {
-                const std::shared_ptr<SMILData> sd = GetSmil(i);
-                smilDataOffset += sd->DurationMilliseconds_Calculated();
-            }
-
             const std::shared_ptr<SMILData> smilData = GetSmil(smilIndex);
 
             shared_ptr<const SMILData::Parallel> par = smilData->NthParallel(parIndex);
@@ -1168,7 +1294,7 @@ public:
                 return -1.0;
             }
 
-            uint32_t offset = smilDataOffset + smilData->ClipOffset(par) + milliseconds;
+            uint32_t offset = _smilOffsets[smilIndex] + smilData->ClipOffset(par) + milliseconds;
 
             uint32_t total = DurationMilliseconds_Calculated();
 
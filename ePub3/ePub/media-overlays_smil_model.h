@@ -36,6 +36,10 @@
 #include <ePub3/xml/node.h>
 #include "media-overlays_smil_data.h"
 #include "package.h"
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 //#include <ePub3/utilities/make_unique.h>
 //std::unique_ptr<KLASS> obj = make_unique<KLASS>(constructor_params);
@@ -76,9 +80,14 @@ http://www.idpf.org/epub/30/spec/epub30-mediaoverlays.html
             inline FORCE_INLINE
             _Function ForEachSmilData(_Function __f) const
             {
-                // the _smilDatas vector iterator does not make a copy of the smart pointer (NO reference count++),
                 // the std::shared_ptr<SMILData> object is not passed as value, but as reference &
-                return std::for_each(_smilDatas.begin(), _smilDatas.end(), __f);
+                // (NO reference count++); each SMIL is parsed before it's passed on
+                for (shared_vector<SMILData>::size_type i = 0; i < _smilDatas.size(); i++)
+                {
+                    ensureSmilParsed(i);
+                    __f(_smilDatas[i]);
+                }
+                return std::move(__f);
             }
     
         public:
@@ -124,16 +133,27 @@ http://www.idpf.org/epub/30/spec/epub30-mediaoverlays.html
 
             EPUB3_EXPORT
 
-            const std::shared_ptr<SMILData> GetSmil(std::vector<std::shared_ptr<SMILData>>::size_type i) const
-            {
-                if (i >= _smilDatas.size())
-                {
-                    return nullptr;
-                }
+            // the SMIL document is parsed on first access
+            const std::shared_ptr<SMILData> GetSmil(std::vector<std::shared_ptr<SMILData>>::size_type i) const;
 
-                const std::shared_ptr<SMILData> smilData = _smilDatas.at(i); // does not make a copy of the smart pointer (NO reference count++)
-                return smilData;
-            }
+            /**
+             Parses the SMILs at indices i-1, i and i+1 on a background thread, so that
+             GetSmil() doesn't block when playback moves to a neighbouring document.
+             SMIL indices are the same as spine indices. Does nothing unless the library
+             is built with FUTURE_ENABLED, since there is no thread pool to run it on.
+             */
+            EPUB3_EXPORT
+
+            void PrefetchSmilsAround(std::vector<std::shared_ptr<SMILData>>::size_type i) const;
+
+            /**
+             The error which stopped the SMIL at index i from parsing, if an error handler
+             threw one. The exception itself is rethrown by every call that needs that SMIL.
+             Returns an empty string if the SMIL parsed, or hasn't been parsed yet.
+             */
+            EPUB3_EXPORT
+
+            string SmilParseError(std::vector<std::shared_ptr<SMILData>>::size_type i) const;
 
             EPUB3_EXPORT
 
@@ -195,7 +215,33 @@ http://www.idpf.org/epub/30/spec/epub30-mediaoverlays.html
 
             void parseMetadata();
 
-            uint32_t parseSMILs();
+            mutable std::mutex _parseLock;
+
+            mutable std::condition_variable _smilParsedCondition;
+
+            mutable std::vector<bool> _smilParsed;
+
+            mutable std::vector<std::thread::id> _smilParsers; // the thread parsing each SMIL, if any
+
+            mutable std::vector<string> _smilParseErrors;
+
+            mutable std::vector<std::exception_ptr> _smilParseExceptions;
+
+            mutable std::vector<uint32_t> _smilDurations;
+
+            mutable bool _allSmilsParsed;
+
+            mutable std::vector<uint32_t> _smilOffsets; // where each SMIL starts on the book's timeline, plus the total; valid once _allSmilsParsed
+
+            std::vector<std::shared_ptr<SMILData>>::size_type smilIndexAt(uint32_t timeMilliseconds) const;
+
+            std::map<std::shared_ptr<ManifestItem>, string> _cache_manifestItemToAbsolutePath;
+
+            uint32_t parseSMILData(SMILDataPtr smilData);
+
+            void ensureSmilParsed(std::vector<std::shared_ptr<SMILData>>::size_type i) const;
+
+            void ensureAllSmilsParsed() const;
 
             uint32_t parseSMIL(SMILDataPtr smilData, shared_ptr<SMILData::Sequence> sequence, shared_ptr<SMILData::Parallel> parallel, const ManifestItemPtr item, shared_ptr<xml::Node> element, std::map<std::shared_ptr<ManifestItem>, string> & cache_manifestItemToAbsolutePath, std::map<string, std::shared_ptr<ManifestItem>> & cache_smilRelativePathToManifestItem); // recursive
 
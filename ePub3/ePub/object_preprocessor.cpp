@@ -30,131 +30,160 @@
 #include "object_preprocessor.h"
 #include "package.h"
 #include "filter_manager.h"
-
-static const REGEX_NS::regex::flag_type regexFlags(REGEX_NS::regex::ECMAScript|REGEX_NS::regex::optimize);
-static const REGEX_NS::regex reEscaper("\\\\\\.\\(\\)\\[\\]\\$\\^\\*\\+\\?\\:\\=\\|", regexFlags);
+#include "markup_scanner.h"
 
 EPUB3_BEGIN_NAMESPACE
 
-static REGEX_NS::regex ParamMatcher("<param[^>]+(name|value)=\"([^\"]*)\"[^>]*?(value|name)=\"([^\"]*)\"(.|\\n|\\r)*?>", regexFlags);
-static REGEX_NS::regex SourceFinder("data=\\\"([^\\\"]*)\\\"", regexFlags);
-static REGEX_NS::regex IDFinder("id=\\\"([^\\\"]*)\\\"", regexFlags);
+typedef MarkupScanner::Match    ScanMatch;
 
-bool ObjectPreprocessor::ShouldApply(ConstManifestItemPtr item)
-{
-    return (item->MediaType() == "application/xhtml+xml" || item->MediaType() == "text/html");
-}
-ContentFilterPtr ObjectPreprocessor::ObjectFilterFactory(ConstPackagePtr package)
-{
-    if ( package->MediaTypesWithDHTMLHandlers().empty() )
-        return nullptr;
-    return std::make_shared<ObjectPreprocessor>(package, "Open"); //New(package, "Open");
-}
-void ObjectPreprocessor::Register()
+// finds the value of the first `name="value"` attribute in [p, end)
+static bool FindAttribute(const char* p, const char* end, const char* name, size_t nameLen, std::string& value)
 {
-    FilterManager::Instance()->RegisterFilter("ObjectPreprocessor", ObjectPreprocessing, ObjectFilterFactory);
+    const char* attr = MarkupScanner::FindLiteral(p, end, name, nameLen, false);
+    if ( attr == end )
+        return false;
+    
+    const char* valueEnd = MarkupScanner::FindChar(attr + nameLen, end, '"');
+    if ( valueEnd == end )
+        return false;
+    
+    value.assign(attr + nameLen, valueEnd);
+    return true;
 }
-ObjectPreprocessor::ObjectPreprocessor(ConstPackagePtr pkg, const string& buttonTitle) : ContentFilter(ShouldApply), _button(buttonTitle)
+
+// matches `name="value"` or `value="value"` at p, returning the end of the value
+static const char* MatchParamAttribute(const char* p, const char* end, bool* isName)
 {
-    Package::StringList mediaTypes = pkg->MediaTypesWithDHTMLHandlers();
-    if ( mediaTypes.empty() )
+    size_t len = 0;
+    if ( MarkupScanner::MatchLiteral(p, end, "name=\"", 6, false) == ScanMatch::Found )
     {
-        // No work for the filter to do here -- disable all matches
-        SetTypeSniffer([](ConstManifestItemPtr){return false;});
-        return;
+        *isName = true;
+        len = 6;
     }
-    
-    std::stringstream ss;
-    ss << "<object\\s+?([^>]*?(?:media-)?type=\"(";
-    
-    auto pos = mediaTypes.begin();
-    auto end = mediaTypes.end();
-    
-    while ( pos != end )
+    else if ( MarkupScanner::MatchLiteral(p, end, "value=\"", 7, false) == ScanMatch::Found )
     {
-        auto here = pos++;
-        std::string regstr("$`\\\\$&$'");
-        std::string str = REGEX_NS::regex_replace(here->stl_str(), reEscaper, regstr);    // yes, double-backslash, so it doesn't escape whatever '$&' is (i.e. the character which needs to be escaped)
-        if ( pos == end )
-            ss << str;
-        else
-            ss << str << "|";
+        *isName = false;
+        len = 7;
     }
-    
-    ss << ")\"[^>]*?)>((?:.|\\n|\\r)*?)</object>";
-    std::string reStr = ss.str();
-    _objectMatcher = REGEX_NS::regex(reStr, regexFlags);
-    
-    for ( auto mediaType : mediaTypes )
+    else
     {
-#if EPUB_HAVE(CXX_MAP_EMPLACE)
-        _handlers.emplace(mediaType, *(pkg->OPFHandlerForMediaType(mediaType)));
-#else
-        _handlers.insert({mediaType, *(pkg->OPFHandlerForMediaType(mediaType))});
-#endif
+        return nullptr;
     }
+    
+    const char* valueEnd = MarkupScanner::FindChar(p + len, end, '"');
+    return (valueEnd == end ? nullptr : valueEnd);
 }
-void* ObjectPreprocessor::FilterData(FilterContext* context, void *data, size_t len, size_t *outputLen)
+
+/*
+ Reads the `param` element starting at p, the way the expression
+ 
+     <param[^>]+(name|value)="([^"]*)"[^>]*?(value|name)="([^"]*)"(.|\n|\r)*?>
+ 
+ would: the first attribute is the last one in the start tag which is followed
+ by a second. Returns the end of the match, or nullptr.
+ */
+static const char* ReadParam(const char* p, const char* end, ContentHandler::ParameterList& params)
 {
-    char* input = reinterpret_cast<char*>(data);
-    // find each `object` tag
-    REGEX_NS::cregex_iterator pos(input, input+len, _objectMatcher);
-    REGEX_NS::cregex_iterator end;
-    if ( pos == end )
+    const char* first = p + 6;
+    const char* limit = MarkupScanner::FindChar(first, end, '>');
+    
+    for ( const char* k = limit - 1; k > first; --k )
     {
-        *outputLen = len;
-        return data;        // no match == no change
+        bool firstIsName = false;
+        const char* firstEnd = MatchParamAttribute(k, end, &firstIsName);
+        if ( firstEnd == nullptr )
+            continue;
+        
+        const char* secondLimit = MarkupScanner::FindChar(firstEnd + 1, end, '>');
+        for ( const char* j = firstEnd + 1; j < secondLimit; ++j )
+        {
+            bool secondIsName = false;
+            const char* secondEnd = MatchParamAttribute(j, end, &secondIsName);
+            if ( secondEnd == nullptr )
+                continue;
+            
+            const char* gt = MarkupScanner::FindChar(secondEnd + 1, end, '>');
+            if ( gt == end )
+                continue;
+            
+            const char* firstValue = k + (firstIsName ? 6 : 7);
+            const char* secondValue = j + (secondIsName ? 6 : 7);
+            
+            string name, value;
+            if ( firstIsName )
+                name = std::string(firstValue, firstEnd);
+            else
+                value = std::string(firstValue, firstEnd);
+            
+            if ( secondIsName )
+                name = std::string(secondValue, secondEnd);
+            else
+                value = std::string(secondValue, secondEnd);
+            
+            params[name] = value;
+            return gt + 1;
+        }
     }
     
-    std::string output;
-    while ( pos != end )
+    return nullptr;
+}
+
+/*
+ Replaces `object` elements handled by one of the package's DHTML handlers:
+ 
+     <object ... type="media/type" ...> content </object>
+ */
+class ObjectPreprocessor::ObjectScanner : public MarkupScanner
+{
+public:
+    ObjectScanner(const ObjectPreprocessor& filter) : MarkupScanner("<object", false), _filter(filter) {}
+    
+protected:
+    virtual ScanMatch MatchConstruct(const char* begin, const char* end, const char** matchEnd, std::string& output) OVERRIDE
     {
-        // output any leading non-matched characters
-        output += pos->prefix();
+        const char* attrs = begin + 7;
+        if ( attrs == end )
+            return ScanMatch::NoneFollowing;
+        if ( !IsSpace(*attrs) )
+            return ScanMatch::None;
+        
+        const char* attrsEnd = FindChar(++attrs, end, '>');
+        if ( attrsEnd == end )
+            return ScanMatch::NoneFollowing;
         
-        std::string type(pos->str(2));
-        // we have matched an <object> element: find the appropriate media handler
-        auto found = _handlers.find(type);
-        if ( found == _handlers.end() )
+        // this also matches `media-type` attributes
+        auto found = _filter._handlers.end();
+        for ( const char* t = FindLiteral(attrs, attrsEnd, "type=\"", 6, false); t != attrsEnd; t = FindLiteral(t + 1, attrsEnd, "type=\"", 6, false) )
         {
-            output += pos->str();
-            continue;
+            const char* typeEnd = FindChar(t + 6, attrsEnd, '"');
+            if ( typeEnd == attrsEnd )
+                break;
+            
+            found = _filter._handlers.find(string(std::string(t + 6, typeEnd)));
+            if ( found != _filter._handlers.end() )
+                break;
         }
+        if ( found == _filter._handlers.end() )
+            return ScanMatch::None;
+        
+        const char* content = attrsEnd + 1;
+        const char* endTag = FindLiteral(content, end, "</object>", 9, false);
+        if ( endTag == end )
+            return ScanMatch::NoneFollowing;
         
         const MediaHandler& handler = found->second;
         ContentHandler::ParameterList params;
-        params["type"] = type;
+        params["type"] = found->first;
         
         // find the data source
-        REGEX_NS::smatch m;
-        std::string attrs(pos->str(1));
-        REGEX_NS::regex_search(attrs.cbegin(), attrs.cend(), m, SourceFinder);
-        string src(m[1].str());
+        std::string src;
+        FindAttribute(attrs, attrsEnd, "data=\"", 6, src);
         
         // find any parameters to the object tag
-        std::string content(pos->str(3));
-        REGEX_NS::sregex_iterator cpos(content.begin(), content.end(), ParamMatcher);
-        REGEX_NS::sregex_iterator cend;
-        
-        while ( cpos != cend )
+        for ( const char* p = FindLiteral(content, endTag, "<param", 6, false); p != endTag; )
         {
-            if ( cpos->length() >= 4 )
-            {
-                string name, value;
-                if ( cpos->str(1) == "name" )
-                    name = cpos->str(2);
-                else
-                    value = cpos->str(2);
-                
-                if ( cpos->str(3) == "value" )
-                    value = cpos->str(4);
-                else
-                    name = cpos->str(4);
-                
-                params[name] = value;
-            }
-            
-            ++cpos;
+            const char* paramEnd = ReadParam(p, endTag, params);
+            p = FindLiteral((paramEnd != nullptr ? paramEnd : p + 1), endTag, "<param", 6, false);
         }
         
         // now determine the target-- this is an absolute URL
@@ -162,8 +191,7 @@ void* ObjectPreprocessor::FilterData(FilterContext* context, void *data, size_t
         
         // find out if the object tag had an id attribute
         std::string objectID;
-        if ( REGEX_NS::regex_search(attrs.cbegin(), attrs.cend(), m, IDFinder) )
-            objectID = m[1].str();
+        FindAttribute(attrs, attrsEnd, "id=\"", 4, objectID);
         
         // now construct the `iframe` tag
         std::string url = target.URIString().stl_str();
@@ -183,15 +211,60 @@ void* ObjectPreprocessor::FilterData(FilterContext* context, void *data, size_t
         output += "><button type=\"submit\"";
         if ( !objectID.empty() )
             output += " id=\"" + objectID + "-button\"";
-        output += ">" + _button.stl_str() + "</button></form>";
+        output += ">" + _filter._button.stl_str() + "</button></form>";
         
         // that's it-- we've replaced the whole lot!
-        
-        // step forward, and if we get the end let's output the current suffix
-        // this ensures that we don't lose everything following the last match
-        auto here = pos++;
-        if ( pos == end )
-            output += here->suffix();
+        *matchEnd = endTag + 9;
+        return ScanMatch::Found;
+    }
+    
+private:
+    const ObjectPreprocessor&   _filter;
+    
+};
+
+bool ObjectPreprocessor::ShouldApply(ConstManifestItemPtr item)
+{
+    return (item->MediaType() == "application/xhtml+xml" || item->MediaType() == "text/html");
+}
+ContentFilterPtr ObjectPreprocessor::ObjectFilterFactory(ConstPackagePtr package)
+{
+    if ( package->MediaTypesWithDHTMLHandlers().empty() )
+        return nullptr;
+    return std::make_shared<ObjectPreprocessor>(package, "Open"); //New(package, "Open");
+}
+void ObjectPreprocessor::Register()
+{
+    FilterManager::Instance()->RegisterFilter("ObjectPreprocessor", ObjectPreprocessing, ObjectFilterFactory);
+}
+ObjectPreprocessor::ObjectPreprocessor(ConstPackagePtr pkg, const string& buttonTitle) : ContentFilter(ShouldApply), _button(buttonTitle)
+{
+    Package::StringList mediaTypes = pkg->MediaTypesWithDHTMLHandlers();
+    if ( mediaTypes.empty() )
+    {
+        // No work for the filter to do here -- disable all matches
+        SetTypeSniffer([](ConstManifestItemPtr){return false;});
+        return;
+    }
+    
+    for ( auto mediaType : mediaTypes )
+    {
+#if EPUB_HAVE(CXX_MAP_EMPLACE)
+        _handlers.emplace(mediaType, *(pkg->OPFHandlerForMediaType(mediaType)));
+#else
+        _handlers.insert({mediaType, *(pkg->OPFHandlerForMediaType(mediaType))});
+#endif
+    }
+}
+void* ObjectPreprocessor::FilterData(FilterContext* context, void *data, size_t len, size_t *outputLen)
+{
+    char* input = reinterpret_cast<char*>(data);
+    
+    std::string output;
+    if ( !ObjectScanner(*this).Scan(input, len, output) )
+    {
+        *outputLen = len;
+        return data;        // no match == no change
     }
     
     *outputLen = output.size();
@@ -34,7 +34,6 @@
 #include <ePub3/filter.h>
 #include <ePub3/utilities/iri.h>
 #include <ePub3/content_handler.h>
-#include REGEX_INCLUDE
 
 EPUB3_BEGIN_NAMESPACE
 
@@ -71,11 +70,11 @@ public:
     
     ///
     /// Standard copy constructor.
-    ObjectPreprocessor(const ObjectPreprocessor& o) : ContentFilter(o), _objectMatcher(o._objectMatcher), _handlers(o._handlers) {}
+    ObjectPreprocessor(const ObjectPreprocessor& o) : ContentFilter(o), _button(o._button), _handlers(o._handlers) {}
     
     ///
     /// C++11 'move' constructor.
-    ObjectPreprocessor(ObjectPreprocessor&& o) : ContentFilter(std::move(o)), _objectMatcher(std::move(o._objectMatcher)), _handlers(std::move(o._handlers)) {}
+    ObjectPreprocessor(ObjectPreprocessor&& o) : ContentFilter(std::move(o)), _button(o._button), _handlers(std::move(o._handlers)) {}
     
     ///
     /// Destructor.
@@ -107,6 +106,12 @@ public:
      and `-button` and applied to the `form` and `button` elements respectively.  It
      is our intention that these rules will make it possible for content authors to
      anticipate these substitutions and build CSS or JavaScript rules directly.
+     
+     The document is scanned once, by hand rather than with regular expressions. An
+     `object` start tag is replaced if any `type` or `media-type` attribute in it
+     names one of the package's DHTML handler media types exactly; the replacement
+     runs to the first `</object>` end tag that follows. The `data` and `id`
+     attributes and any `param` elements inside it are passed to the handler.
      */
     virtual void*   FilterData(FilterContext* context, void* data, size_t len, size_t* outputLen) OVERRIDE;
     
@@ -114,33 +119,6 @@ public:
     static void Register();
     
 protected:
-    /**
-     This regex is used to locate only those `object` tags for which handlers exist.
-     
-     Its text is:
-     
-         <object\s+?([^>]*?media-type="(...|...|...)"[^>]*?)>(.*?)</object>
-     
-     The three ellipses in the middle represent media types. For example, with
-     handlers for 'application/x-slideshow+xml' and 'image/x-slideshow', the regex
-     would read:
-     
-         <object\s+?([^>]*?type="(application/x-slideshow\.xml|image/x-slideshow)"[^>]*?)>(.*?)</object>
-     
-     Note that any and all regex special characters will be replaced automatically
-     during insertion.
-     
-     #### Matches
-     
-     There are a few things captured by the expression:
-     
-     - *0:* The entire `<object...>...</object>` construct.
-     - *1:* The complete string containing all the attribute definitions of the `<object>` tag.
-     - *2:* The value of the `object` element's `type` attribute.
-     - *3:* The `innerHTML` content of the `object` element.
-     */
-    REGEX_NS::regex                         _objectMatcher;
-    
     ///
     /// The (hopefully localized!) title of the generated HTML5 `<button>`.
     const string                            _button;
@@ -149,6 +127,9 @@ protected:
     /// The object keeps its own list of handlers, used to create target URIs.
     std::map<string, MediaHandler>          _handlers;
     
+private:
+    class ObjectScanner;
+    
 };
 
 EPUB3_END_NAMESPACE
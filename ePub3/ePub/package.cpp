@@ -32,6 +32,7 @@
 #include "archive.h"
 #include "archive_xml.h"
 #include "xpath_wrangler.h"
+#include "document_cache.h"
 #include "nav_table.h"
 #include "glossary.h"
 #include "iri.h"
@@ -43,6 +44,7 @@
 #include <ePub3/utilities/error_handler.h>
 #include <sstream>
 #include <list>
+#include <thread>
 #include REGEX_INCLUDE
 #include <ePub3/xml/document.h>
 #include <ePub3/xml/element.h>
@@ -99,7 +101,7 @@ PackageBase::PackageBase(const shared_ptr<Container>& owner, const string& type)
     if ( !_archive )
         throw std::invalid_argument("Owner doesn't have an archive!");
 }
-PackageBase::PackageBase(PackageBase&& o) : _archive(o._archive), _opf(std::move(o._opf)), _pathBase(std::move(o._pathBase)), _type(std::move(o._type)), _manifestByID(std::move(o._manifestByID)), _manifestByAbsolutePath(std::move(o._manifestByAbsolutePath)), _spine(std::move(o._spine))
+PackageBase::PackageBase(PackageBase&& o) : _archive(o._archive), _opf(std::move(o._opf)), _pathBase(std::move(o._pathBase)), _type(std::move(o._type)), _manifestByID(std::move(o._manifestByID)), _manifestByAbsolutePath(std::move(o._manifestByAbsolutePath)), _manifestByDecodedPath(std::move(o._manifestByDecodedPath)), _spineItems(std::move(o._spineItems)), _spineIndexByIDRef(std::move(o._spineIndexByIDRef)), _spine(std::move(o._spine))
 {
     o._archive = nullptr;
 }
@@ -113,12 +115,16 @@ bool PackageBase::Open(const string& path, bool skipLoadingPotentiallyEncryptedC
     ArchiveXmlReader reader(_archive->ReaderAtPath(path.stl_str()));
 #if ENABLE_XML_READ_DOC_MEMORY
 
-        _opf = reader.readXml(path);
+        _opf = DocumentCache::Shared().DocumentAtPath(_archive->Path(), path, [&reader, &path]() {
+            return reader.readXml(path);
+        });
 
 #else
 
 #if EPUB_USE(LIBXML2)
-    _opf = reader.xmlReadDocument(path.c_str(), nullptr);
+    _opf = DocumentCache::Shared().DocumentAtPath(_archive->Path(), path, [&reader, &path]() {
+        return reader.xmlReadDocument(path.c_str(), nullptr);
+    });
 #elif EPUB_USE(WIN_XML)
     _opf = reader.ReadDocument(path.c_str(), nullptr, 0);
 #endif
@@ -146,23 +152,17 @@ bool PackageBase::Open(const string& path, bool skipLoadingPotentiallyEncryptedC
 }
 shared_ptr<SpineItem> PackageBase::SpineItemAt(size_t idx) const
 {
-    shared_ptr<SpineItem> item = _spine;
-    for ( size_t i = 0; i < idx && item != nullptr; i++ )
-    {
-        item = item->Next();
-    }
-    return item;
+    if ( idx >= _spineItems.size() )
+        return nullptr;
+    return _spineItems[idx];
 }
 size_t PackageBase::IndexOfSpineItemWithIDRef(const string &idref) const
 {
-    shared_ptr<SpineItem> item = FirstSpineItem();
-    for ( size_t i = 0; item != nullptr; i++, item = item->Next() )
-    {
-        if ( item->Idref() == idref )
-            return i;
-    }
+    auto found = _spineIndexByIDRef.find(idref);
+    if ( found == _spineIndexByIDRef.end() )
+        return size_t(-1);
     
-    return size_t(-1);
+    return found->second;
 }
 shared_ptr<ManifestItem> PackageBase::ManifestItemWithID(const string &ident) const
 {
@@ -190,6 +190,31 @@ const shared_vector<ManifestItem> PackageBase::ManifestItemsWithProperties(Prope
     }
     return result;
 }
+static string __decode_path(const string& path)
+{
+    url_canon::RawCanonOutputW<256> output;
+    
+    // note that std::string .size() is the same as
+    // ePub3:string .utf8_size() defined in utfstring.h (equivalent to strlen(str.c_str()) ),
+    // but not the same as ePub3:string .size() !!
+    // WATCH OUT!
+    url_util::DecodeURLEscapeSequences(path.c_str(), static_cast<int>(path.utf8_size()), &output);
+    
+    return string(output.data(), output.length());
+}
+void PackageBase::AddManifestItem(const shared_ptr<ManifestItem>& item)
+{
+    string absPath = item->AbsolutePath();
+#if EPUB_HAVE(CXX_MAP_EMPLACE)
+    _manifestByID.emplace(item->Identifier(), item);
+    _manifestByAbsolutePath.emplace(absPath, item);
+#else
+    _manifestByID[item->Identifier()] = item;
+    _manifestByAbsolutePath[absPath] = item;
+#endif
+    _manifestByDecodedPath.emplace(__decode_path(absPath), item);
+    StoreXMLIdentifiable(item);
+}
 shared_ptr<ManifestItem> PackageBase::ManifestItemAtRelativePath(const string& path) const
 {
 	string absPath = _pathBase + (path[0] == '/' ? path.substr(1) : path);
@@ -205,45 +230,13 @@ shared_ptr<ManifestItem> PackageBase::ManifestItemAtRelativePath(const string& p
 
     //if ( path.find("%") != std::string::npos ) SOMETIMES OPF MANIFEST ITEM HREF IS PERCENT-ESCAPED, BUT NOT HTML SRC !!
 
-    url_canon::RawCanonOutputW<256> output;
-
-    // SEE BELOW FOR A DEBUGGING BREAKPOINT / CHECK
-    // note that std::string .size() is the same as
-    // ePub3:string .utf8_size() defined in utfstring.h (equivalent to strlen(str.c_str()) ),
-    // but not the same as ePub3:string .size() !!
-    // WATCH OUT!
-    url_util::DecodeURLEscapeSequences(path.c_str(), static_cast<int>(path.utf8_size()), &output);
-
-    string path_(output.data(), output.length());
-
+    string path_ = __decode_path(path);
     string absPath_ = _pathBase + (path_[0] == '/' ? path_.substr(1) : path_);
-    for (auto& item : _manifestByID)
-    {
-        string absolute = item.second->AbsolutePath();
-
-        url_canon::RawCanonOutputW<256> output_;
-
-//        THIS IS FOR DEBUGGING, SEE COMMENT BELOW ...
-        const char * absChars = absolute.c_str();
-        int absLength_STRLEN = (int)strlen(absChars);
-        int absLength_SIZE = static_cast<int>(absolute.size());
-        int absLength_UTF8SIZE = static_cast<int>(absolute.utf8_size());
-        if (absLength_STRLEN != absLength_SIZE || absLength_STRLEN != absLength_UTF8SIZE || absLength_SIZE != absLength_UTF8SIZE)
-        {
-            // Place breakpoint here
-            //printf("String length DIFF absLength_STRLEN:%d - absLength_SIZE:%d - absLength_UTF8SIZE:%d\n", absLength_STRLEN, absLength_SIZE, absLength_UTF8SIZE);
-        }
-
-        // note that std::string .size() is the same as
-        // ePub3:string .utf8_size() defined in utfstring.h (equivalent to strlen(str.c_str()) ),
-        // but not the same as ePub3:string .size() !!
-        // WATCH OUT!
-        url_util::DecodeURLEscapeSequences(absolute.c_str(), static_cast<int>(absolute.utf8_size()), &output_);
-
-        string absolute_(output_.data(), output_.length());
-
-        if (absolute_ == absPath_)
-            return item.second;
+    
+    // AddManifestItem() indexes every item by its decoded path, whether it comes from Unpack() or a snapshot
+    auto decoded = _manifestByDecodedPath.find(absPath_);
+    if (decoded != _manifestByDecodedPath.end()) {
+        return decoded->second;
     }
 
     // DEBUG
@@ -274,19 +267,13 @@ shared_ptr<SpineItem> PackageBase::ConfirmOrCorrectSpineItemQualifier(shared_ptr
     if ( pComponent->HasQualifier() && pItem->Idref() != pComponent->qualifier )
     {
         // find the item with the qualifier
-        pItem = _spine;
-        uint32_t idx = 2;
+        size_t idx = IndexOfSpineItemWithIDRef(pComponent->qualifier);
+        pItem = SpineItemAt(idx);
         
-        while ( pItem != nullptr )
+        if ( pItem != nullptr )
         {
-            if ( pItem->Idref() == pComponent->qualifier )
-            {
-                // found it-- correct the CFI
-                pComponent->nodeIndex = idx;
-                break;
-            }
-            
-            pItem = pItem->Next();
+            // found it-- correct the CFI
+            pComponent->nodeIndex = uint32_t((idx+1)*2);
         }
     }
     else if ( pComponent->HasQualifier() == false )
@@ -296,7 +283,7 @@ shared_ptr<SpineItem> PackageBase::ConfirmOrCorrectSpineItemQualifier(shared_ptr
     
     return pItem;
 }
-NavigationList PackageBase::NavTablesFromManifestItem(shared_ptr<PackageBase> owner, ManifestItemPtr pItem)
+NavigationList PackageBase::NavTablesFromManifestItem(shared_ptr<PackageBase> owner, ManifestItemPtr pItem, shared_ptr<xml::Document> doc)
 {
     // have to do this one manually, as PackageBase doesn't inherit from PointerType itself
     PackagePtr sharedPkg = std::dynamic_pointer_cast<Package>(owner);
@@ -306,7 +293,8 @@ NavigationList PackageBase::NavTablesFromManifestItem(shared_ptr<PackageBase> ow
     if ( pItem == nullptr )
         return NavigationList();
     
-    auto doc = pItem->ReferencedDocument();
+    if ( !bool(doc) )
+        doc = pItem->ReferencedDocument();
     if ( !bool(doc) )
         return NavigationList();
     
@@ -416,17 +404,25 @@ bool Package::Open(const string& path, bool skipLoadingPotentiallyEncryptedConte
 #endif
     auto status = PackageBase::Open(path);
 	
-	if (status) {
-        // Setup the content filter chain before unpacking the package
-        // to filter its manifest items if needed. For example with
-        // some encrypted EPUB the navigation tables must be decrypted
-        // before being parsed.
-		auto fm = FilterManager::Instance();
-		auto fc = fm->BuildFilterChainForPackage(shared_from_this());
-		SetFilterChain(fc);
-		
-		status = Unpack(skipLoadingPotentiallyEncryptedContent);
-	}
+	if (status)
+		status = _FinishOpen(skipLoadingPotentiallyEncryptedContent);
+
+#if _XML_OVERRIDE_SWITCHES
+    __resetLibXMLOverrides();
+#endif
+    return status;
+}
+bool Package::_FinishOpen(bool skipLoadingPotentiallyEncryptedContent)
+{
+    // Setup the content filter chain before unpacking the package
+    // to filter its manifest items if needed. For example with
+    // some encrypted EPUB the navigation tables must be decrypted
+    // before being parsed.
+    auto fm = FilterManager::Instance();
+    auto fc = fm->BuildFilterChainForPackage(shared_from_this());
+    SetFilterChain(fc);
+    
+    auto status = Unpack(skipLoadingPotentiallyEncryptedContent);
 
     if (status)
     {
@@ -470,9 +466,6 @@ bool Package::Open(const string& path, bool skipLoadingPotentiallyEncryptedConte
         }
     }
 
-#if _XML_OVERRIDE_SWITCHES
-    __resetLibXMLOverrides();
-#endif
     return status;
 }
 bool Package::_OpenForTest(shared_ptr<xml::Document> doc, const string& basePath)
@@ -482,6 +475,10 @@ bool Package::_OpenForTest(shared_ptr<xml::Document> doc, const string& basePath
 #endif
     _opf = doc;
     _pathBase = basePath;
+    
+    // as in _FinishOpen(): navigation documents are read through the chain
+    SetFilterChain(FilterManager::Instance()->BuildFilterChainForPackage(shared_from_this()));
+    
     auto status = Unpack();
 #if _XML_OVERRIDE_SWITCHES
     __resetLibXMLOverrides();
@@ -521,10 +518,18 @@ void Package::LoadMediaOverlays() {
 
 void Package::LoadNavigationTables()
 {
+    // documents parsed concurrently with the rest of the OPF (see Unpack()), used once
+    std::map<ManifestItemPtr, shared_ptr<xml::Document>> prefetched;
+    prefetched.swap(_prefetchedNavDocuments);
+
     if (!_navigation.empty()) // && !_navigation["toc"]->Children().empty()
     {
         return;
     }
+    if (!bool(_opf)) // restored from a snapshot, which had no navigation tables either
+    {
+        return;
+    }
 
     auto root = _opf->Root();
     string rootName(root->Name());
@@ -558,6 +563,11 @@ void Package::LoadNavigationTables()
 
     PackagePtr sharedMe = shared_from_this();
 
+    auto prefetchedDocument = [&prefetched](const ManifestItemPtr& item) -> shared_ptr<xml::Document> {
+        auto found = prefetched.find(item);
+        return (found == prefetched.end() ? nullptr : found->second);
+    };
+
     // now the navigation tables
     if (isEPUB3)
     {
@@ -567,7 +577,7 @@ void Package::LoadNavigationTables()
             if ( !item.second->HasProperty(ItemProperties::Navigation) )
                 continue;
 
-            NavigationList tables = NavTablesFromManifestItem(sharedMe, item.second);
+            NavigationList tables = NavTablesFromManifestItem(sharedMe, item.second, prefetchedDocument(item.second));
             for ( auto& table : tables )
             {
                 // have to dynamic_cast these guys to get the right pointer type
@@ -608,7 +618,7 @@ void Package::LoadNavigationTables()
                     if (!bool(tocItem))
                         throw EPUBError::OPFNoNavDocument;
 
-                    NavigationList tables = NavTablesFromManifestItem(sharedMe, tocItem);
+                    NavigationList tables = NavTablesFromManifestItem(sharedMe, tocItem, prefetchedDocument(tocItem));
                     for (auto& table : tables)
                     {
                         // have to dynamic_cast these guys to get the right pointer type
@@ -641,6 +651,47 @@ void Package::LoadNavigationTables()
 }
 
 
+// Parses a package's navigation documents on another thread while the rest of its OPF
+// is read. A document which fails is simply left out, so that LoadNavigationTables()
+// reads it again and reports the failure where it always has.
+class NavDocumentPrefetch
+{
+public:
+    typedef std::map<ManifestItemPtr, shared_ptr<xml::Document>>    DocumentMap;
+    
+    NavDocumentPrefetch() : _thread(), _documents() {}
+    ~NavDocumentPrefetch() { Join(); }
+    
+    void Start(std::vector<ManifestItemPtr> items)
+    {
+        _thread = std::thread([this, items]() {
+            for (auto& item : items)
+            {
+                try
+                {
+                    auto doc = item->ReferencedDocument();
+                    if (bool(doc))
+                        _documents[item] = doc;
+                }
+                catch (...)
+                {
+                }
+            }
+        });
+    }
+    
+    DocumentMap Join()
+    {
+        if (_thread.joinable())
+            _thread.join();
+        return std::move(_documents);
+    }
+    
+private:
+    std::thread     _thread;
+    DocumentMap     _documents;
+};
+
 bool Package::Unpack(bool skipLoadingPotentiallyEncryptedContent)
 {
     PackagePtr sharedMe = shared_from_this();
@@ -748,14 +799,7 @@ bool Package::Unpack(bool skipLoadingPotentiallyEncryptedContent)
             auto p = std::make_shared<ManifestItem>(sharedMe); //ManifestItem::New(sharedMe);
             if ( p->ParseXML(node) )
             {
-#if EPUB_HAVE(CXX_MAP_EMPLACE)
-                _manifestByID.emplace(p->Identifier(), p);
-                _manifestByAbsolutePath.emplace(p->AbsolutePath(), p);
-#else
-                _manifestByID[p->Identifier()] = p;
-                _manifestByAbsolutePath[p->AbsolutePath()] = p;
-#endif
-                StoreXMLIdentifiable(p);
+                AddManifestItem(p);
             }
             else
             {
@@ -788,6 +832,8 @@ bool Package::Unpack(bool skipLoadingPotentiallyEncryptedContent)
         }
         
         SpineItemPtr cur;
+        _spineItems.clear();
+        _spineIndexByIDRef.clear();
         for ( auto node : spineNodes )
         {
             auto next = std::make_shared<SpineItem>(sharedMe); //SpineItem::New(sharedMe);
@@ -833,6 +879,10 @@ bool Package::Unpack(bool skipLoadingPotentiallyEncryptedContent)
                 _spine = next;
             }
             
+            next->_index = _spineItems.size();
+            _spineItems.push_back(next);
+            _spineIndexByIDRef.emplace(next->Idref(), next->_index);
+            
             cur = next;
         }
     }
@@ -851,6 +901,21 @@ bool Package::Unpack(bool skipLoadingPotentiallyEncryptedContent)
     manifestNodes.clear();
     spineNodes.clear();
     
+    // the navigation documents only need the manifest, so when opening in parallel they're
+    // parsed alongside the collections and metadata below
+    NavDocumentPrefetch navPrefetch;
+    if (!skipLoadingPotentiallyEncryptedContent && Container::ParallelOpenEnabled())
+    {
+        std::vector<ManifestItemPtr> navItems;
+        for (auto& pair : _manifestByID)
+        {
+            if (pair.second->HasProperty(ItemProperties::Navigation) || pair.second->MediaType() == NCXContentType)
+                navItems.push_back(pair.second);
+        }
+        if (!navItems.empty())
+            navPrefetch.Start(std::move(navItems));
+    }
+    
     // collections
     xml::NodeSet collectionNodes;
     
@@ -1175,6 +1240,7 @@ bool Package::Unpack(bool skipLoadingPotentiallyEncryptedContent)
 
     if (!skipLoadingPotentiallyEncryptedContent)
     {
+        _prefetchedNavDocuments = navPrefetch.Join();
         Unpack_Finally(false);
     }
 
@@ -1213,17 +1279,19 @@ void Package::InstallPrefixesFromAttributeValue(const string& attrValue)
         ++pos;
     }
 }
-string Package::UniqueID() const
+string Package::MakeUniqueID(const string& packageID, const string& modificationDate)
 {
-    string packageID = PackageID();
     if ( packageID.empty() )
         return string::EmptyString;
     
-    string modDate = ModificationDate();
-    if ( modDate.empty() )
+    if ( modificationDate.empty() )
         return packageID;
     
-    return _Str(packageID, "@", modDate);
+    return _Str(packageID, "@", modificationDate);
+}
+string Package::UniqueID() const
+{
+    return MakeUniqueID(PackageID(), ModificationDate());
 }
 string Package::URLSafeUniqueID() const
 {
@@ -1249,14 +1317,20 @@ string Package::URLSafeUniqueID() const
     return _Str(packageID, '_', modDate);
 }
 string Package::PackageID() const
+{
+    if ( !bool(_opf) )
+        return _packageID;
+    return PackageIDInDocument(_opf);
+}
+string Package::PackageIDInDocument(shared_ptr<xml::Document> opf)
 {
 #if EPUB_COMPILER_SUPPORTS(CXX_INITIALIZER_LISTS)
-    XPathWrangler xpath(_opf, {{"opf", OPFNamespace}, {"dc", DCNamespace}});
+    XPathWrangler xpath(opf, {{"opf", OPFNamespace}, {"dc", DCNamespace}});
 #else
     XPathWrangler::NamespaceList __m;
     __m["opf"] = OPFNamespace;
     __m["dc"] = DCNamespace;
-    XPathWrangler xpath(_opf, __m);
+    XPathWrangler xpath(opf, __m);
 #endif
     XPathWrangler::StringList strings = xpath.Strings("//*[@id=/opf:package/@unique-identifier]/text()");
     if ( strings.empty() )
@@ -1265,6 +1339,8 @@ string Package::PackageID() const
 }
 string Package::Version() const
 {
+    if ( !bool(_opf) )
+        return _version;
     return _getProp(_opf->Root(), "version");
 }
 void Package::FireLoadEvent(const IRI &url) const
@@ -1287,13 +1363,7 @@ void Package::FireLoadEvent(const IRI &url) const
 }
 shared_ptr<SpineItem> Package::SpineItemWithIDRef(const string &idref) const
 {
-    for ( auto item = FirstSpineItem(); item != nullptr; item = item->Next() )
-    {
-        if ( item->Idref() == idref )
-            return item;
-    }
-    
-    return nullptr;
+    return SpineItemAt(IndexOfSpineItemWithIDRef(idref));
 }
 const CFI Package::CFIForManifestItem(shared_ptr<ManifestItem> item) const
 {
@@ -1342,7 +1412,9 @@ shared_ptr<ManifestItem> Package::ManifestItemForCFI(ePub3::CFI &cfi, CFI* pRema
     {
         if ( (component.nodeIndex & 1) == 1 )
             throw CFI::InvalidCFI("CFI spine item index is odd, which makes no sense for always-empty spine nodes.");
-        SpineItemPtr item = _spine->at((component.nodeIndex>>1)-1);
+        SpineItemPtr item = SpineItemAt((component.nodeIndex>>1)-1);
+        if ( item == nullptr )
+            throw std::out_of_range(_Str("Index ", (component.nodeIndex>>1)-1, " is out of range"));
         
         // check and correct any qualifiers
         item = ConfirmOrCorrectSpineItemQualifier(item, &component);
@@ -1405,140 +1477,107 @@ size_t Package::GetFilterChainSize(ManifestItemPtr manifestItem) const
     return _filterChain->GetFilterChainSize(manifestItem);
 }
 
-const string& Package::Title(bool localized) const
+shared_ptr<const Package::MetadataCache> Package::CachedMetadata() const
 {
-    IRI titleTypeIRI(MakePropertyIRI("title-type"));      // http://idpf.org/epub/vocab/package/#title-type
+    uint64_t generation = PropertyGeneration();
+    auto cache = std::atomic_load(&_metadataCache);
+    if ( cache && cache->generation == generation )
+        return cache;
     
-    // find the main one
-    for ( auto& item : PropertiesMatching(titleTypeIRI) )
+    auto fresh = std::make_shared<MetadataCache>();
+    fresh->generation = generation;
+    
+    IRI titleTypeIRI(MakePropertyIRI("title-type"));      // http://idpf.org/epub/vocab/package/#title-type
+    for ( auto& item : PropertiesMatching(InternIRI(titleTypeIRI)) )
     {
         PropertyExtensionPtr extension = item->ExtensionWithIdentifier(titleTypeIRI);
-        if ( extension == nullptr )
-            continue;
-        
-        if ( extension->Value() == "main" )
-            return (localized? item->LocalizedValue() : item->Value());
+        if ( extension != nullptr )
+            fresh->titlesByType.emplace(extension->Value(), item);   // the first one of each type wins
     }
     
+    fresh->titles = PropertiesMatching(DCType::Title);
+    
+    IRI displaySeqIRI(MakePropertyIRI("display-seq"));  // http://idpf.org/epub/vocab/package/#display-seq
+    for ( auto& item : PropertiesMatching(InternIRI(displaySeqIRI)) )
+    {
+        // all these have a 1-based sequence number
+        PropertyExtensionPtr extension = item->ExtensionWithIdentifier(displaySeqIRI);
+        if ( extension != nullptr )
+            fresh->sequencedTitles.emplace_back(strtoul(extension->Value().c_str(), nullptr, 10) - 1, item);
+    }
+    
+    IRI fileAsIRI(MakePropertyIRI("file-as"));
+    fresh->creators = PropertiesMatching(DCType::Creator);
+    for ( auto& item : fresh->creators )
+    {
+        fresh->creatorsFileAs.push_back(item->ExtensionWithIdentifier(fileAsIRI));
+    }
+    
+    fresh->termsCreators = PropertiesMatching(InternPropertyIRI("creator", "dcterms"));
+    fresh->contributors = PropertiesMatching(InternPropertyIRI("contributor", "dcterms"));
+    fresh->subjects = PropertiesMatching(DCType::Subject);
+    
+    auto first = [](const PropertyList& items) { return (items.empty() ? nullptr : items[0]); };
+    fresh->publisher = first(PropertiesMatching(DCType::Publisher));
+    fresh->language = first(PropertiesMatching(DCType::Language));
+    fresh->source = first(PropertiesMatching(DCType::Source));
+    fresh->rights = first(PropertiesMatching(DCType::Rights));
+    fresh->modified = first(PropertiesMatching(InternPropertyIRI("modified", "dcterms")));
+    
+    fresh->pageProgression = PropertyMatching(InternPropertyIRI("page-progression-direction"));
+    fresh->activeClass = PropertyMatching(InternPropertyIRI("active-class", "media"));
+    fresh->playbackActiveClass = PropertyMatching(InternPropertyIRI("playback-active-class", "media"));
+    fresh->durationTotal = PropertyMatching(InternPropertyIRI("duration", "media"), false);
+    fresh->narrator = PropertyMatching(InternPropertyIRI("narrator", "media"));
+    
+    cache = fresh;
+    std::atomic_store(&_metadataCache, cache);
+    return cache;
+}
+static const string& _TitleOfType(const std::map<string, PropertyPtr>& titlesByType, const string& type, bool localized)
+{
+    auto found = titlesByType.find(type);
+    if ( found == titlesByType.end() )
+        return string::EmptyString;
+    return (localized ? found->second->LocalizedValue() : found->second->Value());
+}
+const string& Package::Title(bool localized) const
+{
+    auto cache = CachedMetadata();
+    
+    // find the main one
+    auto found = cache->titlesByType.find("main");
+    if ( found != cache->titlesByType.end() )
+        return (localized? found->second->LocalizedValue() : found->second->Value());
+    
     // no 'main title' found: just get the dc:title value
-    auto items = PropertiesMatching(DCType::Title);
-    if ( items.empty() )
+    if ( cache->titles.empty() )
         return string::EmptyString;
     
     if ( localized )
-        return items[0]->LocalizedValue();
+        return cache->titles[0]->LocalizedValue();
     
-    return items[0]->Value();
+    return cache->titles[0]->Value();
 }
 const string& Package::Subtitle(bool localized) const
 {
-    IRI titleTypeIRI(MakePropertyIRI("title-type"));      // http://idpf.org/epub/vocab/package/#title-type
-    
-    // find the main one
-    for ( auto item : PropertiesMatching(titleTypeIRI) )
-    {
-        PropertyExtensionPtr extension = item->ExtensionWithIdentifier(titleTypeIRI);
-        if ( extension == nullptr )
-            continue;
-        
-        if ( extension->Value() == "subtitle" )
-        {
-            if ( localized )
-                return item->LocalizedValue();
-            return item->Value();
-        }
-    }
-    
-    // no 'subtitle' found, so no subtitle
-    return string::EmptyString;
+    return _TitleOfType(CachedMetadata()->titlesByType, "subtitle", localized);
 }
 const string& Package::ShortTitle(bool localized) const
 {
-    IRI titleTypeIRI(MakePropertyIRI("title-type"));      // http://idpf.org/epub/vocab/package/#title-type
-    
-    // find the main one
-    for ( auto item : PropertiesMatching(titleTypeIRI) )
-    {
-        PropertyExtensionPtr extension = item->ExtensionWithIdentifier(titleTypeIRI);
-        if ( extension == nullptr )
-            continue;
-        
-        if ( extension->Value() == "short" )
-        {
-            if ( localized )
-                return item->LocalizedValue();
-            return item->Value();
-        }
-    }
-    
-    // no 'subtitle' found, so no subtitle
-    return string::EmptyString;
+    return _TitleOfType(CachedMetadata()->titlesByType, "short", localized);
 }
 const string& Package::CollectionTitle(bool localized) const
 {
-    IRI titleTypeIRI(MakePropertyIRI("title-type"));      // http://idpf.org/epub/vocab/package/#title-type
-    
-    // find the main one
-    for ( auto item : PropertiesMatching(titleTypeIRI) )
-    {
-        PropertyExtensionPtr extension = item->ExtensionWithIdentifier(titleTypeIRI);
-        if ( extension == nullptr )
-            continue;
-        
-        if ( extension->Value() == "collection" )
-        {
-            if ( localized )
-                return item->LocalizedValue();
-            return item->Value();
-        }
-    }
-    
-    // no 'subtitle' found, so no subtitle
-    return string::EmptyString;
+    return _TitleOfType(CachedMetadata()->titlesByType, "collection", localized);
 }
 const string& Package::EditionTitle(bool localized) const
 {
-    IRI titleTypeIRI(MakePropertyIRI("title-type"));      // http://idpf.org/epub/vocab/package/#title-type
-    
-    // find the main one
-    for ( auto item : PropertiesMatching(titleTypeIRI) )
-    {
-        PropertyExtensionPtr extension = item->ExtensionWithIdentifier(titleTypeIRI);
-        if ( extension == nullptr )
-            continue;
-        
-        if ( extension->Value() == "edition" )
-        {
-            if ( localized )
-                return item->LocalizedValue();
-            return item->Value();
-        }
-    }
-    
-    // no 'subtitle' found, so no subtitle
-    return string::EmptyString;
+    return _TitleOfType(CachedMetadata()->titlesByType, "edition", localized);
 }
 const string& Package::ExpandedTitle(bool localized) const
 {
-    IRI titleTypeIRI(MakePropertyIRI("title-type"));      // http://idpf.org/epub/vocab/package/#title-type
-    
-    // find the main one
-    for ( auto item : PropertiesMatching(titleTypeIRI) )
-    {
-        PropertyExtensionPtr extension = item->ExtensionWithIdentifier(titleTypeIRI);
-        if ( extension == nullptr )
-            continue;
-        
-        if ( extension->Value() == "expanded" )
-        {
-            if ( localized )
-                return item->LocalizedValue();
-            return item->Value();
-        }
-    }
-    
-    // no 'subtitle' found, so no subtitle
-    return string::EmptyString;
+    return _TitleOfType(CachedMetadata()->titlesByType, "expanded", localized);
 }
 const string Package::FullTitle(bool localized) const
 {
@@ -1546,22 +1585,19 @@ const string Package::FullTitle(bool localized) const
     if ( !expanded.empty() )
         return expanded;
     
-    auto items = PropertiesMatching(DCType::Title);
+    auto cache = CachedMetadata();
+    auto& items = cache->titles;
     if ( items.size() == 1 )
         return items[0]->Value();
     
-    IRI displaySeqIRI(MakePropertyIRI("display-seq"));  // http://idpf.org/epub/vocab/package/#display-seq
     std::vector<string> titles(items.size());
     
-    auto sequencedItems = PropertiesMatching(displaySeqIRI);
-    if ( !sequencedItems.empty() )
+    if ( !cache->sequencedTitles.empty() )
     {
-        // all these have a 1-based sequence number
-        for ( auto item : sequencedItems )
+        for ( auto& item : cache->sequencedTitles )
         {
-            PropertyExtensionPtr extension = item->ExtensionWithIdentifier(displaySeqIRI);
-            size_t sz = strtoul(extension->Value().c_str(), nullptr, 10) - 1;
-            titles[sz] = (localized ? item->LocalizedValue() : item->Value());
+            if ( item.first < titles.size() )
+                titles[item.first] = (localized ? item.second->LocalizedValue() : item.second->Value());
         }
     }
     else
@@ -1590,8 +1626,9 @@ const string Package::FullTitle(bool localized) const
 }
 const Package::AttributionList Package::AuthorNames(bool localized) const
 {
+    auto cache = CachedMetadata();
     AttributionList result;
-    for ( auto item : PropertiesMatching(DCType::Creator) )
+    for ( auto& item : cache->creators )
     {
         result.emplace_back((localized? item->LocalizedValue() : item->Value()));
     }
@@ -1599,7 +1636,7 @@ const Package::AttributionList Package::AuthorNames(bool localized) const
     if ( result.empty() )
     {
         // maybe they're using dcterms:creator instead?
-        for ( auto item : PropertiesMatching(MakePropertyIRI("creator", "dcterms")) )
+        for ( auto& item : cache->termsCreators )
         {
             result.emplace_back((localized? item->LocalizedValue() : item->Value()));
         }
@@ -1609,11 +1646,12 @@ const Package::AttributionList Package::AuthorNames(bool localized) const
 }
 const Package::AttributionList Package::AttributionNames(bool localized) const
 {
+    auto cache = CachedMetadata();
     AttributionList result;
-    IRI fileAsIRI(MakePropertyIRI("file-as"));
-    for ( auto item : PropertiesMatching(DCType::Creator) )
+    for ( size_t i = 0; i < cache->creators.size(); i++ )
     {
-        auto extension = item->ExtensionWithIdentifier(fileAsIRI);
+        auto& item = cache->creators[i];
+        auto& extension = cache->creatorsFileAs[i];
         if ( extension )
             result.emplace_back(extension->Value());
         else
@@ -1646,7 +1684,7 @@ const string Package::Authors(bool localized) const
 const Package::AttributionList Package::ContributorNames(bool localized) const
 {
     AttributionList result;
-    for ( auto item : PropertiesMatching(MakePropertyIRI("contributor", "dcterms")) )
+    for ( auto& item : CachedMetadata()->contributors )
     {
         result.emplace_back((localized? item->LocalizedValue() : item->Value()));
     }
@@ -1676,17 +1714,17 @@ const string Package::Contributors(bool localized) const
 }
 const string& Package::Publisher() const
 {
-    auto items = PropertiesMatching(DCType::Publisher);
-    if ( items.empty() )
+    auto prop = CachedMetadata()->publisher;
+    if ( !prop )
         return string::EmptyString;
-    return items[0]->Value();
+    return prop->Value();
 }
 const string& Package::Language() const
 {
-    auto items = PropertiesMatching(DCType::Language);
-    if ( items.empty() )
+    auto prop = CachedMetadata()->language;
+    if ( !prop )
         return string::EmptyString;
-    return items[0]->Value();
+    return prop->Value();
 }
 shared_ptr<ManifestItem> Package::CoverManifestItem() const
 {
@@ -1705,7 +1743,7 @@ const string& Package::MediaOverlays_ActiveClass() const
     // See:
     // http://www.idpf.org/epub/30/spec/epub30-mediaoverlays.html#sec-package-metadata
 
-    PropertyPtr prop = PropertyMatching("active-class", "media");
+    PropertyPtr prop = CachedMetadata()->activeClass;
     if (prop != nullptr)
     {
         return prop->Value();
@@ -1721,7 +1759,7 @@ const string& Package::MediaOverlays_PlaybackActiveClass() const
     // see:
     // https://epub-revision.googlecode.com/svn/trunk/build/301/spec/epub30-mediaoverlays.html#sec-package-metadata
 
-    PropertyPtr prop = PropertyMatching("playback-active-class", "media");
+    PropertyPtr prop = CachedMetadata()->playbackActiveClass;
     if (prop != nullptr)
     {
         return prop->Value();
@@ -1736,7 +1774,7 @@ const string& Package::MediaOverlays_DurationTotal() const
     // See:
     // http://www.idpf.org/epub/30/spec/epub30-mediaoverlays.html#sec-package-metadata
 
-    PropertyPtr prop = PropertyMatching("duration", "media", false);
+    PropertyPtr prop = CachedMetadata()->durationTotal;
     if (prop != nullptr)
     {
         return prop->Value();
@@ -1751,7 +1789,7 @@ const string& Package::MediaOverlays_DurationItem(const std::shared_ptr<Manifest
     // See:
     // http://www.idpf.org/epub/30/spec/epub30-mediaoverlays.html#sec-package-metadata
 
-    auto iri = MakePropertyIRI("duration", "media");
+    auto iri = InternPropertyIRI("duration", "media");
 
     PropertyPtr prop = manifestItem->PropertyMatching(iri, false);
     if (prop == nullptr)
@@ -1775,7 +1813,7 @@ const string& Package::MediaOverlays_Narrator(bool localized) const
     // See:
     // http://www.idpf.org/epub/30/spec/epub30-mediaoverlays.html#sec-package-metadata
 
-    PropertyPtr prop = PropertyMatching("narrator", "media");
+    PropertyPtr prop = CachedMetadata()->narrator;
     if (prop != nullptr)
     {
         return localized ? prop->LocalizedValue() : prop->Value();
@@ -1787,24 +1825,24 @@ const string& Package::MediaOverlays_Narrator(bool localized) const
 }
 const string& Package::Source(bool localized) const
 {
-    auto items = PropertiesMatching(DCType::Source);
-    if ( items.empty() )
+    auto prop = CachedMetadata()->source;
+    if ( !prop )
         return string::EmptyString;
-    return (localized? items[0]->LocalizedValue() : items[0]->Value());
+    return (localized? prop->LocalizedValue() : prop->Value());
 }
 const string& Package::CopyrightOwner(bool localized) const
 {
-    auto items = PropertiesMatching(DCType::Rights);
-    if ( items.empty() )
+    auto prop = CachedMetadata()->rights;
+    if ( !prop )
         return string::EmptyString;
-    return (localized? items[0]->LocalizedValue() : items[0]->Value());
+    return (localized? prop->LocalizedValue() : prop->Value());
 }
 const string& Package::ModificationDate() const
 {
-    auto items = PropertiesMatching(MakePropertyIRI("modified", "dcterms"));
-    if ( items.empty() )
+    auto prop = CachedMetadata()->modified;
+    if ( !prop )
         return string::EmptyString;
-    return items[0]->Value();
+    return prop->Value();
 }
 const string Package::ISBN() const
 {
@@ -1822,7 +1860,7 @@ const string Package::ISBN() const
 const Package::StringList Package::Subjects(bool localized) const
 {
     StringList result;
-    for ( auto item : PropertiesMatching(DCType::Subject) )
+    for ( auto& item : CachedMetadata()->subjects )
     {
         result.emplace_back((localized? item->LocalizedValue() : item->Value()));
     }
@@ -1830,7 +1868,7 @@ const Package::StringList Package::Subjects(bool localized) const
 }
 PageProgression Package::PageProgressionDirection() const
 {
-    PropertyPtr prop = PropertyMatching("page-progression-direction");
+    PropertyPtr prop = CachedMetadata()->pageProgression;
     if ( prop )
     {
         if ( prop->Value() == "ltr" )
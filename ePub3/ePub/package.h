@@ -34,6 +34,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <list>
 #include <ePub3/xml/node.h>
 #include <ePub3/utilities/owned_by.h>
@@ -166,6 +167,10 @@ public:
      */
     EPUB3_EXPORT
     shared_ptr<SpineItem>   SpineItemAt(size_t idx) const;
+    
+    ///
+    /// Returns the number of items in the spine. O(1).
+    size_t                  SpineItemCount()        const       { return _spineItems.size(); }
 
     EPUB3_EXPORT
     size_t                  IndexOfSpineItemWithIDRef(const string& idref)  const;
@@ -273,8 +278,12 @@ protected:
     string                    _type;                   ///< The MIME type of the package document.
     ManifestTable             _manifestByID;           ///< All manifest items, indexed by unique identifier.
     ManifestTable             _manifestByAbsolutePath; ///< All manifest items, indexed by absolute path.
+    std::unordered_map<string, shared_ptr<ManifestItem>> _manifestByDecodedPath; ///< All manifest items, indexed by percent-decoded absolute path.
     NavigationMap             _navigation;             ///< All navigation tables, indexed by type.
+    std::map<shared_ptr<ManifestItem>, shared_ptr<xml::Document>> _prefetchedNavDocuments; ///< Navigation documents parsed during a parallel open, for LoadNavigationTables().
     ContentHandlerMap         _contentHandlers;        ///< All installed content handlers, indexed by media-type.
+    shared_vector<SpineItem>  _spineItems;             ///< Every spine item, in order; declared before _spine so the list is torn down iteratively.
+    std::unordered_map<string, size_t> _spineIndexByIDRef; ///< Index of the first spine item referencing each manifest item.
     shared_ptr<SpineItem>     _spine;                  ///< The first item in the spine (SpineItems are a linked list).
     XMLIDLookup               _xmlIDLookup;            ///< Lookup table for all items with XML ID values.
     CollectionList            _collections;            ///< List of all parsed <collection> elements.
@@ -283,6 +292,10 @@ protected:
     // used to verify/correct CFIs
     uint32_t					_spineCFIIndex;     ///< The CFI index for the `<spine>` element in the package document.
     
+    ///
+    /// Indexes a new manifest item by identifier, path and XML ID.
+    void                    AddManifestItem(const shared_ptr<ManifestItem>& item);
+    
     ///
     /// Unpacks the _opf document. Implemented by the subclass, to make PackageBase pure-virtual.
     virtual bool            Unpack(bool skipLoadingPotentiallyEncryptedContent = false) = 0;
@@ -296,7 +309,8 @@ protected:
     
     ///
     /// Loads navigation tables from a given manifest item (which has the `"nav"` property) or one referencing an NCX document.
-    static NavigationList   NavTablesFromManifestItem(shared_ptr<PackageBase> owner, shared_ptr<ManifestItem> pItem);
+    /// If `doc` is `nullptr` the item's document is read and parsed here.
+    static NavigationList   NavTablesFromManifestItem(shared_ptr<PackageBase> owner, shared_ptr<ManifestItem> pItem, shared_ptr<xml::Document> doc = nullptr);
 
 private:
 	// these are only called by NavTablesFromManifestItem()
@@ -391,9 +405,28 @@ public:
     virtual bool            Open(const string& path, bool skipLoadingPotentiallyEncryptedContent = false);
     bool                    _OpenForTest(shared_ptr<xml::Document> doc, const string& basePath);
     
+protected:
+    ///
+    /// The part of Open() which follows loading the OPF document: builds the filter chain,
+    /// unpacks the OPF and its navigation documents, and applies the container's vendor metadata.
+    bool                    _FinishOpen(bool skipLoadingPotentiallyEncryptedContent);
+    
+    // Container's parallel open loads every OPF before finishing any of them
+    friend class Container;
+    friend class PackageSnapshot;
+    
+public:
+    
     ///
     /// The full Unique Identifier, built from the package unique-id and the modification date.
     virtual string          UniqueID()              const;
+    /**
+     Builds a full Unique Identifier the way UniqueID() does.
+     @param packageID The package's unique-id, as PackageID() gives it.
+     @param modificationDate The package's `dcterms:modified` date, as written in the OPF.
+     @result The Unique Identifier, or an empty string if there is no unique-id.
+     */
+    static string           MakeUniqueID(const string& packageID, const string& modificationDate);
     ///
     /// A version of the UniqueID which is suitable for use as a hostname.
     virtual string          URLSafeUniqueID()       const;
@@ -401,6 +434,9 @@ public:
     /// The package's unique-id on its own, without the revision modifier.
     virtual string          PackageID()             const;
     ///
+    /// Finds the unique-id in an OPF document the way PackageID() does.
+    static string           PackageIDInDocument(shared_ptr<xml::Document> opf);
+    ///
     /// MIME type of this package document (usually `application/oebps-package+xml`).
     virtual const string&   Type()                  const       { return _type; }
     ///
@@ -976,10 +1012,43 @@ protected:
     LoadEventHandler        _loadEventHandler;      ///< The current handler for load events.
     MediaSupportList        _mediaSupport;          ///< A list of media types with their support details.
     EPUB2PropertyList       _EPUB2Properties;       ///< A list of EPUB 2 properties for backward compatibility.
+    string                  _version;               ///< The OPF version, for packages restored from a PackageSnapshot (which have no OPF document).
+    string                  _packageID;             ///< The unique-id, for packages restored from a PackageSnapshot.
     
     void                    InitMediaSupport();
     
     FilterChainPtr          _filterChain;           ///< The filter chain for this package.
+    
+    ///
+    /// The properties reported by Title(), Authors() and the other metadata getters.
+    struct MetadataCache
+    {
+        uint64_t                                generation;         ///< The PropertyGeneration() this cache reflects.
+        std::map<string, PropertyPtr>           titlesByType;       ///< The first title carrying each `title-type` value.
+        PropertyList                            titles;             ///< All `dc:title` properties.
+        std::vector<std::pair<size_t, PropertyPtr>> sequencedTitles;    ///< Titles with a `display-seq`, paired with their zero-based position.
+        PropertyList                            creators;           ///< All `dc:creator` properties.
+        std::vector<PropertyExtensionPtr>       creatorsFileAs;     ///< The `file-as` refinement of each creator, if any.
+        PropertyList                            termsCreators;      ///< All `dcterms:creator` properties.
+        PropertyList                            contributors;       ///< All `dcterms:contributor` properties.
+        PropertyList                            subjects;           ///< All `dc:subject` properties.
+        PropertyPtr                             publisher;
+        PropertyPtr                             language;
+        PropertyPtr                             source;
+        PropertyPtr                             rights;
+        PropertyPtr                             modified;
+        PropertyPtr                             pageProgression;
+        PropertyPtr                             activeClass;
+        PropertyPtr                             playbackActiveClass;
+        PropertyPtr                             durationTotal;
+        PropertyPtr                             narrator;
+    };
+    
+    mutable shared_ptr<const MetadataCache> _metadataCache; ///< Swapped atomically; rebuilt when the property generation changes.
+    
+    ///
+    /// Returns the metadata cache, rebuilding it if any property has changed since it was made.
+    shared_ptr<const MetadataCache> CachedMetadata()    const;
 };
 
 EPUB3_END_NAMESPACE
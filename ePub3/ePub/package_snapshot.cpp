@@ -0,0 +1,651 @@
+//
+//  package_snapshot.cpp
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this
+//  list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//  this list of conditions and the following disclaimer in the documentation and/or
+//  other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be
+//  used to endorse or promote products derived from this software without specific
+//  prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+//  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+//  OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+//  OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "package_snapshot.h"
+#include "container.h"
+#include "package.h"
+#include "archive.h"
+#include "encryption.h"
+#include "manifest.h"
+#include "spine.h"
+#include "nav_table.h"
+#include "nav_point.h"
+#include "property.h"
+#include "property_extension.h"
+#include "filter_manager.h"
+#include "content_handler.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <typeinfo>
+#include <unordered_map>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+EPUB3_BEGIN_NAMESPACE
+
+static const uint32_t gSnapshotMagic = 0x53335045;     // "EP3S", little-endian
+static const char * gSnapshotExtension = ".epubsnapshot";
+
+static std::mutex gSnapshotLock;
+static string gSnapshotDirectory;
+
+/**
+ Accumulates the words and strings of a snapshot.
+ */
+class PackageSnapshot::Writer
+{
+public:
+    Writer() : _words(), _offsets(1, 0), _strings(), _index() {}
+    
+    void                Word(uint32_t value)            { _words.push_back(value); }
+    void                Count(size_t value)             { _words.push_back(static_cast<uint32_t>(value)); }
+    void                String(const string& str)
+    {
+        auto found = _index.find(str.stl_str());
+        if ( found != _index.end() )
+        {
+            Word(found->second);
+            return;
+        }
+        
+        uint32_t idx = static_cast<uint32_t>(_offsets.size() - 1);
+        _index.emplace(str.stl_str(), idx);
+        _strings.append(str.stl_str());
+        _offsets.push_back(static_cast<uint32_t>(_strings.size()));
+        Word(idx);
+    }
+    
+    bool                WriteTo(const string& path, Header& header) const
+    {
+        header.stringCount = static_cast<uint32_t>(_offsets.size() - 1);
+        header.wordCount = static_cast<uint32_t>(_words.size());
+        
+        // write to a temporary file and rename it, so readers never see half a snapshot
+        string tmpPath = _Str(path, ".", reinterpret_cast<uintptr_t>(this));
+        {
+            std::ofstream out(tmpPath.stl_str(), std::ios::binary|std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(_words.data()), _words.size() * sizeof(uint32_t));
+            out.write(reinterpret_cast<const char*>(_offsets.data()), _offsets.size() * sizeof(uint32_t));
+            out.write(_strings.data(), _strings.size());
+            if ( !out.good() )
+            {
+                out.close();
+                std::remove(tmpPath.c_str());
+                return false;
+            }
+        }
+        
+        if ( std::rename(tmpPath.c_str(), path.c_str()) != 0 )
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+    
+private:
+    std::vector<uint32_t>                       _words;
+    std::vector<uint32_t>                       _offsets;
+    std::string                                 _strings;
+    std::unordered_map<std::string, uint32_t>   _index;
+};
+
+/**
+ Reads back the words and strings of a snapshot, throwing std::out_of_range if
+ the data is truncated or refers to a string which doesn't exist.
+ */
+class PackageSnapshot::Reader
+{
+public:
+    Reader(const uint32_t* words, size_t wordCount, const uint32_t* offsets, size_t stringCount, const char* strings, size_t stringBytes)
+        : _words(words), _end(words + wordCount), _strings(), _identifiers()
+    {
+        _strings.reserve(stringCount);
+        for ( size_t i = 0; i < stringCount; i++ )
+        {
+            if ( offsets[i] > offsets[i+1] || offsets[i+1] > stringBytes )
+                throw std::out_of_range("Invalid string table in package snapshot");
+            _strings.emplace_back(strings + offsets[i], offsets[i+1] - offsets[i]);
+        }
+    }
+    
+    uint32_t            Word()
+    {
+        if ( _words == _end )
+            throw std::out_of_range("Truncated package snapshot");
+        return *_words++;
+    }
+    size_t              Count()
+    {
+        // no count can exceed the number of words left to describe the items
+        uint32_t n = Word();
+        if ( n > static_cast<size_t>(_end - _words) )
+            throw std::out_of_range("Invalid count in package snapshot");
+        return n;
+    }
+    const string&       String()                        { return _strings.at(Word()); }
+    const IRI&          Identifier()
+    {
+        // the same few property IRIs appear over and over, so each is only parsed once
+        uint32_t idx = Word();
+        auto found = _identifiers.find(idx);
+        if ( found != _identifiers.end() )
+            return found->second;
+        
+        const string& str = _strings.at(idx);
+        return _identifiers.emplace(idx, (str.empty() ? IRI() : IRI(str))).first->second;
+    }
+    
+    bool                AtEnd()                 const   { return _words == _end; }
+    
+private:
+    const uint32_t*     _words;
+    const uint32_t*     _end;
+    std::vector<string> _strings;
+    std::unordered_map<uint32_t, IRI>   _identifiers;
+};
+
+void PackageSnapshot::SetDirectory(const string& path)
+{
+    std::lock_guard<std::mutex> _(gSnapshotLock);
+    gSnapshotDirectory = path;
+}
+string PackageSnapshot::Directory()
+{
+    std::lock_guard<std::mutex> _(gSnapshotLock);
+    return gSnapshotDirectory;
+}
+string PackageSnapshot::PathForArchive(const string& archivePath)
+{
+    string dir = Directory();
+    if ( dir.empty() )
+        return string::EmptyString;
+    
+    // FNV-1a: stable across runs and platforms, unlike std::hash
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for ( unsigned char ch : archivePath.stl_str() )
+    {
+        hash ^= ch;
+        hash *= 0x100000001b3ULL;
+    }
+    
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    
+    if ( dir[dir.size()-1] != '/' )
+        dir += '/';
+    return _Str(dir, name, gSnapshotExtension);
+}
+void PackageSnapshot::Discard(const string& archivePath)
+{
+    string path = PathForArchive(archivePath);
+    if ( !path.empty() )
+        std::remove(path.c_str());
+}
+
+bool PackageSnapshot::DescribeArchive(const string& archivePath, const shared_ptr<Archive>& archive, Header& header)
+{
+    struct stat sb;
+    if ( !bool(archive) || ::stat(archivePath.c_str(), &sb) != 0 )
+        return false;
+    
+    header.magic = gSnapshotMagic;
+    header.version = FormatVersion;
+    header.archiveSize = static_cast<uint64_t>(sb.st_size);
+    header.archiveModified = static_cast<int64_t>(sb.st_mtime);
+    
+    // the central directory's CRCs catch any change to the content, without reading it
+    uLong crc = crc32(0L, Z_NULL, 0);
+    uint32_t count = 0;
+    archive->EachItem([&](const ArchiveItemInfo& info) {
+        std::string name = info.Path().stl_str();
+        uint32_t itemCRC = info.CRC();
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(name.data()), static_cast<uInt>(name.size()));
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(&itemCRC), sizeof(itemCRC));
+        count++;
+    });
+    
+    header.entryCount = count;
+    header.entryChecksum = static_cast<uint32_t>(crc);
+    header.stringCount = header.wordCount = 0;
+    return true;
+}
+
+bool PackageSnapshot::CanSave(const PackagePtr& package)
+{
+    if ( !package->_collections.empty() )
+        return false;
+    
+    // only the handlers from the OPF's <bindings> can be recreated
+    for ( auto& pair : package->_contentHandlers )
+    {
+        for ( auto& handler : pair.second )
+        {
+            if ( typeid(*handler) != typeid(MediaHandler) )
+                return false;
+        }
+    }
+    
+    // don't write out the contents of encrypted navigation documents
+    for ( auto& item : package->_manifestByID )
+    {
+        bool isNavigation = item.second->HasProperty(ItemProperties::Navigation) || item.second->MediaType() == "application/x-dtbncx+xml";
+        if ( isNavigation && package->GetFilterChainSize(item.second) > 0 )
+            return false;
+    }
+    
+    return true;
+}
+
+bool PackageSnapshot::Save(ContainerPtr container)
+{
+    string path = PathForArchive(container->Path());
+    if ( path.empty() || container->_packages.empty() )
+        return false;
+    
+    for ( auto& package : container->_packages )
+    {
+        if ( !CanSave(package) )
+            return false;
+    }
+    
+    Header header;
+    if ( !DescribeArchive(container->Path(), container->_archive, header) )
+        return false;
+    
+    Writer writer;
+    writer.String(container->_appleIBooksDisplayOption_FixedLayout);
+    writer.String(container->_appleIBooksDisplayOption_Orientation);
+    
+    writer.Count(container->_encryption.size());
+    for ( auto& enc : container->_encryption )
+    {
+        writer.String(enc->_algorithm);
+        writer.String(enc->_keyRetrievalMethodType);
+        writer.String(enc->_path);
+        writer.String(enc->_compression_method);
+        writer.String(enc->_uncompressed_size);
+    }
+    
+    writer.Count(container->_packages.size());
+    for ( auto& package : container->_packages )
+    {
+        WritePackage(writer, package);
+    }
+    
+    return writer.WriteTo(path, header);
+}
+
+void PackageSnapshot::WritePackage(Writer& writer, const PackagePtr& package)
+{
+    writer.String(package->_type);
+    writer.String(package->_pathBase);
+    writer.Word(package->_spineCFIIndex);
+    writer.String(package->Version());
+    writer.String(package->PackageID());
+    
+    WriteProperties(writer, *package);
+    
+    writer.Count(package->_EPUB2Properties.size());
+    for ( auto& pair : package->_EPUB2Properties )
+    {
+        writer.String(pair.first);
+        writer.String(pair.second);
+    }
+    
+    writer.Count(package->_manifestByID.size());
+    for ( auto& pair : package->_manifestByID )
+    {
+        const ManifestItemPtr& item = pair.second;
+        writer.String(item->XMLIdentifier());
+        writer.String(item->_href);
+        writer.String(item->_mediaType);
+        writer.String(item->_mediaOverlayID);
+        writer.String(item->_fallbackID);
+        writer.Word(item->_parsedProperties);
+        WriteProperties(writer, *item);
+    }
+    
+    writer.Count(package->_spineItems.size());
+    for ( auto& item : package->_spineItems )
+    {
+        writer.String(item->XMLIdentifier());
+        writer.String(item->_idref);
+        writer.Word(item->_linear ? 1 : 0);
+        writer.String(item->_toc_title);
+        WriteProperties(writer, *item);
+    }
+    
+    writer.Count(package->_contentHandlers.size());
+    for ( auto& pair : package->_contentHandlers )
+    {
+        writer.String(pair.first);
+        writer.Count(pair.second.size());
+        for ( auto& handler : pair.second )
+        {
+            writer.String(std::static_pointer_cast<MediaHandler>(handler)->_handlerIRI.Path(false));
+        }
+    }
+    
+    writer.Count(package->_navigation.size());
+    for ( auto& pair : package->_navigation )
+    {
+        const NavigationTablePtr& table = pair.second;
+        writer.String(table->Type());
+        writer.String(table->Title());
+        writer.String(table->SourceHref());
+        WriteNavigation(writer, table->Children());
+    }
+}
+
+void PackageSnapshot::WriteProperties(Writer& writer, const PropertyHolder& holder)
+{
+    // only the vocabularies added to the reserved ones need to be stored
+    const PropertyHolder::PropertyVocabularyMap& vocabularies = holder._vocabularyLookup;
+    size_t added = 0;
+    for ( auto& pair : vocabularies )
+    {
+        auto reserved = PropertyHolder::ReservedVocabularies.find(pair.first);
+        if ( reserved == PropertyHolder::ReservedVocabularies.end() || reserved->second != pair.second )
+            added++;
+    }
+    
+    writer.Count(added);
+    for ( auto& pair : vocabularies )
+    {
+        auto reserved = PropertyHolder::ReservedVocabularies.find(pair.first);
+        if ( reserved != PropertyHolder::ReservedVocabularies.end() && reserved->second == pair.second )
+            continue;
+        writer.String(pair.first);
+        writer.String(pair.second);
+    }
+    
+    writer.Count(holder._properties.size());
+    for ( auto& prop : holder._properties )
+    {
+        writer.Word(static_cast<uint32_t>(prop->_type));
+        writer.String(prop->_identifier.URIString());
+        writer.String(prop->_value);
+        writer.String(prop->_language);
+        writer.String(prop->XMLIdentifier());
+        
+        writer.Count(prop->_extensions.size());
+        for ( auto& ext : prop->_extensions )
+        {
+            writer.String(ext->_identifier.URIString());
+            writer.String(ext->_value);
+            writer.String(ext->_scheme);
+            writer.String(ext->_language);
+            writer.String(ext->XMLIdentifier());
+        }
+    }
+}
+
+void PackageSnapshot::WriteNavigation(Writer& writer, const NavigationList& children)
+{
+    writer.Count(children.size());
+    for ( auto& child : children )
+    {
+        NavigationPointPtr point = std::dynamic_pointer_cast<NavigationPoint>(child);
+        writer.String(child->Title());
+        writer.String(bool(point) ? point->Content() : string::EmptyString);
+        WriteNavigation(writer, child->Children());
+    }
+}
+
+bool PackageSnapshot::Restore(ContainerPtr container)
+{
+    string path = PathForArchive(container->Path());
+    if ( path.empty() || !container->_packages.empty() )
+        return false;
+    
+    std::ifstream in(path.stl_str(), std::ios::binary|std::ios::ate);
+    if ( !in.is_open() )
+        return false;
+    
+    // read the whole file in one go; it's a few tens of kilobytes at most
+    std::streamoff size = in.tellg();
+    if ( size < static_cast<std::streamoff>(sizeof(Header)) )
+        return false;
+    
+    std::vector<uint32_t> data(static_cast<size_t>((size + 3) / 4));
+    in.seekg(0);
+    if ( !in.read(reinterpret_cast<char*>(data.data()), size) )
+        return false;
+    
+    Header header, expected;
+    memcpy(&header, data.data(), sizeof(Header));
+    if ( !DescribeArchive(container->Path(), container->_archive, expected) )
+        return false;
+    
+    if ( header.magic != expected.magic || header.version != expected.version ||
+         header.archiveSize != expected.archiveSize || header.archiveModified != expected.archiveModified ||
+         header.entryCount != expected.entryCount || header.entryChecksum != expected.entryChecksum )
+    {
+        // out of date: it'll be replaced once the container has been opened
+        return false;
+    }
+    
+    const uint64_t headerWords = sizeof(Header) / sizeof(uint32_t);
+    const uint64_t tableWords = headerWords + header.wordCount + header.stringCount + 1;
+    if ( tableWords * sizeof(uint32_t) > static_cast<uint64_t>(size) )
+        return false;
+    
+    const uint32_t* words = data.data() + headerWords;
+    const uint32_t* offsets = words + header.wordCount;
+    const char* strings = reinterpret_cast<const char*>(offsets + header.stringCount + 1);
+    size_t stringBytes = static_cast<size_t>(size - tableWords * sizeof(uint32_t));
+    
+    Container::EncryptionList encryption;
+    Container::PackageList packages;
+    string fixedLayout, orientation;
+    
+    try
+    {
+        Reader reader(words, header.wordCount, offsets, header.stringCount, strings, stringBytes);
+        
+        fixedLayout = reader.String();
+        orientation = reader.String();
+        
+        for ( size_t i = 0, n = reader.Count(); i < n; i++ )
+        {
+            auto enc = std::make_shared<EncryptionInfo>(container);
+            enc->_algorithm = reader.String();
+            enc->_keyRetrievalMethodType = reader.String();
+            enc->_path = reader.String();
+            enc->_compression_method = reader.String();
+            enc->_uncompressed_size = reader.String();
+            encryption.push_back(enc);
+        }
+        
+        for ( size_t i = 0, n = reader.Count(); i < n; i++ )
+        {
+            packages.push_back(ReadPackage(reader, container));
+        }
+        
+        if ( !reader.AtEnd() || packages.empty() )
+            return false;
+    }
+    catch (std::exception&)
+    {
+        return false;
+    }
+    
+    // all read: now the container can be populated, and the packages' filter chains built
+    container->_encryption = std::move(encryption);
+    container->IndexEncryption();
+    container->_appleIBooksDisplayOption_FixedLayout = fixedLayout;
+    container->_appleIBooksDisplayOption_Orientation = orientation;
+    
+    auto fm = FilterManager::Instance();
+    for ( auto& package : packages )
+    {
+        package->SetFilterChain(fm->BuildFilterChainForPackage(package));
+        package->InitMediaSupport();
+        package->LoadMediaOverlays();
+    }
+    
+    container->_packages = std::move(packages);
+    return true;
+}
+
+PackagePtr PackageSnapshot::ReadPackage(Reader& reader, const ContainerPtr& container)
+{
+    string type = reader.String();
+    PackagePtr package = std::make_shared<Package>(container, type);
+    
+    package->_pathBase = reader.String();
+    package->_spineCFIIndex = reader.Word();
+    package->_version = reader.String();
+    package->_packageID = reader.String();
+    
+    ReadProperties(reader, std::static_pointer_cast<PropertyHolder>(package));
+    
+    for ( size_t i = 0, n = reader.Count(); i < n; i++ )
+    {
+        const string& name = reader.String();
+        package->_EPUB2Properties[name] = reader.String();
+    }
+    
+    // the same tables, in the same order, as Package::Unpack()
+    for ( size_t i = 0, n = reader.Count(); i < n; i++ )
+    {
+        auto item = std::make_shared<ManifestItem>(package);
+        item->SetXMLIdentifier(reader.String());
+        item->_href = reader.String();
+        item->_mediaType = reader.String();
+        item->_mediaOverlayID = reader.String();
+        item->_fallbackID = reader.String();
+        item->_parsedProperties = reader.Word();
+        ReadProperties(reader, item);
+        
+        package->AddManifestItem(item);
+    }
+    
+    SpineItemPtr cur;
+    for ( size_t i = 0, n = reader.Count(); i < n; i++ )
+    {
+        auto next = std::make_shared<SpineItem>(package);
+        next->SetXMLIdentifier(reader.String());
+        next->_idref = reader.String();
+        next->_linear = (reader.Word() != 0);
+        next->_toc_title = reader.String();
+        ReadProperties(reader, next);
+        
+        package->StoreXMLIdentifiable(next);
+        if ( bool(cur) )
+            cur->SetNextItem(next);
+        else
+            package->_spine = next;
+        
+        next->_index = package->_spineItems.size();
+        package->_spineItems.push_back(next);
+        package->_spineIndexByIDRef.emplace(next->Idref(), next->_index);
+        cur = next;
+    }
+    
+    // top-level properties come last, as they do when unpacking
+    package->ForEachProperty([&](PropertyPtr prop) {
+        package->StoreXMLIdentifiable(prop);
+    });
+    
+    for ( size_t i = 0, n = reader.Count(); i < n; i++ )
+    {
+        const string& mediaType = reader.String();
+        for ( size_t j = 0, m = reader.Count(); j < m; j++ )
+        {
+            package->_contentHandlers[mediaType].push_back(std::make_shared<MediaHandler>(package, mediaType, reader.String()));
+        }
+    }
+    
+    for ( size_t i = 0, n = reader.Count(); i < n; i++ )
+    {
+        const string& tableType = reader.String();
+        const string& title = reader.String();
+        auto table = std::make_shared<NavigationTable>(package, reader.String());
+        table->SetType(tableType);
+        table->SetTitle(title);
+        ReadNavigation(reader, table, table);
+        package->_navigation.emplace(table->Type(), table);
+    }
+    
+    return package;
+}
+
+void PackageSnapshot::ReadProperties(Reader& reader, const PropertyHolderPtr& holder)
+{
+    for ( size_t i = 0, n = reader.Count(); i < n; i++ )
+    {
+        const string& prefix = reader.String();
+        holder->_vocabularyLookup[prefix] = reader.String();
+    }
+    
+    PropertyHolderPtr owner = holder;
+    for ( size_t i = 0, n = reader.Count(); i < n; i++ )
+    {
+        auto prop = std::make_shared<Property>(owner);
+        prop->_type = static_cast<DCType>(reader.Word());
+        prop->_identifier = reader.Identifier();
+        prop->_value = reader.String();
+        prop->_language = reader.String();
+        prop->SetXMLIdentifier(reader.String());
+        
+        for ( size_t j = 0, m = reader.Count(); j < m; j++ )
+        {
+            auto ext = std::make_shared<PropertyExtension>(prop);
+            ext->_identifier = reader.Identifier();
+            ext->_value = reader.String();
+            ext->_scheme = reader.String();
+            ext->_language = reader.String();
+            ext->SetXMLIdentifier(reader.String());
+            prop->_extensions.push_back(ext);
+        }
+        
+        holder->_properties.push_back(prop);
+    }
+    
+    holder->PropertiesChanged();
+}
+
+void PackageSnapshot::ReadNavigation(Reader& reader, const shared_ptr<NavigationElement>& parent, shared_ptr<NavigationElement> table)
+{
+    for ( size_t i = 0, n = reader.Count(); i < n; i++ )
+    {
+        // like the navigation document parsers, every point is owned by its table
+        auto point = std::make_shared<NavigationPoint>(table);
+        point->SetTitle(reader.String());
+        point->SetContent(reader.String());
+        ReadNavigation(reader, point, table);
+        parent->AppendChild(point);
+    }
+}
+
+EPUB3_END_NAMESPACE
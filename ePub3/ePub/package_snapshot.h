@@ -0,0 +1,163 @@
+//
+//  package_snapshot.h
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this
+//  list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//  this list of conditions and the following disclaimer in the documentation and/or
+//  other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be
+//  used to endorse or promote products derived from this software without specific
+//  prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+//  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+//  OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+//  OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __ePub3__package_snapshot__
+#define __ePub3__package_snapshot__
+
+#include <ePub3/epub3.h>
+#include <ePub3/property_holder.h>
+#include <ePub3/nav_element.h>
+#include <vector>
+
+EPUB3_BEGIN_NAMESPACE
+
+class Archive;
+
+/**
+ Saves the unpacked contents of a container to a binary snapshot file, and
+ restores them from it, so that opening the same publication again needn't
+ parse any XML beyond META-INF/container.xml.
+ 
+ A snapshot holds the container's encryption data and vendor metadata, and for
+ each package its metadata properties (with their extensions and refinements),
+ manifest, spine, EPUB 2 properties, media handler bindings and navigation
+ tables. Media Overlays, media
+ support and filter chains are rebuilt from those when a snapshot is restored,
+ which is cheap: the SMIL documents themselves are only parsed on demand.
+ 
+ The file is a fixed header, an array of 32-bit words describing the model, a
+ table of string offsets and the string data itself; every string is stored
+ once. The header records the format version, the archive file's size and
+ modification time, and a CRC-32 over the name and CRC-32 of every entry in the
+ archive's central directory. A snapshot which doesn't match the archive in all
+ of these is ignored and replaced.
+ 
+ Snapshots are disabled until SetDirectory() is called. When enabled,
+ Container::Open() restores from a snapshot when it can, and saves one after
+ opening a publication the long way. Containers opened with
+ `skipLoadingPotentiallyEncryptedContent` (i.e. by a ContentModule) never use
+ snapshots, and packages containing collections or custom content handlers, or
+ whose navigation documents pass through a content filter, are never saved.
+ @ingroup utilities
+ */
+class PackageSnapshot
+{
+public:
+    ///
+    /// The current version of the file format. Snapshots of other versions are ignored.
+    static const uint32_t       FormatVersion = 1;
+    
+    /**
+     Sets the directory in which snapshots are kept, enabling them.
+     @param path The path of an existing, writable directory, or an empty string
+     to disable snapshots.
+     */
+    EPUB3_EXPORT
+    static void                 SetDirectory(const string& path);
+    
+    ///
+    /// The directory in which snapshots are kept; empty when disabled.
+    EPUB3_EXPORT
+    static string               Directory();
+    
+    ///
+    /// Whether Container::Open() saves and restores snapshots.
+    static bool                 IsEnabled()                 { return !Directory().empty(); }
+    
+    /**
+     Returns the path of the snapshot file for a given archive.
+     @param archivePath The filesystem path of an EPUB file.
+     @result The snapshot's path, or an empty string if snapshots are disabled.
+     */
+    EPUB3_EXPORT
+    static string               PathForArchive(const string& archivePath);
+    
+    /**
+     Writes a snapshot of a fully opened container.
+     @param container A container whose packages have all been unpacked.
+     @result `true` if the snapshot was written, `false` if the container can't be
+     represented by a snapshot or the file couldn't be written.
+     */
+    EPUB3_EXPORT
+    static bool                 Save(ContainerPtr container);
+    
+    /**
+     Loads a container's packages from its snapshot.
+     
+     The container must have an open archive and no packages. Nothing about it is
+     changed unless the whole snapshot is read successfully.
+     @param container The container to populate.
+     @result `true` if the container was populated from a valid snapshot.
+     */
+    EPUB3_EXPORT
+    static bool                 Restore(ContainerPtr container);
+    
+    ///
+    /// Deletes the snapshot for an archive, if there is one.
+    EPUB3_EXPORT
+    static void                 Discard(const string& archivePath);
+    
+private:
+                                PackageSnapshot()           _DELETED_;
+    
+    class Writer;
+    class Reader;
+    
+    ///
+    /// The fixed-size start of every snapshot file.
+    struct Header
+    {
+        uint32_t    magic;
+        uint32_t    version;
+        uint64_t    archiveSize;
+        int64_t     archiveModified;
+        uint32_t    entryCount;         ///< The number of entries in the archive.
+        uint32_t    entryChecksum;      ///< CRC-32 of each entry's name and CRC-32.
+        uint32_t    stringCount;
+        uint32_t    wordCount;
+    };
+    
+    ///
+    /// Describes the archive a snapshot was taken from (everything but the counts).
+    static bool                 DescribeArchive(const string& archivePath, const shared_ptr<Archive>& archive, Header& header);
+    
+    static bool                 CanSave(const PackagePtr& package);
+    
+    static void                 WritePackage(Writer& writer, const PackagePtr& package);
+    static void                 WriteProperties(Writer& writer, const PropertyHolder& holder);
+    static void                 WriteNavigation(Writer& writer, const NavigationList& children);
+    
+    static PackagePtr           ReadPackage(Reader& reader, const ContainerPtr& container);
+    static void                 ReadProperties(Reader& reader, const PropertyHolderPtr& holder);
+    static void                 ReadNavigation(Reader& reader, const shared_ptr<NavigationElement>& parent, shared_ptr<NavigationElement> table);
+    
+};
+
+EPUB3_END_NAMESPACE
+
+#endif /* defined(__ePub3__package_snapshot__) */
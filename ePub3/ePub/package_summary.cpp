@@ -0,0 +1,239 @@
+//
+//  package_summary.cpp
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this
+//  list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//  this list of conditions and the following disclaimer in the documentation and/or
+//  other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be
+//  used to endorse or promote products derived from this software without specific
+//  prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+//  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+//  OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+//  OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "package_summary.h"
+#include "package.h"
+#include "archive.h"
+#include "archive_xml.h"
+#include "xpath_wrangler.h"
+#include <ePub3/xml/document.h>
+#include <ePub3/xml/element.h>
+#include <ePub3/utilities/error_handler.h>
+#include <sstream>
+
+EPUB3_BEGIN_NAMESPACE
+
+static const char * gContainerFilePath = "META-INF/container.xml";
+static const char * gRootfilesXPath = "/ocf:container/ocf:rootfiles/ocf:rootfile";
+static const char * gOCFNamespace = "urn:oasis:names:tc:opendocument:xmlns:container";
+static const char * gDCNamespace = "http://purl.org/dc/elements/1.1/";
+
+static shared_ptr<xml::Document> __ReadDocument(ArchivePtr archive, const string& path)
+{
+    unique_ptr<ArchiveReader> r = archive->ReaderAtPath(path.stl_str());
+    if ( !bool(r) )
+        return nullptr;
+    
+    // these documents are read once and thrown away, so they bypass the DocumentCache
+    ArchiveXmlReader reader(std::move(r));
+#if ENABLE_XML_READ_DOC_MEMORY
+    return reader.readXml(path);
+#elif EPUB_USE(LIBXML2)
+    return reader.xmlReadDocument(path.c_str(), nullptr);
+#elif EPUB_USE(WIN_XML)
+    return reader.ReadDocument(path.c_str(), nullptr, 0);
+#endif
+}
+
+static bool __HasToken(const string& list, const string& token)
+{
+    std::istringstream ss(list.stl_str());
+    std::string word;
+    while ( ss >> word )
+    {
+        if ( word == token.stl_str() )
+            return true;
+    }
+    return false;
+}
+
+static bool __SummarizePackage(shared_ptr<xml::Document> opf, PackageSummary& summary)
+{
+    static const string kPackageName("package");
+    static const string kMetadataName("metadata");
+    static const string kManifestName("manifest");
+    static const string kSpineName("spine");
+    static const string kMetaName("meta");
+    static const string kItemName("item");
+    static const string kItemrefName("itemref");
+    static const string kTitleName("title");
+    static const string kCreatorName("creator");
+    static const string kIdentifierName("identifier");
+    
+    auto root = opf->Root();
+    if ( !bool(root) || root->Name() != kPackageName )
+        return false;
+    
+    string modified, mainTitleID, coverID, coverHref;
+    std::vector<std::pair<string, string>> titles;
+    
+    // <metadata>, <manifest> and <spine> are the only children we look at
+    for ( auto child = root->FirstElementChild(); bool(child); child = child->NextElementSibling() )
+    {
+        string name(child->Name());
+        if ( name == kMetadataName )
+        {
+            for ( auto node = child->FirstElementChild(); bool(node); node = node->NextElementSibling() )
+            {
+                auto ns = node->Namespace();
+                string nodeName(node->Name());
+                if ( ns != nullptr && ns->URI() == gDCNamespace )
+                {
+                    if ( nodeName == kTitleName )
+                    {
+                        titles.emplace_back(_getProp(node, "id"), node->Content());
+                    }
+                    else if ( nodeName == kCreatorName )
+                    {
+                        summary.authors.push_back(node->Content());
+                    }
+                    else if ( nodeName == kIdentifierName )
+                    {
+                        summary.identifiers.push_back(node->Content());
+                    }
+                }
+                else if ( nodeName == kMetaName )
+                {
+                    string property = _getProp(node, "property");
+                    string refines = _getProp(node, "refines");
+                    if ( property == "dcterms:modified" && refines.empty() )
+                    {
+                        if ( modified.empty() )
+                            modified = node->Content();
+                    }
+                    else if ( property == "title-type" && !refines.empty() && refines[0] == '#' )
+                    {
+                        if ( mainTitleID.empty() && node->Content() == "main" )
+                            mainTitleID = refines.substr(1);
+                    }
+                    else if ( property.empty() && _getProp(node, "name") == "cover" )
+                    {
+                        // EPUB 2: <meta name="cover" content="manifest-item-id"/>
+                        coverID = _getProp(node, "content");
+                    }
+                }
+            }
+        }
+        else if ( name == kManifestName )
+        {
+            for ( auto node = child->FirstElementChild(); bool(node); node = node->NextElementSibling() )
+            {
+                if ( node->Name() != kItemName )
+                    continue;
+                
+                // an EPUB 3 cover-image property wins over an EPUB 2 cover meta
+                bool isCoverImage = __HasToken(_getProp(node, "properties"), "cover-image");
+                if ( isCoverImage || (coverHref.empty() && !coverID.empty() && _getProp(node, "id") == coverID) )
+                    coverHref = _getProp(node, "href");
+                if ( isCoverImage )
+                    coverID.clear();
+            }
+        }
+        else if ( name == kSpineName )
+        {
+            for ( auto node = child->FirstElementChild(); bool(node); node = node->NextElementSibling() )
+            {
+                if ( node->Name() == kItemrefName )
+                    summary.spineSize++;
+            }
+        }
+    }
+    
+    for ( auto& title : titles )
+    {
+        if ( !mainTitleID.empty() && title.first == mainTitleID )
+        {
+            summary.title = title.second;
+            break;
+        }
+    }
+    if ( summary.title.empty() && !titles.empty() )
+        summary.title = titles[0].second;
+    
+    // exactly as the opened Package will have it
+    summary.packageID = Package::PackageIDInDocument(opf);
+    summary.uniqueID = Package::MakeUniqueID(summary.packageID, modified);
+    
+    if ( !coverHref.empty() )
+    {
+        // the same path ManifestItem::AbsolutePath() gives
+        size_t s = coverHref.find_first_of("#?");
+        if ( s != string::npos )
+            coverHref = coverHref.substr(0, s);
+        
+        size_t loc = summary.packagePath.rfind("/");
+        summary.coverPath = (loc == string::npos ? coverHref : _Str(summary.packagePath.substr(0, loc+1), coverHref));
+    }
+    
+    return true;
+}
+
+PackageSummary::SummaryList PackageSummary::ReadContainerAtPath(const string& path)
+{
+    ArchivePtr archive = Archive::Open(path.stl_str());
+    if ( !bool(archive) )
+        throw std::invalid_argument(_Str("Path does not point to a recognised archive file: '", path, "'"));
+    
+    auto ocf = __ReadDocument(archive, gContainerFilePath);
+    if ( !bool(ocf) )
+        throw std::invalid_argument(_Str("ZIP Path not recognised: '", gContainerFilePath, "'"));
+    
+#if EPUB_COMPILER_SUPPORTS(CXX_INITIALIZER_LISTS)
+    XPathWrangler xpath(ocf, { { "ocf", gOCFNamespace } });
+#else
+    XPathWrangler::NamespaceList __ns;
+    __ns["ocf"] = gOCFNamespace;
+    XPathWrangler xpath(ocf, __ns);
+#endif
+    
+    SummaryList result;
+    for ( auto rootfile : xpath.Nodes(gRootfilesXPath) )
+    {
+        PackageSummary summary;
+        summary.containerPath = path;
+        summary.packagePath = _getProp(rootfile, "full-path");
+        if ( summary.packagePath.empty() )
+            continue;
+        
+        auto opf = __ReadDocument(archive, summary.packagePath);
+        if ( !bool(opf) )
+        {
+            HandleError(EPUBError::OCFInvalidRootfileURL, _Str(__PRETTY_FUNCTION__, ": No OPF file at ", summary.packagePath.stl_str()));
+            continue;
+        }
+        
+        if ( __SummarizePackage(opf, summary) )
+            result.push_back(std::move(summary));
+        else
+            HandleError(EPUBError::OPFInvalidPackageDocument);
+    }
+    
+    return result;
+}
+
+EPUB3_END_NAMESPACE
@@ -0,0 +1,103 @@
+//
+//  package_summary.h
+//  ePub3
+//
+//  Copyright (c) 2014 Readium Foundation and/or its licensees. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification,
+//  are permitted provided that the following conditions are met:
+//  1. Redistributions of source code must retain the above copyright notice, this
+//  list of conditions and the following disclaimer.
+//  2. Redistributions in binary form must reproduce the above copyright notice,
+//  this list of conditions and the following disclaimer in the documentation and/or
+//  other materials provided with the distribution.
+//  3. Neither the name of the organization nor the names of its contributors may be
+//  used to endorse or promote products derived from this software without specific
+//  prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+//  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+//  OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+//  OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __ePub3__package_summary__
+#define __ePub3__package_summary__
+
+#include <ePub3/epub3.h>
+#include <vector>
+
+EPUB3_BEGIN_NAMESPACE
+
+/**
+ The handful of details a library needs to list a publication, read without
+ opening its container.
+ 
+ ReadContainerAtPath() reads the zip central directory, META-INF/container.xml
+ and each rootfile's OPF document, and looks only at the OPF's `<metadata>`,
+ `<manifest>` and `<spine>`. Nothing else is loaded: no encryption data, vendor
+ metadata, navigation documents, Media Overlays, filter chains or content
+ modules, and no Package object model is built. The parsed documents are not
+ added to the DocumentCache.
+ 
+ Nothing in the OPF is ever encrypted, so this works for DRM-protected
+ publications too.
+ @ingroup epub-model
+ */
+struct PackageSummary
+{
+    typedef std::vector<string>         StringList;
+    typedef std::vector<PackageSummary> SummaryList;
+    
+    ///
+    /// The filesystem path of the EPUB file.
+    string          containerPath;
+    ///
+    /// The container-relative path of the OPF document.
+    string          packagePath;
+    ///
+    /// The value of the identifier named by the package's `unique-identifier`, as
+    /// Package::PackageID() gives it.
+    string          packageID;
+    ///
+    /// The same value as Package::UniqueID() gives for this package once opened.
+    string          uniqueID;
+    ///
+    /// The title refined as the `main` title, otherwise the first `dc:title`.
+    string          title;
+    ///
+    /// Every `dc:creator`, in document order.
+    StringList      authors;
+    ///
+    /// Every `dc:identifier`, in document order.
+    StringList      identifiers;
+    ///
+    /// The container-relative path of the cover image, or an empty string.
+    string          coverPath;
+    ///
+    /// The number of `<itemref>` elements in the spine.
+    size_t          spineSize;
+    
+    PackageSummary() : spineSize(0) {}
+    
+    /**
+     Summarizes every package in an EPUB file.
+     @param path The filesystem path of an EPUB file.
+     @result One summary for each rootfile which names a readable OPF document, in
+     rootfile order.
+     @throws std::invalid_argument if the file isn't a zip archive or has no
+     META-INF/container.xml.
+     */
+    EPUB3_EXPORT
+    static SummaryList  ReadContainerAtPath(const string& path);
+    
+};
+
+EPUB3_END_NAMESPACE
+
+#endif /* defined(__ePub3__package_summary__) */
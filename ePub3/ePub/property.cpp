@@ -272,6 +272,8 @@ void Property::SetDCType(DCType type)
     {
         _identifier = IRIForDCType(type);
     }
+    
+    IdentifiersChanged();
 }
 void Property::SetPropertyIdentifier(const IRI& iri)
 {
@@ -289,6 +291,19 @@ void Property::SetPropertyIdentifier(const IRI& iri)
         _identifier.SetFragment(found->second.first);
         SetValue(found->second.second);
     }
+    
+    IdentifiersChanged();
+}
+void Property::AddExtension(const std::shared_ptr<PropertyExtension>& ext)
+{
+    _extensions.push_back(ext);
+    IdentifiersChanged();
+}
+void Property::IdentifiersChanged()
+{
+    auto owner = Owner();
+    if ( owner )
+        owner->PropertiesChanged();
 }
 const string& Property::LocalizedValue(const std::locale& locale) const
 {
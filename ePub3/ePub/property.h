@@ -172,6 +172,8 @@ private:
     
                             Property()                              _DELETED_;
     
+    friend class PackageSnapshot;
+    
 public:
                             Property(shared_ptr<PropertyHolder>& owner) : OwnedBy(owner), _type(DCType::Invalid), _value(), _language(), _extensions(), _identifier() {}
                             Property(const Property& o) : OwnedBy(o), XMLIdentifiable(o), _type(o._type), _value(o._value), _language(o._language), _extensions(o._extensions), _identifier(o._identifier) {}
@@ -288,13 +290,19 @@ public:
      Adds a new PropertyExtension which refines this Property's value.
      @param ext The new extension.
      */
-    void                        AddExtension(const std::shared_ptr<PropertyExtension>& ext) {
-        _extensions.push_back(ext);
-    }
+    EPUB3_EXPORT
+    void                        AddExtension(const std::shared_ptr<PropertyExtension>& ext);
     
     EPUB3_EXPORT
     bool                        HasExtensionWithIdentifier(const IRI& ident) const;
     
+    /**
+     Tells the owning PropertyHolder that this property's identifier or extensions
+     have changed, so it can rebuild its lookup tables.
+     */
+    EPUB3_EXPORT
+    void                        IdentifiersChanged();
+    
     /// @}
     
 public:
@@ -53,5 +53,22 @@ bool PropertyExtension::ParseMetaElement(shared_ptr<xml::Node> node)
     SetXMLIdentifier(_getProp(node, "id"));
     return true;
 }
+void PropertyExtension::SetPropertyIdentifier(const IRI& ident)
+{
+    _identifier = ident;
+    
+    auto owner = Owner();
+    if ( owner )
+        owner->IdentifiersChanged();
+}
+void PropertyExtension::SetValue(const string& value)
+{
+    _value = value;
+    
+    // values of extensions such as title-type decide which property a Package reports
+    auto owner = Owner();
+    if ( owner )
+        owner->IdentifiersChanged();
+}
 
 EPUB3_END_NAMESPACE
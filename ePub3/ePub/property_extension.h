@@ -84,7 +84,8 @@ public:
      Sets the property's identifier IRI.
      @param ident The new identifier.
      */
-    void            SetPropertyIdentifier(const IRI& ident) { _identifier = ident; }
+    EPUB3_EXPORT
+    void            SetPropertyIdentifier(const IRI& ident);
     
     ///
     /// Retrieves a scheme constant which determines how the Value() is interpreted.
@@ -104,7 +105,8 @@ public:
      Sets the property's string value.
      @param value The new value.
      */
-    void            SetValue(const string& value)       { _value = value; }
+    EPUB3_EXPORT
+    void            SetValue(const string& value);
     
     ///
     /// The language of the item (if applicable).
@@ -121,6 +123,8 @@ private:
     string      _scheme;
     string      _language;
     IRI         _identifier;
+    
+    friend class PackageSnapshot;
 };
 
 EPUB3_END_NAMESPACE
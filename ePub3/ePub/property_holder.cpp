@@ -29,6 +29,8 @@
 
 #include "property_holder.h"
 #include REGEX_INCLUDE
+#include <atomic>
+#include <mutex>
 
 EPUB3_BEGIN_NAMESPACE
 
@@ -104,11 +106,17 @@ const PropertyHolder::PropertyVocabularyMap PropertyHolder::ReservedVocabularies
 const std::map<const string, bool> PropertyHolder::CoreMediaTypes(&__mtype_values[0], &__mtype_values[13]);
 #endif
 
+static std::mutex                                       gInternLock;
+static std::unordered_map<std::string, PropertyHolder::InternedIRI>    gInternedIRIs;      ///< Keyed by canonical URI string.
+static std::unordered_map<std::string, PropertyHolder::InternedIRI>    gInternedNames;     ///< Keyed by vocabulary stem + reference, as written.
+static std::atomic<uint64_t>                            gPropertyGeneration(0);
+
 PropertyHolder& PropertyHolder::operator=(const PropertyHolder& o)
 {
     _parent = o._parent;
     _properties = o._properties;
     _vocabularyLookup = o._vocabularyLookup;
+    PropertiesChanged();
     return *this;
 }
 PropertyHolder& PropertyHolder::operator=(PropertyHolder&& o)
@@ -116,6 +124,7 @@ PropertyHolder& PropertyHolder::operator=(PropertyHolder&& o)
     _parent = std::move(o._parent);
     _properties = std::move(o._properties);
     _vocabularyLookup = std::move(o._vocabularyLookup);
+    PropertiesChanged();
     return *this;
 }
 void PropertyHolder::AppendProperties(const PropertyHolder& o, shared_ptr<PropertyHolder> sharedMe)
@@ -126,6 +135,7 @@ void PropertyHolder::AppendProperties(const PropertyHolder& o, shared_ptr<Proper
     }
     
     _properties.insert(_properties.end(), o._properties.begin(), o._properties.end());
+    PropertiesChanged();
 }
 void PropertyHolder::AppendProperties(PropertyHolder&& o, shared_ptr<PropertyHolder> sharedMe)
 {
@@ -134,6 +144,7 @@ void PropertyHolder::AppendProperties(PropertyHolder&& o, shared_ptr<PropertyHol
         i->SetOwner(sharedMe);
         _properties.push_back(std::move(i));
     }
+    PropertiesChanged();
 }
 void PropertyHolder::RemoveProperty(const IRI& iri)
 {
@@ -142,6 +153,7 @@ void PropertyHolder::RemoveProperty(const IRI& iri)
         if ( (*pos)->PropertyIdentifier() == iri )
         {
             _properties.erase(pos);
+            PropertiesChanged();
             break;
         }
     }
@@ -161,19 +173,31 @@ void PropertyHolder::ErasePropertyAt(size_type idx)
     auto pos = _properties.begin();
     pos += idx;
     _properties.erase(pos);
+    PropertiesChanged();
 }
 bool PropertyHolder::ContainsProperty(DCType type, bool lookupParents) const
 {
-    IRI iri = IRIForDCType(type);
-    return ContainsProperty(iri, lookupParents);
+    return ContainsProperty(InternIRI(type), lookupParents);
 }
 bool PropertyHolder::ContainsProperty(const IRI& iri, bool lookupParents) const
 {
-    for ( auto &i : _properties )
-    {
-        if ( i->PropertyIdentifier() == iri )
-            return true;
-    }
+    return ContainsProperty(InternIRI(iri), lookupParents);
+}
+bool PropertyHolder::ContainsProperty(const string& reference, const string& prefix, bool lookupParents) const
+{
+    InternedIRI iri = InternPropertyIRI(reference, prefix);
+    if ( iri == 0 )
+        return false;
+    return ContainsProperty(iri, lookupParents);
+}
+bool PropertyHolder::ContainsProperty(InternedIRI iri, bool lookupParents) const
+{
+    if ( iri == 0 )
+        return false;
+    
+    auto index = Index();
+    if ( index->identifiers.find(iri) != index->identifiers.end() )
+        return true;
 
     if (lookupParents)
     {
@@ -184,13 +208,6 @@ bool PropertyHolder::ContainsProperty(const IRI& iri, bool lookupParents) const
     
     return false;
 }
-bool PropertyHolder::ContainsProperty(const string& reference, const string& prefix, bool lookupParents) const
-{
-    IRI iri = MakePropertyIRI(reference, prefix);
-    if ( iri.IsEmpty() )
-        return false;
-    return ContainsProperty(iri, lookupParents);
-}
 bool PropertyHolder::ContainsProperty(DCType type) const
 {
 	return ContainsProperty(type, true);
@@ -208,35 +225,35 @@ bool PropertyHolder::ContainsProperty(const string& reference, const string& pre
 
 const PropertyHolder::PropertyList PropertyHolder::PropertiesMatching(DCType type, bool lookupParents) const
 {
-    IRI iri = IRIForDCType(type);
-    return PropertiesMatching(iri, lookupParents);
+    return PropertiesMatching(InternIRI(type), lookupParents);
 }
 const PropertyHolder::PropertyList PropertyHolder::PropertiesMatching(const IRI& iri, bool lookupParents) const
+{
+    return PropertiesMatching(InternIRI(iri), lookupParents);
+}
+const PropertyHolder::PropertyList PropertyHolder::PropertiesMatching(const string& reference, const string& prefix, bool lookupParents) const
+{
+    InternedIRI iri = InternPropertyIRI(reference, prefix);
+    if ( iri == 0 )
+        return PropertyList();
+    return PropertiesMatching(iri, lookupParents);
+}
+const PropertyHolder::PropertyList PropertyHolder::PropertiesMatching(InternedIRI iri, bool lookupParents) const
 {
     PropertyList output;
     BuildPropertyList(output, iri);
 
     if (lookupParents)
     {
-        auto parent = _parent.lock();
-        if ( parent )
+        // walk the chain directly rather than concatenating each parent's own result list
+        for ( auto parent = _parent.lock(); parent; parent = parent->_parent.lock() )
         {
-            //parent->BuildPropertyList(output, iri);
-
-            PropertyHolder::PropertyList pList = parent->PropertiesMatching(iri, lookupParents);
-            output.insert(output.end(), pList.begin(), pList.end());
+            parent->BuildPropertyList(output, iri);
         }
     }
 
     return output;
 }
-const PropertyHolder::PropertyList PropertyHolder::PropertiesMatching(const string& reference, const string& prefix, bool lookupParents) const
-{
-    IRI iri = MakePropertyIRI(reference, prefix);
-    if ( iri.IsEmpty() )
-        return PropertyList();
-    return PropertiesMatching(iri, lookupParents);
-}
 
 
 const PropertyHolder::PropertyList PropertyHolder::PropertiesMatching(DCType type) const
@@ -256,19 +273,28 @@ const PropertyHolder::PropertyList PropertyHolder::PropertiesMatching(const stri
 
 PropertyPtr PropertyHolder::PropertyMatching(DCType type, bool lookupParents) const
 {
-    IRI iri = IRIForDCType(type);
-    return PropertyMatching(iri, lookupParents);
+    return PropertyMatching(InternIRI(type), lookupParents);
 }
 PropertyPtr PropertyHolder::PropertyMatching(const IRI& iri, bool lookupParents) const
 {
-    // DEBUG
-    auto iriString = iri.URIString();
-
-    for ( auto &i : _properties )
-    {
-        if ( i->PropertyIdentifier() == iri )
-            return i;
-    }
+    return PropertyMatching(InternIRI(iri), lookupParents);
+}
+PropertyPtr PropertyHolder::PropertyMatching(const string& reference, const string& prefix, bool lookupParents) const
+{
+    InternedIRI iri = InternPropertyIRI(reference, prefix);
+    if ( iri == 0 )
+        return nullptr;
+    return PropertyMatching(iri, lookupParents);
+}
+PropertyPtr PropertyHolder::PropertyMatching(InternedIRI iri, bool lookupParents) const
+{
+    if ( iri == 0 )
+        return nullptr;
+    
+    auto index = Index();
+    auto found = index->identifiers.find(iri);
+    if ( found != index->identifiers.end() )
+        return found->second.front();
 
     if (lookupParents)
     {
@@ -279,13 +305,6 @@ PropertyPtr PropertyHolder::PropertyMatching(const IRI& iri, bool lookupParents)
 
     return nullptr;
 }
-PropertyPtr PropertyHolder::PropertyMatching(const string& reference, const string& prefix, bool lookupParents) const
-{
-    IRI iri = MakePropertyIRI(reference, prefix);
-    if ( iri.IsEmpty() )
-        return nullptr;
-    return PropertyMatching(iri, lookupParents);
-}
 
 
 PropertyPtr PropertyHolder::PropertyMatching(DCType type) const
@@ -303,6 +322,112 @@ PropertyPtr PropertyHolder::PropertyMatching(const string& reference, const stri
 	return PropertyMatching(reference, prefix, true);
 }
 
+PropertyHolder::InternedIRI PropertyHolder::InternIRI(const IRI& iri)
+{
+    if ( iri.IsEmpty() && !iri.IsURN() )
+        return 0;
+    
+    // IRI equality compares canonical URI strings (or URN components), so do we
+    std::string key = (iri.IsURN() ? iri.IRIString() : iri.URIString()).stl_str();
+    
+    std::lock_guard<std::mutex> _(gInternLock);
+    auto found = gInternedIRIs.find(key);
+    if ( found != gInternedIRIs.end() )
+        return found->second;
+    
+    InternedIRI result = static_cast<InternedIRI>(gInternedIRIs.size() + 1);
+    gInternedIRIs.emplace(std::move(key), result);
+    return result;
+}
+PropertyHolder::InternedIRI PropertyHolder::InternIRI(DCType type)
+{
+    static const std::vector<InternedIRI> __dctypes = []() {
+        std::vector<InternedIRI> result;
+        for ( uint32_t i = 0; i <= static_cast<uint32_t>(DCType::Type); i++ )
+        {
+            result.push_back(InternIRI(IRIForDCType(static_cast<DCType>(i))));
+        }
+        return result;
+    }();
+    
+    auto idx = static_cast<uint32_t>(type);
+    if ( idx >= __dctypes.size() )
+        return 0;
+    return __dctypes[idx];
+}
+PropertyHolder::InternedIRI PropertyHolder::InternPropertyIRI(const string& reference, const string& prefix) const
+{
+    auto found = _vocabularyLookup.find(prefix);
+    if ( found == _vocabularyLookup.end() )
+    {
+        auto parent = _parent.lock();
+        if ( parent )
+            return parent->InternPropertyIRI(reference, prefix);
+        
+        return 0;
+    }
+    
+    std::string name = found->second.stl_str() + reference.stl_str();
+    {
+        std::lock_guard<std::mutex> _(gInternLock);
+        auto pos = gInternedNames.find(name);
+        if ( pos != gInternedNames.end() )
+            return pos->second;
+    }
+    
+    InternedIRI result = InternIRI(IRI(string(name)));
+    
+    std::lock_guard<std::mutex> _(gInternLock);
+    gInternedNames.emplace(std::move(name), result);
+    return result;
+}
+uint64_t PropertyHolder::PropertyGeneration() const
+{
+    uint64_t result = _generation;
+    for ( auto parent = _parent.lock(); parent; parent = parent->_parent.lock() )
+    {
+        result = std::max(result, parent->_generation);
+    }
+    return result;
+}
+void PropertyHolder::PropertiesChanged()
+{
+    _generation = ++gPropertyGeneration;
+}
+shared_ptr<const PropertyHolder::PropertyIndex> PropertyHolder::Index() const
+{
+    auto index = std::atomic_load(&_index);
+    if ( index && index->generation == _generation )
+        return index;
+    
+    auto fresh = std::make_shared<PropertyIndex>();
+    fresh->generation = _generation;
+    for ( auto& prop : _properties )
+    {
+        InternedIRI ident = InternIRI(prop->PropertyIdentifier());
+        if ( ident != 0 )
+        {
+            fresh->identifiers[ident].push_back(prop);
+            fresh->references[ident].push_back(prop);
+        }
+        
+        for ( auto& extension : prop->Extensions() )
+        {
+            InternedIRI extIdent = InternIRI(extension->PropertyIdentifier());
+            if ( extIdent == 0 )
+                continue;
+            
+            // each property appears once per IRI, however many extensions share it
+            auto& list = fresh->references[extIdent];
+            if ( list.empty() || list.back() != prop )
+                list.push_back(prop);
+        }
+    }
+    
+    index = fresh;
+    std::atomic_store(&_index, index);
+    return index;
+}
 void PropertyHolder::RegisterPrefixIRIStem(const string &prefix, const string &iriStem)
 {
     auto found = _vocabularyLookup.find(prefix);
@@ -334,16 +459,15 @@ IRI PropertyHolder::PropertyIRIFromString(const string &attrValue) const
     // there are two captures, at indices 1 and 2
     return MakePropertyIRI(pieces.str(2), pieces.str(1));
 }
-void PropertyHolder::BuildPropertyList(PropertyList& output, const IRI& iri) const
+void PropertyHolder::BuildPropertyList(PropertyList& output, InternedIRI iri) const
 {
-    if ( iri.IsEmpty() )
+    if ( iri == 0 )
         return;
     
-    for ( auto& i : _properties )
-    {
-        if ( i->PropertyIdentifier() == iri || i->HasExtensionWithIdentifier(iri) )
-            output.push_back(i);
-    }
+    auto index = Index();
+    auto found = index->references.find(iri);
+    if ( found != index->references.end() )
+        output.insert(output.end(), found->second.begin(), found->second.end());
 }
 
 EPUB3_END_NAMESPACE
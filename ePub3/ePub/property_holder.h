@@ -33,6 +33,7 @@
 #include <ePub3/utilities/basic.h>
 #include <ePub3/utilities/owned_by.h>
 #include <ePub3/property.h>
+#include <unordered_map>
 
 EPUB3_BEGIN_NAMESPACE
 
@@ -54,6 +55,11 @@ public:
     /// A lookup table for property vocabulary IRI stubs, indexed by prefix.
     typedef std::map<string, string>            PropertyVocabularyMap;
     
+    ///
+    /// A small integer standing in for a property IRI. Equal IRIs always intern
+    /// to the same value, and zero stands for the empty IRI.
+    typedef uint32_t                            InternedIRI;
+    
     ///
     /// The list of Core Media Types from [OPF 3.0 ??5.1](http://idpf.org/epub/30/spec/epub30-publications.html#sec-core-media-types).
     static const std::map<const string, bool>   CoreMediaTypes;
@@ -62,16 +68,29 @@ public:
     static const std::map<DCType, const IRI>    DCTypeIRIs;
     
 private:
+    ///
+    /// The properties of a holder, grouped by interned IRI. Built on demand.
+    struct PropertyIndex
+    {
+        uint64_t                                        generation;     ///< The holder generation this index reflects.
+        std::unordered_map<InternedIRI, PropertyList>   identifiers;    ///< Properties by their own identifier, in document order.
+        std::unordered_map<InternedIRI, PropertyList>   references;     ///< Properties by their own identifier or that of any of their extensions.
+    };
+    
     weak_ptr<PropertyHolder>                    _parent;            ///< Parent object used to 'inherit' properties.
     PropertyList                                _properties;        ///< All properties, in document order.
     PropertyVocabularyMap                       _vocabularyLookup;  ///< A lookup table for property-prefix->IRI-stem mappings.
+    uint64_t                                    _generation;        ///< Bumped whenever the property list changes.
+    mutable shared_ptr<const PropertyIndex>     _index;             ///< Lookup tables for _properties; swapped atomically.
+    
+    friend class PackageSnapshot;
     
 public:
-                        PropertyHolder() : _parent(), _properties(), _vocabularyLookup(ReservedVocabularies) {}
+                        PropertyHolder() : _parent(), _properties(), _vocabularyLookup(ReservedVocabularies), _generation(0), _index() {}
     template <class _Parent>
-                        PropertyHolder(const shared_ptr<_Parent>& parent) : _parent(std::dynamic_pointer_cast<PropertyHolder>(parent)), _properties(), _vocabularyLookup(ReservedVocabularies) {}
-                        PropertyHolder(const PropertyHolder& o) : _parent(o._parent), _properties(o._properties), _vocabularyLookup(o._vocabularyLookup) {}
-                        PropertyHolder(PropertyHolder&& o) : _parent(std::move(o._parent)), _properties(std::move(o._properties)), _vocabularyLookup(std::move(o._vocabularyLookup)) {}
+                        PropertyHolder(const shared_ptr<_Parent>& parent) : _parent(std::dynamic_pointer_cast<PropertyHolder>(parent)), _properties(), _vocabularyLookup(ReservedVocabularies), _generation(0), _index() {}
+                        PropertyHolder(const PropertyHolder& o) : _parent(o._parent), _properties(o._properties), _vocabularyLookup(o._vocabularyLookup), _generation(o._generation), _index() {}
+                        PropertyHolder(PropertyHolder&& o) : _parent(std::move(o._parent)), _properties(std::move(o._properties)), _vocabularyLookup(std::move(o._vocabularyLookup)), _generation(o._generation), _index() {}
     virtual             ~PropertyHolder() {}
     
     virtual PropertyHolder& operator=(const PropertyHolder& o);
@@ -80,9 +99,9 @@ public:
     virtual size_type   NumberOfProperties() const                      { return _properties.size(); }
     
     
-    virtual void        AddProperty(const shared_ptr<Property>& prop)   { _properties.push_back(prop); }
-    virtual void        AddProperty(const shared_ptr<Property>&& prop)  { _properties.push_back(std::move(prop)); }
-    virtual void        AddProperty(Property* prop)                     { _properties.emplace_back(prop); }
+    virtual void        AddProperty(const shared_ptr<Property>& prop)   { _properties.push_back(prop); PropertiesChanged(); }
+    virtual void        AddProperty(const shared_ptr<Property>&& prop)  { _properties.push_back(std::move(prop)); PropertiesChanged(); }
+    virtual void        AddProperty(Property* prop)                     { _properties.emplace_back(prop); PropertiesChanged(); }
     
     EPUB3_EXPORT
     virtual void        AppendProperties(const PropertyHolder& properties, shared_ptr<PropertyHolder> sharedMe);
@@ -139,6 +158,60 @@ public:
     EPUB3_EXPORT
     PropertyPtr         PropertyMatching(const string& reference, const string& prefix="") const;
     
+    /// @{
+    /// @name Interned Lookups
+    
+    /**
+     Interns a property IRI.
+     @param iri The IRI to intern.
+     @result The interned value, shared by every IRI equal to `iri`.
+     */
+    EPUB3_EXPORT
+    static InternedIRI  InternIRI(const IRI& iri);
+    ///
+    /// Interns the IRI returned by IRIForDCType(). Zero for `Invalid` and `Custom`.
+    EPUB3_EXPORT
+    static InternedIRI  InternIRI(DCType type);
+    /**
+     Interns a property IRI built from a reference and vocabulary prefix.
+     
+     This is equivalent to `InternIRI(MakePropertyIRI(reference, prefix))`, but
+     remembers the result, so repeated calls don't parse the IRI again.
+     @result The interned value, or zero if the prefix is unknown.
+     */
+    EPUB3_EXPORT
+    InternedIRI         InternPropertyIRI(const string& reference, const string& prefix=string::EmptyString) const;
+    
+    EPUB3_EXPORT
+    bool                ContainsProperty(InternedIRI iri, bool lookupParents=true) const;
+    EPUB3_EXPORT
+    const PropertyList  PropertiesMatching(InternedIRI iri, bool lookupParents=true) const;
+    EPUB3_EXPORT
+    PropertyPtr         PropertyMatching(InternedIRI iri, bool lookupParents=true) const;
+    
+    /// @}
+    
+    /**
+     Returns a value which changes whenever the properties of this holder or any
+     of its parents change.
+     
+     Values come from a single process-wide counter, so the generation of a chain
+     of holders is the largest of their individual generations. Use it to
+     validate anything computed from the results of PropertiesMatching().
+     */
+    EPUB3_EXPORT
+    uint64_t            PropertyGeneration() const;
+    
+    /**
+     Records a change to the property list.
+     
+     AddProperty() and friends call this automatically, as do Property and
+     PropertyExtension when their identifiers or extensions change, or when the
+     value of an extension changes.
+     */
+    EPUB3_EXPORT
+    void                PropertiesChanged();
+    
     template <class _Function>
     inline FORCE_INLINE
     _Function           ForEachProperty(_Function __f) const
@@ -154,7 +227,12 @@ public:
     IRI                 PropertyIRIFromString(const string& value) const;
     
 protected:
-    void                BuildPropertyList(PropertyList& output, const IRI& iri) const;
+    void                BuildPropertyList(PropertyList& output, InternedIRI iri) const;
+    
+private:
+    ///
+    /// Returns the lookup tables for this holder's properties, rebuilding them if stale.
+    shared_ptr<const PropertyIndex> Index() const;
     
 };
 
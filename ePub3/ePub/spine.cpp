@@ -36,10 +36,10 @@ EPUB3_BEGIN_NAMESPACE
 const IRI SpineItem::PageSpreadRightPropertyIRI("http://idpf.org/epub/vocab/package/#page-spread-right");
 const IRI SpineItem::PageSpreadLeftPropertyIRI("http://idpf.org/epub/vocab/package/#page-spread-left");
 
-SpineItem::SpineItem(const shared_ptr<Package>& owner) : OwnedBy(owner), PropertyHolder(owner), _idref(), _linear(true), _next(), _prev()
+SpineItem::SpineItem(const shared_ptr<Package>& owner) : OwnedBy(owner), PropertyHolder(owner), _idref(), _linear(true), _next(), _prev(), _index(size_t(-1))
 {
 }
-SpineItem::SpineItem(SpineItem&& o) : OwnedBy(std::move(o)), PropertyHolder(std::move(o)), XMLIdentifiable(std::move(o)), _idref(std::move(o._idref)), _linear(o._linear), _prev(std::move(o._prev)), _next(std::move(o._next))
+SpineItem::SpineItem(SpineItem&& o) : OwnedBy(std::move(o)), PropertyHolder(std::move(o)), XMLIdentifiable(std::move(o)), _idref(std::move(o._idref)), _linear(o._linear), _prev(std::move(o._prev)), _next(std::move(o._next)), _index(o._index)
 {
 }
 SpineItem::~SpineItem()
@@ -66,6 +66,28 @@ bool SpineItem::ParseXML(shared_ptr<xml::Node> node)
     }
     return true;
 }
+size_t SpineItem::Count() const
+{
+    auto package = this->Owner();
+    if ( package && _index < package->SpineItemCount() )
+        return package->SpineItemCount() - _index;
+    
+    // not part of an indexed spine: walk it, iteratively
+    size_t count = 1;
+    for ( auto n = _next; n != nullptr; n = n->_next )
+        count++;
+    return count;
+}
+size_t SpineItem::Index() const
+{
+    if ( _index != size_t(-1) )
+        return _index;
+    
+    size_t index = 0;
+    for ( auto p = _prev.lock(); p != nullptr; p = p->_prev.lock() )
+        index++;
+    return index;
+}
 shared_ptr<ManifestItem> SpineItem::ManifestItem() const
 {
     auto package = this->Owner();
@@ -124,11 +124,15 @@ public:
     /// @name Metadata
     
     ///
-    /// Returns an O(n) count of items in the spine (starting with this item).
-    inline size_t       Count()             const       { return (_next == nullptr ? 1 : 1 + _next->Count()); }
+    /// Returns a count of items in the spine (starting with this item). O(1) for
+    /// items loaded from a package's spine.
+    EPUB3_EXPORT
+    size_t              Count()             const;
     ///
-    /// Returns the index of the current item in the overall spine. O(n).
-    inline size_t       Index()             const       { return (_prev.expired() ? 0 : _prev.lock()->Index() + 1); }
+    /// Returns the index of the current item in the overall spine. O(1) for items
+    /// loaded from a package's spine.
+    EPUB3_EXPORT
+    size_t              Index()             const;
     
     ///
     /// Returns this item's identifier (if any).
@@ -215,8 +219,10 @@ protected:
     
     weak_ptr<SpineItem>     _prev;              ///< The SpineItem preceding this one in the spine.
     shared_ptr<SpineItem>   _next;              ///< The SpineItem following this one in the spine.
+    size_t                  _index;             ///< Position in the owning package's spine index, or `size_t(-1)` if not indexed.
     
     friend class Package;
+    friend class PackageSnapshot;
     
     EPUB3_EXPORT
     void SetNextItem(const shared_ptr<SpineItem>& next);
@@ -31,16 +31,225 @@
 #include "package.h"
 #include "container.h"
 #include "filter_manager.h"
-#include REGEX_INCLUDE
+#include "markup_scanner.h"
 
 EPUB3_BEGIN_NAMESPACE
 
-static const REGEX_NS::regex_constants::syntax_option_type SwitchRegexFlags = REGEX_NS::regex::icase|REGEX_NS::regex::optimize|REGEX_NS::regex::ECMAScript;
+typedef MarkupScanner::Match    ScanMatch;
 
-REGEX_NS::regex SwitchPreprocessor::CommentedSwitchIdentifier("(?:<!--)(\\s*<(?:epub:)switch(?:.|\\n|\\r)*?<(?:epub:)default(?:.|\\n|\\r)*?>\\s*)(?:-->)((?:.|\\n|\\r)*?)(?:<!--)(\\s*</(?:epub:)default>(?:.|\\n|\\r)*?)(?:-->)", SwitchRegexFlags);
-REGEX_NS::regex SwitchPreprocessor::SwitchContentExtractor("<(?:epub:)?switch(?:.|\\n|\\r)*?>((?:.|\\n|\\r)*?)</(?:epub:)?switch(?:.|\\n|\\r)*?>", SwitchRegexFlags);
-REGEX_NS::regex SwitchPreprocessor::CaseContentExtractor("<(?:epub:)?case\\s+required-namespace=\"(.*?)\">((?:.|\\n|\\r)*?)</(?:epub:)?case(?:.|\\n|\\r)*?>", SwitchRegexFlags);
-REGEX_NS::regex SwitchPreprocessor::DefaultContentExtractor("<(?:epub:)?default(?:.|\\n|\\r)*?>((?:.|\\n|\\r)*?)</(?:epub:)?default(?:.|\\n|\\r)*?>", SwitchRegexFlags);
+// matches `name` or `epub:name` at p, regardless of case
+static ScanMatch MatchElementName(const char* p, const char* end, const char* name, size_t nameLen, size_t* matchedLen)
+{
+    if ( MarkupScanner::MatchLiteral(p, end, "epub:", 5, true) == ScanMatch::Found && MarkupScanner::MatchLiteral(p + 5, end, name, nameLen, true) == ScanMatch::Found )
+    {
+        *matchedLen = 5 + nameLen;
+        return ScanMatch::Found;
+    }
+    
+    if ( MarkupScanner::MatchLiteral(p, end, name, nameLen, true) == ScanMatch::Found )
+    {
+        *matchedLen = nameLen;
+        return ScanMatch::Found;
+    }
+    
+    return ScanMatch::None;
+}
+
+// finds the first `</name` or `</epub:name` at or after p
+static const char* FindEndTag(const char* p, const char* end, const char* name, size_t nameLen, size_t* tagNameLen)
+{
+    for ( p = MarkupScanner::FindLiteral(p, end, "</", 2, false); p != end; p = MarkupScanner::FindLiteral(p + 1, end, "</", 2, false) )
+    {
+        if ( MatchElementName(p + 2, end, name, nameLen, tagNameLen) == ScanMatch::Found )
+            return p;
+    }
+    return end;
+}
+
+/*
+ Uncomments switch compounds which have been commented out everywhere but the
+ content of their epub:default element, by dropping these four markers:
+ 
+     <!--<epub:switch ...> ... <epub:default>-->
+         default content
+     <!--</epub:default></epub:switch>-->
+ */
+class SwitchUncommenter : public MarkupScanner
+{
+public:
+    SwitchUncommenter() : MarkupScanner("<!--", false) {}
+    
+protected:
+    virtual ScanMatch MatchConstruct(const char* begin, const char* end, const char** matchEnd, std::string& output) OVERRIDE
+    {
+        const char* p = SkipSpace(begin + 4, end);
+        if ( MatchLiteral(p, end, "<epub:switch", 12, true) != ScanMatch::Found )
+            return ScanMatch::None;
+        
+        const char* def = FindLiteral(p + 12, end, "<epub:default", 13, true);
+        if ( def == end )
+            return ScanMatch::NoneFollowing;
+        
+        // the comment must end straight after a '>' (i.e. the epub:default start tag)
+        const char* firstClose = nullptr;
+        for ( const char* gt = FindChar(def + 13, end, '>'); gt != end && firstClose == nullptr; gt = FindChar(gt + 1, end, '>') )
+        {
+            const char* q = SkipSpace(gt + 1, end);
+            if ( MatchLiteral(q, end, "-->", 3, false) == ScanMatch::Found )
+                firstClose = q;
+        }
+        if ( firstClose == nullptr )
+            return ScanMatch::NoneFollowing;
+        
+        // ...and another must start straight before the epub:default end tag
+        const char* content = firstClose + 3;
+        const char* reopen = nullptr;
+        const char* endTag = nullptr;
+        for ( const char* c = FindLiteral(content, end, "<!--", 4, false); c != end && reopen == nullptr; c = FindLiteral(c + 1, end, "<!--", 4, false) )
+        {
+            const char* q = SkipSpace(c + 4, end);
+            if ( MatchLiteral(q, end, "</epub:default>", 15, true) == ScanMatch::Found )
+            {
+                reopen = c;
+                endTag = q;
+            }
+        }
+        if ( reopen == nullptr )
+            return ScanMatch::NoneFollowing;
+        
+        const char* lastClose = FindLiteral(endTag + 15, end, "-->", 3, false);
+        if ( lastClose == end )
+            return ScanMatch::NoneFollowing;
+        
+        output.append(begin + 4, firstClose);
+        output.append(content, reopen);
+        output.append(reopen + 4, lastClose);
+        *matchEnd = lastClose + 3;
+        return ScanMatch::Found;
+    }
+    
+};
+
+/*
+ Replaces each switch compound with the content of its first supported epub:case
+ element, or of its epub:default element.
+ */
+class SwitchReplacer : public MarkupScanner
+{
+public:
+    SwitchReplacer(const SwitchPreprocessor::NamespaceList& namespaces) : MarkupScanner("<", false), _namespaces(namespaces) {}
+    
+protected:
+    virtual ScanMatch MatchConstruct(const char* begin, const char* end, const char** matchEnd, std::string& output) OVERRIDE
+    {
+        size_t nameLen = 0;
+        if ( MatchElementName(begin + 1, end, "switch", 6, &nameLen) != ScanMatch::Found )
+            return ScanMatch::None;
+        
+        const char* content = FindChar(begin + 1 + nameLen, end, '>');
+        if ( content == end )
+            return ScanMatch::NoneFollowing;
+        ++content;
+        
+        const char* endTag = FindEndTag(content, end, "switch", 6, &nameLen);
+        if ( endTag == end )
+            return ScanMatch::NoneFollowing;
+        
+        const char* gt = FindChar(endTag + 2 + nameLen, end, '>');
+        if ( gt == end )
+            return ScanMatch::NoneFollowing;
+        
+        if ( !AppendCase(content, endTag, output) )
+            AppendDefault(content, endTag, output);
+        
+        *matchEnd = gt + 1;
+        return ScanMatch::Found;
+    }
+    
+private:
+    const SwitchPreprocessor::NamespaceList&    _namespaces;
+    
+    // finds the end of an element's content, and the end of its end tag
+    static const char* FindElementEnd(const char* content, const char* end, const char* name, size_t nameLen, const char** tagEnd)
+    {
+        size_t tagNameLen = 0;
+        const char* endTag = FindEndTag(content, end, name, nameLen, &tagNameLen);
+        if ( endTag == end )
+            return end;
+        
+        *tagEnd = FindChar(endTag + 2 + tagNameLen, end, '>');
+        return (*tagEnd == end ? end : endTag);
+    }
+    
+    // outputs the content of the first epub:case whose required namespace is supported
+    bool AppendCase(const char* p, const char* end, std::string& output) const
+    {
+        if ( _namespaces.empty() )
+            return false;
+        
+        for ( p = FindChar(p, end, '<'); p != end; p = FindChar(p, end, '<') )
+        {
+            const char* start = p++;
+            
+            size_t nameLen = 0;
+            if ( MatchElementName(start + 1, end, "case", 4, &nameLen) != ScanMatch::Found )
+                continue;
+            
+            const char* attr = SkipSpace(start + 1 + nameLen, end);
+            if ( attr == start + 1 + nameLen || MatchLiteral(attr, end, "required-namespace=\"", 20, true) != ScanMatch::Found )
+                continue;
+            
+            // the namespace runs to the first `">` on the same line
+            const char* ns = attr + 20;
+            const char* nsEnd = ns;
+            while ( nsEnd < end && *nsEnd != '\n' && *nsEnd != '\r' && !(nsEnd[0] == '"' && nsEnd + 1 < end && nsEnd[1] == '>') )
+                ++nsEnd;
+            if ( nsEnd == end || nsEnd[0] != '"' )
+                continue;
+            
+            const char* tagEnd = nullptr;
+            const char* content = nsEnd + 2;
+            const char* contentEnd = FindElementEnd(content, end, "case", 4, &tagEnd);
+            if ( contentEnd == end )
+                return false;
+            
+            for ( auto& supported : _namespaces )
+            {
+                if ( supported.stl_str().compare(0, std::string::npos, ns, nsEnd - ns) == 0 )
+                {
+                    output.append(content, contentEnd);
+                    return true;
+                }
+            }
+            
+            p = tagEnd + 1;
+        }
+        
+        return false;
+    }
+    
+    // outputs the content of the epub:default element
+    static void AppendDefault(const char* p, const char* end, std::string& output)
+    {
+        for ( p = FindChar(p, end, '<'); p != end; p = FindChar(p + 1, end, '<') )
+        {
+            size_t nameLen = 0;
+            if ( MatchElementName(p + 1, end, "default", 7, &nameLen) != ScanMatch::Found )
+                continue;
+            
+            const char* content = FindChar(p + 1 + nameLen, end, '>');
+            if ( content == end )
+                return;
+            
+            const char* tagEnd = nullptr;
+            const char* contentEnd = FindElementEnd(++content, end, "default", 7, &tagEnd);
+            if ( contentEnd != end )
+                output.append(content, contentEnd);
+            return;
+        }
+    }
+    
+};
 
 #if EPUB_COMPILER_SUPPORTS(CXX_INITIALIZER_LISTS)
 SwitchPreprocessor::NamespaceList SwitchPreprocessor::_supportedNamespaces{};
@@ -70,65 +279,17 @@ void * SwitchPreprocessor::FilterData(FilterContext* context, void *data, size_t
 {
     char* input = reinterpret_cast<char*>(data);
     
-    // handle partially-commented switch statements
-    std::string inputStr(reinterpret_cast<const char*>(data));
-    std::string replacement("$1$2$3");
-    std::string str = REGEX_NS::regex_replace(inputStr, CommentedSwitchIdentifier, replacement);
-    
-    // str now contains a non-commented value (or the input if no switch statements were commented out)
-    auto pos = REGEX_NS::sregex_iterator(str.begin(), str.end(), SwitchContentExtractor);
-    auto end = REGEX_NS::sregex_iterator();
+    // handle partially-commented switch statements, then the switch statements themselves
+    std::string uncommented;
+    bool changed = SwitchUncommenter().Scan(input, len, uncommented);
     
     std::string output;
-    while ( pos != end )
+    changed |= SwitchReplacer(_supportedNamespaces).Scan(uncommented.data(), uncommented.size(), output);
+    
+    if ( !changed )
     {
-        // output any non-matched characters
-        output += pos->prefix();
-        
-        std::string switchContents = pos->str(1);
-        
-        bool matched = false;
-        
-        // now scan the contents for any epub:case statements
-        if ( _supportedNamespaces.size() != 0 )
-        {
-            auto cpos = REGEX_NS::sregex_iterator(switchContents.begin(), switchContents.end(), CaseContentExtractor);
-            while ( cpos != end )
-            {
-                for ( auto ns : _supportedNamespaces )
-                {
-                    if ( ns == cpos->str(1) )
-                    {
-                        // this case uses a supported namespace
-                        matched = true;
-                        break;
-                    }
-                }
-                
-                if ( matched )
-                {
-                    // we matched the case, so append its contents and skip the remainder
-                    output += cpos->str(2);
-                    break;
-                }
-                
-                ++cpos;
-            }
-        }
-        
-        if ( !matched )
-        {
-            // no matching case statements, so find the epub:default
-            REGEX_NS::smatch defaultCase;
-            if ( REGEX_NS::regex_search(switchContents, defaultCase, DefaultContentExtractor) )
-                output += defaultCase[1].str();
-        }
-        
-        // step forward, and if we get the end let's output the current suffix
-        // this ensures that we don't lose everything following the last match
-        auto here = pos++;
-        if ( pos == end )
-            output += here->suffix();
+        *outputLen = len;
+        return data;
     }
     
     *outputLen = output.size();
@@ -33,7 +33,6 @@
 #include <ePub3/epub3.h>
 #include <ePub3/filter.h>
 #include <vector>
-#include REGEX_INCLUDE
 
 EPUB3_BEGIN_NAMESPACE
 
@@ -82,15 +81,30 @@ public:
     /// The standard C++11 'move' constructor.
     SwitchPreprocessor(SwitchPreprocessor&& o) : ContentFilter(std::move(o)) {}
     
-    /**
-     This processor won't work on streamed data, it requires the whole thing at once.
-     */
+    ///
+    /// This processor won't work on streamed data, it requires the whole thing at once.
     virtual OperatingMode GetOperatingMode() const OVERRIDE { return OperatingMode::RequiresCompleteData; }
     
     /**
-     Filters the input data using regular expressions to identify epub:switch
-     compounds and replace them wholesale wih the contents of an epub:case or
-     epub:default element.
+     Replaces each epub:switch compound wholesale with the contents of an epub:case
+     or epub:default element.
+     
+     The document is scanned once, by hand rather than with regular expressions.
+     First, any switch compound which has been commented out apart from the content
+     of its epub:default element is uncommented. For instance, we might see:
+     
+         <!--<epub:switch id="bob">
+           <epub:case required-namespace="...">
+              ...
+           </epub:case>
+           <epub:default>-->
+             <img src="..." /><!--
+           </epub:default>
+         </epub:switch>-->
+     
+     A switch compound which has been commented out in its entirety (i.e. where the
+     publisher has provided the default content separately) is left commented, but
+     its contents are still replaced.
      
      If the list of supported namespaces is empty, then this takes an optimized path,
      ignoring epub:case elements completely. Otherwise, it will inspect the 
@@ -98,6 +112,10 @@ public:
      the contents of its supported namespace list to make a decision. The first
      matching epub:case statement will be output in place of the entire switch
      compound.
+     
+     Element names are matched regardless of case, with or without the `epub:`
+     prefix, and each element ends at the first matching end tag; nested switches are
+     not supported.
      */
     virtual void * FilterData(FilterContext* context, void *data, size_t len, size_t *outputLen) OVERRIDE;
     
@@ -118,43 +136,6 @@ protected:
      */
     static NamespaceList    _supportedNamespaces;
     
-private:
-    /**
-     A regex to un-comment any epub:switch blocks.
-     
-     For instance, we might see:
-     
-         <!--<epub:switch id="bob">
-           <epub:case required-namespace="...">
-              ...
-           </epub:case>
-           <epub:default>-->
-             <img src="..." /><!--
-           </epub:default>
-         </epub:switch>-->
-     
-     This regex will identify such constructs, but will NOT match an entire
-     commented-out epub:switch block (i.e. where the publisher has chosen to comment
-     out the whole thing and provide only the default content).
-     */
-    static REGEX_NS::regex   CommentedSwitchIdentifier;
-    
-    /**
-     This expression locates and isolates the content of each epub:switch element.
-     */
-    static REGEX_NS::regex   SwitchContentExtractor;
-    
-    /**
-     This expression locates and extracts the contents and types of each epub:case
-     element.
-     */
-    static REGEX_NS::regex   CaseContentExtractor;
-    
-    /**
-     This expression locates and extracts the content of the epub:default element.
-     */
-    static REGEX_NS::regex   DefaultContentExtractor;
-    
 };
 
 EPUB3_END_NAMESPACE
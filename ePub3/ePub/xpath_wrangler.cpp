@@ -39,22 +39,33 @@ XPathWrangler::XPathWrangler(shared_ptr<xml::Document> doc, const NamespaceList&
 XPathWrangler::XPathWrangler(const XPathWrangler& o) : _doc(o._doc), _namespaces(o._namespaces)
 {
 }
-XPathWrangler::XPathWrangler(XPathWrangler&& o) : _doc(std::move(o._doc))
+XPathWrangler::XPathWrangler(XPathWrangler&& o) : _doc(std::move(o._doc)), _namespaces(std::move(o._namespaces)), _evaluator(std::move(o._evaluator))
 {
 }
 XPathWrangler::~XPathWrangler()
 {
 }
-XPathWrangler::StringList XPathWrangler::Strings(const string& xpath, shared_ptr<xml::Node> node)
+xml::XPathEvaluator& XPathWrangler::Evaluator(const string& xpath)
 {
-    StringList strings;
+    if ( _evaluator )
+    {
+        _evaluator->SetXPath(xml::string(xpath.c_str()));
+        return *_evaluator;
+    }
     
-	xml::XPathEvaluator eval(xml::string(xpath.c_str()), _doc);
-	xml::XPathEvaluator::ObjectType type;
+    _evaluator.reset(new xml::XPathEvaluator(xml::string(xpath.c_str()), _doc));
     for (auto& pair : _namespaces)
     {
-        eval.RegisterNamespace(pair.first.stl_str(), pair.second.stl_str());
+        _evaluator->RegisterNamespace(pair.first.stl_str(), pair.second.stl_str());
     }
+    return *_evaluator;
+}
+XPathWrangler::StringList XPathWrangler::Strings(const string& xpath, shared_ptr<xml::Node> node)
+{
+    StringList strings;
+    
+	xml::XPathEvaluator& eval = Evaluator(xpath);
+	xml::XPathEvaluator::ObjectType type;
 
 	if ( eval.Evaluate((bool(node) ? node : _doc), &type) )
     {
@@ -86,11 +97,7 @@ xml::NodeSet XPathWrangler::Nodes(const string& xpath, shared_ptr<xml::Node> nod
 {
 	xml::NodeSet result;
 
-    xml::XPathEvaluator eval(xml::string(xpath.c_str()), _doc);
-	for (auto& item : _namespaces)
-	{
-		eval.RegisterNamespace(item.first.stl_str(), item.second.stl_str());
-	}
+	xml::XPathEvaluator& eval = Evaluator(xpath);
 	xml::XPathEvaluator::ObjectType type;
     if ( eval.Evaluate((bool(node) ? node : _doc), &type) )
     {
@@ -107,6 +114,8 @@ void XPathWrangler::RegisterNamespaces(const NamespaceList &namespaces)
     for ( auto item : namespaces )
     {
 		_namespaces[item.first] = item.second;
+        if ( _evaluator )
+            _evaluator->RegisterNamespace(item.first.stl_str(), item.second.stl_str());
     }
 }
 void XPathWrangler::NameDefaultNamespace(const string& name)
@@ -117,6 +126,8 @@ void XPathWrangler::NameDefaultNamespace(const string& name)
 		if (ns->Prefix().empty())
 		{
 			_namespaces[""] = ns->URI();
+			if ( _evaluator )
+				_evaluator->RegisterNamespace("", ns->URI().stl_str());
 		}
 	}
 }
@@ -177,6 +177,14 @@ public:
 protected:
 	shared_ptr<xml::Document>	_doc;			///< The XML document on which this will operate.
 	NamespaceList				_namespaces;	///< The namespaces to register when running XPath queries.
+    
+    ///
+    /// The evaluation context for _doc, created on first use and reused by every query.
+	std::unique_ptr<xml::XPathEvaluator>	_evaluator;
+    
+    ///
+    /// Points the evaluation context at a new expression.
+    xml::XPathEvaluator&        Evaluator(const string& xpath);
 };
 
 EPUB3_END_NAMESPACE
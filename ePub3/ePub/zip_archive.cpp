@@ -34,8 +34,12 @@
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <atomic>
+#include <cstring>
 #if EPUB_OS(UNIX)
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 #include <fcntl.h>
 #if EPUB_OS(WINDOWS)
@@ -193,6 +197,7 @@ ZipArchive::ZipItemInfo::ZipItemInfo(struct zip_stat & info) : ArchiveItemInfo()
     SetIsCompressed(info.comp_method == ZIP_CM_STORE);
     SetCompressedSize(static_cast<size_t>(info.comp_size));
     SetUncompressedSize(static_cast<size_t>(info.size));
+    SetCRC(static_cast<uint32_t>(info.crc));
 }
 #if ENABLE_ZIP_ARCHIVE_WRITER
 string ZipArchive::TempFilePath()
@@ -200,13 +205,28 @@ string ZipArchive::TempFilePath()
     return GetTempFilePath("zip");
 }
 #endif //ENABLE_ZIP_ARCHIVE_WRITER
-ZipArchive::ZipArchive(const string & path)
+static std::atomic<bool> gMemoryMappingEnabled(false);
+
+void ZipArchive::SetMemoryMappingEnabled(bool enabled)
+{
+    if ( enabled )
+        MappedByteStream::InstallFaultHandler();
+    gMemoryMappingEnabled = enabled;
+}
+bool ZipArchive::MemoryMappingEnabled()
+{
+    return gMemoryMappingEnabled;
+}
+ZipArchive::ZipArchive(const string & path) : _mappingLength(0)
 {
     int zerr = 0;
     _zip = zip_open(path.c_str(), ZIP_CREATE, &zerr);
     if ( _zip == nullptr )
         throw std::runtime_error(std::string("zip_open() failed: ") + zError(zerr));
     _path = path;
+    InstallLock();
+    SetSeekPointInterval(DefaultSeekPointInterval);
+    MapArchiveFile(path);
 }
 ZipArchive::~ZipArchive()
 {
@@ -219,8 +239,127 @@ Archive & ZipArchive::operator = (ZipArchive &&o)
         zip_close(_zip);
     _zip = o._zip;
     o._zip = nullptr;
+    _mapping = std::move(o._mapping);
+    _mappingLength = o._mappingLength;
+    _verifiedCRCs = std::move(o._verifiedCRCs);
+    InstallLock();
     return dynamic_cast<Archive&>(*this);
 }
+static void __zip_lock(void* ctx)
+{
+    reinterpret_cast<std::recursive_mutex*>(ctx)->lock();
+}
+static void __zip_unlock(void* ctx)
+{
+    reinterpret_cast<std::recursive_mutex*>(ctx)->unlock();
+}
+void ZipArchive::InstallLock()
+{
+    if ( _zip != nullptr )
+        zip_set_lock_callbacks(_zip, &__zip_lock, &__zip_unlock, reinterpret_cast<void*>(&_lock));
+}
+void ZipArchive::MapArchiveFile(const string& path)
+{
+    _mapping.reset();
+    _mappingLength = 0;
+    _verifiedCRCs.reset();
+    
+    if ( !gMemoryMappingEnabled )
+        return;
+    
+#if EPUB_OS(UNIX)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if ( fd == -1 )
+        return;
+    
+    struct stat sb;
+    if ( ::fstat(fd, &sb) == 0 && sb.st_size > 0 )
+    {
+        size_t length = static_cast<size_t>(sb.st_size);
+        void* addr = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if ( addr != MAP_FAILED )
+        {
+            _mapping = std::shared_ptr<const void>(addr, [length](const void* p) {
+                ::munmap(const_cast<void*>(p), length);
+            });
+            _mappingLength = length;
+        }
+    }
+    
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+#elif EPUB_PLATFORM(WIN)
+    HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if ( file == INVALID_HANDLE_VALUE )
+        return;
+    
+    LARGE_INTEGER size;
+    if ( ::GetFileSizeEx(file, &size) && size.QuadPart > 0 && static_cast<ULONGLONG>(size.QuadPart) <= SIZE_MAX )
+    {
+        HANDLE mapping = ::CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if ( mapping != NULL )
+        {
+            void* addr = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if ( addr != NULL )
+            {
+                _mapping = std::shared_ptr<const void>(addr, [](const void* p) {
+                    ::UnmapViewOfFile(p);
+                });
+                _mappingLength = static_cast<size_t>(size.QuadPart);
+            }
+            
+            // the view keeps the mapping object alive
+            ::CloseHandle(mapping);
+        }
+    }
+    
+    ::CloseHandle(file);
+#endif
+    
+    if ( bool(_mapping) && _zip->cdir != nullptr )
+    {
+        size_t count = static_cast<size_t>(_zip->cdir->nentry);
+        _verifiedCRCs = std::shared_ptr<std::atomic<bool>>(new std::atomic<bool>[count], std::default_delete<std::atomic<bool>[]>());
+        for ( size_t i = 0; i < count; i++ )
+            _verifiedCRCs.get()[i] = false;
+    }
+}
+unique_ptr<ByteStream> ZipArchive::MappedByteStreamAtIndex(int idx) const
+{
+    if ( !bool(_mapping) || !bool(_verifiedCRCs) || _zip == nullptr || _zip->cdir == nullptr || idx < 0 || idx >= _zip->cdir->nentry )
+        return nullptr;
+    
+    // replaced or added items don't live in the file yet
+    if ( _zip->entry != nullptr && (idx >= _zip->nentry || _zip->entry[idx].state != ZIP_ST_UNCHANGED) )
+        return nullptr;
+    
+    const struct zip_dirent& de = _zip->cdir->entry[idx];
+    if ( de.comp_method != ZIP_CM_STORE || (de.bitflags & ZIP_GPBF_ENCRYPTED) != 0 || de.comp_size != de.uncomp_size )
+        return nullptr;
+    
+    // the data follows the item's local header, whose variable-length fields may
+    // differ from those in the central directory
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(_mapping.get());
+    size_t offset = de.offset;
+    if ( offset > _mappingLength || _mappingLength - offset < LENTRYSIZE || std::memcmp(base + offset, LOCAL_MAGIC, 4) != 0 )
+        return nullptr;
+    
+    const uint8_t* header = base + offset;
+    size_t nameLength = header[26] | (header[27] << 8);
+    size_t extraLength = header[28] | (header[29] << 8);
+    offset += LENTRYSIZE + nameLength + extraLength;
+    if ( offset > _mappingLength || _mappingLength - offset < de.comp_size )
+        return nullptr;
+    
+    // each item's CRC is checked by the first stream to read all of it
+    std::shared_ptr<std::atomic<bool>> verified(_verifiedCRCs, _verifiedCRCs.get() + idx);
+    return make_unique<MappedByteStream>(_mapping, base + offset, de.comp_size, de.crc, verified);
+}
+void ZipArchive::SetSeekPointInterval(unsigned int interval)
+{
+    if ( _zip != nullptr )
+        zip_set_seek_interval(_zip, interval);
+}
 void ZipArchive::EachItem(std::function<void (const ArchiveItemInfo &)> fn) const
 {
     struct zip_stat zinfo = {0};
@@ -251,6 +390,13 @@ bool ZipArchive::CreateFolder(const string & path)
 }
 unique_ptr<ByteStream> ZipArchive::ByteStreamAtPath(const string &path) const
 {
+    if ( bool(_mapping) )
+    {
+        unique_ptr<ByteStream> stream = MappedByteStreamAtIndex(zip_name_locate(_zip, Sanitized(path).c_str(), 0));
+        if ( bool(stream) )
+            return stream;
+    }
+    
     return make_unique<ZipFileByteStream>(_zip, path);
 }
 
@@ -32,7 +32,9 @@
 
 #include <ePub3/archive.h>
 #include <libzip/zip.h>
+#include <atomic>
 #include <list>
+#include <mutex>
 
 EPUB3_BEGIN_NAMESPACE
 
@@ -66,10 +68,10 @@ public:
     ZipArchive(const string & path="");
     ///
     /// move constructos.
-    ZipArchive(ZipArchive &&o) : _zip(o._zip) { o._zip = nullptr; }
+    ZipArchive(ZipArchive &&o) : _zip(o._zip), _mapping(std::move(o._mapping)), _mappingLength(o._mappingLength), _verifiedCRCs(std::move(o._verifiedCRCs)) { o._zip = nullptr; InstallLock(); }
     ///
     /// Initialize directly from a `libzip` internal structure.
-    explicit ZipArchive(struct zip * aZip) : _zip(aZip) {}
+    explicit ZipArchive(struct zip * aZip) : _zip(aZip), _mappingLength(0) { InstallLock(); SetSeekPointInterval(DefaultSeekPointInterval); }
     virtual ~ZipArchive();
     
     ///
@@ -77,6 +79,47 @@ public:
     EPUB3_EXPORT
     Archive & operator = (ZipArchive &&o);
     
+    ///
+    /// The default spacing of inflate checkpoints, in uncompressed bytes.
+    static const unsigned int DefaultSeekPointInterval = 256 * 1024;
+    
+    /**
+     Sets how often inflate checkpoints are recorded for compressed items.
+     
+     While a compressed item is being read, a snapshot of the decompressor state is
+     taken roughly every `interval` bytes. Seeking within that item (including via
+     ZipFileByteStream::Clone()) then resumes decompression from the nearest
+     snapshot rather than from the start of the item. The snapshots are kept until
+     the archive is closed.
+     @param interval The minimum distance between checkpoints, or `0` to disable
+     them and release any already recorded.
+     */
+    EPUB3_EXPORT
+    void SetSeekPointInterval(unsigned int interval);
+    
+    /**
+     Sets whether archives opened from a path map their file into memory.
+     
+     When enabled, ByteStreamAtPath() returns a MappedByteStream
+     for items stored without compression. Those streams read straight out of the
+     mapped file, with no system calls and no locking, so any number of them can be
+     used at once on different threads. Compressed items are read through `libzip`
+     as before.
+     
+     The mapping is only valid while the file is unchanged on disk, and is only
+     available on platforms which support it. Enabling it calls
+     MappedByteStream::InstallFaultHandler(), so that a read from a file truncated
+     underneath it fails instead of raising SIGBUS. Disabled by default.
+     @param enabled `true` to map archives opened from now on, `false` otherwise.
+     */
+    EPUB3_EXPORT
+    static void SetMemoryMappingEnabled(bool enabled);
+    
+    ///
+    /// Whether archives opened from a path map their file into memory.
+    EPUB3_EXPORT
+    static bool MemoryMappingEnabled();
+    
     virtual void EachItem(std::function<void(const ArchiveItemInfo&)> fn) const OVERRIDE;
     
     virtual bool ContainsItem(const string & path) const;
@@ -101,6 +144,32 @@ protected:
     
     typedef std::list<zip_source*>  ZipSourceList;
     ZipSourceList   _liveSources;   ///< A list of live zip sources, which must be cleaned up upon closing.
+    
+    ///
+    /// Guards libzip's list of open files and seek index, so that items may be read on several threads at
+    /// once. Item data is read with positional I/O outside this lock, so reads of different items don't wait
+    /// on one another.
+    std::recursive_mutex    _lock;
+    
+    ///
+    /// Points the libzip lock callbacks at `_lock`.
+    void            InstallLock();
+    
+    std::shared_ptr<const void> _mapping;   ///< The archive file mapped into memory, if available.
+    size_t          _mappingLength;         ///< The length of `_mapping` in bytes.
+    std::shared_ptr<std::atomic<bool>> _verifiedCRCs;   ///< One flag per item, set once a mapped read has checked its CRC.
+    
+    ///
+    /// Maps the archive file at `path` into memory, if enabled and supported.
+    void            MapArchiveFile(const string& path);
+    
+    /**
+     Creates a stream reading an item directly from the mapped archive file.
+     @param idx The index of the item in the archive.
+     @result A MappedByteStream, or `nullptr` if the item is compressed, encrypted
+     or modified, or if the archive file isn't mapped.
+     */
+    unique_ptr<ByteStream> MappedByteStreamAtIndex(int idx) const;
 
 };
 
@@ -28,7 +28,10 @@
 //  OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "byte_stream.h"
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <libzip/zip.h>
 #include <libzip/zipint.h>          // for internals of zip_file
@@ -39,9 +42,16 @@
 #if EPUB_OS(WINDOWS)
 # include <io.h>
 #endif
+#if EPUB_PLATFORM(WIN)
+# include <windows.h>
+#endif
 #if EPUB_OS(UNIX)
 # include <unistd.h>    // for dup()
+# include <setjmp.h>
+# include <signal.h>
 #endif
+#include <mutex>
+#include <zlib.h>
 
 #include <ePub3/utilities/make_unique.h>
 
@@ -749,7 +759,7 @@ std::shared_ptr<SeekableByteStream> FileByteStream::Clone() const
 #pragma mark -
 #endif
 
-ZipFileByteStream::ZipFileByteStream(struct zip* archive, const string& path, int flags) : SeekableByteStream(), _file(nullptr), _mode(std::ios::in | std::ios::out | std::ios::app | std::ios::binary)
+ZipFileByteStream::ZipFileByteStream(struct zip* archive, const string& path, int flags) : SeekableByteStream(), _file(nullptr), _mode(std::ios::in | std::ios::out | std::ios::app | std::ios::binary), _zipFlags(0)
 {
     Open(archive, path, flags);
 }
@@ -779,6 +789,7 @@ bool ZipFileByteStream::Open(struct zip *archive, const string &path, int flags)
         Close();
     
     _file = zip_fopen(archive, Sanitized(path).c_str(), flags);
+    _zipFlags = flags;
     return ( _file != nullptr );
 }
 void ZipFileByteStream::Close()
@@ -842,10 +853,12 @@ std::shared_ptr<SeekableByteStream> ZipFileByteStream::Clone() const
 	if (_file == nullptr)
 		return nullptr;
 
-	struct zip_file* newFile = zip_fopen_index(_file->za, _file->file_index, _file->flags);
+	// NB: _file->flags holds libzip's internal ZIP_ZF_* state, not the ZIP_FL_* open flags
+	struct zip_file* newFile = zip_fopen_index(_file->za, _file->file_index, _zipFlags);
 	if (newFile == nullptr)
 		return nullptr;
     
+    // resumes from the nearest inflate checkpoint for compressed files
     zip_fseek(newFile, Position(), ZIP_SEEK_SET);
 
 	auto result = std::make_shared<ZipFileByteStream>();
@@ -853,11 +866,234 @@ std::shared_ptr<SeekableByteStream> ZipFileByteStream::Clone() const
 	{
 		result->_file = newFile;
 		result->_mode = _mode;
+		result->_zipFlags = _zipFlags;
 	}
 
 	return result;
 }
 
+#if 0
+#pragma mark -
+#endif
+
+#if EPUB_OS(UNIX)
+// Touching a page of a file mapping which is no longer backed by the file, because
+// something truncated it, raises SIGBUS. Once InstallFaultHandler() has been called,
+// copies out of a mapping catch that on the copying thread and report a failed read
+// instead; any other SIGBUS goes to whoever handled it before. The jump target is
+// volatile so that setting it isn't optimized away around the copy.
+static thread_local sigjmp_buf* volatile __mapped_copy_jump = nullptr;
+static struct sigaction         __previous_sigbus_action;
+static std::atomic<bool>        __mapped_copy_handler_installed(false);
+
+static void __mapped_copy_sigbus(int sig, siginfo_t* info, void* context)
+{
+    if ( __mapped_copy_jump != nullptr )
+        siglongjmp(*__mapped_copy_jump, 1);
+    
+    if ( (__previous_sigbus_action.sa_flags & SA_SIGINFO) != 0 )
+        __previous_sigbus_action.sa_sigaction(sig, info, context);
+    else if ( __previous_sigbus_action.sa_handler != SIG_DFL && __previous_sigbus_action.sa_handler != SIG_IGN )
+        __previous_sigbus_action.sa_handler(sig);
+    else
+        ::sigaction(SIGBUS, &__previous_sigbus_action, nullptr);     // the fault recurs, and is fatal
+}
+void MappedByteStream::InstallFaultHandler()
+{
+    static std::once_flag __installed;
+    std::call_once(__installed, []() {
+        // SA_NODEFER leaves SIGBUS unblocked in the handler, so jumping out of it
+        // doesn't need to restore the signal mask
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_sigaction = &__mapped_copy_sigbus;
+        action.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        ::sigaction(SIGBUS, &action, &__previous_sigbus_action);
+        __mapped_copy_handler_installed = true;
+    });
+}
+static bool __mapped_copy(void* dst, const void* src, size_t len)
+{
+    if ( !__mapped_copy_handler_installed.load(std::memory_order_relaxed) )
+    {
+        std::memcpy(dst, src, len);
+        return true;
+    }
+    
+    // no signal mask to save, so this doesn't make a system call
+    sigjmp_buf jump;
+    if ( sigsetjmp(jump, 0) != 0 )
+    {
+        __mapped_copy_jump = nullptr;
+        return false;
+    }
+    
+    __mapped_copy_jump = &jump;
+    std::memcpy(dst, src, len);
+    __mapped_copy_jump = nullptr;
+    return true;
+}
+#elif EPUB_PLATFORM(WIN)
+// A file can't be truncated while it's mapped, but a view of a file on a network
+// share can still fail to page in. Structured exception handling needs nothing installing.
+void MappedByteStream::InstallFaultHandler()
+{
+}
+static bool __mapped_copy(void* dst, const void* src, size_t len)
+{
+    __try
+    {
+        std::memcpy(dst, src, len);
+    }
+    __except ( GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH )
+    {
+        return false;
+    }
+    return true;
+}
+#else
+void MappedByteStream::InstallFaultHandler()
+{
+}
+static bool __mapped_copy(void* dst, const void* src, size_t len)
+{
+    std::memcpy(dst, src, len);
+    return true;
+}
+#endif
+
+MappedByteStream::MappedByteStream(std::shared_ptr<const void> owner, const void* bytes, size_type length)
+    : SeekableByteStream(), _owner(owner), _bytes(reinterpret_cast<const uint8_t*>(bytes)), _length(length), _pos(0),
+      _verified(), _expectedCRC(0), _crc(0), _crcLength(0)
+{
+    _eof = (_length == 0);
+}
+MappedByteStream::MappedByteStream(std::shared_ptr<const void> owner, const void* bytes, size_type length,
+                                   uint32_t crc, std::shared_ptr<std::atomic<bool>> verified)
+    : SeekableByteStream(), _owner(owner), _bytes(reinterpret_cast<const uint8_t*>(bytes)), _length(length), _pos(0),
+      _verified(verified), _expectedCRC(crc), _crc(0), _crcLength(0)
+{
+    _eof = (_length == 0);
+}
+ByteStream::size_type MappedByteStream::BytesAvailable() _NOEXCEPT
+{
+    if ( _bytes == nullptr )
+        return 0;
+    return _length - _pos;
+}
+bool MappedByteStream::IsOpen() const _NOEXCEPT
+{
+    return _bytes != nullptr;
+}
+void MappedByteStream::Close()
+{
+    _bytes = nullptr;
+    _owner.reset();
+}
+ByteStream::size_type MappedByteStream::ReadBytes(void *buf, size_type len)
+{
+    if ( _bytes == nullptr )
+        return 0;
+
+    size_type numRead = std::min(len, _length - _pos);
+    if ( !__mapped_copy(buf, _bytes + _pos, numRead) )
+    {
+        Close();
+        return 0;
+    }
+    
+    // like libzip, check the CRC once the whole content has been read in order
+    if ( bool(_verified) && !_verified->load() && (_pos == 0 || _pos == _crcLength) )
+    {
+        if ( _pos == 0 )
+        {
+            _crc = 0;
+            _crcLength = 0;
+        }
+        _crc = static_cast<uint32_t>(crc32(_crc, reinterpret_cast<const Bytef*>(buf), static_cast<uInt>(numRead)));
+        _crcLength += numRead;
+        if ( _crcLength == _length )
+        {
+            if ( _crc != _expectedCRC )
+            {
+                Close();
+                return 0;
+            }
+            _verified->store(true);
+        }
+    }
+    
+    _pos += numRead;
+    _eof = (_pos == _length);
+    return numRead;
+}
+ByteStream::size_type MappedByteStream::ReadAllBytes(void **buf)
+{
+    size_type count = BytesAvailable();
+    if ( count == 0 )
+        return 0;
+
+    // the size is known up front, so there's no need to grow the buffer as we go
+    void* result = ::malloc(count);
+    if ( result == nullptr )
+        return 0;
+
+    count = ReadBytes(result, count);
+    if ( count == 0 )
+    {
+        ::free(result);
+        return 0;
+    }
+
+    *buf = result;
+    return count;
+}
+ByteStream::size_type MappedByteStream::Seek(size_type by, std::ios::seekdir dir)
+{
+    if ( _bytes == nullptr )
+        return 0;
+
+    // like fseek(), relative seeks pass negative offsets through the unsigned type
+    std::ptrdiff_t offset = static_cast<std::ptrdiff_t>(by);
+    std::ptrdiff_t base = 0;
+    switch ( dir )
+    {
+        case std::ios::beg:
+        default:
+            break;
+        case std::ios::cur:
+            base = static_cast<std::ptrdiff_t>(_pos);
+            break;
+        case std::ios::end:
+            base = static_cast<std::ptrdiff_t>(_length);
+            break;
+    }
+
+    std::ptrdiff_t pos = base + offset;
+    if ( pos < 0 )
+        pos = 0;
+    else if ( static_cast<size_type>(pos) > _length )
+        pos = static_cast<std::ptrdiff_t>(_length);
+
+    _pos = static_cast<size_type>(pos);
+    _eof = (_pos == _length);
+    return _pos;
+}
+ByteStream::size_type MappedByteStream::Position() const
+{
+    return _pos;
+}
+std::shared_ptr<SeekableByteStream> MappedByteStream::Clone() const
+{
+    if ( _bytes == nullptr )
+        return nullptr;
+
+    auto result = std::make_shared<MappedByteStream>(_owner, _bytes, _length, _expectedCRC, _verified);
+    result->Seek(_pos, std::ios::beg);
+    return result;
+}
+
 #ifdef SUPPORT_ASYNC
 #if 0
 #pragma mark -
@@ -951,7 +1187,7 @@ std::shared_ptr<SeekableByteStream> AsyncZipFileByteStream::Clone() const
 		return nullptr;
 
 
-	struct zip_file* newFile = zip_fopen_index(_file->za, _file->file_index, _file->flags);
+	struct zip_file* newFile = zip_fopen_index(_file->za, _file->file_index, _zipFlags);
 	if (newFile == nullptr)
 		return nullptr;
 
@@ -960,6 +1196,7 @@ std::shared_ptr<SeekableByteStream> AsyncZipFileByteStream::Clone() const
 	{
 		result->_file = newFile;
 		result->_mode = _mode;
+		result->_zipFlags = _zipFlags;
 	}
 
 	return result;
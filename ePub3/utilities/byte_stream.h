@@ -32,6 +32,7 @@
 
 #include <ePub3/epub3.h>
 #include <ePub3/utilities/ring_buffer.h>
+#include <atomic>
 #include <functional>
 #include <ios>
 
@@ -613,7 +614,7 @@ class ZipFileByteStream : public SeekableByteStream
 public:
     ///
     /// Create a new unattached stream.
-                            ZipFileByteStream() : SeekableByteStream(), _file(nullptr) {}
+                            ZipFileByteStream() : SeekableByteStream(), _file(nullptr), _zipFlags(0) {}
     /**
      Create a new stream to a file within a zip archive.
      @param archive The Zip arrchive containing the target file.
@@ -686,6 +687,125 @@ public:
 protected:
     struct zip_file*        _file;      ///< The underlying Zip file stream.
 	std::ios::openmode		_mode;		///< The mode used to open the file (used by Clone()).
+    int                     _zipFlags;  ///< The flags used to open the file (used by Clone()).
+
+};
+
+/**
+ A read-only ByteStream over a block of memory, such as an uncompressed item within
+ a memory-mapped Zip archive.
+
+ Reads copy straight out of the underlying memory, with no system calls and no
+ intermediate buffering. The memory is kept alive by an owner object shared between
+ the stream, its clones and whoever created it.
+ @ingroup utilities
+ */
+class MappedByteStream : public SeekableByteStream
+{
+public:
+    /**
+     Create a new stream over a block of memory.
+     @param owner An object keeping `bytes` valid for as long as it is referenced.
+     @param bytes The first byte of the stream's content.
+     @param length The number of bytes of content.
+     */
+    EPUB3_EXPORT            MappedByteStream(std::shared_ptr<const void> owner, const void* bytes, size_type length);
+    /**
+     Create a new stream over a block of memory whose content has a known CRC-32.
+
+     The checksum is verified the first time the content is read from start to end;
+     a mismatch fails the read which reaches the end, and closes the stream.
+     @param owner An object keeping `bytes` valid for as long as it is referenced.
+     @param bytes The first byte of the stream's content.
+     @param length The number of bytes of content.
+     @param crc The expected CRC-32 of the content.
+     @param verified Shared by every stream over this content; set once the checksum
+     has matched, after which it isn't computed again.
+     */
+    EPUB3_EXPORT            MappedByteStream(std::shared_ptr<const void> owner, const void* bytes, size_type length,
+                                             uint32_t crc, std::shared_ptr<std::atomic<bool>> verified);
+    virtual                 ~MappedByteStream() {}
+
+    /**
+     Lets reads from a file mapping fail cleanly if the file is truncated underneath it.
+
+     On UNIX this installs a process-wide SIGBUS handler, which passes on any fault
+     that doesn't come from a MappedByteStream read. Without it, such a read raises
+     SIGBUS as a plain memory access would. ZipArchive::SetMemoryMappingEnabled()
+     calls this; call it before reading a stream over a file mapping of your own.
+     Safe to call more than once.
+     */
+    EPUB3_EXPORT
+    static void             InstallFaultHandler();
+
+private:
+                            MappedByteStream(const MappedByteStream&)           _DELETED_;
+                            MappedByteStream(MappedByteStream&&)                _DELETED_;
+    MappedByteStream&       operator=(const MappedByteStream&)                  _DELETED_;
+    MappedByteStream&       operator=(MappedByteStream&&)                       _DELETED_;
+
+public:
+    ///
+    /// @copydoc ByteStream::BytesAvailable()
+    virtual size_type       BytesAvailable()                        _NOEXCEPT OVERRIDE;
+    ///
+    /// @copydoc ByteStream::SpaceAvailable
+    virtual size_type       SpaceAvailable()                        const _NOEXCEPT OVERRIDE { return 0; }
+
+    ///
+    /// @copydoc ByteStream::IsOpen()
+    virtual bool            IsOpen()                                const _NOEXCEPT OVERRIDE;
+    ///
+    /// @copydoc ByteStream::Close()
+    virtual void            Close() OVERRIDE;
+
+    ///
+    /// @copydoc ByteStream::ReadBytes()
+    virtual size_type       ReadBytes(void* buf, size_type len) OVERRIDE;
+    ///
+    /// @copydoc ByteStream::ReadAllBytes()
+    virtual size_type       ReadAllBytes(void** buf) OVERRIDE;
+    ///
+    /// @copydoc ByteStream::WriteBytes()
+    virtual size_type       WriteBytes(const void* buf, size_type len) OVERRIDE { return 0; }
+
+    /**
+     Seek to a position within the stream's content.
+     @param by The amount to move the stream position.
+     @param dir The starting point for the position calculation: current position,
+     start of content, or end of content.
+     @result The new stream position, clamped to the bounds of the content.
+     */
+    virtual size_type       Seek(size_type by, std::ios::seekdir dir) OVERRIDE;
+
+    /**
+     Returns the current position within the stream's content.
+     @result The current stream position.
+     */
+    virtual size_type       Position() const OVERRIDE;
+
+    /**
+     Creates a new independent stream over the same memory.
+
+     The clone starts at the receiver's current position. No data is copied.
+     @result A new MappedByteStream instance.
+     */
+    virtual std::shared_ptr<SeekableByteStream> Clone() const OVERRIDE;
+
+    ///
+    /// The size of the stream's content in bytes.
+    size_type               Length()                                const _NOEXCEPT { return _length; }
+
+protected:
+    std::shared_ptr<const void> _owner;     ///< Keeps the underlying memory alive.
+    const uint8_t*          _bytes;         ///< The stream's content, or `nullptr` once closed.
+    size_type               _length;        ///< The size of the content.
+    size_type               _pos;           ///< The current read position.
+    
+    std::shared_ptr<std::atomic<bool>> _verified;   ///< Set once the content's CRC has matched; `nullptr` if there's no CRC.
+    uint32_t                _expectedCRC;   ///< The CRC-32 the content should have.
+    uint32_t                _crc;           ///< The CRC-32 of the first `_crcLength` bytes.
+    size_type               _crcLength;     ///< How much of the content has been read, in order, from its start.
 
 };
 
@@ -152,15 +152,21 @@ void serial_executor::add(closure_type closure)
 #pragma mark -
 #endif
 
-__thread_pool_impl_stdcpp::__thread_pool_impl_stdcpp(int num_threads) : _queue(), _timed_queue(), _threads(), _jobs_in_flight(0), _mutex(), _exiting(false), _jobs_ready(), _timers_updated(), _timed_addition_thread()
+__thread_pool_impl_stdcpp::__thread_pool_impl_stdcpp(int num_threads) : _queue(), _worker_queues(), _timed_queue(), _threads(), _jobs_queued(0), _timed_jobs_queued(0), _jobs_in_flight(0), _idle_workers(0), _mutex(), _queue_mutex(), _idle_mutex(), _exiting(false), _jobs_ready(), _drained(), _timers_updated(), _drained_handler(), _timed_addition_thread()
 {
     if ( num_threads < 1 )
         num_threads = std::thread::hardware_concurrency();
     if ( num_threads < 1 )
         num_threads = 1;
     
+    // all the deques must exist before the first worker goes looking for something to steal
     for ( int i = 0; i < num_threads; i++ ) {
-		_threads.emplace_back(&__thread_pool_impl_stdcpp::_RunWorker, this);
+        _worker_queues.emplace_back(new __worker_queue);
+    }
+    
+    _threads.reserve(num_threads);
+    for ( int i = 0; i < num_threads; i++ ) {
+		_threads.emplace_back(&__thread_pool_impl_stdcpp::_RunWorker, this, size_t(i));
     }
     
     _timed_addition_thread = std::thread(&__thread_pool_impl_stdcpp::_RunTimer, this);
@@ -172,7 +178,10 @@ __thread_pool_impl_stdcpp::~__thread_pool_impl_stdcpp()
     _mutex.unlock();
     
     // wake up all threads -- any that are waiting will see _exiting and exit immediately
+    _idle_mutex.lock();
     _jobs_ready.notify_all();
+    _drained.notify_all();
+    _idle_mutex.unlock();
     _timers_updated.notify_all();
     
     // wait until all threads have exited
@@ -184,13 +193,29 @@ __thread_pool_impl_stdcpp::~__thread_pool_impl_stdcpp()
 }
 void __thread_pool_impl_stdcpp::add(executor::closure_type closure)
 {
-    std::unique_lock<std::mutex> _(_mutex);
+    // count it first: a worker which sees the count but not yet the closure will simply look again
+    ++_jobs_queued;
     
-    // enqueue the job
-    _queue.push(closure);
+    int worker = _CurrentWorker();
+    if ( worker >= 0 )
+    {
+        // called from one of our own closures: the deque is only contended by thieves
+        __worker_queue& q = *_worker_queues[worker];
+        std::lock_guard<std::mutex> _(q._lock);
+        q._tasks.push_back(closure);
+    }
+    else
+    {
+        std::lock_guard<std::mutex> _(_queue_mutex);
+        _queue.push_back(closure);
+    }
     
-    // wake one available thread
-    _jobs_ready.notify_one();
+    // wake one available thread, if any are asleep
+    if ( _idle_workers > 0 )
+    {
+        std::lock_guard<std::mutex> _(_idle_mutex);
+        _jobs_ready.notify_one();
+    }
 }
 void __thread_pool_impl_stdcpp::add_at(std::chrono::system_clock::time_point abs_time, executor::closure_type closure)
 {
@@ -198,39 +223,128 @@ void __thread_pool_impl_stdcpp::add_at(std::chrono::system_clock::time_point abs
     
     // enqueue the time and the closure-- the priority_queue will sort it into place automatically
     _timed_queue.emplace(abs_time, closure);
+    ++_timed_jobs_queued;
     
     // notify the timer thread that changes have been made
     _timers_updated.notify_all();
 }
-void __thread_pool_impl_stdcpp::_RunWorker()
+void __thread_pool_impl_stdcpp::wait_idle()
+{
+    std::unique_lock<std::mutex> lk(_idle_mutex);
+    _drained.wait(lk, [this]() {
+        return _exiting || (_jobs_queued == 0 && _jobs_in_flight == 0);
+    });
+}
+void __thread_pool_impl_stdcpp::set_drained_handler(executor::closure_type handler)
 {
-    do
+    std::lock_guard<std::mutex> _(_idle_mutex);
+    _drained_handler = handler;
+}
+int __thread_pool_impl_stdcpp::_CurrentWorker() const
+{
+    // _threads doesn't change once the constructor returns, and there are only a handful
+    std::thread::id self = std::this_thread::get_id();
+    for ( size_t i = 0; i < _threads.size(); i++ )
     {
-        std::unique_lock<std::mutex> lk(_mutex);
-        if (!_exiting && _queue.size() == 0)
-            _jobs_ready.wait(lk);
-        
-        if ( _exiting )
-            break;
+        if ( _threads[i].get_id() == self )
+            return int(i);
+    }
+    return -1;
+}
+bool __thread_pool_impl_stdcpp::_TakeJob(size_t index, executor::closure_type& closure)
+{
+    // our own deque first, newest closure first
+    {
+        __worker_queue& q = *_worker_queues[index];
+        std::lock_guard<std::mutex> _(q._lock);
+        if ( !q._tasks.empty() )
+        {
+            closure = std::move(q._tasks.back());
+            q._tasks.pop_back();
+            return true;
+        }
+    }
+    
+    // then anything added from outside the pool, in order
+    {
+        std::lock_guard<std::mutex> _(_queue_mutex);
+        if ( !_queue.empty() )
+        {
+            closure = std::move(_queue.front());
+            _queue.pop_front();
+            return true;
+        }
+    }
+    
+    // then steal the oldest closure from another worker, skipping any that are busy
+    size_t count = _worker_queues.size();
+    for ( size_t i = 1; i < count; i++ )
+    {
+        __worker_queue& victim = *_worker_queues[(index + i) % count];
+        std::unique_lock<std::mutex> lk(victim._lock, std::try_to_lock);
+        if ( !lk.owns_lock() || victim._tasks.empty() )
+            continue;
         
-        if (_queue.empty())
-            continue;       // is this why the copy below is crashing sometimes?
+        closure = std::move(victim._tasks.front());
+        victim._tasks.pop_front();
+        return true;
+    }
+    
+    return false;
+}
+void __thread_pool_impl_stdcpp::_NotifyDrained()
+{
+    executor::closure_type handler;
+    {
+        std::lock_guard<std::mutex> _(_idle_mutex);
+        handler = _drained_handler;
+    }
+    
+    // the handler runs before waiters are released; if it adds more work they keep waiting
+    if ( bool(handler) )
+        executor::_run_closure(handler);
+    
+    std::lock_guard<std::mutex> _(_idle_mutex);
+    _drained.notify_all();
+}
+void __thread_pool_impl_stdcpp::_RunWorker(size_t index)
+{
+    executor::closure_type closure;
+    while ( !_exiting )
+    {
+        if ( !_TakeJob(index, closure) )
+        {
+            // something's on its way in, or sitting in a deque we couldn't lock
+            if ( _jobs_queued > 0 )
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            
+            // _idle_workers is raised before the count is checked, and add() raises the count
+            //  before checking _idle_workers, so one of us always sees the other
+            std::unique_lock<std::mutex> lk(_idle_mutex);
+            ++_idle_workers;
+            _jobs_ready.wait(lk, [this]() {
+                return _exiting || _jobs_queued > 0;
+            });
+            --_idle_workers;
+            continue;
+        }
         
-        // NB: mutex is locked at this point, remember
-		executor::closure_type closure = _queue.front();
-        _queue.pop();
+        // in flight before it stops being queued, so wait_idle() never sees both at zero
         ++_jobs_in_flight;
-        
-        // unlock the mutex
-        lk.unlock();
+        --_jobs_queued;
         
         // run the closure
         executor::_run_closure(closure);
         
-//        if ( --_jobs_in_flight == 0 && bool(_drained_handler) )
-//            _drained_handler();
+        // release anything it captured before anyone is told we're done
+        closure = nullptr;
         
-    } while (1);
+        if ( --_jobs_in_flight == 0 && _jobs_queued == 0 )
+            _NotifyDrained();
+    }
 }
 void __thread_pool_impl_stdcpp::_RunTimer()
 {
@@ -265,8 +379,9 @@ void __thread_pool_impl_stdcpp::_RunTimer()
             // unlock the mutex before calling add(), which will want to own the lock itself
             lk.unlock();
             
-            // add the closure to the execution queue
+            // add the closure to the execution queue, then stop counting it as a timer
             add(closure);
+            --_timed_jobs_queued;
         }
         
     }
@@ -369,6 +484,14 @@ main_thread_executor()
 }
 #endif
 
+thread_pool&
+default_thread_pool()
+{
+    // deliberately leaked, so tasks still running at exit don't outlive their pool
+    static thread_pool* __pool = new thread_pool(thread_pool::Automatic);
+    return *__pool;
+}
+
 #if EPUB_PLATFORM(MAC)
 template <typename _Rep, typename _Period>
 CFTimeInterval CFTimeIntervalFromDuration(std::chrono::duration<_Rep, _Period>& __d)
@@ -36,6 +36,9 @@
 #include <functional>
 #include <chrono>
 #include <queue>
+#include <deque>
+#include <vector>
+#include <memory>
 #include <atomic>
 #include <mutex>
 #include <thread>
@@ -590,18 +593,38 @@ struct __timed_closure_less : std::binary_function<timed_closure, timed_closure,
 
 class __thread_pool_impl_stdcpp
 {
-	std::queue<executor::closure_type>	_queue;
+    // Every worker owns a deque of closures. Closures added by a worker go onto the
+    // back of its own deque and it pops them from there, newest first, so nested work
+    // stays on the thread that spawned it. A worker with nothing to do takes the oldest
+    // closure from the shared queue (anything added from outside the pool) and then
+    // steals from the front of the other workers' deques.
+    struct __worker_queue
+    {
+        std::mutex                          _lock;
+        std::deque<executor::closure_type>  _tasks;
+    };
+    typedef std::unique_ptr<__worker_queue> __worker_queue_ptr;
+
+	std::deque<executor::closure_type>  _queue;
+	std::vector<__worker_queue_ptr>     _worker_queues;
 	timed_closure_queue                 _timed_queue;
 
 	std::vector<std::thread>            _threads;
 	std::thread                         _timed_addition_thread;
 
+	std::atomic_size_t                  _jobs_queued;
+	std::atomic_size_t                  _timed_jobs_queued;
 	std::atomic_size_t                  _jobs_in_flight;
+	std::atomic_size_t                  _idle_workers;
 
-	std::mutex                          _mutex;
+	std::mutex                          _mutex;         // guards _timed_queue
+	std::mutex                          _queue_mutex;   // guards _queue
+	std::mutex                          _idle_mutex;    // guards sleeping workers and _drained_handler
 	std::atomic<bool>                   _exiting;
 	std::condition_variable             _jobs_ready;
+	std::condition_variable             _drained;
 	std::condition_variable             _timers_updated;
+	executor::closure_type              _drained_handler;
 	
 	__thread_pool_impl_stdcpp(int num_threads);
     
@@ -613,7 +636,7 @@ class __thread_pool_impl_stdcpp
     FORCE_INLINE
 	size_t uninitiated_task_count() const
         {
-            return _queue.size() + _timed_queue.size();
+            return _jobs_queued + _timed_jobs_queued;
         }
 
 	void add_at(std::chrono::system_clock::time_point abs_time, executor::closure_type closure);
@@ -624,10 +647,17 @@ class __thread_pool_impl_stdcpp
             add_at(std::chrono::system_clock::now() + rel_time, closure);
         }
 
+	void wait_idle();
+	void set_drained_handler(executor::closure_type handler);
+
 private:
-	void _RunWorker();
+	void _RunWorker(size_t index);
 	void _RunTimer();
 
+	int  _CurrentWorker() const;
+	bool _TakeJob(size_t index, executor::closure_type& closure);
+	void _NotifyDrained();
+
 	friend class thread_pool;
 };
 
@@ -713,11 +743,39 @@ public:
 		{
 			__impl_.add_after(rel_time, closure);
 		}
+
+#if !EPUB_PLATFORM(WINRT)
+    /**
+     Blocks until no closures are queued or running. Closures scheduled with add_at()
+     or add_after() are not waited for until their time comes. Must not be called
+     from one of the pool's own threads.
+     */
+    void wait_idle()
+        {
+            __impl_.wait_idle();
+        }
+    
+    /**
+     Sets a closure which is run on a pool thread each time the pool runs out of work.
+     It may be called more than once for a single drain.
+     */
+    void set_drained_handler(closure_type handler)
+        {
+            __impl_.set_drained_handler(handler);
+        }
+#endif
     
 };
 
 std::shared_ptr<executor> main_thread_executor();
 
+/**
+ The process-wide pool on which async(launch::pooled, ...) runs tasks, along with
+ their continuations. It has one thread per core, is created on first use, and is
+ never destroyed.
+ */
+thread_pool& default_thread_pool();
+
 EPUB3_END_NAMESPACE
 
 #endif //FUTURE_ENABLED
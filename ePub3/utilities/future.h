@@ -426,7 +426,12 @@ enum class launch
     none = 0,
     async = 1,
     deferred = 2,
-    any = async | deferred
+    any = async | deferred,
+    
+    ///
+    /// Runs the task, and any continuations attached without a policy, on
+    /// default_thread_pool() rather than a thread of its own.
+    pooled = 4
 };
 
 enum class future_status
@@ -718,6 +723,7 @@ struct __shared_state_base
     bool                    __done_;
     bool                    __is_deferred_;
     launch                  __policy_;
+    executor*               __executor_;    // not owned: see async(executor&, ...)
     bool                    __is_constructed_;
     mutable std::mutex      __mutex_;
     std::condition_variable __waiters_;
@@ -737,6 +743,7 @@ struct __shared_state_base
         : __done_(false),
           __is_deferred_(false),
           __policy_(launch::none),
+          __executor_(nullptr),
           __is_constructed_(false),
           __continuation_ptr_()
         {}
@@ -758,6 +765,14 @@ struct __shared_state_base
             __policy_ = launch::async;
         }
     
+    // continuations attached without a policy run on the same executor
+    FORCE_INLINE
+    void set_executor(executor* __exec)
+        {
+            set_async();
+            __executor_ = __exec;
+        }
+    
     FORCE_INLINE
     _WaiterListType::iterator register_external_waiter(condition_variable_any& __cv)
         {
@@ -938,6 +953,12 @@ struct __shared_state_base
             return __policy_;
         }
     
+    FORCE_INLINE
+    executor* launch_executor(std::unique_lock<std::mutex>& __lk) const
+        {
+            return __executor_;
+        }
+    
     FORCE_INLINE
     __future_state::state get_state() const
         {
@@ -1267,13 +1288,20 @@ struct __future_async_shared_state_base
     typedef __shared_state<_Rp> _Base;
     
 protected:
-    std::thread __thr_;
+    std::thread __thr_;     // guarded by __mutex_ once a continuation may start it
     
     FORCE_INLINE
     void join()
         {
-            if (__thr_.joinable())
-                __thr_.join();
+            // waiters, the destructor and the thread starting a continuation can all get
+            // here at once, so only one of them takes the thread and joins it
+            std::thread __t;
+            {
+                std::lock_guard<std::mutex> _(this->__mutex_);
+                __t.swap(__thr_);
+            }
+            if (__t.joinable())
+                __t.join();
         }
     
 public:
@@ -1313,8 +1341,11 @@ struct __future_async_shared_state
 public:
     explicit FORCE_INLINE
     __future_async_shared_state(_Fp&& __f)
-        : _Base(std::thread(&__future_async_shared_state::run, this, std::forward<_Fp>(__f)))
-        {}
+        : _Base()
+        {
+            // not in the initializer: the thread mustn't start before our mutex exists
+            this->__thr_ = std::thread(&__future_async_shared_state::run, this, std::forward<_Fp>(__f));
+        }
     
     static FORCE_INLINE
     void run(__future_async_shared_state* __that, _Fp&& __f)
@@ -1339,8 +1370,11 @@ struct __future_async_shared_state<_Rp&, _Fp>
 public:
     explicit FORCE_INLINE
     __future_async_shared_state(_Fp&& __f)
-        : _Base(std::thread(&__future_async_shared_state::run, this, std::forward<_Fp>(__f)))
-        {}
+        : _Base()
+        {
+            // not in the initializer: the thread mustn't start before our mutex exists
+            this->__thr_ = std::thread(&__future_async_shared_state::run, this, std::forward<_Fp>(__f));
+        }
     
     static FORCE_INLINE
     void run(__future_async_shared_state* __that, _Fp&& __f)
@@ -1365,8 +1399,11 @@ struct __future_async_shared_state<void, _Fp>
 public:
     explicit FORCE_INLINE
     __future_async_shared_state(_Fp&& __f)
-        : _Base(std::thread(&__future_async_shared_state::run, this, std::forward<_Fp>(__f)))
-        {}
+        : _Base()
+        {
+            // not in the initializer: the thread mustn't start before our mutex exists
+            this->__thr_ = std::thread(&__future_async_shared_state::run, this, std::forward<_Fp>(__f));
+        }
     
     static FORCE_INLINE
     void run(__future_async_shared_state* __that, _Fp&& __f)
@@ -1383,6 +1420,63 @@ public:
         }
 };
 
+template <typename _Rp, typename _Fp>
+struct __future_executor_shared_state
+    : __shared_state<_Rp>
+{
+    _Fp __func_;
+    
+public:
+    explicit FORCE_INLINE
+    __future_executor_shared_state(executor* __exec, _Fp&& __f)
+        : __func_(std::forward<_Fp>(__f))
+        {
+            this->set_executor(__exec);
+        }
+    
+    FORCE_INLINE
+    void run()
+        {
+            try
+            {
+                this->mark_finished_with_result(invoke(__func_));
+            }
+            catch (...)
+            {
+                this->mark_exceptional_finish();
+            }
+        }
+};
+
+template <typename _Fp>
+struct __future_executor_shared_state<void, _Fp>
+    : __shared_state<void>
+{
+    _Fp __func_;
+    
+public:
+    explicit FORCE_INLINE
+    __future_executor_shared_state(executor* __exec, _Fp&& __f)
+        : __func_(std::forward<_Fp>(__f))
+        {
+            this->set_executor(__exec);
+        }
+    
+    FORCE_INLINE
+    void run()
+        {
+            try
+            {
+                invoke(__func_);
+                this->mark_finished_with_result();
+            }
+            catch (...)
+            {
+                this->mark_exceptional_finish();
+            }
+        }
+};
+
 template <typename _Rp, typename _Fp>
 struct __future_deferred_shared_state
     : __shared_state<_Rp>
@@ -1959,6 +2053,11 @@ FORCE_INLINE
 future<_Rp>
 __make_future_deferred_shared_state(_Fp&& __f);
 
+template <class _Rp, class _Fp>
+FORCE_INLINE
+future<_Rp>
+__make_future_executor_shared_state(executor& __exec, _Fp&& __f);
+
 template <typename _Fut, typename _Rp, typename _Fp>
     struct __future_deferred_continuation_shared_state;
 template <typename _Fut, typename _Rp, typename _Fp>
@@ -1979,7 +2078,7 @@ __make_future_deferred_continuation_shared_state(std::unique_lock<std::mutex>& _
 template <class _Fut, class _Rp, class _Fp>
 FORCE_INLINE
 future<_Rp>
-__make_future_executor_continuation_shared_state(std::unique_lock<std::mutex>& __lk, _Fut&& __f, executor* __e, _Fp&& __c);
+__make_future_executor_continuation_shared_state(std::unique_lock<std::mutex>& __lk, _Fut&& __f, executor* __e, bool __run_if_ready, _Fp&& __c);
 
 template <typename _Fut, typename _Rp>
     struct __future_unwrap_shared_state;
@@ -2252,7 +2351,7 @@ private:
         __make_future_deferred_continuation_shared_state(std::unique_lock<std::mutex>&, _F&&, _Fp&&);
     template <class _F, class _Up, class _Fp>
         friend future<_Up>
-        __make_future_executor_continuation_shared_state(std::unique_lock<std::mutex>&, _F&&, executor*, _Fp&&);
+        __make_future_executor_continuation_shared_state(std::unique_lock<std::mutex>&, _F&&, executor*, bool, _Fp&&);
     
     template <typename, typename>
         friend struct __future_unwrap_shared_state;
@@ -2271,6 +2370,9 @@ private:
     template <class _Up, class _Fp>
         friend future<_Up>
         __make_future_deferred_shared_state(_Fp&& __f);
+    template <class _Up, class _Fp>
+        friend future<_Up>
+        __make_future_executor_shared_state(executor&, _Fp&&);
     
     template <class _Tp>
         friend future<typename std::decay<_Tp>::type>
@@ -2466,7 +2568,7 @@ private:
         __make_future_deferred_continuation_shared_state(std::unique_lock<std::mutex>&, _F&&, _Fp&&);
     template <class _F, class _Up, class _Fp>
         friend future<_Up>
-        __make_future_executor_continuation_shared_state(std::unique_lock<std::mutex>&, _F&&, executor*, _Fp&&);
+        __make_future_executor_continuation_shared_state(std::unique_lock<std::mutex>&, _F&&, executor*, bool, _Fp&&);
     
     template <typename, typename>
         friend struct __future_unwrap_shared_state;
@@ -2485,6 +2587,9 @@ private:
     template <class _Up, class _Fp>
         friend future<_Up>
         __make_future_deferred_shared_state(_Fp&& __f);
+    template <class _Up, class _Fp>
+        friend future<_Up>
+        __make_future_executor_shared_state(executor&, _Fp&&);
     
     template <class _Tp>
         friend future<typename std::decay<_Tp>::type>
@@ -3551,6 +3656,17 @@ __make_future_async_shared_state(_Fp&& __f)
     return future<_Rp>(__h);
 }
 
+template <class _Rp, class _Fp>
+future<_Rp>
+__make_future_executor_shared_state(executor& __exec, _Fp&& __f)
+{
+    std::shared_ptr<__future_executor_shared_state<_Rp, _Fp>> __h(new __future_executor_shared_state<_Rp, _Fp>(&__exec, std::forward<_Fp>(__f)));
+    __exec.add([__h]() {
+        __h->run();
+    });
+    return future<_Rp>(__h);
+}
+
 ////////////////////////////////////////////////////////////////////////////
 // Free functions
 
@@ -3566,7 +3682,11 @@ async(launch __policy, _Fp&& __f, _Args&&... __args)
     typedef typename _BF::_Rp _Rp;
     
     future<_Rp> __r;
-    if (int(__policy) & int(launch::async))
+    if (int(__policy) & int(launch::pooled))
+    {
+        __r = __make_future_executor_shared_state<_Rp>(default_thread_pool(), _BF(decay_copy(std::forward<_Fp>(__f)), decay_copy(std::forward<_Args>(__args))...));
+    }
+    else if (int(__policy) & int(launch::async))
     {
         __r = __make_future_async_shared_state<_Rp>(_BF(decay_copy(std::forward<_Fp>(__f)), decay_copy(std::forward<_Args>(__args))...));
     }
@@ -3577,6 +3697,23 @@ async(launch __policy, _Fp&& __f, _Args&&... __args)
     
     return __r;
 }
+/**
+ Runs a task on an executor, such as a thread_pool. Continuations attached to the
+ result without a launch policy run on the same executor.
+ 
+ The result keeps only a plain pointer to the executor, so it must outlive the
+ future and any continuations attached to it; default_thread_pool() lives for the
+ life of the process. The same goes for the executor passed to then().
+ */
+template <class _Fp, class ..._Args>
+future<typename __invoke_of<typename std::decay<_Fp>::type, typename std::decay<_Args>::type...>::type>
+async(executor& __exec, _Fp&& __f, _Args&&... __args)
+{
+    typedef __async_func<typename std::decay<_Fp>::type, typename std::decay<_Args>::type...> _BF;
+    typedef typename _BF::_Rp _Rp;
+    
+    return __make_future_executor_shared_state<_Rp>(__exec, _BF(decay_copy(std::forward<_Fp>(__f)), decay_copy(std::forward<_Args>(__args))...));
+}
 #if !EPUB_COMPILER(MSVC)
 template <class _Fp, class ..._Args>
 future<typename __invoke_of<typename std::decay<_Fp>::type, typename std::decay<_Args>::type...>::type>
@@ -3710,6 +3847,7 @@ public:
     void launch_continuation(std::unique_lock<std::mutex>& __lk)
         {
             __lk.unlock();
+            std::lock_guard<std::mutex> _(this->__mutex_);
             this->__thr_ = std::thread(&__future_async_continuation_shared_state::run, this);
         }
     
@@ -3750,11 +3888,12 @@ public:
     void launch_continuation(std::unique_lock<std::mutex>& __lk)
         {
             __lk.unlock();
+            std::lock_guard<std::mutex> _(this->__mutex_);
             this->__thr_ = std::thread(&__future_async_continuation_shared_state::run, this);
         }
     
     static
-    void run(__future_async_continuation_shared_state& __that)
+    void run(__future_async_continuation_shared_state* __that)
     {
         try
         {
@@ -3865,26 +4004,34 @@ public:
     FORCE_INLINE
     __future_executor_continuation_shared_state(_Fut&& __f, executor* __exec, _Fp&& __c)
         : __parent_(std::move(__f)), __continuation_(std::move(__c)), __target_(__exec)
-        {}
+        {
+            this->set_executor(__exec);
+        }
     
     virtual
     void launch_continuation(std::unique_lock<std::mutex>& __lk)
         {
             assert(__target_ != nullptr);
-            __relocker __relock(__lk);
+            __lk.unlock();
             
-            auto self = this->shared_from_this();
-            __target_->add([this, self]() {
-                try
-                {
-                    this->mark_finished_with_result(this->__continuation_(std::move(this->__parent_)));
-                }
-                catch (...)
-                {
-                    this->mark_exceptional_finish();
-                }
+            auto self = std::static_pointer_cast<__future_executor_continuation_shared_state>(this->shared_from_this());
+            __target_->add([self]() {
+                run(self.get());
             });
         }
+    
+    static
+    void run(__future_executor_continuation_shared_state* __that)
+        {
+            try
+            {
+                __that->mark_finished_with_result(__that->__continuation_(std::move(__that->__parent_)));
+            }
+            catch (...)
+            {
+                __that->mark_exceptional_finish();
+            }
+        }
 };
 
 template <typename _Fut, typename _Fp>
@@ -3899,7 +4046,9 @@ public:
     FORCE_INLINE
     __future_executor_continuation_shared_state(_Fut&& __f, executor* __exec, _Fp&& __c)
         : __parent_(std::move(__f)), __continuation_(std::move(__c)), __target_(__exec)
-        {}
+        {
+            this->set_executor(__exec);
+        }
     
     virtual
     void launch_continuation(std::unique_lock<std::mutex>& __lk)
@@ -3907,19 +4056,25 @@ public:
             assert(__target_ != nullptr);
             __lk.unlock();
             
-            auto self = this->shared_from_this();
-            __target_->add([this, self]() {
-                try
-                {
-                    this->__continuation_(std::move(this->__parent_));
-                    this->mark_finished_with_result();
-                }
-                catch (...)
-                {
-                    this->mark_exceptional_finish();
-                }
+            auto self = std::static_pointer_cast<__future_executor_continuation_shared_state>(this->shared_from_this());
+            __target_->add([self]() {
+                run(self.get());
             });
         }
+    
+    static
+    void run(__future_executor_continuation_shared_state* __that)
+        {
+            try
+            {
+                __that->__continuation_(std::move(__that->__parent_));
+                __that->mark_finished_with_result();
+            }
+            catch (...)
+            {
+                __that->mark_exceptional_finish();
+            }
+        }
 };
 
 template <typename _Fut, typename _Rp, typename _Fp>
@@ -3931,21 +4086,44 @@ __make_future_deferred_continuation_shared_state(std::unique_lock<std::mutex>& _
     return future<_Rp>(__h);
 }
 
+// A continuation of a future which is already ready runs straight away on the calling
+// thread: there's nothing to wait for, so there's no point handing it to another. This
+// is only done where the caller didn't ask for a particular executor.
+template <typename _State>
+void
+__attach_or_run_continuation(std::unique_lock<std::mutex>& __lk, const std::shared_ptr<_State>& __h, bool __run_if_ready = true)
+{
+    if (__run_if_ready && __h->__parent_.__future_->__done_)
+    {
+        __lk.unlock();
+        _State::run(__h.get());
+    }
+    else
+    {
+        // if the parent is ready, the continuation may consume it on another thread
+        // before we're done with its lock, so hold on to it until that's released
+        auto __parent = __h->__parent_.__future_;
+        __parent->set_continuation_ptr(__h, __lk);
+        if (__lk.owns_lock())
+            __lk.unlock();
+    }
+}
+
 template <typename _Fut, typename _Rp, typename _Fp>
 future<_Rp>
 __make_future_async_continuation_shared_state(std::unique_lock<std::mutex>& __lk, _Fut&& __f, _Fp&& __c)
 {
     std::shared_ptr<__future_async_continuation_shared_state<_Fut, _Rp, _Fp>> __h(new __future_async_continuation_shared_state<_Fut, _Rp, _Fp>(std::move(__f), std::forward<_Fp>(__c)));
-    __h->__parent_.__future_->set_continuation_ptr(__h, __lk);
+    __attach_or_run_continuation(__lk, __h);
     return future<_Rp>(__h);
 }
 
 template <typename _Fut, typename _Rp, typename _Fp>
 future<_Rp>
-__make_future_executor_continuation_shared_state(std::unique_lock<std::mutex>& __lk, _Fut&& __f, executor* __exec, _Fp&& __c)
+__make_future_executor_continuation_shared_state(std::unique_lock<std::mutex>& __lk, _Fut&& __f, executor* __exec, bool __run_if_ready, _Fp&& __c)
 {
     std::shared_ptr<__future_executor_continuation_shared_state<_Fut, _Rp, _Fp>> __h(new __future_executor_continuation_shared_state<_Fut, _Rp, _Fp>(std::move(__f), __exec, std::forward<_Fp>(__c)));
-    __h->__parent_.__future_->set_continuation_ptr(__h, __lk);
+    __attach_or_run_continuation(__lk, __h, __run_if_ready);
     return future<_Rp>(__h);
 }
 
@@ -3963,7 +4141,11 @@ future<_Rp>::then(launch __policy, _Fp&& __func)
         throw future_uninitialized();
     
     std::unique_lock<std::mutex> __lk(this->__future_->__mutex_);
-    if (int(__policy) & int(launch::async))
+    if (int(__policy) & int(launch::pooled))
+    {
+        return std::move(__make_future_executor_continuation_shared_state<future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), &default_thread_pool(), true, std::forward<_Fp>(__func)));
+    }
+    else if (int(__policy) & int(launch::async))
     {
         return std::move(__make_future_async_continuation_shared_state<future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), std::forward<_Fp>(__func)));
     }
@@ -3988,7 +4170,11 @@ future<_Rp>::then(_Fp&& __func)
         throw future_uninitialized();
     
     std::unique_lock<std::mutex> __lk(this->__future_->__mutex_);
-    if (int(this->launch_policy(__lk)) & int(launch::async))
+    if (executor* __exec = this->__future_->launch_executor(__lk))
+    {
+        return std::move(__make_future_executor_continuation_shared_state<future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), __exec, true, std::forward<_Fp>(__func)));
+    }
+    else if (int(this->launch_policy(__lk)) & int(launch::async))
     {
         return std::move(__make_future_async_continuation_shared_state<future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), std::forward<_Fp>(__func)));
     }
@@ -4013,7 +4199,7 @@ future<_Rp>::then(executor& __exec, _Fp&& __func)
         throw future_uninitialized();
     
     std::unique_lock<std::mutex> __lk(this->__future_->__mutex_);
-    return std::move(__make_future_executor_continuation_shared_state<future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), &__exec, std::forward<_Fp>(__func)));
+    return std::move(__make_future_executor_continuation_shared_state<future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), &__exec, false, std::forward<_Fp>(__func)));
 }
 
 template <typename _Rp>
@@ -4027,7 +4213,11 @@ shared_future<_Rp>::then(launch __policy, _Fp&& __func)
         throw future_uninitialized();
     
     std::unique_lock<std::mutex> __lk(this->__future_->__mutex_);
-    if (int(__policy) & int(launch::async))
+    if (int(__policy) & int(launch::pooled))
+    {
+        return std::move(__make_future_executor_continuation_shared_state<shared_future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), &default_thread_pool(), true, std::forward<_Fp>(__func)));
+    }
+    else if (int(__policy) & int(launch::async))
     {
         return std::move(__make_future_async_continuation_shared_state<shared_future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), std::forward<_Fp>(__func)));
     }
@@ -4052,7 +4242,11 @@ shared_future<_Rp>::then(_Fp&& __func)
         throw future_uninitialized();
     
     std::unique_lock<std::mutex> __lk(this->__future_->__mutex_);
-    if (int(this->launch_policy(__lk)) & int(launch::async))
+    if (executor* __exec = this->__future_->launch_executor(__lk))
+    {
+        return std::move(__make_future_executor_continuation_shared_state<shared_future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), __exec, true, std::forward<_Fp>(__func)));
+    }
+    else if (int(this->launch_policy(__lk)) & int(launch::async))
     {
         return std::move(__make_future_async_continuation_shared_state<shared_future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), std::forward<_Fp>(__func)));
     }
@@ -4077,7 +4271,7 @@ shared_future<_Rp>::then(executor& __exec, _Fp&& __func)
         throw future_uninitialized();
     
     std::unique_lock<std::mutex> __lk(this->__future_->__mutex_);
-    return std::move(__make_future_executor_continuation_shared_state<shared_future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), &__exec, std::forward<_Fp>(__func)));
+    return std::move(__make_future_executor_continuation_shared_state<shared_future<_Rp>, _Fut, _Fp>(__lk, std::move(*this), &__exec, false, std::forward<_Fp>(__func)));
 }
 
 EPUB3_END_NAMESPACE
@@ -30,6 +30,11 @@
 #include "utfstring.h"
 #include "integer_sequence.h"
 #include <locale>
+#include <algorithm>
+#include <cstring>
+#if EPUB_CPU(X86_64) || (EPUB_CPU(X86) && defined(__SSE2__))
+# include <emmintrin.h>
+#endif
 
 #if EPUB_PLATFORM(WINRT)
 // need a converter from UTF-8 to Windows' wchar_t
@@ -53,6 +58,39 @@ const size_t utf8_sizes[256] = {
 const string::size_type string::npos = string::__base::npos;
 const string string::EmptyString = string();
 
+// every kIndexStride'th code point has its byte offset recorded
+static const string::size_type kIndexStride = 32;
+
+// the index of a pure-ASCII string: only its address is meaningful
+const string::_IndexTable string::_asciiIndex = { 0, {} };
+
+// returns true if no byte has its high bit set
+static bool IsASCII(const char* p, size_t n) _NOEXCEPT
+{
+    const char* end = p + n;
+#if EPUB_CPU(X86_64) || (EPUB_CPU(X86) && defined(__SSE2__))
+    for ( ; end - p >= 16; p += 16 )
+    {
+        if ( _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) != 0 )
+            return false;
+    }
+#else
+    for ( ; end - p >= 8; p += 8 )
+    {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        if ( (word & UINT64_C(0x8080808080808080)) != 0 )
+            return false;
+    }
+#endif
+    for ( ; p < end; ++p )
+    {
+        if ( (static_cast<unsigned char>(*p) & 0x80) != 0 )
+            return false;
+    }
+    return true;
+}
+
 string::string(const_u4pointer s)
 {
     _base.append(_Convert<value_type>::toUTF8(s));
@@ -137,7 +175,8 @@ string::size_type string::size() const _NOEXCEPT
 {
     // note that ePub3::string .utf8_size() actually returns _base.size() (from std::string)
     // but that ePub3::string .size() does not necessarily return the same as std::string .size() !
-    return to_utf32_size(_base.size());
+    const _IndexTable* table = index_table();
+    return (is_ascii(table) ? _base.size() : table->length);
 }
 void string::resize(size_type n, value_type c)
 {
@@ -146,6 +185,7 @@ void string::resize(size_type n, value_type c)
     {
         // get UTF-8 prepresentation of the character
         _base.append(_Convert<value_type>::toUTF8(c, n-__s));
+        invalidate_index();
     }
     else if ( n < __s )
     {
@@ -161,6 +201,7 @@ void string::resize(size_type n)
         // extend with NUL chars-- one byte each in UTF-8
         size_type toAdd = n - __s;
         _base.resize(_base.size() + toAdd);
+        invalidate_index();
     }
     else if ( n < __s )
     {
@@ -173,6 +214,7 @@ void string::resize(size_type n)
         if ( n == 0 )
         {
             _base.resize(0);
+            invalidate_index();
             return;
         }
         
@@ -190,6 +232,7 @@ void string::resize(size_type n)
         
         // resize the underlying byte string
         _base.resize(newByteSize);
+        invalidate_index();
     }
 }
 #if 0//EPUB_PLATFORM(WINRT)
@@ -201,27 +244,32 @@ void string::resize(size_type n)
 #endif
 const string::value_type string::at(size_type pos) const
 {
-    return const_cast<string*>(this)->at(pos);
+    return const_cast<string*>(this)->at(pos);     // at() doesn't modify the string
 }
 string::value_type string::at(size_type pos)
 {
+    // read through the const accessor, which leaves the code-point index intact
     typedef _Convert<value_type> Converter;
-    const char * _pos = reinterpret_cast<const char*>(xmlAt(pos));
+    const char * _pos = reinterpret_cast<const char*>(static_cast<const string*>(this)->xmlAt(pos));
+    if ( (static_cast<unsigned char>(*_pos) & 0x80) == 0 )
+        return static_cast<value_type>(*_pos);
     Converter::wide_string wstr = Converter::fromUTF8(_pos, 0, UTF8CharLen(*_pos));
     return wstr[0];
 }
 const xmlChar * string::xmlAt(size_type pos) const
-{
-    return const_cast<string*>(this)->xmlAt(pos);
-}
-xmlChar * string::xmlAt(size_type pos)
 {
     if ( pos >= size() )
         throw std::range_error("Position beyond size of string.");
     
     __base::size_type bpos = to_byte_size(pos);
-    const char * p = &_base.at(bpos);
-    return const_cast<xmlChar*>(reinterpret_cast<const xmlChar *>(p));
+    return reinterpret_cast<const xmlChar *>(&_base.at(bpos));
+}
+xmlChar * string::xmlAt(size_type pos)
+{
+    // the caller may write through the result, so the index can't be trusted afterwards
+    xmlChar * p = const_cast<xmlChar*>(static_cast<const string*>(this)->xmlAt(pos));
+    invalidate_index();
+    return p;
 }
 string::__base string::utf8At(size_type pos) const
 {
@@ -234,18 +282,21 @@ template <>
 string & string::assign(iterator first, iterator last)
 {
     _base.assign(first.base(), last.base());
+    invalidate_index();
     return *this;
 }
 template <>
 string & string::assign(__base::const_iterator first, __base::const_iterator last)
 {
     _base.assign(first, last);
+    invalidate_index();
     return *this;
 }
 template <>
 string & string::assign(const char *first, const char *last)
 {
     _base.assign(first, last-first);
+    invalidate_index();
     return *this;
 }
 #endif
@@ -261,16 +312,19 @@ string & string::assign(const string &o, size_type i, size_type n)
     }
     
     _base.assign(pos, end);
+    invalidate_index();
     return *this;
 }
 string & string::assign(const_u4pointer s, size_type n)
 {
     _base.assign(_Convert<value_type>::toUTF8(s, 0, n));
+    invalidate_index();
     return *this;
 }
 string& string::assign(const char16_t* s, size_type n)
 {
     _base.assign(_Convert<char16_t>::toUTF8(s, 0, n));
+    invalidate_index();
     return *this;
 }
 #ifndef UTFSTRING_SPECIALIZATIONS_INLINED
@@ -278,18 +332,21 @@ template <>
 string & string::append(const_iterator first, const_iterator last)
 {
     _base.append(first.base(), last.base());
+    invalidate_index();
     return *this;
 }
 template <>
 string & string::append(__base::const_iterator first, __base::const_iterator last)
 {
     _base.append(first, last);
+    invalidate_index();
     return *this;
 }
 template <>
 string & string::append(const char * first, const char * last)
 {
     _base.append(first, last-first);
+    invalidate_index();
     return *this;
 }
 #endif
@@ -302,6 +359,7 @@ string & string::append(const string &o, size_type i, size_type n)
 string & string::append(const_u4pointer s, size_type n)
 {
     _base.append(_Convert<value_type>::toUTF8(s, 0, n));
+    invalidate_index();
     return *this;
 }
 string & string::append(size_type n, value_type c)
@@ -313,6 +371,7 @@ string & string::append(size_type n, value_type c)
 string & string::append(const char16_t* s, size_type n)
 {
     _base.append(_Convert<char16_t>::toUTF8(s, 0, n));
+    invalidate_index();
     return *this;
 }
 string & string::append(size_type n, char16_t c)
@@ -329,9 +388,11 @@ string::iterator string::insert(iterator pos, iterator first, iterator last)
     
 #if CXX11_STRING_UNAVAILABLE
     _base.insert(pos.base(), first.base(), last.base());
+    invalidate_index();
     return iterator(pos + std::distance(first, last));
 #else
     __base::iterator inserted(_base.insert(pos.base(), first.base(), last.base()));
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -342,9 +403,11 @@ string::iterator string::insert(iterator pos, __base::iterator first, __base::it
         return pos;
 #if CXX11_STRING_UNAVAILABLE
     _base.insert(pos.base(), first, last);
+    invalidate_index();
     return iterator(pos + utf32_distance(first, last));
 #else
     __base::iterator inserted(_base.insert(pos.base(), first, last));
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -365,6 +428,7 @@ string & string::insert(size_type pos, const string &s, size_type b, size_type e
         throw std::range_error("Position to copy from inserted string out of range");
     
     _base.insert(bpos, s._base, bb, be);
+    invalidate_index();
     return *this;
 }
 string::iterator string::insert(iterator pos, const string &s, size_type b, size_type e)
@@ -386,9 +450,11 @@ string::iterator string::insert(iterator pos, const string &s, size_type b, size
     
 #if CXX11_STRING_UNAVAILABLE
     _base.insert(pos.base(), first, last);
+    invalidate_index();
     return iterator(pos + utf32_distance(first, last));
 #else
     __base::iterator inserted(_base.insert(pos.base(), first, last));
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -404,6 +470,7 @@ string & string::insert(size_type pos, const_u4pointer s, size_type e)
     
     auto utf8 = _Convert<value_type>::toUTF8(s, 0, e);
     _base.insert(to_byte_size(pos), utf8);
+    invalidate_index();
     return *this;
 }
 string & string::insert(size_type pos, const char16_t* s, size_type e)
@@ -418,6 +485,7 @@ string & string::insert(size_type pos, const char16_t* s, size_type e)
     
     auto utf8 = _Convert<char16_t>::toUTF8(s, 0, e);
     _base.insert(to_byte_size(pos), utf8);
+    invalidate_index();
     return *this;
 }
 string & string::insert(size_type pos, size_type n, value_type c)
@@ -434,6 +502,7 @@ string & string::insert(size_type pos, size_type n, value_type c)
     if ( utf8.size() == 1 )
     {
         _base.insert(to_byte_size(pos), n, utf8[0]);
+        invalidate_index();
     }
     else
     {
@@ -444,6 +513,7 @@ string & string::insert(size_type pos, size_type n, value_type c)
             buf.append(utf8);
         
         _base.insert(to_byte_size(pos), buf);
+        invalidate_index();
     }
     
     return *this;
@@ -462,6 +532,7 @@ string & string::insert(size_type pos, size_type n, char16_t c)
     if ( utf8.size() == 1 )
     {
         _base.insert(to_byte_size(pos), n, utf8[0]);
+        invalidate_index();
     }
     else
     {
@@ -472,6 +543,7 @@ string & string::insert(size_type pos, size_type n, char16_t c)
             buf.append(utf8);
         
         _base.insert(to_byte_size(pos), buf);
+        invalidate_index();
     }
     
     return *this;
@@ -483,9 +555,11 @@ string::iterator string::insert(iterator pos, const_u4pointer s, size_type e)
     auto utf8 = _Convert<value_type>::toUTF8(s, 0, e);
 #if CXX11_STRING_UNAVAILABLE
     _base.insert(pos.base(), utf8.begin(), utf8.end());
+    invalidate_index();
     return iterator(pos + e);
 #else
     __base::iterator inserted(_base.insert(pos.base(), utf8.begin(), utf8.end()));
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -496,9 +570,11 @@ string::iterator string::insert(iterator pos, const char16_t* s, size_type e)
     auto utf8 = _Convert<char16_t>::toUTF8(s, 0, e);
 #if CXX11_STRING_UNAVAILABLE
     _base.insert(pos.base(), utf8.begin(), utf8.end());
+    invalidate_index();
     return iterator(pos + utf32_distance(utf8.begin(), utf8.end()));
 #else
     __base::iterator inserted(_base.insert(pos.base(), utf8.begin(), utf8.end()));
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -514,9 +590,11 @@ string::iterator string::insert(iterator pos, size_type n, value_type c)
     {
 #if CXX11_STRING_UNAVAILABLE
         _base.insert(pos.base(), n, utf8[0]);
+        invalidate_index();
         return iterator(pos + n);
 #else
         __base::iterator inserted(_base.insert(pos.base(), n, utf8[0]));
+        invalidate_index();
         return iterator(inserted, _base.begin(), _base.end());
 #endif
     }
@@ -528,9 +606,11 @@ string::iterator string::insert(iterator pos, size_type n, value_type c)
         buf.append(utf8);
 #if CXX11_STRING_UNAVAILABLE
     _base.insert(pos.base(), buf.begin(), buf.end());
+    invalidate_index();
     return iterator(pos + n);
 #else
     auto inserted = _base.insert(pos.base(), buf.begin(), buf.end());
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -546,9 +626,11 @@ string::iterator string::insert(iterator pos, size_type n, char16_t c)
     {
 #if CXX11_STRING_UNAVAILABLE
         _base.insert(pos.base(), n, utf8[0]);
+        invalidate_index();
         return iterator(pos + n);
 #else
         __base::iterator inserted(_base.insert(pos.base(), n, utf8[0]));
+        invalidate_index();
         return iterator(inserted, _base.begin(), _base.end());
 #endif
     }
@@ -560,9 +642,11 @@ string::iterator string::insert(iterator pos, size_type n, char16_t c)
         buf.append(utf8);
 #if CXX11_STRING_UNAVAILABLE
     _base.insert(pos.base(), buf.begin(), buf.end());
+    invalidate_index();
     return iterator(pos + n);
 #else
     auto inserted = _base.insert(pos.base(), buf.begin(), buf.end());
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -570,12 +654,14 @@ string & string::insert(size_type pos, const __base &s, size_type b, size_type e
 {
     throw_unless_insertable(s, b, e);
     _base.insert(to_byte_size(pos), s, b, e);
+    invalidate_index();
     return *this;
 }
 string & string::insert(size_type pos, __base::iterator b, __base::iterator e)
 {
     throw_unless_insertable(&(*b), 0, e-b);
     _base.insert(_base.begin()+to_byte_size(pos), b, e);
+    invalidate_index();
     return *this;
 }
 string::iterator string::insert(iterator pos, const __base &s, size_type b, size_type e)
@@ -585,9 +671,11 @@ string::iterator string::insert(iterator pos, const __base &s, size_type b, size
     auto __b = s.begin()+b;
     auto __e = (e == npos ? s.end() : s.begin()+e);
     _base.insert(pos.base(), __b, __e);
+    invalidate_index();
     return iterator(pos + utf32_distance(__b, __e));
 #else
     auto inserted(_base.insert(pos.base(), s.begin()+b, (e == npos ? s.end() : s.begin()+e)));
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -598,11 +686,13 @@ string & string::insert(size_type pos, const char *s, size_type b, size_type e)
         _base.insert(to_byte_size(pos), s+b);
     else
         _base.insert(to_byte_size(pos), s+b, e-b);
+    invalidate_index();
     return *this;
 }
 string & string::insert(size_type pos, size_type n, char c)
 {
     _base.insert(to_byte_size(pos), n, c);
+    invalidate_index();
     return *this;
 }
 string::iterator string::insert(iterator pos, const char * str, size_type b, size_type e)
@@ -614,9 +704,11 @@ string::iterator string::insert(iterator pos, const char * str, size_type b, siz
         e = strlen(str) - b;
 #if CXX11_STRING_UNAVAILABLE
     _base.insert(pos.base(), str+b, str+e);
+    invalidate_index();
     return iterator(pos + utf32_distance(__base::const_iterator(str+b), __base::const_iterator(str+e)));
 #else
     auto inserted(_base.insert(pos.base(), str+b, str+e));
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -626,9 +718,11 @@ string::iterator string::insert(iterator pos, size_type n, char c)
         return append(n, c).end();
 #if CXX11_STRING_UNAVAILABLE
     _base.insert(pos.base(), n, c);
+    invalidate_index();
     return iterator(pos + n);
 #else
     auto inserted(_base.insert(pos.base(), n, c));
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -648,12 +742,14 @@ string & string::erase(size_type pos, size_type n)
         if ( n == npos || pos+n == __s )
         {
             _base.erase(to_byte_size(pos));
+            invalidate_index();
         }
         else
         {
             __base::size_type bpos = to_byte_size(pos);
             __base::size_type bend = to_byte_size(pos, pos+n);
             _base.erase(bpos, bend-bpos);
+            invalidate_index();
         }
     }
     
@@ -662,11 +758,13 @@ string & string::erase(size_type pos, size_type n)
 string::iterator string::erase(cxx11_const_iterator pos)
 {
     auto modified(_base.erase(pos.base()));
+    invalidate_index();
     return iterator(modified, _base.begin(), _base.end());
 }
 string::iterator string::erase(cxx11_const_iterator first, cxx11_const_iterator last)
 {
     auto modified(_base.erase(first.base(), last.base()));
+    invalidate_index();
     return iterator(modified, _base.begin(), _base.end());
 }
 #ifndef UTFSTRING_SPECIALIZATIONS_INLINED
@@ -674,12 +772,14 @@ template <>
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, cxx11_const_iterator j1, cxx11_const_iterator j2)
 {
     _base.replace(i1.base(), i2.base(), j1.base(), j2.base());
+    invalidate_index();
     return *this;
 }
 template <>
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, __base::const_iterator j1, __base::const_iterator j2)
 {
     _base.replace(i1.base(), i2.base(), j1, j2);
+    invalidate_index();
     return *this;
 }
 template <>
@@ -687,42 +787,50 @@ string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, std::
 {
     auto utf8 = _Convert<value_type>::toUTF8(&(*j1), 0, std::distance(j1, j2));
     _base.replace(i1.base(), i2.base(), utf8);
+    invalidate_index();
     return *this;
 }
 #endif
 string & string::replace(size_type pos1, size_type n1, const string & str)
 {
     _base.replace(to_byte_size(pos1), to_byte_size(pos1, pos1+n1), str._base);
+    invalidate_index();
     return *this;
 }
 string & string::replace(size_type pos1, size_type n1, const string & str, size_type pos2, size_type n2)
 {
     _base.replace(to_byte_size(pos1), to_byte_size(pos1, pos1+n1), str._base, str.to_byte_size(pos2), str.to_byte_size(pos2, pos2+n2));
+    invalidate_index();
     return *this;
 }
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, const string& str)
 {
     _base.replace(i1.base(), i2.base(), str._base);
+    invalidate_index();
     return *this;
 }
 string & string::replace(size_type pos, size_type n1, const_u4pointer s, size_type n2)
 {
     _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), _Convert<value_type>::toUTF8(s, 0, n2));
+    invalidate_index();
     return *this;
 }
 string & string::replace(size_type pos, size_type n1, const char16_t* s, size_type n2)
 {
     _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), _Convert<char16_t>::toUTF8(s, 0, n2));
+    invalidate_index();
     return *this;
 }
 string & string::replace(size_type pos, size_type n1, const_u4pointer s)
 {
     _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), _Convert<value_type>::toUTF8(s));
+    invalidate_index();
     return *this;
 }
 string & string::replace(size_type pos, size_type n1, const char16_t* s)
 {
     _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), _Convert<char16_t>::toUTF8(s));
+    invalidate_index();
     return *this;
 }
 string & string::replace(size_type pos, size_type n1, size_type n2, value_type c)
@@ -731,10 +839,12 @@ string & string::replace(size_type pos, size_type n1, size_type n2, value_type c
     if ( n2 == 1 )
     {
         _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), utf8);
+        invalidate_index();
     }
     else if ( utf8.length() == 1 )
     {
         _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), n2, utf8[0]);
+        invalidate_index();
     }
     else
     {
@@ -743,6 +853,7 @@ string & string::replace(size_type pos, size_type n1, size_type n2, value_type c
         for ( size_type i = 0; i < n2; i++ )
             buf.append(utf8);
         _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), buf);
+        invalidate_index();
     }
     
     return *this;
@@ -753,10 +864,12 @@ string & string::replace(size_type pos, size_type n1, size_type n2, char16_t c)
     if ( n2 == 1 )
     {
         _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), utf8);
+        invalidate_index();
     }
     else if ( utf8.length() == 1 )
     {
         _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), n2, utf8[0]);
+        invalidate_index();
     }
     else
     {
@@ -765,6 +878,7 @@ string & string::replace(size_type pos, size_type n1, size_type n2, char16_t c)
         for ( size_type i = 0; i < n2; i++ )
             buf.append(utf8);
         _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), buf);
+        invalidate_index();
     }
     
     return *this;
@@ -772,21 +886,25 @@ string & string::replace(size_type pos, size_type n1, size_type n2, char16_t c)
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, const_u4pointer s, size_type n)
 {
     _base.replace(i1.base(), i2.base(), _Convert<value_type>::toUTF8(s, 0, n));
+    invalidate_index();
     return *this;
 }
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, const char16_t* s, size_type n)
 {
     _base.replace(i1.base(), i2.base(), _Convert<char16_t>::toUTF8(s, 0, n));
+    invalidate_index();
     return *this;
 }
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, const_u4pointer s)
 {
     _base.replace(i1.base(), i2.base(), _Convert<value_type>::toUTF8(s));
+    invalidate_index();
     return *this;
 }
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, const char16_t* s)
 {
     _base.replace(i1.base(), i2.base(), _Convert<char16_t>::toUTF8(s));
+    invalidate_index();
     return *this;
 }
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, size_type n, char16_t c)
@@ -795,10 +913,12 @@ string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, size_
     if ( n == 1 )
     {
         _base.replace(i1.base(), i2.base(), utf8);
+        invalidate_index();
     }
     else if ( utf8.length() == 1 )
     {
         _base.replace(i1.base(), i2.base(), n, utf8[0]);
+        invalidate_index();
     }
     else
     {
@@ -807,6 +927,7 @@ string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, size_
         for ( size_type i = 0; i < n; i++ )
             buf.append(utf8);
         _base.replace(i1.base(), i2.base(), buf);
+        invalidate_index();
     }
     
     return *this;
@@ -814,46 +935,55 @@ string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, size_
 string & string::replace(size_type pos1, size_type n1, const __base & str)
 {
     _base.replace(to_byte_size(pos1), to_byte_size(pos1, pos1+n1), str);
+    invalidate_index();
     return *this;
 }
 string & string::replace(size_type pos1, size_type n1, const __base & str, size_type pos2, size_type n2)
 {
     _base.replace(to_byte_size(pos1), to_byte_size(pos1, pos1+n1), str, pos2, n2);
+    invalidate_index();
     return *this;
 }
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, const __base & str)
 {
     _base.replace(i1.base(), i2.base(), str);
+    invalidate_index();
     return *this;
 }
 string & string::replace(size_type pos, size_type n1, const char * s, size_type n2)
 {
     _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), s, n2);
+    invalidate_index();
     return *this;
 }
 string & string::replace(size_type pos, size_type n1, const char * s)
 {
     _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), s);
+    invalidate_index();
     return *this;
 }
 string & string::replace(size_type pos, size_type n1, size_type n2, char c)
 {
     _base.replace(to_byte_size(pos), to_byte_size(pos, pos+n1), n2, c);
+    invalidate_index();
     return *this;
 }
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, const char * s, size_type n)
 {
     _base.replace(i1.base(), i2.base(), s, n);
+    invalidate_index();
     return *this;
 }
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, const char * s)
 {
     _base.replace(i1.base(), i2.base(), s);
+    invalidate_index();
     return *this;
 }
 string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, size_type n, char c)
 {
     _base.replace(i1.base(), i2.base(), n, c);
+    invalidate_index();
     return *this;
 }
 string::size_type string::copy(u4pointer s, size_type n, size_type pos) const
@@ -896,6 +1026,7 @@ string& string::tolower(const std::locale& loc)
 {
     auto& facet = std::use_facet<std::ctype<char>>(loc);
     facet.tolower(const_cast<char*>(_base.data()), const_cast<char*>(_base.data()) + _base.size());
+    invalidate_index();
     return *this;
 }
 const string string::tolower(const std::locale& loc) const
@@ -906,6 +1037,7 @@ string& string::toupper(const std::locale& loc)
 {
     auto& facet = std::use_facet<std::ctype<char>>(loc);
 	facet.toupper(const_cast<char*>(_base.data()), const_cast<char*>(_base.data()) + _base.size());
+	invalidate_index();
     return *this;
 }
 const string string::toupper(const std::locale& loc) const
@@ -1198,67 +1330,104 @@ void string::throw_unless_insertable(const xmlChar *s, size_type b, size_type e)
     throw_unless_insertable(reinterpret_cast<const char*>(s), b, e);
 }
 
-string::__base::size_type string::to_byte_size(size_type __n) const _NOEXCEPT
+const string::_IndexTable* string::index_table() const _NOEXCEPT
 {
-    __base::size_type count = 0;
-    if ( __n == npos || __n > size() )
-    {
-        count = __base::npos;
-    }
-    else if ( __n == size() )
+    const _IndexTable* table = _index.load(std::memory_order_acquire);
+    if ( table != nullptr )
+        return table;
+    
+    if ( IsASCII(_base.data(), _base.size()) )
     {
-        count = _base.size();
+        table = &_asciiIndex;
     }
     else
     {
-        auto pos = _base.cbegin();
-        auto end = _base.cend();
-        for ( size_type s = 0; s < __n && pos < end; s++ )
+        _IndexTable* built = new _IndexTable;
+        built->offsets.reserve(_base.size() / kIndexStride + 1);
+        
+        size_type count = 0;
+        for ( __base::size_type b = 0, e = _base.size(); b < e; count++ )
         {
-            size_t c = UTF8CharLen(*pos);
-            pos += c;
-            count += c;
+            if ( count % kIndexStride == 0 )
+                built->offsets.push_back(b);
+            b += UTF8CharLen(_base[b]);
         }
+        built->length = count;
+        table = built;
     }
     
-    return count;
+    // another reader may have got there first; const strings can be shared between threads
+    const _IndexTable* expected = nullptr;
+    if ( !_index.compare_exchange_strong(expected, table, std::memory_order_acq_rel, std::memory_order_acquire) )
+    {
+        if ( table != &_asciiIndex )
+            delete table;
+        table = expected;
+    }
+    
+    return table;
 }
-string::__base::size_type string::to_byte_size(size_type __b, size_type __e) const _NOEXCEPT
+void string::release_index() _NOEXCEPT
 {
-    if ( __e == __base::npos )
-        return __base::npos;
+    const _IndexTable* table = _index.exchange(nullptr, std::memory_order_acq_rel);
+    if ( table != &_asciiIndex )
+        delete table;
+}
+string::const_iterator string::iterator_at(size_type pos) const
+{
+    __base::size_type bpos = to_byte_size(pos);
+    if ( bpos > _base.size() )
+        bpos = _base.size();
+    return const_iterator(_base.begin()+bpos, _base.begin(), _base.end());
+}
+string::__base::size_type string::to_byte_size(size_type __n) const _NOEXCEPT
+{
+    const _IndexTable* table = index_table();
+    size_type length = (is_ascii(table) ? _base.size() : table->length);
     
-    __base::size_type r = to_byte_size(__b);
-    if ( __e == 0 )
-        return r;
+    if ( __n == npos || __n > length )
+        return __base::npos;
+    if ( __n == length )
+        return _base.size();
+    if ( is_ascii(table) )
+        return __n;
     
-    auto pos = _base.cbegin()+r;
-    for ( size_type i = __b; i < __e; i++ )
+    // start from the nearest recorded offset, then step over at most kIndexStride-1 characters
+    __base::size_type count = table->offsets[__n / kIndexStride];
+    for ( size_type s = __n - (__n % kIndexStride); s < __n; s++ )
     {
-        size_t c = UTF8CharLen(*pos);
-        pos += c;
-        r += c;
+        count += UTF8CharLen(_base[count]);
     }
     
-    return r;
+    return count;
+}
+string::__base::size_type string::to_byte_size(size_type __b, size_type __e) const _NOEXCEPT
+{
+    if ( __e == __base::npos )
+        return __base::npos;
+    if ( __e <= __b )
+        return to_byte_size(__b);
+    
+    // positions beyond the end are clamped to it
+    __base::size_type r = to_byte_size(__e);
+    return (r == __base::npos ? _base.size() : r);
 }
 string::size_type string::to_utf32_size(__base::size_type __n) const _NOEXCEPT
 {
-    size_type count = 0;
     if ( __n == __base::npos || __n > _base.size() )
+        return npos;
+    
+    const _IndexTable* table = index_table();
+    if ( is_ascii(table) )
+        return __n;
+    
+    // find the last recorded offset at or before __n, then count up to it
+    auto found = std::upper_bound(table->offsets.begin(), table->offsets.end(), __n);
+    size_type idx = size_type(found - table->offsets.begin()) - 1;
+    size_type count = idx * kIndexStride;
+    for ( __base::size_type s = table->offsets[idx]; s < __n; count++ )
     {
-        count = npos;
-    }
-    else
-    {
-        auto pos = _base.cbegin();
-        auto end = _base.cend();
-        for ( size_type s = 0; s < __n && pos < end; count++ )
-        {
-            size_t c = UTF8CharLen(*pos);
-            pos += c;
-            s += c;
-        }
+        s += UTF8CharLen(_base[s]);
     }
     
     return count;
@@ -1267,16 +1436,9 @@ string::size_type string::to_utf32_size(__base::size_type __b, __base::size_type
 {
     if ( __e == npos )
         return npos;
-    
-    size_type count = 0;
-    auto pos = _base.cbegin()+__b;
-    for ( size_type i = __b; i < __e; )
-    {
-        size_t c = UTF8CharLen(*pos);
-        pos += c;
-        count++;
-    }
-    return count;
+    if ( __e <= __b )
+        return 0;
+    return to_utf32_size(__e) - to_utf32_size(__b);
 }
 string::size_type string::utf32_distance(__base::const_iterator first, __base::const_iterator last) _NOEXCEPT
 {
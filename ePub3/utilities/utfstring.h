@@ -44,6 +44,7 @@
 #include <map>
 #include <stdexcept>
 #include <limits>
+#include <atomic>
 
 #if EPUB_USE(LIBXML2)
 #include <libxml/xmlstring.h>
@@ -122,7 +123,7 @@ public:
     // Standard
     string() : _base() {}
     string(const string &o) : _base(o._base) {}
-    string(string &&o) : _base(std::move(o._base)) {}
+    string(string &&o) : _base(std::move(o._base)), _index(o._index.exchange(nullptr)) {}
     string(const string & s, size_type i, size_type n=npos) : _base(s._base, s.to_byte_size(i), s.to_byte_size(i,n)) {}
     
     // From char32_t (value_type)
@@ -186,7 +187,7 @@ public:
     template <typename... Args>
     string(const Args&... args) : _base(_Str(args...)) {}
     */
-    ~string() {}
+    ~string() { invalidate_index(); }
     
 #if 0
 #pragma mark - Length/Iteration/Indexing
@@ -205,7 +206,7 @@ public:
     
     void reserve(size_type res_arg = 0) { return _base.reserve(res_arg*4); } // best guess
     void shrink_to_fit() { _base.shrink_to_fit(); }
-    void clear() _NOEXCEPT { _base.clear(); }
+    void clear() _NOEXCEPT { _base.clear(); invalidate_index(); }
     bool empty() const _NOEXCEPT { return _base.empty(); }
     
     iterator begin() _NOEXCEPT { return iterator(_base.begin(), _base.begin(), _base.end()); }
@@ -222,6 +223,7 @@ public:
     value_type operator[](size_type pos) { return at(pos); }
     
     EPUB3_EXPORT const xmlChar * xmlAt(size_type pos) const;
+    /// Writable access to the UTF-8 bytes; discards the cached code-point index.
     EPUB3_EXPORT xmlChar * xmlAt(size_type pos);
     
     EPUB3_EXPORT __base utf8At(size_type pos) const;
@@ -246,9 +248,17 @@ public:
     EPUB3_EXPORT string & assign(InputIterator first, InputIterator last);
     
     // standard
-    string & assign(const string &o) { _base.assign(o._base); return *this; }
+    string & assign(const string &o) { _base.assign(o._base); invalidate_index(); return *this; }
     EPUB3_EXPORT string & assign(const string &o, size_type i, size_type n=npos);
-    string & assign(string &&o) { _base.assign(std::move(o._base)); return *this; }
+    string & assign(string &&o)
+        {
+            // the moved content keeps its index; `o` is left without one
+            _base.assign(std::move(o._base));
+            const _IndexTable* index = o._index.exchange(nullptr);
+            invalidate_index();
+            _index.store(index);
+            return *this;
+        }
     string & operator=(const string & o) { return assign(o); }
     string & operator=(string &&o) { return assign(o); }
     
@@ -277,19 +287,19 @@ public:
 #endif
     
     // std::string
-    EPUB3_EXPORT string & assign(const __base & o) { _base.assign(o); return *this; }
+    EPUB3_EXPORT string & assign(const __base & o) { _base.assign(o); invalidate_index(); return *this; }
     string & assign(const __base & o, size_type i, size_type n=npos)
-        { _base.assign(o, i, n); return *this; }
-    string & assign(__base &&o) { _base.assign(o); return *this; }
+        { _base.assign(o, i, n); invalidate_index(); return *this; }
+    string & assign(__base &&o) { _base.assign(o); invalidate_index(); return *this; }
     string & operator=(const __base &o) { return assign(o); }
     string & operator=(__base &&o) { return assign(o); }
     
     // char
-    string & assign(const char * s, size_type n) { _base.assign(s, n); return *this; }
-    string & assign(const char * s) { _base.assign(s); return *this; }
-    string & assign(size_type n, char c) { _base.assign(n, c); return *this; }
+    string & assign(const char * s, size_type n) { _base.assign(s, n); invalidate_index(); return *this; }
+    string & assign(const char * s) { _base.assign(s); invalidate_index(); return *this; }
+    string & assign(size_type n, char c) { _base.assign(n, c); invalidate_index(); return *this; }
 #if EPUB_COMPILER_SUPPORTS(CXX_INITIALIZER_LISTS)
-    string & assign(std::initializer_list<__base::value_type> __il) { _base.assign(__il); return *this; }
+    string & assign(std::initializer_list<__base::value_type> __il) { _base.assign(__il); invalidate_index(); return *this; }
 #endif
     string & operator=(const char * s) { return assign(s, __base::traits_type::length(s)); }
     string & operator=(char c) { return assign(1, c); }
@@ -298,9 +308,9 @@ public:
 #endif
     
     // xmlChar
-    string & assign(const xmlChar * s, size_type n) { _base.assign(reinterpret_cast<const char *>(s), n); return *this; }
-    string & assign(const xmlChar * s) { _base.assign(reinterpret_cast<const char *>(s), xmlStrlen(s)); return *this; }
-    string & assign(size_type n, xmlChar c) { _base.assign(n, static_cast<char>(c)); return *this; }
+    string & assign(const xmlChar * s, size_type n) { _base.assign(reinterpret_cast<const char *>(s), n); invalidate_index(); return *this; }
+    string & assign(const xmlChar * s) { _base.assign(reinterpret_cast<const char *>(s), xmlStrlen(s)); invalidate_index(); return *this; }
+    string & assign(size_type n, xmlChar c) { _base.assign(n, static_cast<char>(c)); invalidate_index(); return *this; }
 #if EPUB_COMPILER_SUPPORTS(CXX_INITIALIZER_LISTS)
     string & assign(std::initializer_list<xmlChar> __il) { return assign(__il.begin(), __il.end()); }
 #endif
@@ -321,9 +331,9 @@ public:
     string & append(const Args&... args) { return append(string(args...)); }
 #endif
     // standard
-    string & append(const string &o) { _base.append(o._base); return *this; }
+    string & append(const string &o) { _base.append(o._base); invalidate_index(); return *this; }
     EPUB3_EXPORT string & append(const string &o, size_type i, size_type n=npos);
-    string & append(string &&o) { _base.append(std::move(o._base)); return *this; }
+    string & append(string &&o) { _base.append(std::move(o._base)); invalidate_index(); return *this; }
     string & operator+=(const string & o) { return append(o); }
     string & operator+=(string &&o) { return append(o); }
     
@@ -352,18 +362,18 @@ public:
 #endif
     
     // std::string
-    string & append(const __base & o) { _base.append(o); return *this; }
-    string & append(const __base & o, size_type i, size_type n=npos) { _base.append(o, i, n); return *this; }
-    string & append(__base &&o) { _base.append(o); return *this; }
+    string & append(const __base & o) { _base.append(o); invalidate_index(); return *this; }
+    string & append(const __base & o, size_type i, size_type n=npos) { _base.append(o, i, n); invalidate_index(); return *this; }
+    string & append(__base &&o) { _base.append(o); invalidate_index(); return *this; }
     string & operator+=(const __base &o) { return append(o); }
     string & operator+=(__base &&o) { return append(o); }
     
     // char
-    string & append(const char * s, size_type n) { _base.append(s, n); return *this; }
-    string & append(const char * s) { _base.append(s); return *this; }
-    string & append(size_type n, char c) { _base.append(n, c); return *this; }
+    string & append(const char * s, size_type n) { _base.append(s, n); invalidate_index(); return *this; }
+    string & append(const char * s) { _base.append(s); invalidate_index(); return *this; }
+    string & append(size_type n, char c) { _base.append(n, c); invalidate_index(); return *this; }
 #if EPUB_COMPILER_SUPPORTS(CXX_INITIALIZER_LISTS)
-    string & append(std::initializer_list<__base::value_type> __il) { _base.append(__il); return *this; }
+    string & append(std::initializer_list<__base::value_type> __il) { _base.append(__il); invalidate_index(); return *this; }
 #endif
     string & operator+=(const char * s) { return append(s); }
     string & operator+=(char c) { return append(1, c); }
@@ -372,9 +382,9 @@ public:
 #endif
     
     // xmlChar
-    string & append(const xmlChar * s, size_type n) { _base.append(reinterpret_cast<const char *>(s), n); return *this; }
-    string & append(const xmlChar * s) { _base.append(reinterpret_cast<const char *>(s), xmlStrlen(s)); return *this; }
-    string & append(size_type n, xmlChar c) { _base.append(n, static_cast<char>(c)); return *this; }
+    string & append(const xmlChar * s, size_type n) { _base.append(reinterpret_cast<const char *>(s), n); invalidate_index(); return *this; }
+    string & append(const xmlChar * s) { _base.append(reinterpret_cast<const char *>(s), xmlStrlen(s)); invalidate_index(); return *this; }
+    string & append(size_type n, xmlChar c) { _base.append(n, static_cast<char>(c)); invalidate_index(); return *this; }
 #if EPUB_COMPILER_SUPPORTS(CXX_INITIALIZER_LISTS)
     string & append(std::initializer_list<xmlChar> __il) { return append(__il.begin(), __il.end()); }
 #endif
@@ -554,6 +564,8 @@ public:
 #endif
     {
         _base.swap(str._base);
+        invalidate_index();
+        str.invalidate_index();
     }
     
     EPUB3_EXPORT std::u32string utf32string() const;
@@ -654,17 +666,17 @@ public:
     };
     
     size_type find_first_of(const string& str, size_type pos=0) const _NOEXCEPT {
-        auto __r = find_first_of(const_iterator(_base, pos), end(), str.begin(), str.end(), __traits_eq<traits_type>());
+        auto __r = find_first_of(iterator_at(pos), end(), str.begin(), str.end(), __traits_eq<traits_type>());
         if ( __r == end() )
             return npos;
-        return utf8::distance(begin().base(), __r.base());
+        return to_utf32_size(__r.base() - _base.begin());
     }
     size_type find_first_of(const __base& str, size_type pos=0) const {
         validate_utf8(str.substr(pos));
-        auto __r = find_first_of(const_iterator(_base, pos), end(), const_iterator(str.begin(), str.begin(), str.end()), const_iterator(str.end(), str.begin(), str.end()), __traits_eq<traits_type>());
+        auto __r = find_first_of(iterator_at(pos), end(), const_iterator(str.begin(), str.begin(), str.end()), const_iterator(str.end(), str.begin(), str.end()), __traits_eq<traits_type>());
         if ( __r == end() )
             return npos;
-        return utf8::distance(begin().base(), __r.base());
+        return to_utf32_size(__r.base() - _base.begin());
     }
     template <typename _CharT>
     size_type find_first_of(const _CharT * s, size_type pos, size_type n) const {
@@ -677,10 +689,10 @@ public:
     }
     template <typename _CharT>
     size_type find_first_of(_CharT c, size_type pos = 0) const _NOEXCEPT {
-        auto __r = std::find_first_of(begin()+pos, end(), &c, ((&c) + sizeof(_CharT)));
+        auto __r = std::find_first_of(iterator_at(pos), end(), &c, ((&c) + sizeof(_CharT)));
         if ( __r == end() )
             return npos;
-        return utf8::distance(begin().base(), __r.base());
+        return to_utf32_size(__r.base() - _base.begin());
     }
     
     size_type find_last_of(const string& str, size_type pos=npos) const _NOEXCEPT {
@@ -690,11 +702,11 @@ public:
         else
             pos = __sz;
         const_iterator __p = begin();
-        for ( const_iterator __ps = __p + pos; __ps != __p; )
+        for ( const_iterator __ps = iterator_at(pos); __ps != __p; )
         {
             size_type __r = str.find(*--__ps);
             if ( __r != npos )
-                return utf8::distance(begin().base(), __ps.base());
+                return to_utf32_size(__ps.base() - _base.begin());
         }
         return npos;
     }
@@ -706,11 +718,11 @@ public:
         else
             pos = __sz;
         const_iterator __p = begin();
-        for ( const_iterator __ps = __p + pos; __ps != __p; )
+        for ( const_iterator __ps = iterator_at(pos); __ps != __p; )
         {
             size_type __r = str.find((--__ps).utf8char());
             if ( __r != npos )
-                return utf8::distance(begin().base(), __ps.base());
+                return to_utf32_size(__ps.base() - _base.begin());
         }
         return npos;
     }
@@ -733,9 +745,9 @@ public:
         {
             const_iterator __p = begin();
             const_iterator __pe = end();
-            for ( const_iterator __ps = __p + pos; __ps != __pe; ++__ps )
+            for ( const_iterator __ps = iterator_at(pos); __ps != __pe; ++__ps )
                 if ( str.find(*__ps) == npos )
-                    return utf8::distance(__p.base(), __ps.base());
+                    return to_utf32_size(__ps.base() - _base.begin());
         }
         return npos;
     }
@@ -746,9 +758,9 @@ public:
         {
             const_iterator __p = begin();
             const_iterator __pe = end();
-            for ( const_iterator __ps = __p + pos; __ps != __pe; ++__ps )
+            for ( const_iterator __ps = iterator_at(pos); __ps != __pe; ++__ps )
                 if ( str.find(__ps.utf8char()) == npos )
-                    return utf8::distance(__p.base(), __ps.base());
+                    return to_utf32_size(__ps.base() - _base.begin());
         }
         return npos;
     }
@@ -772,9 +784,9 @@ public:
         else
             pos = __sz;
         const_iterator __p = begin();
-        for ( const_iterator __ps = __p + pos; __ps != __p; )
+        for ( const_iterator __ps = iterator_at(pos); __ps != __p; )
             if ( str.find(*--__ps) == npos )
-                return utf8::distance(__p.base(), __ps.base());
+                return to_utf32_size(__ps.base() - _base.begin());
         return npos;
     }
     size_type find_last_not_of(const __base& str, size_type pos=npos) const {
@@ -784,9 +796,9 @@ public:
         else
             pos = __sz;
         const_iterator __p = begin();
-        for ( const_iterator __ps = __p + pos; __ps != __p; )
+        for ( const_iterator __ps = iterator_at(pos); __ps != __p; )
             if ( str.find((--__ps).utf8char()) == npos )
-                return utf8::distance(__p.base(), __ps.base());
+                return to_utf32_size(__ps.base() - _base.begin());
         return npos;
     }
     template <typename _CharT>
@@ -873,6 +885,27 @@ public:
 protected:
     __base      _base;
     
+    ///
+    /// Maps code-point indices to byte offsets for a string containing non-ASCII
+    /// characters. Built on first use, and discarded whenever the string changes.
+    struct _IndexTable
+    {
+        size_type               length;     ///< The number of code points.
+        std::vector<__base::size_type>  offsets;    ///< The byte offset of every kIndexStride'th code point.
+    };
+    
+    ///
+    /// `nullptr` until the first indexed access; pure-ASCII strings then point to a
+    /// shared marker, since every index is a byte offset.
+    mutable std::atomic<const _IndexTable*>   _index {nullptr};
+    static const _IndexTable    _asciiIndex;
+    
+    const _IndexTable* index_table() const _NOEXCEPT;
+    static bool is_ascii(const _IndexTable* table) _NOEXCEPT { return table == &_asciiIndex; }
+    void invalidate_index() _NOEXCEPT { if ( _index.load(std::memory_order_relaxed) != nullptr ) release_index(); }
+    void release_index() _NOEXCEPT;
+    const_iterator iterator_at(size_type pos) const;
+    
     void validate_utf8(const __base &s) const;
     void validate_utf8(const char *s, size_type sz) const;
     void validate_utf8(const xmlChar *s, size_type sz) const;
@@ -1383,4 +1416,14 @@ operator<<(std::basic_ostream<_CharT, _Traits>& __os, const string& __str) {
 
 EPUB3_END_NAMESPACE
 
+namespace std {
+    // allows ePub3::string keys in unordered containers; hashes the UTF-8 bytes
+    template <>
+    struct hash<::EPUB3_NAMESPACE::string>
+    {
+        size_t operator()(const ::EPUB3_NAMESPACE::string& __s) const _NOEXCEPT
+            { return hash<::std::string>()(__s.stl_str()); }
+    };
+}
+
 #endif /* defined(__ePub3_xml_string__) */
@@ -40,36 +40,42 @@ template <>
 FORCE_INLINE string & string::assign(iterator first, iterator last)
 {
     _base.assign(first.base(), last.base());
+    invalidate_index();
     return *this;
 }
 template <>
 FORCE_INLINE string & string::assign(__base::const_iterator first, __base::const_iterator last)
 {
     _base.assign(first, last);
+    invalidate_index();
     return *this;
 }
 template <>
 FORCE_INLINE string & string::assign(const char *first, const char *last)
 {
     _base.assign(first, last-first);
+    invalidate_index();
     return *this;
 }
 template <>
 FORCE_INLINE string & string::append(const_iterator first, const_iterator last)
 {
     _base.append(first.base(), last.base());
+    invalidate_index();
     return *this;
 }
 template <>
 FORCE_INLINE string & string::append(__base::const_iterator first, __base::const_iterator last)
 {
     _base.append(first, last);
+    invalidate_index();
     return *this;
 }
 template <>
 FORCE_INLINE string & string::append(const char * first, const char * last)
 {
     _base.append(first, last-first);
+    invalidate_index();
     return *this;
 }
 template <>
@@ -80,9 +86,11 @@ FORCE_INLINE string::iterator string::insert(iterator pos, iterator first, itera
 
 #if CXX11_STRING_UNAVAILABLE
     _base.insert(pos.base(), first.base(), last.base());
+    invalidate_index();
     return iterator(pos + std::distance(first, last));
 #else
     __base::iterator inserted(_base.insert(pos.base(), first.base(), last.base()));
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -93,9 +101,11 @@ FORCE_INLINE string::iterator string::insert(iterator pos, __base::iterator firs
         return pos;
 #if CXX11_STRING_UNAVAILABLE
     _base.insert(pos.base(), first, last);
+    invalidate_index();
     return iterator(pos + utf32_distance(first, last));
 #else
     __base::iterator inserted(_base.insert(pos.base(), first, last));
+    invalidate_index();
     return iterator(inserted, _base.begin(), _base.end());
 #endif
 }
@@ -103,12 +113,14 @@ template <>
 FORCE_INLINE string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, cxx11_const_iterator j1, cxx11_const_iterator j2)
 {
     _base.replace(i1.base(), i2.base(), j1.base(), j2.base());
+    invalidate_index();
     return *this;
 }
 template <>
 FORCE_INLINE string & string::replace(cxx11_const_iterator i1, cxx11_const_iterator i2, __base::const_iterator j1, __base::const_iterator j2)
 {
     _base.replace(i1.base(), i2.base(), j1, j2);
+    invalidate_index();
     return *this;
 }
 template <>
@@ -116,6 +128,7 @@ FORCE_INLINE string & string::replace(cxx11_const_iterator i1, cxx11_const_itera
 {
     auto utf8 = _Convert<value_type>::toUTF8(&(*j1), 0, std::distance(j1, j2));
     _base.replace(i1.base(), i2.base(), utf8);
+    invalidate_index();
     return *this;
 }
 template <>
@@ -31,6 +31,10 @@
 #include "node.h"
 #include "document.h"
 #include <libxml/xpathInternals.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 EPUB3_XML_BEGIN_NAMESPACE
 
@@ -42,6 +46,148 @@ static XPathEvaluator::ObjectType __get_obj_type(xmlXPathObjectPtr ptr)
     return (ptr == nullptr ? XPathEvaluator::ObjectType::Undefined : XPathEvaluator::ObjectType(ptr->type));
 }
 
+// libxml2 caches function lookups inside a compiled expression while evaluating
+// it, so a compiled expression is only ever used by one evaluator at a time: the
+// cache lends each one out and takes it back when the evaluator is done with it.
+typedef std::shared_ptr<xmlXPathCompExpr> CompiledXPath;
+
+static const size_t _CompiledXPathCacheLimit = 512;
+
+class CompiledXPathCache
+{
+public:
+    CompiledXPathCache() : _lock(), _recent(), _entries(), _idleCount(0), _generation(0) {}
+    
+    // returns an idle expression compiled from `key`, or nullptr
+    xmlXPathCompExprPtr CheckOut(const std::string& key, unsigned& generation)
+    {
+        std::lock_guard<std::mutex> _(_lock);
+        generation = _generation;
+        
+        auto found = _entries.find(key);
+        if ( found == _entries.end() )
+            return nullptr;
+        
+        xmlXPathCompExprPtr result = found->second.idle.back();
+        found->second.idle.pop_back();
+        _idleCount--;
+        if ( found->second.idle.empty() )
+        {
+            _recent.erase(found->second.use);
+            _entries.erase(found);
+        }
+        return result;
+    }
+    
+    void CheckIn(const std::string& key, unsigned generation, xmlXPathCompExprPtr comp)
+    {
+        std::lock_guard<std::mutex> _(_lock);
+        if ( generation != _generation )
+        {
+            // compiled before a flush
+            xmlXPathFreeCompExpr(comp);
+            return;
+        }
+        
+        auto found = _entries.find(key);
+        if ( found == _entries.end() )
+        {
+            _recent.push_front(key);
+            found = _entries.emplace(key, Entry{_recent.begin(), {}}).first;
+        }
+        else
+        {
+            _recent.splice(_recent.begin(), _recent, found->second.use);
+        }
+        found->second.idle.push_back(comp);
+        _idleCount++;
+        
+        // evict from the least recently returned expression
+        while ( _idleCount > _CompiledXPathCacheLimit )
+        {
+            auto victim = _entries.find(_recent.back());
+            xmlXPathFreeCompExpr(victim->second.idle.back());
+            victim->second.idle.pop_back();
+            _idleCount--;
+            if ( victim->second.idle.empty() )
+            {
+                _recent.pop_back();
+                _entries.erase(victim);
+            }
+        }
+    }
+    
+    void Flush()
+    {
+        std::lock_guard<std::mutex> _(_lock);
+        for ( auto& item : _entries )
+        {
+            for ( auto comp : item.second.idle )
+                xmlXPathFreeCompExpr(comp);
+        }
+        _entries.clear();
+        _recent.clear();
+        _idleCount = 0;
+        _generation++;
+    }
+    
+private:
+    struct Entry
+    {
+        std::list<std::string>::iterator    use;
+        std::vector<xmlXPathCompExprPtr>    idle;
+    };
+    
+    std::mutex                              _lock;
+    std::list<std::string>                  _recent;        ///< Keys, most recently returned first.
+    std::unordered_map<std::string, Entry>  _entries;
+    size_t                                  _idleCount;
+    unsigned                                _generation;
+};
+
+static CompiledXPathCache& _CompiledXPathCache()
+{
+    // never destroyed: evaluators living in other statics may still return expressions
+    static CompiledXPathCache* __cache = new CompiledXPathCache;
+    return *__cache;
+}
+
+// A call to a prefixed function makes libxml2 keep a pointer to the namespace URI
+// owned by the evaluating context, so those expressions are never reused by another.
+static bool __calls_prefixed_function(const std::string& xpath)
+{
+    for ( size_t paren = xpath.find('('); paren != std::string::npos; paren = xpath.find('(', paren+1) )
+    {
+        if ( paren == 0 )
+            continue;
+        size_t end = xpath.find_last_not_of(" \t\r\n", paren-1);
+        if ( end == std::string::npos )
+            continue;
+        size_t start = end + 1;
+        while ( start > 0 && (isalnum(static_cast<unsigned char>(xpath[start-1])) || strchr("_-.:", xpath[start-1]) != nullptr) )
+            start--;
+        
+        std::string name = xpath.substr(start, end + 1 - start);
+        size_t colon = name.find(':');
+        if ( colon != std::string::npos && colon > 0 && name.find("::") == std::string::npos )
+            return true;
+    }
+    return false;
+}
+
+static std::string __cache_key(const string & xpath, const XPathEvaluator::NamespaceMap & namespaces)
+{
+    std::string key(xpath.stl_str());
+    for ( auto& item : namespaces )
+    {
+        key += '\x1f';
+        key += item.first.stl_str();
+        key += '=';
+        key += item.second.stl_str();
+    }
+    return key;
+}
+
 void XPathEvaluator::_XMLFunctionWrapper(xmlXPathParserContextPtr ctx, int nargs)
 {
     // find the C++ wrapper object
@@ -62,11 +208,11 @@ void XPathEvaluator::_XMLFunctionWrapper(xmlXPathParserContextPtr ctx, int nargs
 }
 
 XPathEvaluator::XPathEvaluator(const string & xpath, std::shared_ptr<const class Document> document)
-: _xpath(xpath), _document(document), _ctx(nullptr), _compiled(nullptr), _lastResult(NULL)
+: _xpath(xpath), _document(document), _namespaces(), _ctx(nullptr), _compiled(nullptr), _lastResult(NULL)
 {
+    // xmlXPathNewContext() registers all the core functions itself
     xmlDocPtr doc = const_cast<_xmlDoc*>(document->xml());
     _ctx = xmlXPathNewContext(doc);
-    xmlXPathRegisterAllFunctions(_ctx);
     
     //_compiled = xmlXPathCompile(xpath.utf8());
     
@@ -79,21 +225,58 @@ XPathEvaluator::XPathEvaluator(const string & xpath, std::shared_ptr<const class
 }
 XPathEvaluator::~XPathEvaluator()
 {
-    if ( _compiled != nullptr )
-        xmlXPathFreeCompExpr(_compiled);
     if ( _lastResult != nullptr )
         xmlXPathFreeObject(_lastResult);
     if ( _ctx != nullptr )
         xmlXPathFreeContext(_ctx);
 }
 
+void XPathEvaluator::SetXPath(const string & xpath)
+{
+    if ( _lastResult != nullptr )
+    {
+        xmlXPathFreeObject(_lastResult);
+        _lastResult = nullptr;
+    }
+    
+    _xpath = xpath;
+    _compiled.reset();
+}
+
 bool XPathEvaluator::Compile()
 {
     if (_compiled)
         return true;
     
-    _compiled = xmlXPathCompile(_xpath.utf8());
-    return _compiled != nullptr;
+    if ( __calls_prefixed_function(_xpath.stl_str()) )
+    {
+        xmlXPathCompExprPtr comp = xmlXPathCtxtCompile(_ctx, _xpath.utf8());
+        if ( comp == nullptr )
+            return false;
+        _compiled = CompiledXPath(comp, xmlXPathFreeCompExpr);
+        return true;
+    }
+    
+    std::string key = __cache_key(_xpath, _namespaces);
+    unsigned generation = 0;
+    xmlXPathCompExprPtr comp = _CompiledXPathCache().CheckOut(key, generation);
+    if ( comp == nullptr )
+    {
+        comp = xmlXPathCtxtCompile(_ctx, _xpath.utf8());
+        if ( comp == nullptr )
+            return false;
+    }
+    
+    // hand it back to the cache once this evaluator is finished with it
+    _compiled = CompiledXPath(comp, [key, generation](xmlXPathCompExprPtr p) {
+        _CompiledXPathCache().CheckIn(key, generation, p);
+    });
+    return true;
+}
+
+void XPathEvaluator::FlushCompiledExpressionCache()
+{
+    _CompiledXPathCache().Flush();
 }
 
 #if 0
@@ -102,7 +285,17 @@ bool XPathEvaluator::Compile()
 
 bool XPathEvaluator::RegisterNamespace(const string &prefix, const string &uri)
 {
-    return (xmlXPathRegisterNs(_ctx, prefix.utf8(), uri.utf8()) == 0);
+    if ( xmlXPathRegisterNs(_ctx, prefix.utf8(), uri.utf8()) != 0 )
+        return false;
+    
+    // the cache key includes the namespaces, so look the expression up again
+    auto found = _namespaces.find(prefix);
+    if ( found == _namespaces.end() || found->second != uri )
+    {
+        _namespaces[prefix] = uri;
+        _compiled.reset();
+    }
+    return true;
 }
 bool XPathEvaluator::RegisterNamespaces(const NamespaceMap &namespaces)
 {
@@ -253,9 +446,11 @@ bool XPathEvaluator::Evaluate(std::shared_ptr<const Node> node, ObjectType * res
     if ( _lastResult != nullptr )
         xmlXPathFreeObject(_lastResult);
     
+    _lastResult = nullptr;
+    
     _ctx->node = const_cast<xmlNodePtr>(node->xml());
-    if (_compiled != nullptr)
-        _lastResult = xmlXPathCompiledEval(_compiled, _ctx);
+    if (Compile())
+        _lastResult = xmlXPathCompiledEval(_compiled.get(), _ctx);
     else
         _lastResult = xmlXPathEval(_xpath.utf8(), _ctx);
     if (resultType != nullptr)
@@ -267,14 +462,19 @@ bool XPathEvaluator::EvaluateAsBoolean(std::shared_ptr<const Node> node)
     if ( _lastResult != nullptr )
         xmlXPathFreeObject(_lastResult);
     
+    _lastResult = nullptr;
+    
     _ctx->node = const_cast<xmlNodePtr>(node->xml());
     int r = 0;
-    if (_compiled != nullptr) {
-        r = xmlXPathCompiledEvalToBoolean(_compiled, _ctx);
+    if (Compile()) {
+        r = xmlXPathCompiledEvalToBoolean(_compiled.get(), _ctx);
     } else {
         xmlXPathObjectPtr obj = xmlXPathEval(_xpath.utf8(), _ctx);
         if (obj != nullptr)
+        {
             r = xmlXPathCastToBoolean(obj);
+            xmlXPathFreeObject(obj);
+        }
     }
     return ( r != 0 );
 }
@@ -36,6 +36,7 @@
 #include <libxml/xpath.h>
 #endif
 #include <functional>
+#include <memory>
 #if EPUB_USE(PTHREADS)
 # include <pthread.h>
 #endif
@@ -87,10 +88,29 @@ public:
     string XPath() const { return _xpath; }
 	std::shared_ptr<const class Document> Document() const { return _document; }
     
+    /**
+     Replaces the expression to evaluate, keeping the evaluation context (and all
+     registered namespaces, functions and variables) for the new one.
+     */
+    void SetXPath(const string & xpath);
+    
     //////////////////////////////////////////////////////////////////
     // Compilation (optional)
+    
+    /**
+     Compiles the expression against the currently-registered namespaces.
+     
+     Compiled expressions are reused process-wide: when an evaluator is destroyed or
+     given a new expression, its compiled expression goes back to a cache, and the
+     next evaluator to need the same expression with the same namespaces takes it
+     from there instead of compiling it again. Evaluate() compiles automatically.
+     */
     bool Compile();
     
+    ///
+    /// Drops all cached compiled expressions.
+    static void FlushCompiledExpressionCache();
+    
     //////////////////////////////////////////////////////////////////
     // Evaluation
     
@@ -130,15 +150,15 @@ protected:
 #endif
     string									_xpath;
 	std::shared_ptr<const class Document>	_document;
+	NamespaceMap							_namespaces;
 #if EPUB_USE(LIBXML2)
     _xmlXPathContext *      _ctx;
-    _xmlXPathCompExpr *     _compiled;
+    std::shared_ptr<_xmlXPathCompExpr>  _compiled;
     FunctionLookup          _functions;
     
     _xmlXPathObject *       _lastResult;
 #elif EPUB_USE(WIN_XML)
 	::Windows::Data::Xml::Dom::XmlNodeList^	_lastResult;
-	std::map<string, string>				_namespaces;
 #endif
 };
 
@@ -45,6 +45,15 @@ XPathEvaluator::~XPathEvaluator()
 {
 	_lastResult = nullptr;
 }
+void XPathEvaluator::SetXPath(const string & xpath)
+{
+	_xpath = xpath;
+	_lastResult = nullptr;
+}
+void XPathEvaluator::FlushCompiledExpressionCache()
+{
+	// MSXML compiles on every SelectNodes() call; there is nothing cached here
+}
 
 #if 0
 #pragma mark - XPath Environment
@@ -29,6 +29,9 @@
 
 #include "io.h"
 #include "../tree/document.h"
+#include <libxml/parser.h>
+#include <libxml/HTMLparser.h>
+#include <vector>
 
 EPUB3_XML_BEGIN_NAMESPACE
 
@@ -96,6 +99,89 @@ std::shared_ptr<Document> InputBuffer::xmlReadDocument(const char * url, const c
     }
     return Wrapped<Document>(raw);
 }
+std::shared_ptr<Document> InputBuffer::pushParseDocument(const char * url, const char * encoding, int options, bool html)
+{
+    _encodingCheck = encoding;
+    
+    std::vector<char> chunk(PushChunkSize);
+    int len = read_cb(this, chunk.data(), PushChunkSize);
+    if ( len < 0 )
+        return nullptr;
+    
+    // the first chunk goes in with the context, so the parser can sniff the encoding
+    xmlParserCtxtPtr ctxt = nullptr;
+    if ( html )
+    {
+        // unlike htmlReadMemory(), the HTML push parser neither sniffs for a BOM nor
+        // skips one, so do both here
+        xmlCharEncoding enc = XML_CHAR_ENCODING_NONE;
+        int bom = 0;
+        if ( encoding != nullptr )
+        {
+            enc = xmlParseCharEncoding(encoding);
+        }
+        else if ( len >= 4 )
+        {
+            enc = xmlDetectCharEncoding(reinterpret_cast<const xmlChar*>(chunk.data()), len);
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(chunk.data());
+            if ( enc == XML_CHAR_ENCODING_UTF8 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF )
+                bom = 3;
+            else if ( (enc == XML_CHAR_ENCODING_UTF16LE && p[0] == 0xFF && p[1] == 0xFE) || (enc == XML_CHAR_ENCODING_UTF16BE && p[0] == 0xFE && p[1] == 0xFF) )
+                bom = 2;
+        }
+        ctxt = htmlCreatePushParserCtxt(nullptr, nullptr, chunk.data() + bom, len - bom, url, enc);
+        if ( ctxt != nullptr )
+            htmlCtxtUseOptions(ctxt, options);
+    }
+    else
+    {
+        ctxt = xmlCreatePushParserCtxt(nullptr, nullptr, nullptr, 0, url);
+        if ( ctxt != nullptr )
+        {
+            xmlCtxtUseOptions(ctxt, options);
+            xmlCtxtResetPush(ctxt, chunk.data(), len, url, encoding);
+        }
+    }
+    if ( ctxt == nullptr )
+        return nullptr;
+    
+    // a fatal error with recovery disabled switches the parser off, so stop reading
+    while ( len > 0 && ctxt->disableSAX == 0 )
+    {
+        len = read_cb(this, chunk.data(), PushChunkSize);
+        if ( len <= 0 )
+            break;
+        if ( html )
+            htmlParseChunk(ctxt, chunk.data(), len, 0);
+        else
+            xmlParseChunk(ctxt, chunk.data(), len, 0);
+    }
+    if ( html )
+        htmlParseChunk(ctxt, nullptr, 0, 1);
+    else
+        xmlParseChunk(ctxt, nullptr, 0, 1);
+    
+    // same acceptance rules as xmlReadMemory() and htmlReadMemory()
+    xmlDocPtr raw = ctxt->myDoc;
+    ctxt->myDoc = nullptr;
+    if ( !html && !ctxt->wellFormed && !ctxt->recovery && raw != nullptr )
+    {
+        xmlFreeDoc(raw);
+        raw = nullptr;
+    }
+    if ( html )
+        htmlFreeParserCtxt(ctxt);
+    else
+        xmlFreeParserCtxt(ctxt);
+    
+    if (!bool(raw) || (raw->type != XML_HTML_DOCUMENT_NODE && raw->type != XML_DOCUMENT_NODE) || !bool(raw->children)) {
+        if (bool(raw)) {
+            xmlFreeDoc(raw);
+        }
+        return nullptr;
+    }
+    return Wrapped<Document>(raw);
+}
 //std::shared_ptr<Document> InputBuffer::htmlReadDocument(const char *url, const char *encoding, int options)
 //{
 //    _encodingCheck = encoding;
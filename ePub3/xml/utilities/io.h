@@ -71,6 +71,19 @@ public:
     std::shared_ptr<Document> xmlReadDocument(const char * url, const char * encoding, int options);
 //    std::shared_ptr<Document> htmlReadDocument(const char * url, const char * encoding, int options);
 
+    /**
+     Parses a document with a push parser, feeding it one chunk at a time from read().
+     
+     Unlike xmlReadDocument(), the parser never needs the whole source in memory at
+     once, and parsing proceeds as the data is produced.
+     @param url The document's base URL.
+     @param encoding The document's encoding, or `nullptr` to detect it.
+     @param options A combination of `xmlParserOption` flags.
+     @param html Whether to use the HTML parser rather than the XML parser.
+     @result The parsed document, or `nullptr` if no usable document was produced.
+     */
+    std::shared_ptr<Document> pushParseDocument(const char * url, const char * encoding, int options, bool html=false);
+
 #elif EPUB_USE(WIN_XML)
 	::Windows::Storage::IStorageFile^ File() { return _store; }
 	operator ::Windows::Storage::IStorageFile^() { return _store; }
@@ -100,6 +113,12 @@ protected:
     static int read_cb(void * context, char * buffer, int len);
     static int close_cb(void * context);
     
+#if EPUB_USE(LIBXML2)
+    ///
+    /// The size of each chunk handed to the push parser.
+    static const int PushChunkSize = 16 * 1024;
+#endif
+    
 };
 
 